@@ -0,0 +1,60 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.Esp32JsCborArrayEncoder = exports.decodeCbor = exports.encodeCbor = void 0;
+var stringbuffer_1 = require("./stringbuffer");
+/**
+ * Encodes a value as CBOR (RFC 8949). Numbers take the shortest integer or
+ * float encoding keeping their value, typed arrays, ArrayBuffers and
+ * DataViews are byte strings and dates are epoch time values. Members
+ * which JSON.stringify omits are omitted as well, undefined is kept.
+ * Throws like JSON.stringify on cyclic values.
+ */
+function encodeCbor(value) {
+    return el_cborEncode(value);
+}
+exports.encodeCbor = encodeCbor;
+/**
+ * Decodes a CBOR value, byte strings become Uint8Arrays and epoch time
+ * values Dates. Other tags are ignored. Throws a TypeError on invalid
+ * input or if data follows the value.
+ */
+function decodeCbor(data) {
+    return el_cborDecode(data);
+}
+exports.decodeCbor = decodeCbor;
+/**
+ * Encodes an array item by item without keeping the items, e.g. readings
+ * as they are taken. The items are collected to chunks of about chunkSize
+ * bytes which are passed to onChunk. The encoded array has an indefinite
+ * length, so the number of items does not need to be known in advance.
+ */
+var Esp32JsCborArrayEncoder = /** @class */ (function () {
+    function Esp32JsCborArrayEncoder(onChunk, chunkSize) {
+        if (chunkSize === void 0) { chunkSize = 1436; }
+        this.onChunk = onChunk;
+        this.chunkSize = chunkSize;
+        // start of an array of indefinite length
+        this.buffer = new stringbuffer_1.ByteBuffer(new Uint8Array([0x9f]));
+    }
+    Esp32JsCborArrayEncoder.prototype.push = function (value) {
+        this.buffer.append(el_cborEncode(value));
+        if (this.buffer.length >= this.chunkSize) {
+            this.flush();
+        }
+    };
+    /** Passes the items encoded so far to onChunk. */
+    Esp32JsCborArrayEncoder.prototype.flush = function () {
+        if (this.buffer.length > 0) {
+            var chunk = this.buffer.toBytes();
+            this.buffer.consume(chunk.length);
+            this.onChunk(chunk);
+        }
+    };
+    /** Ends the array and passes the rest to onChunk. */
+    Esp32JsCborArrayEncoder.prototype.end = function () {
+        // break code ending the array
+        this.buffer.append(new Uint8Array([0xff]));
+        this.flush();
+    };
+    return Esp32JsCborArrayEncoder;
+}());
+exports.Esp32JsCborArrayEncoder = Esp32JsCborArrayEncoder;
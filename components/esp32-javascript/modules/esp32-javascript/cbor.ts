@@ -0,0 +1,62 @@
+import { ByteBuffer } from "./stringbuffer";
+
+/**
+ * Encodes a value as CBOR (RFC 8949). Numbers take the shortest integer or
+ * float encoding keeping their value, typed arrays, ArrayBuffers and
+ * DataViews are byte strings and dates are epoch time values. Members
+ * which JSON.stringify omits are omitted as well, undefined is kept.
+ * Throws like JSON.stringify on cyclic values.
+ */
+export function encodeCbor(value: unknown): Uint8Array {
+  return el_cborEncode(value);
+}
+
+/**
+ * Decodes a CBOR value, byte strings become Uint8Arrays and epoch time
+ * values Dates. Other tags are ignored. Throws a TypeError on invalid
+ * input or if data follows the value.
+ */
+export function decodeCbor(data: Uint8Array | ArrayBuffer): unknown {
+  return el_cborDecode(data);
+}
+
+/**
+ * Encodes an array item by item without keeping the items, e.g. readings
+ * as they are taken. The items are collected to chunks of about chunkSize
+ * bytes which are passed to onChunk. The encoded array has an indefinite
+ * length, so the number of items does not need to be known in advance.
+ */
+export class Esp32JsCborArrayEncoder {
+  private buffer: ByteBuffer;
+
+  constructor(
+    private onChunk: (chunk: Uint8Array) => void,
+    private chunkSize = 1436
+  ) {
+    // start of an array of indefinite length
+    this.buffer = new ByteBuffer(new Uint8Array([0x9f]));
+  }
+
+  public push(value: unknown): void {
+    this.buffer.append(el_cborEncode(value));
+    if (this.buffer.length >= this.chunkSize) {
+      this.flush();
+    }
+  }
+
+  /** Passes the items encoded so far to onChunk. */
+  public flush(): void {
+    if (this.buffer.length > 0) {
+      const chunk = this.buffer.toBytes();
+      this.buffer.consume(chunk.length);
+      this.onChunk(chunk);
+    }
+  }
+
+  /** Ends the array and passes the rest to onChunk. */
+  public end(): void {
+    // break code ending the array
+    this.buffer.append(new Uint8Array([0xff]));
+    this.flush();
+  }
+}
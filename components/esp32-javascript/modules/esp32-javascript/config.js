@@ -4,6 +4,7 @@ var __importDefault = (this && this.__importDefault) || function (mod) {
 Object.defineProperty(exports, "__esModule", { value: true });
 exports.saveConfig = exports.reloadConfig = exports.config = void 0;
 var firmware_config_1 = __importDefault(require("./firmware-config"));
+var json_writer_1 = require("./json-writer");
 var CONFIG_PATH = "/data/config.js";
 function reloadConfig() {
     try {
@@ -18,7 +19,9 @@ exports.reloadConfig = reloadConfig;
 function saveConfig(config) {
     try {
         console.debug("Saving config.");
-        writeFile(CONFIG_PATH, JSON.stringify(config));
+        if (json_writer_1.writeJsonFile(CONFIG_PATH, config) < 0) {
+            throw Error("Could not write config");
+        }
         console.debug("Reloading config.");
         reloadConfig();
     }
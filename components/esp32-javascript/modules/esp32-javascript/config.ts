@@ -1,4 +1,5 @@
 import firmwareConfig from "./firmware-config";
+import { writeJsonFile } from "./json-writer";
 export interface Esp32JsConfig {
   access: {
     username: string;
@@ -33,7 +34,9 @@ export function reloadConfig(): void {
 export function saveConfig(config: Esp32JsConfig): void {
   try {
     console.debug("Saving config.");
-    writeFile(CONFIG_PATH, JSON.stringify(config));
+    if (writeJsonFile(CONFIG_PATH, config) < 0) {
+      throw Error("Could not write config");
+    }
     console.debug("Reloading config.");
     reloadConfig();
   } catch (error) {
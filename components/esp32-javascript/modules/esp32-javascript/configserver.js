@@ -10,10 +10,14 @@ var __assign = (this && this.__assign) || function () {
     return __assign.apply(this, arguments);
 };
 Object.defineProperty(exports, "__esModule", { value: true });
-exports.startConfigServer = exports.redirect = exports.baExceptionPathes = exports.requestHandler = exports.addSchema = void 0;
+exports.startConfigServer = exports.redirect = exports.uploadLimit = exports.baExceptionPathes = exports.requestHandler = exports.router = exports.addSchema = void 0;
 var configManager = require("./config");
 var boot_1 = require("./boot");
 var http_1 = require("./http");
+var json_writer_1 = require("./json-writer");
+var multipart_1 = require("./multipart");
+var router_1 = require("./router");
+var static_files_1 = require("./static-files");
 var schema = {
     access: {
         type: "object",
@@ -85,8 +89,34 @@ function addSchema(additional) {
     schema = __assign(__assign({}, schema), additional);
 }
 exports.addSchema = addSchema;
+/**
+ * Routes of the config server. Requests no route matches are passed to
+ * the handlers in {@link requestHandler}.
+ */
+exports.router = new router_1.Router();
 exports.requestHandler = [];
 exports.baExceptionPathes = [];
+/**
+ * Files can be uploaded with PUT /files/<name> or with the form of the setup
+ * page. They are written natively to /data/files/<name> without buffering
+ * them in RAM.
+ */
+exports.uploadLimit = 64 * 1024;
+var uploadPath = /^\/files\/([A-Za-z0-9._-]+)$/;
+// the name of a file uploaded with a form without its path, null if it is not allowed
+function uploadName(filename) {
+    var name = filename.replace(/^.*[\\/]/, "");
+    return uploadPath.test("/files/" + name) && name.charAt(0) !== "."
+        ? name
+        : null;
+}
+// prefers an uploaded copy of a CDN asset, so pages work without internet
+function asset(name, url) {
+    var path = "/data/files/" + name;
+    return fileStat(path) || fileStat(path + ".gz")
+        ? "/files/" + name
+        : url;
+}
 function redirect(res, location) {
     res.setStatus(302);
     res.headers.set("location", location);
@@ -101,6 +131,7 @@ function page(res, headline, text, cb) {
     }
     res.setStatus(200);
     res.headers.set("content-type", "text/html");
+    res.compress();
     res.write("<!doctype html><html><head><title>esp32-javascript</title>\n      <meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">\n      <style>\n      body {\n        font-family: monospace;\n        font-size: 13pt;\n      }\n      .input {\n        font-family: monospace;\n        font-size: 13pt;\n      }\n      .fill {\n        width: calc(100% - 146px);\n      }\n      .full {\n        width: calc(100% - 16px);\n      }\n      .txt {\n        height: 100px;\n      }\n      .formlabel {\n        display: inline-block;\n        width: 130px;\n      }\n      .formpad {\n        padding: 8px;\n      }\n      .green {\n        color: green;\n      }\n      .red {\n        color: red;\n      }\n      </style>\n      \n      </head>\n      <body><div><div><div><h1>" + headline + "</h1>");
     if (Array.isArray(text)) {
         res.write(text.join(""));
@@ -110,14 +141,51 @@ function page(res, headline, text, cb) {
     }
     res.end("</div></div></div></body></html>\r\n\r\n");
 }
+function setupPage(req, res) {
+    var _a, _b, _c, _d, _e;
+    var saved = false;
+    var error = undefined;
+    if (req.path === "/setup" && req.method === "POST") {
+        try {
+            var storedConfig = configManager.config;
+            if (!storedConfig.wifi) {
+                storedConfig.wifi = {};
+            }
+            if (!storedConfig.ota) {
+                storedConfig.ota = {};
+            }
+            var form = req.form;
+            if (form && form.error) {
+                throw Error("Malformed form data (" + form.error + ")");
+            }
+            var config_1 = form ? form.fields : http_1.parseQueryStr(req.body);
+            storedConfig.wifi.ssid = config_1.ssid;
+            storedConfig.wifi.password = config_1.password;
+            storedConfig.ota.url = config_1.url;
+            storedConfig.ota.offline = config_1.offline === "true";
+            storedConfig.ota.script = config_1.script;
+            configManager.saveConfig(storedConfig);
+            saved = true;
+        }
+        catch (err) {
+            error = err;
+        }
+    }
+    var config = configManager.config;
+    page(res, "Setup", "" + (saved
+        ? '<div class="formpad green">Saved. Some settings require a restart.</div>'
+        : "") + (error
+        ? "<div class=\"formpad red\">Saving failed. Error message: " + error + "</div>"
+        : "") + "<form action=\"/setup\" method=\"post\" enctype=\"multipart/form-data\">\n        <div class=\"formpad\"><label for=\"ssid\" class=\"formlabel\">SSID</label><input type=\"text\" name=\"ssid\" class=\"fill input\" value=\"" + (((_a = config.wifi) === null || _a === void 0 ? void 0 : _a.ssid) || "") + "\" /></div>\n        <div class=\"formpad\"><label for=\"password\" class=\"formlabel\">Password</label><input type=\"text\" name=\"password\" class=\"fill input\" value=\"" + (((_b = config.wifi) === null || _b === void 0 ? void 0 : _b.password) || "") + "\" /></div>\n        <div class=\"formpad\"><label for=\"url\" class=\"formlabel\">JS file url</label><input type=\"text\" name=\"url\" class=\"fill input\" value=\"" + (((_c = config.ota) === null || _c === void 0 ? void 0 : _c.url) || "") + "\" /></div>\n        <div class=\"formpad\"><label for=\"offline\"><input type=\"checkbox\" name=\"offline\" value=\"true\" " + (((_d = config.ota) === null || _d === void 0 ? void 0 : _d.offline) ? "checked" : "") + "/> Offline Mode</label></div>\n        <label for=\"script\" class=\"formpad\">Offline Script</label><div class=\"formpad\"><textarea name=\"script\" class=\"full input txt\">" + (((_e = config.ota) === null || _e === void 0 ? void 0 : _e.script) || "") + "</textarea></div>\n        <div class=\"formpad\"><input type=\"submit\" value=\"Save\" class=\"formpad input\"/></div></form>\n        <h1>Upload file</h1>\n        <form action=\"/files\" method=\"post\" enctype=\"multipart/form-data\"><div class=\"formpad\"><input type=\"file\" name=\"file\" class=\"input\"/></div>\n        <div class=\"formpad\"><input type=\"submit\" value=\"Upload\" class=\"formpad input\"/></div></form>\n        <h1>Request restart</h1>\n        <form action=\"/restart\" method=\"post\"><div class=\"formpad\"><input type=\"submit\" value=\"Restart\" class=\"formpad input\"/></div></form>\n        <h1>Uptime</h1>\n        <div class=\"formpad\">\n          Boot time: " + boot_1.getBootTime() + "\n        </div>\n        <div class=\"formpad\">\n          Uptime (hours): " + Math.floor((Date.now() - boot_1.getBootTime().getTime()) / 10 / 60 / 60) /
+        100 + "<br />\n        </div>\n        <div class=\"formpad\">\n          Boot time is only available if a valid 'JS file url' is configured, otherwise it starts at unix epoch (1970).\n        </div>");
+}
 function startConfigServer() {
     console.info("Starting config server.");
     var authString = "Basic " +
         btoa(configManager.config.access.username +
             ":" +
             configManager.config.access.password);
-    http_1.httpServer(80, false, function (req, res) {
-        var _a, _b, _c, _d, _e;
+    exports.router.use(function (req, res, next) {
         if (req.headers.get("authorization") !== authString &&
             exports.baExceptionPathes.indexOf(req.path) < 0) {
             console.debug("401 response");
@@ -125,45 +193,12 @@ function startConfigServer() {
             res.headers.set("WWW-Authenticate", 'Basic realm="Enter credentials"');
             res.end("401 Unauthorized");
         }
-        else if (req.path === "/restart" && req.method === "POST") {
-            page(res, "Restart", '<div class="formpad green">Restarting... please wait. <a href="/">Home</a></div>', function () {
-                setTimeout(restart, 1000);
-            });
-        }
-        else if (req.path === "/setup" || req.path === "/restart") {
-            var saved = false;
-            var error = undefined;
-            if (req.path === "/setup" && req.method === "POST") {
-                try {
-                    var storedConfig = configManager.config;
-                    if (!storedConfig.wifi) {
-                        storedConfig.wifi = {};
-                    }
-                    if (!storedConfig.ota) {
-                        storedConfig.ota = {};
-                    }
-                    var config_1 = http_1.parseQueryStr(req.body);
-                    storedConfig.wifi.ssid = config_1.ssid;
-                    storedConfig.wifi.password = config_1.password;
-                    storedConfig.ota.url = config_1.url;
-                    storedConfig.ota.offline = config_1.offline === "true";
-                    storedConfig.ota.script = config_1.script;
-                    configManager.saveConfig(storedConfig);
-                    saved = true;
-                }
-                catch (err) {
-                    error = err;
-                }
-            }
-            var config = configManager.config;
-            page(res, "Setup", "" + (saved
-                ? '<div class="formpad green">Saved. Some settings require a restart.</div>'
-                : "") + (error
-                ? "<div class=\"formpad red\">Saving failed. Error message: " + error + "</div>"
-                : "") + "<form action=\"/setup\" method=\"post\">\n        <div class=\"formpad\"><label for=\"ssid\" class=\"formlabel\">SSID</label><input type=\"text\" name=\"ssid\" class=\"fill input\" value=\"" + (((_a = config.wifi) === null || _a === void 0 ? void 0 : _a.ssid) || "") + "\" /></div>\n        <div class=\"formpad\"><label for=\"password\" class=\"formlabel\">Password</label><input type=\"text\" name=\"password\" class=\"fill input\" value=\"" + (((_b = config.wifi) === null || _b === void 0 ? void 0 : _b.password) || "") + "\" /></div>\n        <div class=\"formpad\"><label for=\"url\" class=\"formlabel\">JS file url</label><input type=\"text\" name=\"url\" class=\"fill input\" value=\"" + (((_c = config.ota) === null || _c === void 0 ? void 0 : _c.url) || "") + "\" /></div>\n        <div class=\"formpad\"><label for=\"offline\"><input type=\"checkbox\" name=\"offline\" value=\"true\" " + (((_d = config.ota) === null || _d === void 0 ? void 0 : _d.offline) ? "checked" : "") + "/> Offline Mode</label></div>\n        <label for=\"script\" class=\"formpad\">Offline Script</label><div class=\"formpad\"><textarea name=\"script\" class=\"full input txt\">" + (((_e = config.ota) === null || _e === void 0 ? void 0 : _e.script) || "") + "</textarea></div>\n        <div class=\"formpad\"><input type=\"submit\" value=\"Save\" class=\"formpad input\"/></div></form>\n        <h1>Request restart</h1>\n        <form action=\"/restart\" method=\"post\"><div class=\"formpad\"><input type=\"submit\" value=\"Restart\" class=\"formpad input\"/></div></form>\n        <h1>Uptime</h1>\n        <div class=\"formpad\">\n          Boot time: " + boot_1.getBootTime() + "\n        </div>\n        <div class=\"formpad\">\n          Uptime (hours): " + Math.floor((Date.now() - boot_1.getBootTime().getTime()) / 10 / 60 / 60) /
-                100 + "<br />\n        </div>\n        <div class=\"formpad\">\n          Boot time is only available if a valid 'JS file url' is configured, otherwise it starts at unix epoch (1970).\n        </div>");
-        }
         else {
+            next();
+        }
+    });
+    http_1.httpServer(80, false, function (req, res) {
+        exports.router.handle(req, res, function () {
             var handled = false;
             for (var i = 0; i < exports.requestHandler.length; i++) {
                 if (!res.isEnded) {
@@ -183,57 +218,118 @@ function startConfigServer() {
                 }
             }
             if (!handled && !res.isEnded) {
-                if (req.path === "/") {
-                    redirect(res, "/setup");
-                }
-                else {
-                    res.setStatus(404, "Not found");
-                    res.headers.set("Content-type", "text/plain");
-                    res.end("Not found");
-                }
+                res.setStatus(404, "Not found");
+                res.headers.set("Content-type", "text/plain");
+                res.end("Not found");
+            }
+        });
+    }, function (req) {
+        var upload = uploadPath.exec(req.path);
+        if (req.method === "PUT" && upload) {
+            if (req.headers.get("authorization") !== authString) {
+                // discard the body, the request is answered with 401
+                return { onData: function () { }, maxSize: exports.uploadLimit };
             }
+            return { file: "/data/files/" + upload[1], maxSize: exports.uploadLimit };
         }
+        if (req.method === "POST" &&
+            (req.path === "/setup" || req.path === "/files")) {
+            if (req.headers.get("authorization") !== authString) {
+                return { onData: function () { }, maxSize: exports.uploadLimit };
+            }
+            return multipart_1.receiveMultipart(req, {
+                // the file or offline script and the other fields
+                maxSize: 2 * exports.uploadLimit,
+                maxFieldSize: exports.uploadLimit,
+                onPart: function (part) {
+                    if (part.filename === null) {
+                        // form fields are collected in req.form.fields
+                        return;
+                    }
+                    var name = uploadName(part.filename);
+                    if (req.path === "/files" && part.name === "file" && name) {
+                        return { file: "/data/files/" + name, maxSize: exports.uploadLimit };
+                    }
+                    // other files are dropped
+                    return { maxSize: exports.uploadLimit };
+                },
+            });
+        }
+    });
+    exports.router.get("/", function (req, res) {
+        redirect(res, "/setup");
+    });
+    exports.router.route("*", "/setup", setupPage);
+    exports.router.get("/restart", setupPage);
+    exports.router.post("/restart", function (req, res) {
+        page(res, "Restart", '<div class="formpad green">Restarting... please wait. <a href="/">Home</a></div>', function () {
+            setTimeout(restart, 1000);
+        });
     });
-    exports.requestHandler.push(function (req, res) {
-        if (req.path === "/config") {
-            res.setStatus(200);
-            res.headers.set("Content-type", "text/html");
-            res.end("<html>\n      <head>\n        <title>Configuration</title>\n        <meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">\n        <link \n          rel=\"stylesheet\" \n          href=\"https://bootswatch.com/4/united/bootstrap.min.css\" \n          crossorigin=\"anonymous\"\n        />\n        <link\n          rel=\"stylesheet\"\n          href=\"https://use.fontawesome.com/releases/v5.6.1/css/all.css\"\n          crossorigin=\"anonymous\"\n        />\n      </head>\n      <body>\n        <div class=\"container\">\n          <div id=\"editor_holder\"></div>\n          <p>\n            <form action=\"/restart\" method=\"post\">\n              <button\n                type=\"button\"\n                class=\"btn btn-primary\"\n                onclick=\"save(editor.getValue())\"\n              >\n                Save\n              </button>\n              <button\n                type=\"submit\"\n                class=\"btn btn-secondary\"\n              >\n                Restart\n              </button>\n            </form>\n          </p>\n        </div>\n        <script\n          src=\"https://code.jquery.com/jquery-3.2.1.slim.min.js\"\n          integrity=\"sha384-KJ3o2DKtIkvYIK3UENzmM7KCkRr/rE9/Qpg6aAZGJwFDMVNA/GpGFF93hXpG5KkN\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script\n          src=\"https://cdnjs.cloudflare.com/ajax/libs/popper.js/1.12.9/umd/popper.min.js\"\n          integrity=\"sha384-ApNbgh9B+Y1QKtv3Rn7W3mgPxhU9K/ScQsAP7hUibX39j7fakFPskvXusvfa0b4Q\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script\n          src=\"https://maxcdn.bootstrapcdn.com/bootstrap/4.0.0/js/bootstrap.min.js\"\n          integrity=\"sha384-JZR6Spejh4U02d8jOt6vLEHfe/JQGiRRSQQxSfFWpi1MquVdAyjUar5+76PVCmYl\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script src=\"https://cdn.jsdelivr.net/npm/@json-editor/json-editor@latest/dist/jsoneditor.min.js\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script>\n          const element = document.getElementById(\"editor_holder\");\n          const editor = new JSONEditor(element, \n            {\n              theme: \"bootstrap4\",\n              iconlib: \"fontawesome5\",\n              disable_edit_json: true,\n              disable_array_delete_all_rows: true,\n              disable_array_delete_last_row: true,\n              ajax: true,\n              schema: {\n                $schema: \"http://json-schema.org/draft-07/schema\",\n                $ref: '/config/schema'\n              }\n            });\n          editor.on('ready', () => {\n            editor.disable();\n            fetch('/config/current').then(r=>r.json()).then(data => {\n              editor.setValue(data);\n              editor.enable();\n            });\n          });\n\n          function save(data)\n          {\n            fetch('/config/current', { method: 'POST', body: JSON.stringify(data)}).then(()=>alert('Saved. Some settings may require a restart.'));\n          }\n        </script>\n      </body>\n    </html>");
+    exports.router.put("/files/:name", function (req, res) {
+        if (uploadPath.test(req.path)) {
+            // the body was already written to /data/files by the http server
+            res.setStatus(201);
+            res.end("Saved.");
+        }
+        else {
+            res.setStatus(400);
+            res.end("Invalid file name.");
         }
     });
-    exports.requestHandler.push(function (req, res) {
-        if (req.path === "/config/schema") {
-            res.setStatus(200);
-            res.headers.set("Content-type", "application/json");
-            res.end("\n      {\n        \"type\": \"object\",\n        \"format\": \"categories\",\n        \"options\": {\n          \"disable_collapse\": true,\n          \"disable_properties\": true\n        },\n        \"title\": \"Configuration\",\n        \"description\": \"Configure every aspect.\",\n        \"additionalProperties\": false,\n        \"required\": " + JSON.stringify(Object.keys(schema)) + ",\n        \"properties\": " + JSON.stringify(schema) + "\n      }");
+    exports.router.post("/files", function (req, res) {
+        var form = req.form;
+        var file = form && !form.error ? form.files.file : undefined;
+        if (file) {
+            var path = file.substring(5);
+            page(res, "Upload file", "<div class=\"formpad green\">Saved as <a href=\"" + path + "\">" + path + "</a>. <a href=\"/setup\">Back</a></div>");
         }
+        else {
+            page(res, "Upload file", "<div class=\"formpad red\">Upload failed" + (form && form.error ? " (" + form.error + ")" : "") + ". <a href=\"/setup\">Back</a></div>");
+        }
+    });
+    exports.router.get("/files/*", static_files_1.serveStatic("/data/files"));
+    exports.router.get("/config", function (req, res) {
+        var bootstrapCss = asset("bootstrap.min.css", "https://bootswatch.com/4/united/bootstrap.min.css");
+        var fontawesomeCss = asset("all.css", "https://use.fontawesome.com/releases/v5.6.1/css/all.css");
+        var jquery = asset("jquery-3.2.1.slim.min.js", "https://code.jquery.com/jquery-3.2.1.slim.min.js");
+        var popper = asset("popper.min.js", "https://cdnjs.cloudflare.com/ajax/libs/popper.js/1.12.9/umd/popper.min.js");
+        var bootstrap = asset("bootstrap.min.js", "https://maxcdn.bootstrapcdn.com/bootstrap/4.0.0/js/bootstrap.min.js");
+        var jsoneditor = asset("jsoneditor.min.js", "https://cdn.jsdelivr.net/npm/@json-editor/json-editor@latest/dist/jsoneditor.min.js");
+        res.setStatus(200);
+        res.headers.set("Content-type", "text/html");
+        res.compress();
+        res.end("<html>\n      <head>\n        <title>Configuration</title>\n        <meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">\n        <link \n          rel=\"stylesheet\" \n          href=\"" + bootstrapCss + "\" \n          crossorigin=\"anonymous\"\n        />\n        <link\n          rel=\"stylesheet\"\n          href=\"" + fontawesomeCss + "\"\n          crossorigin=\"anonymous\"\n        />\n      </head>\n      <body>\n        <div class=\"container\">\n          <div id=\"editor_holder\"></div>\n          <p>\n            <form action=\"/restart\" method=\"post\">\n              <button\n                type=\"button\"\n                class=\"btn btn-primary\"\n                onclick=\"save(editor.getValue())\"\n              >\n                Save\n              </button>\n              <button\n                type=\"submit\"\n                class=\"btn btn-secondary\"\n              >\n                Restart\n              </button>\n            </form>\n          </p>\n        </div>\n        <script\n          src=\"" + jquery + "\"\n          integrity=\"sha384-KJ3o2DKtIkvYIK3UENzmM7KCkRr/rE9/Qpg6aAZGJwFDMVNA/GpGFF93hXpG5KkN\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script\n          src=\"" + popper + "\"\n          integrity=\"sha384-ApNbgh9B+Y1QKtv3Rn7W3mgPxhU9K/ScQsAP7hUibX39j7fakFPskvXusvfa0b4Q\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script\n          src=\"" + bootstrap + "\"\n          integrity=\"sha384-JZR6Spejh4U02d8jOt6vLEHfe/JQGiRRSQQxSfFWpi1MquVdAyjUar5+76PVCmYl\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script src=\"" + jsoneditor + "\"\n          crossorigin=\"anonymous\"\n        ></script>\n        <script>\n          const element = document.getElementById(\"editor_holder\");\n          const editor = new JSONEditor(element, \n            {\n              theme: \"bootstrap4\",\n              iconlib: \"fontawesome5\",\n              disable_edit_json: true,\n              disable_array_delete_all_rows: true,\n              disable_array_delete_last_row: true,\n              ajax: true,\n              schema: {\n                $schema: \"http://json-schema.org/draft-07/schema\",\n                $ref: '/config/schema'\n              }\n            });\n          editor.on('ready', () => {\n            editor.disable();\n            fetch('/config/current').then(r=>r.json()).then(data => {\n              editor.setValue(data);\n              editor.enable();\n            });\n          });\n\n          function save(data)\n          {\n            fetch('/config/current', { method: 'POST', body: JSON.stringify(data)}).then(()=>alert('Saved. Some settings may require a restart.'));\n          }\n        </script>\n      </body>\n    </html>");
+    });
+    exports.router.get("/config/schema", function (req, res) {
+        res.setStatus(200);
+        res.headers.set("Content-type", "application/json");
+        res.compress();
+        res.end("\n      {\n        \"type\": \"object\",\n        \"format\": \"categories\",\n        \"options\": {\n          \"disable_collapse\": true,\n          \"disable_properties\": true\n        },\n        \"title\": \"Configuration\",\n        \"description\": \"Configure every aspect.\",\n        \"additionalProperties\": false,\n        \"required\": " + JSON.stringify(Object.keys(schema)) + ",\n        \"properties\": " + JSON.stringify(schema) + "\n      }");
+    });
+    exports.router.get("/config/current", function (req, res) {
+        res.setStatus(200);
+        res.headers.set("Content-type", "application/json");
+        res.compress();
+        json_writer_1.sendJson(res, configManager.config);
     });
-    exports.requestHandler.push(function (req, res) {
-        if (req.path === "/config/current") {
-            if (req.method === "GET") {
-                res.setStatus(200);
-                res.headers.set("Content-type", "application/json");
-                res.end(JSON.stringify(configManager.config));
+    exports.router.post("/config/current", function (req, res) {
+        try {
+            if (req.body) {
+                configManager.saveConfig(JSON.parse(req.body));
+                res.setStatus(204);
+                res.end();
             }
-            else if (req.method === "POST") {
-                try {
-                    if (req.body) {
-                        configManager.saveConfig(JSON.parse(req.body));
-                        res.setStatus(204);
-                        res.end();
-                    }
-                    else {
-                        res.setStatus(400);
-                        res.end("No config provided.");
-                    }
-                }
-                catch (error) {
-                    console.error(error);
-                    res.setStatus(500);
-                    res.end("Internal server error while saving configuration.");
-                }
+            else {
+                res.setStatus(400);
+                res.end("No config provided.");
             }
         }
+        catch (error) {
+            console.error(error);
+            res.setStatus(500);
+            res.end("Internal server error while saving configuration.");
+        }
     });
 }
 exports.startConfigServer = startConfigServer;
@@ -7,6 +7,10 @@ import {
   parseQueryStr,
   Esp32JsRequest,
 } from "./http";
+import { sendJson } from "./json-writer";
+import { receiveMultipart } from "./multipart";
+import { Router } from "./router";
+import { serveStatic } from "./static-files";
 
 let schema = {
   access: {
@@ -80,12 +84,42 @@ export function addSchema(additional: any): void {
   schema = { ...schema, ...additional };
 }
 
+/**
+ * Routes of the config server. Requests no route matches are passed to
+ * the handlers in {@link requestHandler}.
+ */
+export const router = new Router();
+
 export const requestHandler: ((
   req: Esp32JsRequest,
   res: Esp32JsResponse
 ) => void | boolean)[] = [];
 export const baExceptionPathes: string[] = [];
 
+/**
+ * Files can be uploaded with PUT /files/<name> or with the form of the setup
+ * page. They are written natively to /data/files/<name> without buffering
+ * them in RAM.
+ */
+export const uploadLimit = 64 * 1024;
+const uploadPath = /^\/files\/([A-Za-z0-9._-]+)$/;
+
+// the name of a file uploaded with a form without its path, null if it is not allowed
+function uploadName(filename: string): string | null {
+  const name = filename.replace(/^.*[\\/]/, "");
+  return uploadPath.test("/files/" + name) && name.charAt(0) !== "."
+    ? name
+    : null;
+}
+
+// prefers an uploaded copy of a CDN asset, so pages work without internet
+function asset(name: string, url: string) {
+  const path = "/data/files/" + name;
+  return fileStat(path) || fileStat(path + ".gz")
+    ? "/files/" + name
+    : url;
+}
+
 export function redirect(res: Esp32JsResponse, location: string): void {
   res.setStatus(302);
   res.headers.set("location", location);
@@ -106,6 +140,7 @@ function page(
 
   res.setStatus(200);
   res.headers.set("content-type", "text/html");
+  res.compress();
 
   res.write(`<!doctype html><html><head><title>esp32-javascript</title>
       <meta name="viewport" content="width=device-width, initial-scale=1, shrink-to-fit=no">
@@ -152,73 +187,50 @@ function page(
   res.end("</div></div></div></body></html>\r\n\r\n");
 }
 
-export function startConfigServer(): void {
-  console.info("Starting config server.");
-  const authString =
-    "Basic " +
-    btoa(
-      configManager.config.access.username +
-        ":" +
-        configManager.config.access.password
-    );
-  httpServer(80, false, function (req, res) {
-    if (
-      req.headers.get("authorization") !== authString &&
-      baExceptionPathes.indexOf(req.path) < 0
-    ) {
-      console.debug("401 response");
-      res.setStatus(401);
-      res.headers.set("WWW-Authenticate", 'Basic realm="Enter credentials"');
-      res.end("401 Unauthorized");
-    } else if (req.path === "/restart" && req.method === "POST") {
-      page(
-        res,
-        "Restart",
-        '<div class="formpad green">Restarting... please wait. <a href="/">Home</a></div>',
-        function () {
-          setTimeout(restart, 1000);
-        }
-      );
-    } else if (req.path === "/setup" || req.path === "/restart") {
-      let saved = false;
-      let error = undefined;
-
-      if (req.path === "/setup" && req.method === "POST") {
-        try {
-          const storedConfig = configManager.config;
-          if (!storedConfig.wifi) {
-            storedConfig.wifi = {};
-          }
-          if (!storedConfig.ota) {
-            storedConfig.ota = {};
-          }
+function setupPage(req: Esp32JsRequest, res: Esp32JsResponse): void {
+  let saved = false;
+  let error = undefined;
 
-          const config = parseQueryStr(req.body);
-          storedConfig.wifi.ssid = config.ssid;
-          storedConfig.wifi.password = config.password;
-          storedConfig.ota.url = config.url;
-          storedConfig.ota.offline = config.offline === "true";
-          storedConfig.ota.script = config.script;
+  if (req.path === "/setup" && req.method === "POST") {
+    try {
+      const storedConfig = configManager.config;
+      if (!storedConfig.wifi) {
+        storedConfig.wifi = {};
+      }
+      if (!storedConfig.ota) {
+        storedConfig.ota = {};
+      }
 
-          configManager.saveConfig(storedConfig);
-          saved = true;
-        } catch (err) {
-          error = err;
-        }
+      const form = req.form;
+      if (form && form.error) {
+        throw Error(`Malformed form data (${form.error})`);
       }
-      const config = configManager.config;
-      page(
-        res,
-        "Setup",
-        `${
-          saved
-            ? '<div class="formpad green">Saved. Some settings require a restart.</div>'
-            : ""
-        }${
-          error
-            ? `<div class="formpad red">Saving failed. Error message: ${error}</div>`
-            : ""
-        }<form action="/setup" method="post">
+      const config = form ? form.fields : parseQueryStr(req.body);
+      storedConfig.wifi.ssid = config.ssid;
+      storedConfig.wifi.password = config.password;
+      storedConfig.ota.url = config.url;
+      storedConfig.ota.offline = config.offline === "true";
+      storedConfig.ota.script = config.script;
+
+      configManager.saveConfig(storedConfig);
+      saved = true;
+    } catch (err) {
+      error = err;
+    }
+  }
+  const config = configManager.config;
+  page(
+    res,
+    "Setup",
+    `${
+      saved
+        ? '<div class="formpad green">Saved. Some settings require a restart.</div>'
+        : ""
+    }${
+      error
+        ? `<div class="formpad red">Saving failed. Error message: ${error}</div>`
+        : ""
+    }<form action="/setup" method="post" enctype="multipart/form-data">
         <div class="formpad"><label for="ssid" class="formlabel">SSID</label><input type="text" name="ssid" class="fill input" value="${
           config.wifi?.ssid || ""
         }" /></div>
@@ -235,6 +247,9 @@ export function startConfigServer(): void {
           config.ota?.script || ""
         }</textarea></div>
         <div class="formpad"><input type="submit" value="Save" class="formpad input"/></div></form>
+        <h1>Upload file</h1>
+        <form action="/files" method="post" enctype="multipart/form-data"><div class="formpad"><input type="file" name="file" class="input"/></div>
+        <div class="formpad"><input type="submit" value="Upload" class="formpad input"/></div></form>
         <h1>Request restart</h1>
         <form action="/restart" method="post"><div class="formpad"><input type="submit" value="Restart" class="formpad input"/></div></form>
         <h1>Uptime</h1>
@@ -250,53 +265,187 @@ export function startConfigServer(): void {
         <div class="formpad">
           Boot time is only available if a valid 'JS file url' is configured, otherwise it starts at unix epoch (1970).
         </div>`
-      );
+  );
+}
+
+export function startConfigServer(): void {
+  console.info("Starting config server.");
+  const authString =
+    "Basic " +
+    btoa(
+      configManager.config.access.username +
+        ":" +
+        configManager.config.access.password
+    );
+  router.use(function (req, res, next) {
+    if (
+      req.headers.get("authorization") !== authString &&
+      baExceptionPathes.indexOf(req.path) < 0
+    ) {
+      console.debug("401 response");
+      res.setStatus(401);
+      res.headers.set("WWW-Authenticate", 'Basic realm="Enter credentials"');
+      res.end("401 Unauthorized");
     } else {
-      let handled = false;
-      for (let i = 0; i < requestHandler.length; i++) {
-        if (!res.isEnded) {
-          try {
-            const reqHandled = requestHandler[i](req, res);
-            handled = Boolean(handled || reqHandled);
-          } catch (error) {
-            const errorMessage = "Internal server error: " + error;
-            console.error(errorMessage);
-            if (!res.isEnded) {
-              res.setStatus(500);
-              res.headers.set("Content-type", "text/plain");
-              res.end(errorMessage);
+      next();
+    }
+  });
+
+  httpServer(
+    80,
+    false,
+    function (req, res) {
+      router.handle(req, res, function () {
+        let handled = false;
+        for (let i = 0; i < requestHandler.length; i++) {
+          if (!res.isEnded) {
+            try {
+              const reqHandled = requestHandler[i](req, res);
+              handled = Boolean(handled || reqHandled);
+            } catch (error) {
+              const errorMessage = "Internal server error: " + error;
+              console.error(errorMessage);
+              if (!res.isEnded) {
+                res.setStatus(500);
+                res.headers.set("Content-type", "text/plain");
+                res.end(errorMessage);
+              }
             }
           }
         }
-      }
-      if (!handled && !res.isEnded) {
-        if (req.path === "/") {
-          redirect(res, "/setup");
-        } else {
+        if (!handled && !res.isEnded) {
           res.setStatus(404, "Not found");
           res.headers.set("Content-type", "text/plain");
           res.end("Not found");
         }
+      });
+    },
+    function (req) {
+      const upload = uploadPath.exec(req.path);
+      if (req.method === "PUT" && upload) {
+        if (req.headers.get("authorization") !== authString) {
+          // discard the body, the request is answered with 401
+          return { onData: function () {}, maxSize: uploadLimit };
+        }
+        return { file: `/data/files/${upload[1]}`, maxSize: uploadLimit };
+      }
+      if (
+        req.method === "POST" &&
+        (req.path === "/setup" || req.path === "/files")
+      ) {
+        if (req.headers.get("authorization") !== authString) {
+          return { onData: function () {}, maxSize: uploadLimit };
+        }
+        return receiveMultipart(req, {
+          // the file or offline script and the other fields
+          maxSize: 2 * uploadLimit,
+          maxFieldSize: uploadLimit,
+          onPart: function (part) {
+            if (part.filename === null) {
+              // form fields are collected in req.form.fields
+              return;
+            }
+            const name = uploadName(part.filename);
+            if (req.path === "/files" && part.name === "file" && name) {
+              return { file: `/data/files/${name}`, maxSize: uploadLimit };
+            }
+            // other files are dropped
+            return { maxSize: uploadLimit };
+          },
+        });
       }
     }
+  );
+
+  router.get("/", function (req, res) {
+    redirect(res, "/setup");
+  });
+  router.route("*", "/setup", setupPage);
+  router.get("/restart", setupPage);
+  router.post("/restart", function (req, res) {
+    page(
+      res,
+      "Restart",
+      '<div class="formpad green">Restarting... please wait. <a href="/">Home</a></div>',
+      function () {
+        setTimeout(restart, 1000);
+      }
+    );
   });
 
-  requestHandler.push((req, res) => {
-    if (req.path === "/config") {
-      res.setStatus(200);
-      res.headers.set("Content-type", "text/html");
-      res.end(`<html>
+  router.put("/files/:name", function (req, res) {
+    if (uploadPath.test(req.path)) {
+      // the body was already written to /data/files by the http server
+      res.setStatus(201);
+      res.end("Saved.");
+    } else {
+      res.setStatus(400);
+      res.end("Invalid file name.");
+    }
+  });
+
+  router.post("/files", function (req, res) {
+    const form = req.form;
+    const file = form && !form.error ? form.files.file : undefined;
+    if (file) {
+      const path = file.substring(5);
+      page(
+        res,
+        "Upload file",
+        `<div class="formpad green">Saved as <a href="${path}">${path}</a>. <a href="/setup">Back</a></div>`
+      );
+    } else {
+      page(
+        res,
+        "Upload file",
+        `<div class="formpad red">Upload failed${
+          form && form.error ? ` (${form.error})` : ""
+        }. <a href="/setup">Back</a></div>`
+      );
+    }
+  });
+  router.get("/files/*", serveStatic("/data/files"));
+
+  router.get("/config", function (req, res) {
+    const bootstrapCss = asset(
+      "bootstrap.min.css",
+      "https://bootswatch.com/4/united/bootstrap.min.css"
+    );
+    const fontawesomeCss = asset(
+      "all.css",
+      "https://use.fontawesome.com/releases/v5.6.1/css/all.css"
+    );
+    const jquery = asset(
+      "jquery-3.2.1.slim.min.js",
+      "https://code.jquery.com/jquery-3.2.1.slim.min.js"
+    );
+    const popper = asset(
+      "popper.min.js",
+      "https://cdnjs.cloudflare.com/ajax/libs/popper.js/1.12.9/umd/popper.min.js"
+    );
+    const bootstrap = asset(
+      "bootstrap.min.js",
+      "https://maxcdn.bootstrapcdn.com/bootstrap/4.0.0/js/bootstrap.min.js"
+    );
+    const jsoneditor = asset(
+      "jsoneditor.min.js",
+      "https://cdn.jsdelivr.net/npm/@json-editor/json-editor@latest/dist/jsoneditor.min.js"
+    );
+    res.setStatus(200);
+    res.headers.set("Content-type", "text/html");
+    res.compress();
+    res.end(`<html>
       <head>
         <title>Configuration</title>
         <meta name="viewport" content="width=device-width, initial-scale=1, shrink-to-fit=no">
         <link 
           rel="stylesheet" 
-          href="https://bootswatch.com/4/united/bootstrap.min.css" 
+          href="${bootstrapCss}" 
           crossorigin="anonymous"
         />
         <link
           rel="stylesheet"
-          href="https://use.fontawesome.com/releases/v5.6.1/css/all.css"
+          href="${fontawesomeCss}"
           crossorigin="anonymous"
         />
       </head>
@@ -322,21 +471,21 @@ export function startConfigServer(): void {
           </p>
         </div>
         <script
-          src="https://code.jquery.com/jquery-3.2.1.slim.min.js"
+          src="${jquery}"
           integrity="sha384-KJ3o2DKtIkvYIK3UENzmM7KCkRr/rE9/Qpg6aAZGJwFDMVNA/GpGFF93hXpG5KkN"
           crossorigin="anonymous"
         ></script>
         <script
-          src="https://cdnjs.cloudflare.com/ajax/libs/popper.js/1.12.9/umd/popper.min.js"
+          src="${popper}"
           integrity="sha384-ApNbgh9B+Y1QKtv3Rn7W3mgPxhU9K/ScQsAP7hUibX39j7fakFPskvXusvfa0b4Q"
           crossorigin="anonymous"
         ></script>
         <script
-          src="https://maxcdn.bootstrapcdn.com/bootstrap/4.0.0/js/bootstrap.min.js"
+          src="${bootstrap}"
           integrity="sha384-JZR6Spejh4U02d8jOt6vLEHfe/JQGiRRSQQxSfFWpi1MquVdAyjUar5+76PVCmYl"
           crossorigin="anonymous"
         ></script>
-        <script src="https://cdn.jsdelivr.net/npm/@json-editor/json-editor@latest/dist/jsoneditor.min.js"
+        <script src="${jsoneditor}"
           crossorigin="anonymous"
         ></script>
         <script>
@@ -369,14 +518,13 @@ export function startConfigServer(): void {
         </script>
       </body>
     </html>`);
-    }
   });
 
-  requestHandler.push((req, res) => {
-    if (req.path === "/config/schema") {
-      res.setStatus(200);
-      res.headers.set("Content-type", "application/json");
-      res.end(`
+  router.get("/config/schema", function (req, res) {
+    res.setStatus(200);
+    res.headers.set("Content-type", "application/json");
+    res.compress();
+    res.end(`
       {
         "type": "object",
         "format": "categories",
@@ -390,31 +538,29 @@ export function startConfigServer(): void {
         "required": ${JSON.stringify(Object.keys(schema))},
         "properties": ${JSON.stringify(schema)}
       }`);
-    }
   });
 
-  requestHandler.push((req, res) => {
-    if (req.path === "/config/current") {
-      if (req.method === "GET") {
-        res.setStatus(200);
-        res.headers.set("Content-type", "application/json");
-        res.end(JSON.stringify(configManager.config));
-      } else if (req.method === "POST") {
-        try {
-          if (req.body) {
-            configManager.saveConfig(JSON.parse(req.body));
-            res.setStatus(204);
-            res.end();
-          } else {
-            res.setStatus(400);
-            res.end("No config provided.");
-          }
-        } catch (error) {
-          console.error(error);
-          res.setStatus(500);
-          res.end("Internal server error while saving configuration.");
-        }
+  router.get("/config/current", function (req, res) {
+    res.setStatus(200);
+    res.headers.set("Content-type", "application/json");
+    res.compress();
+    sendJson(res, configManager.config);
+  });
+
+  router.post("/config/current", function (req, res) {
+    try {
+      if (req.body) {
+        configManager.saveConfig(JSON.parse(req.body));
+        res.setStatus(204);
+        res.end();
+      } else {
+        res.setStatus(400);
+        res.end("No config provided.");
       }
+    } catch (error) {
+      console.error(error);
+      res.setStatus(500);
+      res.end("Internal server error while saving configuration.");
     }
   });
 }
@@ -56,17 +56,46 @@ declare function shutdownSSL(ref: any): void;
 declare function freeSSL(ref: any): void;
 declare function createSSLClientContext(): number;
 declare function createSSL(clientContext: number, host?: string): number;
-declare function connectSSL(sslHandle: number, sockfd: number): number;
+declare function connectSSL(
+  sslHandle: number,
+  sockfd: number,
+  host?: string,
+  port?: number
+): number;
+declare function el_clearTlsSessionCache(): void;
 declare function createSSLServerContext(): number;
 declare function acceptSSL(ssl: any, newsockfd: number): number;
 
+interface Esp32JsSocketStats {
+  bytesIn: number;
+  bytesOut: number;
+  reads: number;
+  writes: number;
+  readEagain: number;
+  writeEagain: number;
+  handshakes: number;
+  handshakeUs: number;
+  firstBytes: number;
+  firstByteUs: number;
+  dispatches: number;
+  dispatchUs: number;
+  dispatchMaxUs: number;
+  openSockets?: number;
+  closedSockets?: number;
+}
+declare function el_getSocketStats(
+  sockfd?: number
+): Esp32JsSocketStats | undefined;
+
 declare function el_closeSocket(sockfd: number): void;
+declare function el_shutdownSocket(sockfd: number): void;
 declare function el_createNonBlockingSocket(): number;
 declare function el_connectNonBlocking(
   sockfd: number,
   host: string,
   port: number
-): void;
+): number;
+declare function el_clearDnsCache(): void;
 declare function el_bindAndListen(sockfd: number, port: number): number;
 declare function el_acceptIncoming(sockfd: number): number;
 declare function el_registerSocketEvents(
@@ -80,5 +109,211 @@ declare function readSocket(
   ssl: any
 ): { data: string; length: number };
 
+interface Esp32JsHttpParserHandler {
+  onHead(
+    method: string,
+    path: string,
+    headers: string[],
+    contentLength: number,
+    chunked: boolean,
+    keepAlive: boolean
+  ): void;
+  onBody(data: string | Uint8Array): void;
+  /** Returns true if the connection is taken over, parsing stops then. */
+  onComplete(): boolean | void;
+  /** Gets called with the data received after a taken over request. */
+  onDetached(data: string, length: number): void;
+}
+interface Esp32JsHttpResponseHandler {
+  /** Returns true if the response has no body. */
+  onHead(
+    status: number,
+    statusText: string,
+    headers: string[],
+    contentLength: number,
+    chunked: boolean,
+    keepAlive: boolean
+  ): boolean;
+  onBody(data: Uint8Array): void;
+  onComplete(): void;
+}
+declare function el_createHttpParser(response?: boolean): number;
+declare function el_freeHttpParser(parser: number): void;
+declare function el_executeHttpParser(
+  parser: number,
+  data: string | Uint8Array,
+  handler: Esp32JsHttpParserHandler | Esp32JsHttpResponseHandler
+): number;
+declare function el_setHttpParserBody(
+  parser: number,
+  binary: boolean,
+  maxSize: number,
+  file?: string
+): boolean;
+declare function el_buildResponseHead(
+  status: number,
+  statusText: string,
+  headers: string[],
+  flags: number
+): Uint8Array;
+declare function el_createDeflateStream(gzip: boolean): number;
+declare function el_freeDeflateStream(stream: number): void;
+declare function el_writeDeflateStream(
+  stream: number,
+  data: string | Uint8Array | undefined,
+  final: boolean
+): Uint8Array;
+declare function el_createWebSocketParser(
+  client: boolean,
+  maxMessageSize: number
+): number;
+declare function el_freeWebSocketParser(parser: number): void;
+declare function el_executeWebSocketParser(
+  parser: number,
+  data: string | Uint8Array,
+  handler: {
+    onMessage?: (data: string | Uint8Array, binary: boolean) => void;
+    onPing?: (payload: Uint8Array) => void;
+    onPong?: (payload: Uint8Array) => void;
+    onClose?: (code: number, reason: string) => void;
+  }
+): number;
+declare function el_encodeWebSocketFrame(
+  opcode: number,
+  data: string | Uint8Array | undefined,
+  mask: boolean
+): Uint8Array;
+declare function el_webSocketAccept(key: string): string;
+declare function el_createWebSocketKey(): string;
+declare function el_createMqttParser(maxPacketSize: number): number;
+declare function el_freeMqttParser(parser: number): void;
+declare function el_executeMqttParser(
+  parser: number,
+  data: string | Uint8Array,
+  handler: {
+    onConnack?: (sessionPresent: boolean, returnCode: number) => void;
+    onPublish?: (
+      topic: string,
+      payload: Uint8Array,
+      qos: number,
+      retain: boolean,
+      dup: boolean,
+      packetId: number
+    ) => void;
+    onPuback?: (packetId: number) => void;
+    onSuback?: (packetId: number, returnCodes: number[]) => void;
+    onUnsuback?: (packetId: number) => void;
+    onPingresp?: () => void;
+  }
+): number;
+declare function el_encodeMqttConnect(
+  clientId: string,
+  keepAlive: number,
+  cleanSession: boolean,
+  username?: string,
+  password?: string,
+  willTopic?: string,
+  willPayload?: Uint8Array,
+  willQos?: number,
+  willRetain?: boolean
+): Uint8Array;
+declare function el_encodeMqttPublish(
+  topic: string,
+  payload: string | Uint8Array,
+  qos: number,
+  retain: boolean,
+  dup: boolean,
+  packetId: number
+): Uint8Array;
+declare function el_encodeMqttSubscribe(
+  packetId: number,
+  filters: string[],
+  qos?: number
+): Uint8Array;
+declare function el_encodeMqttPacket(type: number, packetId?: number): Uint8Array;
+declare function el_createMultipartParser(boundary: string): number;
+declare function el_freeMultipartParser(parser: number): void;
+declare function el_executeMultipartParser(
+  parser: number,
+  data: string | Uint8Array,
+  handler: {
+    onPart: (headers: string[]) => void;
+    onData: (chunk: Uint8Array) => void;
+    onPartEnd: () => void;
+  }
+): number;
+declare function el_setMultipartPartBody(
+  parser: number,
+  maxSize: number,
+  file?: string
+): boolean;
+
+declare function el_setHeader(
+  list: (number | string)[],
+  name: string,
+  value: string,
+  replace: boolean
+): void;
+declare function el_getHeader(
+  list: (number | string)[],
+  name: string
+): string | null;
+declare function el_deleteHeader(list: (number | string)[], name: string): void;
+declare function el_appendHeaderList(
+  list: (number | string)[],
+  headerList: string[]
+): void;
+declare function el_headerNames(): string[];
+declare function el_byteBufferAppend(
+  segments: Uint8Array[],
+  data: string | Uint8Array
+): number;
+declare function el_byteBufferIndexOf(
+  segments: Uint8Array[],
+  offset: number,
+  search: string | Uint8Array | number,
+  position: number
+): number;
+declare function el_byteBufferRead(
+  segments: Uint8Array[],
+  offset: number,
+  start: number,
+  end: number,
+  asString: true
+): string;
+declare function el_byteBufferRead(
+  segments: Uint8Array[],
+  offset: number,
+  start: number,
+  end: number,
+  asString: false
+): Uint8Array;
+declare function el_createJsonWriter(value: unknown): unknown[];
+declare function el_writeJson(
+  state: unknown[],
+  chunkSize?: number
+): Uint8Array | null;
+declare function el_writeJsonFile(path: string, value: unknown): number;
+declare function el_cborEncode(value: unknown): Uint8Array;
+declare function el_cborDecode(data: Uint8Array | ArrayBuffer): unknown;
+
+declare function el_setIdleTimeout(sockfd: number, timeout: number): void;
+declare function el_sweepIdleSockets(): { expired: number[]; armed: number };
+
+declare function el_openFileStream(
+  path: string,
+  offset?: number,
+  length?: number
+): number;
+declare function el_sendFileStream(
+  stream: number,
+  sockfd: number,
+  ssl: any
+): number;
+declare function el_closeFileStream(stream: number): void;
+
 declare function readFile(path: string): string;
 declare function writeFile(path: string, data: string): void;
+declare function fileStat(
+  path: string
+): { size: number; mtime: number } | undefined;
@@ -0,0 +1,138 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.Esp32JsEventStream = exports.encodeEvent = void 0;
+var socketEvents = require("socket-events");
+var textEncoder = new TextEncoder();
+var heartbeat = textEncoder.encode(":\n\n");
+/**
+ * Encodes an event in the text/event-stream format. Line breaks in data are
+ * split into several data fields.
+ */
+function encodeEvent(data, event, id) {
+    var text = "";
+    if (typeof id === "string") {
+        if (/[\r\n]/.test(id)) {
+            throw Error("Invalid event id");
+        }
+        text += "id: " + id + "\n";
+    }
+    if (event) {
+        if (/[\r\n]/.test(event)) {
+            throw Error("Invalid event name");
+        }
+        text += "event: " + event + "\n";
+    }
+    text += "data: " + data.replace(/\r\n|\r|\n/g, "\ndata: ") + "\n\n";
+    return textEncoder.encode(text);
+}
+exports.encodeEvent = encodeEvent;
+var EventStreamClient = /** @class */ (function () {
+    function EventStreamClient(socket, maxBufferedAmount, lastEventId) {
+        this.socket = socket;
+        this.maxBufferedAmount = maxBufferedAmount;
+        this.lastEventId = lastEventId;
+        this.bufferedAmount = 0;
+    }
+    EventStreamClient.prototype.send = function (data, event, id) {
+        this.queue(encodeEvent(data, event, id));
+    };
+    /** Queues an encoded event, the buffer may be shared with other clients. */
+    EventStreamClient.prototype.queue = function (encoded) {
+        var _this = this;
+        this.bufferedAmount += encoded.length;
+        if (this.bufferedAmount > this.maxBufferedAmount) {
+            console.warn("Event stream client on socket " + this.socket.sockfd + " dropped, " + this.bufferedAmount + " bytes were not written");
+            this.close();
+            return;
+        }
+        this.socket.writeShared(encoded, function () {
+            _this.bufferedAmount -= encoded.length;
+        });
+    };
+    EventStreamClient.prototype.close = function () {
+        socketEvents.closeSocket(this.socket);
+    };
+    return EventStreamClient;
+}());
+/**
+ * Server-sent events for any number of clients. A broadcast encodes the
+ * event once and every client queues the same buffer. The streams are
+ * delimited by closing the connection instead of chunked encoding, so the
+ * bytes sent to all clients are identical. Clients which do not keep up
+ * are dropped, browsers reconnect by themselves.
+ */
+var Esp32JsEventStream = /** @class */ (function () {
+    function Esp32JsEventStream(options) {
+        this.clients = [];
+        this.heartbeatTimer = -1;
+        this.sentSinceHeartbeat = false;
+        this.heartbeatInterval =
+            options && typeof options.heartbeatInterval === "number"
+                ? options.heartbeatInterval
+                : 15000;
+        this.maxBufferedAmount =
+            (options && options.maxBufferedAmount) || 8 * 1024;
+        this.retry = (options && options.retry) || 0;
+    }
+    /**
+     * Answers a request with an event stream and adds it to the clients.
+     * Requests other than GET are answered with 405 and null is returned.
+     */
+    Esp32JsEventStream.prototype.accept = function (req, res) {
+        var _this = this;
+        if (req.method !== "GET") {
+            res.setStatus(405);
+            res.end("Method not allowed");
+            return null;
+        }
+        res.headers.set("content-type", "text/event-stream");
+        res.headers.set("cache-control", "no-cache");
+        res.headers.set("connection", "close");
+        var socket = res.upgrade(200);
+        var client = new EventStreamClient(socket, this.maxBufferedAmount, req.headers.get("last-event-id"));
+        socket.onClose = function () { return _this.remove(client); };
+        this.clients.push(client);
+        if (this.retry > 0) {
+            client.queue(textEncoder.encode("retry: " + this.retry + "\n\n"));
+        }
+        if (this.heartbeatTimer < 0 && this.heartbeatInterval > 0) {
+            this.heartbeatTimer = setInterval(function () {
+                // comments keep idle connections open through proxies
+                if (!_this.sentSinceHeartbeat) {
+                    _this.queueAll(heartbeat);
+                }
+                _this.sentSinceHeartbeat = false;
+            }, this.heartbeatInterval);
+        }
+        return client;
+    };
+    /** Sends an event to all clients. */
+    Esp32JsEventStream.prototype.broadcast = function (data, event, id) {
+        if (this.clients.length > 0) {
+            this.sentSinceHeartbeat = true;
+            this.queueAll(encodeEvent(data, event, id));
+        }
+    };
+    Esp32JsEventStream.prototype.clientCount = function () {
+        return this.clients.length;
+    };
+    /** Closes the connections of all clients. */
+    Esp32JsEventStream.prototype.close = function () {
+        this.clients.slice().forEach(function (client) { return client.close(); });
+    };
+    Esp32JsEventStream.prototype.queueAll = function (encoded) {
+        // clients which are dropped remove themselves from the list
+        this.clients.slice().forEach(function (client) { return client.queue(encoded); });
+    };
+    Esp32JsEventStream.prototype.remove = function (client) {
+        var index = this.clients.indexOf(client);
+        if (index >= 0) {
+            this.clients.splice(index, 1);
+        }
+        if (this.clients.length === 0 && this.heartbeatTimer >= 0) {
+            clearInterval(this.heartbeatTimer);
+            this.heartbeatTimer = -1;
+        }
+    };
+    return Esp32JsEventStream;
+}());
+exports.Esp32JsEventStream = Esp32JsEventStream;
@@ -0,0 +1,181 @@
+import socketEvents = require("socket-events");
+import { Esp32JsRequest, Esp32JsResponse } from "./http";
+
+export interface Esp32JsEventStreamOptions {
+  /** Interval of heartbeat comments in milliseconds, 0 disables them, defaults to 15 s. */
+  heartbeatInterval?: number;
+  /** A client is dropped if more bytes wait to be written to it, defaults to 8 KB. */
+  maxBufferedAmount?: number;
+  /** Reconnection delay in milliseconds sent to new clients. */
+  retry?: number;
+}
+
+export interface Esp32JsEventStreamClient {
+  /** The Last-Event-ID header of a reconnecting client. */
+  lastEventId: string | null;
+  /** Bytes of events which are not written to the client yet. */
+  bufferedAmount: number;
+  send: (data: string, event?: string, id?: string) => void;
+  close: () => void;
+}
+
+const textEncoder = new TextEncoder();
+const heartbeat = textEncoder.encode(":\n\n");
+
+/**
+ * Encodes an event in the text/event-stream format. Line breaks in data are
+ * split into several data fields.
+ */
+export function encodeEvent(
+  data: string,
+  event?: string,
+  id?: string
+): Uint8Array {
+  let text = "";
+  if (typeof id === "string") {
+    if (/[\r\n]/.test(id)) {
+      throw Error("Invalid event id");
+    }
+    text += `id: ${id}\n`;
+  }
+  if (event) {
+    if (/[\r\n]/.test(event)) {
+      throw Error("Invalid event name");
+    }
+    text += `event: ${event}\n`;
+  }
+  text += `data: ${data.replace(/\r\n|\r|\n/g, "\ndata: ")}\n\n`;
+  return textEncoder.encode(text);
+}
+
+class EventStreamClient implements Esp32JsEventStreamClient {
+  public bufferedAmount = 0;
+
+  constructor(
+    private socket: socketEvents.Esp32JsSocket,
+    private maxBufferedAmount: number,
+    public lastEventId: string | null
+  ) {}
+
+  public send(data: string, event?: string, id?: string): void {
+    this.queue(encodeEvent(data, event, id));
+  }
+
+  /** Queues an encoded event, the buffer may be shared with other clients. */
+  public queue(encoded: Uint8Array): void {
+    this.bufferedAmount += encoded.length;
+    if (this.bufferedAmount > this.maxBufferedAmount) {
+      console.warn(
+        `Event stream client on socket ${this.socket.sockfd} dropped, ${this.bufferedAmount} bytes were not written`
+      );
+      this.close();
+      return;
+    }
+    this.socket.writeShared(encoded, () => {
+      this.bufferedAmount -= encoded.length;
+    });
+  }
+
+  public close(): void {
+    socketEvents.closeSocket(this.socket);
+  }
+}
+
+/**
+ * Server-sent events for any number of clients. A broadcast encodes the
+ * event once and every client queues the same buffer. The streams are
+ * delimited by closing the connection instead of chunked encoding, so the
+ * bytes sent to all clients are identical. Clients which do not keep up
+ * are dropped, browsers reconnect by themselves.
+ */
+export class Esp32JsEventStream {
+  private clients: EventStreamClient[] = [];
+  private heartbeatTimer = -1;
+  private sentSinceHeartbeat = false;
+  private heartbeatInterval: number;
+  private maxBufferedAmount: number;
+  private retry: number;
+
+  constructor(options?: Esp32JsEventStreamOptions) {
+    this.heartbeatInterval =
+      options && typeof options.heartbeatInterval === "number"
+        ? options.heartbeatInterval
+        : 15000;
+    this.maxBufferedAmount =
+      (options && options.maxBufferedAmount) || 8 * 1024;
+    this.retry = (options && options.retry) || 0;
+  }
+
+  /**
+   * Answers a request with an event stream and adds it to the clients.
+   * Requests other than GET are answered with 405 and null is returned.
+   */
+  public accept(
+    req: Esp32JsRequest,
+    res: Esp32JsResponse
+  ): Esp32JsEventStreamClient | null {
+    if (req.method !== "GET") {
+      res.setStatus(405);
+      res.end("Method not allowed");
+      return null;
+    }
+    res.headers.set("content-type", "text/event-stream");
+    res.headers.set("cache-control", "no-cache");
+    res.headers.set("connection", "close");
+    const socket = res.upgrade(200);
+    const client = new EventStreamClient(
+      socket,
+      this.maxBufferedAmount,
+      req.headers.get("last-event-id")
+    );
+    socket.onClose = () => this.remove(client);
+    this.clients.push(client);
+
+    if (this.retry > 0) {
+      client.queue(textEncoder.encode(`retry: ${this.retry}\n\n`));
+    }
+    if (this.heartbeatTimer < 0 && this.heartbeatInterval > 0) {
+      this.heartbeatTimer = setInterval(() => {
+        // comments keep idle connections open through proxies
+        if (!this.sentSinceHeartbeat) {
+          this.queueAll(heartbeat);
+        }
+        this.sentSinceHeartbeat = false;
+      }, this.heartbeatInterval);
+    }
+    return client;
+  }
+
+  /** Sends an event to all clients. */
+  public broadcast(data: string, event?: string, id?: string): void {
+    if (this.clients.length > 0) {
+      this.sentSinceHeartbeat = true;
+      this.queueAll(encodeEvent(data, event, id));
+    }
+  }
+
+  public clientCount(): number {
+    return this.clients.length;
+  }
+
+  /** Closes the connections of all clients. */
+  public close(): void {
+    this.clients.slice().forEach((client) => client.close());
+  }
+
+  private queueAll(encoded: Uint8Array) {
+    // clients which are dropped remove themselves from the list
+    this.clients.slice().forEach((client) => client.queue(encoded));
+  }
+
+  private remove(client: EventStreamClient) {
+    const index = this.clients.indexOf(client);
+    if (index >= 0) {
+      this.clients.splice(index, 1);
+    }
+    if (this.clients.length === 0 && this.heartbeatTimer >= 0) {
+      clearInterval(this.heartbeatTimer);
+      this.heartbeatTimer = -1;
+    }
+  }
+}
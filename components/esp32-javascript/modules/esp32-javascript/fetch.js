@@ -1,518 +1,207 @@
-(function (self){
-var support = {
-	searchParams: 'URLSearchParams' in self,
-	iterable: 'Symbol' in self && 'iterator' in Symbol,
-	blob:
-	  'FileReader' in self &&
-	  'Blob' in self &&
-	  (function() {
-		try {
-		  new Blob()
-		  return true
-		} catch (e) {
-		  return false
-		}
-	  })(),
-	formData: 'FormData' in self,
-	arrayBuffer: 'ArrayBuffer' in self
-  }
-  
-  function isDataView(obj) {
-	return obj && DataView.prototype.isPrototypeOf(obj)
-  }
-  
-  if (support.arrayBuffer) {
-	var viewClasses = [
-	  '[object Int8Array]',
-	  '[object Uint8Array]',
-	  '[object Uint8ClampedArray]',
-	  '[object Int16Array]',
-	  '[object Uint16Array]',
-	  '[object Int32Array]',
-	  '[object Uint32Array]',
-	  '[object Float32Array]',
-	  '[object Float64Array]'
-	]
-  
-	var isArrayBufferView =
-	  ArrayBuffer.isView ||
-	  function(obj) {
-		return obj && viewClasses.indexOf(Object.prototype.toString.call(obj)) > -1
-	  }
-  }
-  
-  function normalizeName(name) {
-	if (typeof name !== 'string') {
-	  name = String(name)
-	}
-	if (/[^a-z0-9\-#$%&'*+.^_`|~]/i.test(name) || name === '') {
-	  throw new TypeError('Invalid character in header field name:'+name)
-	}
-	return name.toLowerCase()
-  }
-  
-  function normalizeValue(value) {
-	if (typeof value !== 'string') {
-	  value = String(value)
-	}
-	return value
-  }
-  
-  // Build a destructive iterator for the value list
-  function iteratorFor(items) {
-	var iterator = {
-	  next: function() {
-		var value = items.shift()
-		return {done: value === undefined, value: value}
-	  }
-	}
-  
-	if (support.iterable) {
-	  iterator[Symbol.iterator] = function() {
-		return iterator
-	  }
-	}
-  
-	return iterator
-  }
-  
-  var Headers=function(headers) {
-	this.map = {}
-  
-	if (headers instanceof Headers) {
-	  headers.forEach(function(value, name) {
-		this.append(name, value)
-	  }, this)
-	} else if (Array.isArray(headers)) {
-	  headers.forEach(function(header) {
-		this.append(header[0], header[1])
-	  }, this)
-	} else if (headers) {
-	  Object.getOwnPropertyNames(headers).forEach(function(name) {
-		this.append(name, headers[name])
-	  }, this)
-	}
-  }
-  
-  Headers.prototype.append = function(name, value) {
-	name = normalizeName(name)
-	value = normalizeValue(value)
-	var oldValue = this.map[name]
-	this.map[name] = oldValue ? oldValue + ', ' + value : value
-  }
-  
-  Headers.prototype['delete'] = function(name) {
-	delete this.map[normalizeName(name)]
-  }
-  
-  Headers.prototype.get = function(name) {
-	name = normalizeName(name)
-	return this.has(name) ? this.map[name] : null
-  }
-  
-  Headers.prototype.has = function(name) {
-	return this.map.hasOwnProperty(normalizeName(name))
-  }
-  
-  Headers.prototype.set = function(name, value) {
-	this.map[normalizeName(name)] = normalizeValue(value)
-  }
-  
-  Headers.prototype.forEach = function(callback, thisArg) {
-	for (var name in this.map) {
-	  if (this.map.hasOwnProperty(name)) {
-		callback.call(thisArg, this.map[name], name, this)
-	  }
-	}
-  }
-  
-  Headers.prototype.keys = function() {
-	var items = []
-	this.forEach(function(value, name) {
-	  items.push(name)
-	})
-	return iteratorFor(items)
-  }
-  
-  Headers.prototype.values = function() {
-	var items = []
-	this.forEach(function(value) {
-	  items.push(value)
-	})
-	return iteratorFor(items)
-  }
-  
-  Headers.prototype.entries = function() {
-	var items = []
-	this.forEach(function(value, name) {
-	  items.push([name, value])
-	})
-	return iteratorFor(items)
-  }
-  
-  if (support.iterable) {
-	Headers.prototype[Symbol.iterator] = Headers.prototype.entries
-  }
-  
-  function consumed(body) {
-	if (body.bodyUsed) {
-	  return Promise.reject(new TypeError('Already read'))
-	}
-	body.bodyUsed = true
-  }
-  
-  function fileReaderReady(reader) {
-	return new Promise(function(resolve, reject) {
-	  reader.onload = function() {
-		resolve(reader.result)
-	  }
-	  reader.onerror = function() {
-		reject(reader.error)
-	  }
-	})
-  }
-  
-  function readBlobAsArrayBuffer(blob) {
-	var reader = new FileReader()
-	var promise = fileReaderReady(reader)
-	reader.readAsArrayBuffer(blob)
-	return promise
-  }
-  
-  function readBlobAsText(blob) {
-	var reader = new FileReader()
-	var promise = fileReaderReady(reader)
-	reader.readAsText(blob)
-	return promise
-  }
-  
-  function readArrayBufferAsText(buf) {
-	var view = new Uint8Array(buf)
-	var chars = new Array(view.length)
-  
-	for (var i = 0; i < view.length; i++) {
-	  chars[i] = String.fromCharCode(view[i])
-	}
-	return chars.join('')
-  }
-  
-  function bufferClone(buf) {
-	if (buf.slice) {
-	  return buf.slice(0)
-	} else {
-	  var view = new Uint8Array(buf.byteLength)
-	  view.set(new Uint8Array(buf))
-	  return view.buffer
-	}
-  }
-  
-  function Body() {
-	this.bodyUsed = false
-  
-	this._initBody = function(body) {
-	  this._bodyInit = body
-	  if (!body) {
-		this._bodyText = ''
-	  } else if (typeof body === 'string') {
-		this._bodyText = body
-	  } else if (support.blob && Blob.prototype.isPrototypeOf(body)) {
-		this._bodyBlob = body
-	  } else if (support.formData && FormData.prototype.isPrototypeOf(body)) {
-		this._bodyFormData = body
-	  } else if (support.searchParams && URLSearchParams.prototype.isPrototypeOf(body)) {
-		this._bodyText = body.toString()
-	  } else if (support.arrayBuffer && support.blob && isDataView(body)) {
-		this._bodyArrayBuffer = bufferClone(body.buffer)
-		// IE 10-11 can't handle a DataView body.
-		this._bodyInit = new Blob([this._bodyArrayBuffer])
-	  } else if (support.arrayBuffer && (ArrayBuffer.prototype.isPrototypeOf(body) || isArrayBufferView(body))) {
-		this._bodyArrayBuffer = bufferClone(body)
-	  } else {
-		this._bodyText = body = Object.prototype.toString.call(body)
-	  }
-  
-	  if (!this.headers.get('content-type')) {
-		if (typeof body === 'string') {
-		  this.headers.set('content-type', 'text/plain;charset=UTF-8')
-		} else if (this._bodyBlob && this._bodyBlob.type) {
-		  this.headers.set('content-type', this._bodyBlob.type)
-		} else if (support.searchParams && URLSearchParams.prototype.isPrototypeOf(body)) {
-		  this.headers.set('content-type', 'application/x-www-form-urlencoded;charset=UTF-8')
-		}
-	  }
-	}
-  
-	if (support.blob) {
-	  this.blob = function() {
-		var rejected = consumed(this)
-		if (rejected) {
-		  return rejected
-		}
-  
-		if (this._bodyBlob) {
-		  return Promise.resolve(this._bodyBlob)
-		} else if (this._bodyArrayBuffer) {
-		  return Promise.resolve(new Blob([this._bodyArrayBuffer]))
-		} else if (this._bodyFormData) {
-		  throw new Error('could not read FormData body as blob')
-		} else {
-		  return Promise.resolve(new Blob([this._bodyText]))
-		}
-	  }
-  
-	  this.arrayBuffer = function() {
-		if (this._bodyArrayBuffer) {
-		  return consumed(this) || Promise.resolve(this._bodyArrayBuffer)
-		} else {
-		  return this.blob().then(readBlobAsArrayBuffer)
-		}
-	  }
-	}
-  
-	this.text = function() {
-	  var rejected = consumed(this)
-	  if (rejected) {
-		return rejected
-	  }
-  
-	  if (this._bodyBlob) {
-		return readBlobAsText(this._bodyBlob)
-	  } else if (this._bodyArrayBuffer) {
-		return Promise.resolve(readArrayBufferAsText(this._bodyArrayBuffer))
-	  } else if (this._bodyFormData) {
-		throw new Error('could not read FormData body as text')
-	  } else {
-		return Promise.resolve(this._bodyText)
-	  }
-	}
-  
-	if (support.formData) {
-	  this.formData = function() {
-		return this.text().then(decode)
-	  }
-	}
-  
-	this.json = function() {
-	  return this.text().then(JSON.parse)
-	}
-  
-	return this
-  }
-  
-  // HTTP methods whose capitalization should be normalized
-  var methods = ['DELETE', 'GET', 'HEAD', 'OPTIONS', 'POST', 'PUT']
-  
-  function normalizeMethod(method) {
-	var upcased = method.toUpperCase()
-	return methods.indexOf(upcased) > -1 ? upcased : method
-  }
-  
-  var Request=function(input, options) {
-	options = options || {}
-	var body = options.body
-  
-	if (input instanceof Request) {
-	  if (input.bodyUsed) {
-		throw new TypeError('Already read')
-	  }
-	  this.url = input.url
-	  this.credentials = input.credentials
-	  if (!options.headers) {
-		this.headers = new Headers(input.headers)
-	  }
-	  this.method = input.method
-	  this.mode = input.mode
-	  this.signal = input.signal
-	  if (!body && input._bodyInit != null) {
-		body = input._bodyInit
-		input.bodyUsed = true
-	  }
-	} else {
-	  this.url = String(input)
-	}
-  
-	this.credentials = options.credentials || this.credentials || 'same-origin'
-	if (options.headers || !this.headers) {
-	  this.headers = new Headers(options.headers)
-	}
-	this.method = normalizeMethod(options.method || this.method || 'GET')
-	this.mode = options.mode || this.mode || null
-	this.signal = options.signal || this.signal
-	this.referrer = null
-  
-	if ((this.method === 'GET' || this.method === 'HEAD') && body) {
-	  throw new TypeError('Body not allowed for GET or HEAD requests')
-	}
-	this._initBody(body)
-  }
-  
-  Request.prototype.clone = function() {
-	return new Request(this, {body: this._bodyInit})
-  }
-  
-  function decode(body) {
-	var form = new FormData()
-	body
-	  .trim()
-	  .split('&')
-	  .forEach(function(bytes) {
-		if (bytes) {
-		  var split = bytes.split('=')
-		  var name = split.shift().replace(/\+/g, ' ')
-		  var value = split.join('=').replace(/\+/g, ' ')
-		  form.append(decodeURIComponent(name), decodeURIComponent(value))
-		}
-	  })
-	return form
-  }
-  
-  function parseHeaders(rawHeaders) {
-	var headers = new Headers()
-	// Replace instances of \r\n and \n followed by at least one space or horizontal tab with a space
-	// https://tools.ietf.org/html/rfc7230#section-3.2
-	var preProcessedHeaders = rawHeaders.replace(/\r?\n[\t ]+/g, ' ')
-	preProcessedHeaders.split(/\r?\n/).forEach(function(line) {
-	  var parts = line.split(':')
-	  var key = parts.shift().trim()
-	  if (key) {
-		var value = parts.join(':').trim()
-		headers.append(key, value)
-	  }
-	})
-	return headers
-  }
-  
-  Body.call(Request.prototype)
-  
-  var Response=function(bodyInit, options) {
-	if (!options) {
-	  options = {}
-	}
-  
-	this.type = 'default'
-	this.status = options.status === undefined ? 200 : options.status
-	this.ok = this.status >= 200 && this.status < 300
-	this.statusText = 'statusText' in options ? options.statusText : 'OK'
-	this.headers = new Headers(options.headers)
-	this.url = options.url || ''
-	this._initBody(bodyInit)
-  }
-  
-  Body.call(Response.prototype)
-  
-  Response.prototype.clone = function() {
-	return new Response(this._bodyInit, {
-	  status: this.status,
-	  statusText: this.statusText,
-	  headers: new Headers(this.headers),
-	  url: this.url
-	})
-  }
-  
-  Response.error = function() {
-	var response = new Response(null, {status: 0, statusText: ''})
-	response.type = 'error'
-	return response
-  }
-  
-  var redirectStatuses = [301, 302, 303, 307, 308]
-  
-  Response.redirect = function(url, status) {
-	if (redirectStatuses.indexOf(status) === -1) {
-	  throw new RangeError('Invalid status code')
-	}
-  
-	return new Response(null, {status: status, headers: {location: url}})
-  }
-  
-  var DOMException = self.DOMException
-  try {
-	new DOMException()
-  } catch (err) {
-	DOMException = function(message, name) {
-	  this.message = message
-	  this.name = name
-	  var error = Error(message)
-	  this.stack = error.stack
-	}
-	DOMException.prototype = Object.create(Error.prototype)
-	DOMException.prototype.constructor = DOMException
-  }
-  
-  var fetch=function(input, init) {
-	return new Promise(function(resolve, reject) {
-	  var request = new Request(input, init)
-  
-	  if (request.signal && request.signal.aborted) {
-		return reject(new DOMException('Aborted', 'AbortError'))
-	  }
-  
-	  var xhr = new XMLHttpRequest()
-  
-	  function abortXhr() {
-		xhr.abort()
-	  }
-  
-	  xhr.onload = function() {
-		var options = {
-		  status: xhr.status,
-		  statusText: xhr.statusText,
-		  headers: parseHeaders(xhr.getAllResponseHeaders() || '')
-		}
-		options.url = 'responseURL' in xhr ? xhr.responseURL : options.headers.get('X-Request-URL')
-		var body = 'response' in xhr ? xhr.response : xhr.responseText
-		resolve(new Response(body, options))
-	  }
-  
-	  xhr.onerror = function() {
-		reject(new TypeError('Network request failed'))
-	  }
-  
-	  xhr.ontimeout = function() {
-		reject(new TypeError('Network request failed'))
-	  }
-  
-	  xhr.onabort = function() {
-		reject(new DOMException('Aborted', 'AbortError'))
-	  }
-  
-	  xhr.open(request.method, request.url, true)
-  
-	  if (request.credentials === 'include') {
-		xhr.withCredentials = true
-	  } else if (request.credentials === 'omit') {
-		xhr.withCredentials = false
-	  }
-  
-	  if ('responseType' in xhr && support.blob) {
-		xhr.responseType = 'blob'
-	  }
-  
-	  request.headers.forEach(function(value, name) {
-		xhr.setRequestHeader(name, value)
-	  })
-  
-	  if (request.signal) {
-		request.signal.addEventListener('abort', abortXhr)
-  
-		xhr.onreadystatechange = function() {
-		  // DONE (success or failure)
-		  if (xhr.readyState === 4) {
-			request.signal.removeEventListener('abort', abortXhr)
-		  }
-		}
-	  }
-  
-	  xhr.send(typeof request._bodyInit === 'undefined' ? null : request._bodyInit)
-	})
-  }
-  
-  fetch.polyfill = true
-  
-  if (!self.fetch) {
-	self.fetch = fetch
-	self.Headers = Headers
-	self.Request = Request
-	self.Response = Response
-  }
-})(global);
\ No newline at end of file
+var __extends = (this && this.__extends) || (function () {
+    var extendStatics = function (d, b) {
+        extendStatics = Object.setPrototypeOf ||
+            ({ __proto__: [] } instanceof Array && function (d, b) { d.__proto__ = b; }) ||
+            function (d, b) { for (var p in b) if (b.hasOwnProperty(p)) d[p] = b[p]; };
+        return extendStatics(d, b);
+    };
+    return function (d, b) {
+        extendStatics(d, b);
+        function __() { this.constructor = d; }
+        d.prototype = b === null ? Object.create(b) : (__.prototype = b.prototype, new __());
+    };
+})();
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.fetch = exports.Esp32JsFetchResponse = exports.Esp32JsFetchRequest = void 0;
+var http_1 = require("./http");
+var headers_1 = require("./headers");
+var headers_2 = require("./headers");
+Object.defineProperty(exports, "Esp32JsHeaders", { enumerable: true, get: function () { return headers_2.Esp32JsHeaders; } });
+var textEncoder = new TextEncoder();
+var textDecoder = new TextDecoder();
+// HTTP methods whose capitalization should be normalized
+var methods = ["DELETE", "GET", "HEAD", "OPTIONS", "POST", "PUT"];
+var redirectStatuses = [301, 302, 303, 307, 308];
+// parsing is expensive and most requests go to the url of the one before
+var lastUrl;
+function parseUrl(href) {
+    if (!lastUrl || lastUrl.href !== href) {
+        lastUrl = { href: href, parsed: urlparse(href) };
+    }
+    return lastUrl.parsed;
+}
+/**
+ * Body of requests and responses. It is kept as bytes, strings are
+ * encoded once when the body is created and decoded once when it is read.
+ */
+var FetchBody = /** @class */ (function () {
+    function FetchBody(body) {
+        this.bodyUsed = false;
+        if (body === null || body === undefined) {
+            this.bodyBytes = null;
+        }
+        else if (body instanceof Uint8Array) {
+            this.bodyBytes = body;
+        }
+        else if (body instanceof ArrayBuffer) {
+            this.bodyBytes = new Uint8Array(body);
+        }
+        else {
+            this.bodyBytes = textEncoder.encode(String(body));
+        }
+    }
+    /** Returns the received bytes without copying them if possible. */
+    FetchBody.prototype.arrayBuffer = function () {
+        return this.consume(function (bytes) {
+            return bytes.byteOffset === 0 && bytes.byteLength === bytes.buffer.byteLength
+                ? bytes.buffer
+                : new Uint8Array(bytes).buffer;
+        });
+    };
+    FetchBody.prototype.text = function () {
+        return this.consume(function (bytes) { return textDecoder.decode(bytes); });
+    };
+    FetchBody.prototype.json = function () {
+        return this.consume(function (bytes) { return JSON.parse(textDecoder.decode(bytes)); });
+    };
+    FetchBody.prototype.consume = function (read) {
+        var _this = this;
+        return new Promise(function (resolve, reject) {
+            if (_this.bodyUsed) {
+                reject(new TypeError("Already read"));
+                return;
+            }
+            _this.bodyUsed = true;
+            try {
+                resolve(read(_this.bodyBytes || new Uint8Array(0)));
+            }
+            catch (error) {
+                reject(error);
+            }
+        });
+    };
+    return FetchBody;
+}());
+function setDefaultContentType(headers, body) {
+    if (typeof body === "string" && !headers.has("content-type")) {
+        headers.set("content-type", "text/plain;charset=UTF-8");
+    }
+}
+var Esp32JsFetchRequest = /** @class */ (function (_super) {
+    __extends(Esp32JsFetchRequest, _super);
+    function Esp32JsFetchRequest(input, init) {
+        var _this = this;
+        var options = init || {};
+        var request = input instanceof Esp32JsFetchRequest ? input : null;
+        if (request && request.bodyUsed) {
+            throw new TypeError("Already read");
+        }
+        var body = options.body;
+        if (request && !body && request.bodyBytes) {
+            body = request.bodyBytes;
+            request.bodyUsed = true;
+        }
+        _this = _super.call(this, body) || this;
+        _this.url = request ? request.url : String(input);
+        var method = options.method || (request ? request.method : "GET");
+        _this.method =
+            methods.indexOf(method.toUpperCase()) >= 0
+                ? method.toUpperCase()
+                : method;
+        _this.headers = new headers_1.Esp32JsHeaders(options.headers || (request ? request.headers : undefined));
+        if ((_this.method === "GET" || _this.method === "HEAD") && body) {
+            throw new TypeError("Body not allowed for GET or HEAD requests");
+        }
+        setDefaultContentType(_this.headers, body);
+        return _this;
+    }
+    Esp32JsFetchRequest.prototype.clone = function () {
+        return new Esp32JsFetchRequest(this, { body: this.bodyBytes });
+    };
+    return Esp32JsFetchRequest;
+}(FetchBody));
+exports.Esp32JsFetchRequest = Esp32JsFetchRequest;
+var Esp32JsFetchResponse = /** @class */ (function (_super) {
+    __extends(Esp32JsFetchResponse, _super);
+    function Esp32JsFetchResponse(body, init) {
+        var _this = _super.call(this, body) || this;
+        _this.type = "default";
+        var options = init || {};
+        _this.status = options.status === undefined ? 200 : options.status;
+        _this.ok = _this.status >= 200 && _this.status < 300;
+        _this.statusText =
+            options.statusText === undefined ? "OK" : options.statusText;
+        _this.headers = new headers_1.Esp32JsHeaders(options.headers);
+        _this.url = options.url || "";
+        setDefaultContentType(_this.headers, body);
+        return _this;
+    }
+    Esp32JsFetchResponse.error = function () {
+        var response = new Esp32JsFetchResponse(null, {
+            status: 0,
+            statusText: "",
+        });
+        response.type = "error";
+        return response;
+    };
+    Esp32JsFetchResponse.redirect = function (url, status) {
+        if (redirectStatuses.indexOf(status) === -1) {
+            throw new RangeError("Invalid status code");
+        }
+        return new Esp32JsFetchResponse(null, {
+            status: status,
+            headers: { location: url },
+        });
+    };
+    Esp32JsFetchResponse.prototype.clone = function () {
+        return new Esp32JsFetchResponse(this.bodyBytes, {
+            status: this.status,
+            statusText: this.statusText,
+            headers: this.headers,
+            url: this.url,
+        });
+    };
+    return Esp32JsFetchResponse;
+}(FetchBody));
+exports.Esp32JsFetchResponse = Esp32JsFetchResponse;
+/**
+ * Sends a request over the pooled connections of the http client. The
+ * response body is received as bytes, so arrayBuffer() returns them
+ * without a copy, text() and json() decode them once. The headers are
+ * taken from the native parser as they are.
+ */
+function fetch(input, init) {
+    return new Promise(function (resolve, reject) {
+        var request;
+        try {
+            request = new Esp32JsFetchRequest(input, init);
+        }
+        catch (error) {
+            reject(error);
+            return;
+        }
+        var url = parseUrl(request.url);
+        if (url.protocol !== "http:" && url.protocol !== "https:") {
+            reject(new TypeError("Unsupported protocol for esp32 fetch implementation: " + url.protocol));
+            return;
+        }
+        var ssl = url.protocol === "https:";
+        var requestHeaders = "";
+        request.headers.forEach(function (value, name) {
+            requestHeaders += name + ": " + value + "\r\n";
+        });
+        http_1.httpRequest(ssl, url.hostname, url.port || (ssl ? "443" : "80"), url.pathname + url.search, request.method, requestHeaders, request.bodyBytes, function (received) {
+            var response = new Esp32JsFetchResponse(received.body, {
+                status: received.status,
+                statusText: received.statusText,
+                url: request.url,
+            });
+            response.headers = headers_1.Esp32JsHeaders.fromList(received.headerList);
+            resolve(response);
+        }, function (message) {
+            console.error(message);
+            reject(new TypeError("Network request failed"));
+        });
+    });
+}
+exports.fetch = fetch;
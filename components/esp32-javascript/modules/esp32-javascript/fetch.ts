@@ -0,0 +1,259 @@
+import { httpRequest } from "./http";
+import { Esp32JsHeaders, Esp32JsHeadersInit } from "./headers";
+
+export { Esp32JsHeaders, Esp32JsHeadersInit } from "./headers";
+
+// the implementation of promise.js, installed as global by index.ts
+declare const Promise: {
+  new <T>(
+    executor: (
+      resolve: (value: T) => void,
+      reject: (reason: unknown) => void
+    ) => void
+  ): Promise<T>;
+};
+
+export type Esp32JsBodyInit = string | Uint8Array | ArrayBuffer | null;
+
+export interface Esp32JsRequestInit {
+  method?: string;
+  headers?: Esp32JsHeadersInit;
+  /** A Uint8Array body is sent without copying it. */
+  body?: Esp32JsBodyInit;
+}
+
+export interface Esp32JsResponseInit {
+  status?: number;
+  statusText?: string;
+  headers?: Esp32JsHeadersInit;
+  url?: string;
+}
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+// HTTP methods whose capitalization should be normalized
+const methods = ["DELETE", "GET", "HEAD", "OPTIONS", "POST", "PUT"];
+const redirectStatuses = [301, 302, 303, 307, 308];
+
+// parsing is expensive and most requests go to the url of the one before
+let lastUrl: { href: string; parsed: AnchorElement } | undefined;
+
+function parseUrl(href: string): AnchorElement {
+  if (!lastUrl || lastUrl.href !== href) {
+    lastUrl = { href, parsed: urlparse(href) };
+  }
+  return lastUrl.parsed;
+}
+
+/**
+ * Body of requests and responses. It is kept as bytes, strings are
+ * encoded once when the body is created and decoded once when it is read.
+ */
+class FetchBody {
+  public bodyUsed = false;
+  /** The body as sent or received, reading it does not use the body. */
+  public bodyBytes: Uint8Array | null;
+
+  constructor(body?: Esp32JsBodyInit) {
+    if (body === null || body === undefined) {
+      this.bodyBytes = null;
+    } else if (body instanceof Uint8Array) {
+      this.bodyBytes = body;
+    } else if (body instanceof ArrayBuffer) {
+      this.bodyBytes = new Uint8Array(body);
+    } else {
+      this.bodyBytes = textEncoder.encode(String(body));
+    }
+  }
+
+  /** Returns the received bytes without copying them if possible. */
+  public arrayBuffer(): Promise<ArrayBuffer> {
+    return this.consume((bytes) =>
+      bytes.byteOffset === 0 && bytes.byteLength === bytes.buffer.byteLength
+        ? bytes.buffer
+        : new Uint8Array(bytes).buffer
+    );
+  }
+
+  public text(): Promise<string> {
+    return this.consume((bytes) => textDecoder.decode(bytes));
+  }
+
+  public json(): Promise<unknown> {
+    return this.consume((bytes) => JSON.parse(textDecoder.decode(bytes)));
+  }
+
+  private consume<T>(read: (bytes: Uint8Array) => T): Promise<T> {
+    return new Promise<T>((resolve, reject) => {
+      if (this.bodyUsed) {
+        reject(new TypeError("Already read"));
+        return;
+      }
+      this.bodyUsed = true;
+      try {
+        resolve(read(this.bodyBytes || new Uint8Array(0)));
+      } catch (error) {
+        reject(error);
+      }
+    });
+  }
+}
+
+function setDefaultContentType(
+  headers: Esp32JsHeaders,
+  body: Esp32JsBodyInit | undefined
+) {
+  if (typeof body === "string" && !headers.has("content-type")) {
+    headers.set("content-type", "text/plain;charset=UTF-8");
+  }
+}
+
+export class Esp32JsFetchRequest extends FetchBody {
+  public url: string;
+  public method: string;
+  public headers: Esp32JsHeaders;
+
+  constructor(
+    input: string | Esp32JsFetchRequest,
+    init?: Esp32JsRequestInit
+  ) {
+    const options = init || {};
+    const request = input instanceof Esp32JsFetchRequest ? input : null;
+    if (request && request.bodyUsed) {
+      throw new TypeError("Already read");
+    }
+    let body = options.body;
+    if (request && !body && request.bodyBytes) {
+      body = request.bodyBytes;
+      request.bodyUsed = true;
+    }
+    super(body);
+
+    this.url = request ? request.url : String(input);
+    const method = options.method || (request ? request.method : "GET");
+    this.method =
+      methods.indexOf(method.toUpperCase()) >= 0
+        ? method.toUpperCase()
+        : method;
+    this.headers = new Esp32JsHeaders(
+      options.headers || (request ? request.headers : undefined)
+    );
+    if ((this.method === "GET" || this.method === "HEAD") && body) {
+      throw new TypeError("Body not allowed for GET or HEAD requests");
+    }
+    setDefaultContentType(this.headers, body);
+  }
+
+  public clone(): Esp32JsFetchRequest {
+    return new Esp32JsFetchRequest(this, { body: this.bodyBytes });
+  }
+}
+
+export class Esp32JsFetchResponse extends FetchBody {
+  public type = "default";
+  public status: number;
+  public ok: boolean;
+  public statusText: string;
+  public headers: Esp32JsHeaders;
+  public url: string;
+
+  constructor(body?: Esp32JsBodyInit, init?: Esp32JsResponseInit) {
+    super(body);
+    const options = init || {};
+    this.status = options.status === undefined ? 200 : options.status;
+    this.ok = this.status >= 200 && this.status < 300;
+    this.statusText =
+      options.statusText === undefined ? "OK" : options.statusText;
+    this.headers = new Esp32JsHeaders(options.headers);
+    this.url = options.url || "";
+    setDefaultContentType(this.headers, body);
+  }
+
+  public static error(): Esp32JsFetchResponse {
+    const response = new Esp32JsFetchResponse(null, {
+      status: 0,
+      statusText: "",
+    });
+    response.type = "error";
+    return response;
+  }
+
+  public static redirect(url: string, status: number): Esp32JsFetchResponse {
+    if (redirectStatuses.indexOf(status) === -1) {
+      throw new RangeError("Invalid status code");
+    }
+    return new Esp32JsFetchResponse(null, {
+      status,
+      headers: { location: url },
+    });
+  }
+
+  public clone(): Esp32JsFetchResponse {
+    return new Esp32JsFetchResponse(this.bodyBytes, {
+      status: this.status,
+      statusText: this.statusText,
+      headers: this.headers,
+      url: this.url,
+    });
+  }
+}
+
+/**
+ * Sends a request over the pooled connections of the http client. The
+ * response body is received as bytes, so arrayBuffer() returns them
+ * without a copy, text() and json() decode them once. The headers are
+ * taken from the native parser as they are.
+ */
+export function fetch(
+  input: string | Esp32JsFetchRequest,
+  init?: Esp32JsRequestInit
+): Promise<Esp32JsFetchResponse> {
+  return new Promise<Esp32JsFetchResponse>((resolve, reject) => {
+    let request: Esp32JsFetchRequest;
+    try {
+      request = new Esp32JsFetchRequest(input, init);
+    } catch (error) {
+      reject(error);
+      return;
+    }
+
+    const url = parseUrl(request.url);
+    if (url.protocol !== "http:" && url.protocol !== "https:") {
+      reject(
+        new TypeError(
+          `Unsupported protocol for esp32 fetch implementation: ${url.protocol}`
+        )
+      );
+      return;
+    }
+    const ssl = url.protocol === "https:";
+    let requestHeaders = "";
+    request.headers.forEach((value, name) => {
+      requestHeaders += `${name}: ${value}\r\n`;
+    });
+
+    httpRequest(
+      ssl,
+      url.hostname,
+      url.port || (ssl ? "443" : "80"),
+      url.pathname + url.search,
+      request.method,
+      requestHeaders,
+      request.bodyBytes,
+      (received) => {
+        const response = new Esp32JsFetchResponse(received.body, {
+          status: received.status,
+          statusText: received.statusText,
+          url: request.url,
+        });
+        response.headers = Esp32JsHeaders.fromList(received.headerList);
+        resolve(response);
+      },
+      (message) => {
+        console.error(message);
+        reject(new TypeError("Network request failed"));
+      }
+    );
+  });
+}
@@ -0,0 +1,84 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.Esp32JsHeaders = void 0;
+// names of the ids of well-known headers in header lists
+var knownHeaders = el_headerNames();
+// builds a destructive iterator for the value list
+function iteratorFor(items) {
+    return {
+        next: function () {
+            var value = items.shift();
+            return { done: value === undefined, value: value };
+        },
+    };
+}
+/**
+ * Header map of fetch requests and responses, also used by httpServer.
+ * Names are case-insensitive, values appended to an existing name are
+ * joined with ", ". Names are validated and lower cased natively, entries
+ * are kept in one array of names and values in which well-known names are
+ * small integer ids.
+ */
+var Esp32JsHeaders = /** @class */ (function () {
+    function Esp32JsHeaders(headers) {
+        var _this = this;
+        this.list = [];
+        if (headers instanceof Esp32JsHeaders) {
+            this.list = headers.list.slice();
+        }
+        else if (Array.isArray(headers)) {
+            headers.forEach(function (header) { return _this.append(header[0], header[1]); });
+        }
+        else if (headers) {
+            var init_1 = headers;
+            Object.keys(init_1).forEach(function (name) { return _this.append(name, init_1[name]); });
+        }
+    }
+    /**
+     * Creates headers from the flat name/value list of the native http
+     * parser, whose names are lower case and validated already.
+     */
+    Esp32JsHeaders.fromList = function (headerList) {
+        var headers = new Esp32JsHeaders();
+        el_appendHeaderList(headers.list, headerList);
+        return headers;
+    };
+    Esp32JsHeaders.prototype.append = function (name, value) {
+        el_setHeader(this.list, name, value, false);
+    };
+    Esp32JsHeaders.prototype.delete = function (name) {
+        el_deleteHeader(this.list, name);
+    };
+    Esp32JsHeaders.prototype.get = function (name) {
+        return el_getHeader(this.list, name);
+    };
+    Esp32JsHeaders.prototype.has = function (name) {
+        return el_getHeader(this.list, name) !== null;
+    };
+    Esp32JsHeaders.prototype.set = function (name, value) {
+        el_setHeader(this.list, name, value, true);
+    };
+    Esp32JsHeaders.prototype.forEach = function (callback, thisArg) {
+        var list = this.list;
+        for (var i = 0; i < list.length; i += 2) {
+            var name = list[i];
+            callback.call(thisArg, list[i + 1], typeof name === "number" ? knownHeaders[name] : name, this);
+        }
+    };
+    Esp32JsHeaders.prototype.keys = function () {
+        var items = [];
+        this.forEach(function (value, name) { return items.push(name); });
+        return iteratorFor(items);
+    };
+    Esp32JsHeaders.prototype.values = function () {
+        var items = [];
+        this.forEach(function (value) { return items.push(value); });
+        return iteratorFor(items);
+    };
+    Esp32JsHeaders.prototype.entries = function () {
+        var items = [];
+        this.forEach(function (value, name) { return items.push([name, value]); });
+        return iteratorFor(items);
+    };
+    return Esp32JsHeaders;
+}());
+exports.Esp32JsHeaders = Esp32JsHeaders;
@@ -0,0 +1,107 @@
+export type Esp32JsHeadersInit =
+  | Esp32JsHeaders
+  | string[][]
+  | { [name: string]: string };
+
+// names of the ids of well-known headers in header lists
+const knownHeaders = el_headerNames();
+
+interface HeadersIterator<T> {
+  next: () => { done: boolean; value: T | undefined };
+}
+
+// builds a destructive iterator for the value list
+function iteratorFor<T>(items: T[]): HeadersIterator<T> {
+  return {
+    next: function () {
+      const value = items.shift();
+      return { done: value === undefined, value };
+    },
+  };
+}
+
+/**
+ * Header map of fetch requests and responses, also used by httpServer.
+ * Names are case-insensitive, values appended to an existing name are
+ * joined with ", ". Names are validated and lower cased natively, entries
+ * are kept in one array of names and values in which well-known names are
+ * small integer ids.
+ */
+export class Esp32JsHeaders {
+  private list: (number | string)[] = [];
+
+  constructor(headers?: Esp32JsHeadersInit) {
+    if (headers instanceof Esp32JsHeaders) {
+      this.list = headers.list.slice();
+    } else if (Array.isArray(headers)) {
+      headers.forEach((header) => this.append(header[0], header[1]));
+    } else if (headers) {
+      const init = headers;
+      Object.keys(init).forEach((name) => this.append(name, init[name]));
+    }
+  }
+
+  /**
+   * Creates headers from the flat name/value list of the native http
+   * parser, whose names are lower case and validated already.
+   */
+  public static fromList(headerList: string[]): Esp32JsHeaders {
+    const headers = new Esp32JsHeaders();
+    el_appendHeaderList(headers.list, headerList);
+    return headers;
+  }
+
+  public append(name: string, value: string): void {
+    el_setHeader(this.list, name, value, false);
+  }
+
+  public delete(name: string): void {
+    el_deleteHeader(this.list, name);
+  }
+
+  public get(name: string): string | null {
+    return el_getHeader(this.list, name);
+  }
+
+  public has(name: string): boolean {
+    return el_getHeader(this.list, name) !== null;
+  }
+
+  public set(name: string, value: string): void {
+    el_setHeader(this.list, name, value, true);
+  }
+
+  public forEach(
+    callback: (value: string, name: string, headers: Esp32JsHeaders) => void,
+    thisArg?: unknown
+  ): void {
+    const list = this.list;
+    for (let i = 0; i < list.length; i += 2) {
+      const name = list[i];
+      callback.call(
+        thisArg,
+        list[i + 1] as string,
+        typeof name === "number" ? knownHeaders[name] : name,
+        this
+      );
+    }
+  }
+
+  public keys(): HeadersIterator<string> {
+    const items: string[] = [];
+    this.forEach((value, name) => items.push(name));
+    return iteratorFor(items);
+  }
+
+  public values(): HeadersIterator<string> {
+    const items: string[] = [];
+    this.forEach((value) => items.push(value));
+    return iteratorFor(items);
+  }
+
+  public entries(): HeadersIterator<string[]> {
+    const items: string[][] = [];
+    this.forEach((value, name) => items.push([name, value]));
+    return iteratorFor(items);
+  }
+}
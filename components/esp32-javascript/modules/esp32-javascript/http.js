@@ -1,26 +1,39 @@
 Object.defineProperty(exports, "__esModule", { value: true });
-exports.XMLHttpRequest = exports.httpClient = exports.parseQueryStr = exports.decodeQueryParam = exports.httpServer = void 0;
+exports.XMLHttpRequest = exports.httpRequest = exports.httpClient = exports.httpClientPool = exports.parseQueryStr = exports.decodeQueryParam = exports.httpServer = exports.httpServerLimits = exports.acceptsEncoding = void 0;
 var socketEvents = require("socket-events");
 var stringbuffer_1 = require("./stringbuffer");
+var headers_1 = require("./headers");
+// data a client may send after an upgrade request before it is upgraded
+var maxPendingUpgradeData = 16 * 1024;
 var sockListen = socketEvents.sockListen;
 var sockConnect = socketEvents.sockConnect;
 var closeSocket = socketEvents.closeSocket;
-function parseHeaders(complete, endOfHeaders) {
-    var headersRaw = complete.substring(0, endOfHeaders).toString();
-    var headerTokens = headersRaw.split("\r\n");
-    var statusLine = headerTokens.shift();
-    var headers = new Headers();
-    headerTokens.forEach(function (headerLine) {
-        var delim = headerLine.indexOf(":");
-        if (delim >= 0) {
-            headers.append(headerLine.substring(0, delim).trim(), headerLine.substring(delim + 1).trim());
-        }
+// flags of el_buildResponseHead selecting pre-encoded header lines
+var responseHeadConnectionClose = 1;
+var responseHeadKeepAlive = 2;
+var responseHeadChunked = 4;
+// answers without reading the request and ends the connection. Closing it
+// with unread data would reset it and the client may lose the response, so
+// only the sending side is shut down and the rest of the request is
+// discarded until the client closes the connection or stops sending.
+function writeEmptyResponse(socket, status) {
+    socket.onData = null;
+    socket.write(el_buildResponseHead(status, "", ["content-length", "0"], responseHeadConnectionClose));
+    socket.flush(function () {
+        socketEvents.shutdownSocket(socket);
     });
-    return {
-        statusLine: statusLine,
-        headers: headers,
-    };
+    socket.setReadTimeout(2000);
+}
+/**
+ * Checks if a content coding is listed in an Accept-Encoding header
+ * without being excluded by q=0.
+ */
+function acceptsEncoding(acceptEncoding, coding) {
+    return (acceptEncoding !== null &&
+        new RegExp("(^|[ ,])" + coding + "($|[ ,;])", "i").test(acceptEncoding) &&
+        !new RegExp("(^|[ ,])" + coding + " *; *q=0(\\.0*)?($|[ ,])", "i").test(acceptEncoding));
 }
+exports.acceptsEncoding = acceptsEncoding;
 var EventEmitter = /** @class */ (function () {
     function EventEmitter() {
         this.listener = {};
@@ -38,223 +51,420 @@ var EventEmitter = /** @class */ (function () {
     };
     return EventEmitter;
 }());
-function httpServer(port, isSSL, cb) {
+/**
+ * Connection limits of {@link httpServer}. Connections exceeding
+ * maxConnections get a 503 response unless an idle keep-alive connection
+ * can be closed instead, on SSL servers they are closed without response.
+ * Upgraded connections, i.e. websockets and event streams, are not counted.
+ */
+exports.httpServerLimits = {
+    /** Maximum number of simultaneously open connections per server, 0 means unlimited. */
+    maxConnections: 6,
+    /** Maximum number of connections accepted per event loop turn. */
+    acceptBudget: 4,
+};
+/**
+ * Starts a http server. The callback is called with each completely
+ * received request.
+ *
+ * @param onRequestBody Optionally called with requests which have a body
+ * as soon as their headers were received. It can return options to stream
+ * the body or to write it to a file. req.body is null for such requests.
+ */
+function httpServer(port, isSSL, cb, onRequestBody) {
     var textEncoder = new TextEncoder();
-    var textDecoder = new TextDecoder();
     sockListen(port, function (socket) {
         var requestCounter = 0;
-        var complete = null;
-        var contentLength = 0;
-        var headers;
-        var statusLine;
-        var gotten = 0;
+        var parser = el_createHttpParser();
+        // if a request is partially received
+        var receiving = false;
+        var received = null;
+        // as decided by the parser from the connection header and the version
+        var receivedKeepAlive = true;
+        var bodyParts = null;
+        var bodyOptions = null;
+        // the parser calls its handlers synchronously, a handler which closes
+        // the socket must not free the parser while it is still running
+        var parsing = false;
+        var closed = false;
+        // the parser stops after a request with an upgrade header, data
+        // received after it is kept for the new owner of the connection
+        var receivedUpgrade = false;
+        var pending = null;
+        var pendingLength = 0;
+        var upgraded = false;
+        var resume = function () {
+            socket.readPaused = false;
+        };
+        var endBody = function (complete) {
+            var options = bodyOptions;
+            bodyOptions = null;
+            if (options && options.onEnd) {
+                options.onEnd(complete);
+            }
+        };
         var active = [];
-        socket.onData = function (data, _, length) {
-            complete = complete ? complete.append(data) : new stringbuffer_1.StringBuffer(data);
-            gotten += length;
-            var endOfHeaders = complete.indexOf("\r\n\r\n");
-            if (gotten >= 4 && endOfHeaders >= 0) {
-                if (!headers) {
-                    var parsed = parseHeaders(complete, endOfHeaders);
-                    statusLine = parsed.statusLine;
-                    headers = parsed.headers;
-                    requestCounter++;
-                    console.debug("Request on socket " + socket.sockfd + ": " + statusLine + ", requestCounter:" + requestCounter);
-                }
-                var postedData = null;
-                var contentLengthHeader = headers.get("content-length");
-                if (typeof contentLengthHeader === "string") {
-                    contentLength = parseInt(contentLengthHeader);
-                }
-                if (contentLength > 0) {
-                    console.debug("A request body is expected.");
-                    if (gotten >= endOfHeaders + 4 + contentLength) {
-                        var potentialRequestBody = textEncoder.encode(complete.substring(endOfHeaders + 4).toString());
-                        postedData = textDecoder.decode(potentialRequestBody.subarray(0, contentLength));
-                        console.debug("Request body is complete:");
-                        console.debug(postedData);
+        // compressor of the response being written, responses of a connection
+        // are written one after another
+        var deflateStream = 0;
+        var handleRequest = function (req, keepAlive, upgradeRequest) {
+            var headers = req.headers;
+            var eventEmitter = new EventEmitter();
+            var responseHeaders = new headers_1.Esp32JsHeaders();
+            var chunkedEncoding = false;
+            var compressRequested = false;
+            // the client asked to close the connection after this response, with
+            // connection: close or as HTTP/1.0 client without keep-alive. After an
+            // upgrade request no further requests are read, so the connection is
+            // closed unless it gets upgraded.
+            var closeRequested = !keepAlive || upgradeRequest;
+            var closeConnection = false;
+            // initialize response
+            var res = {
+                headers: responseHeaders,
+                isEnded: false,
+                statusWritten: false,
+                headersWritten: false,
+                status: { status: 200, statusText: "OK" },
+                on: function (event, cb) {
+                    eventEmitter.on(event, cb);
+                },
+                flush: function (cb) {
+                    socket.flush(cb);
+                },
+                setStatus: function (status, statusText) {
+                    res.status.status = status;
+                    res.status.statusText = statusText || "";
+                },
+                write: function (data) {
+                    if (res.isEnded) {
+                        throw Error("request has already ended");
+                    }
+                    if (!res.headersWritten) {
+                        res.statusWritten = true;
+                        res.headersWritten = true;
+                        socket.write(buildHead());
+                    }
+                    if (deflateStream &&
+                        typeof data !== "undefined" &&
+                        data.length > 0) {
+                        data = el_writeDeflateStream(deflateStream, data, false);
+                    }
+                    writeBody(data);
+                },
+                end: function (data) {
+                    if (!res.headersWritten) {
+                        res.write();
+                    }
+                    if (deflateStream) {
+                        // the last part of the body also ends the compressed stream
+                        var last = el_writeDeflateStream(deflateStream, data, true);
+                        el_freeDeflateStream(deflateStream);
+                        deflateStream = 0;
+                        res.write(last);
                     }
                     else {
-                        //wait for more data to come (body of  a POST request)
-                        console.debug("Waiting for more data to come:");
-                        console.debug(contentLength);
-                        console.debug(complete.length);
-                        console.debug(gotten);
-                        console.debug(endOfHeaders);
-                        return;
+                        res.write(data);
                     }
-                }
-                if (statusLine) {
-                    var startOfPath = statusLine.indexOf(" ");
-                    var path = statusLine.substring(startOfPath + 1, statusLine.indexOf(" ", startOfPath + 1));
-                    var method = complete.substring(0, startOfPath).toString();
-                    var req_1 = {
-                        method: method,
-                        path: path,
-                        body: postedData,
-                        headers: headers,
-                    };
-                    var eventEmitter_1 = new EventEmitter();
-                    var responseHeaders_1 = new Headers();
-                    var chunkedEncoding_1 = false;
-                    var isConnectionClose_1 = function () {
-                        var close = false;
-                        if (!close && headers && headers.get("connection") === "close") {
-                            close = true;
-                        }
-                        if (!close &&
-                            responseHeaders_1 &&
-                            responseHeaders_1.get("transfer-encoding") !== "chunked" &&
-                            !responseHeaders_1.has("content-length")) {
-                            close = true;
-                        }
-                        if (!close &&
-                            responseHeaders_1 &&
-                            responseHeaders_1.get("connection") === "close") {
-                            close = true;
+                    if (chunkedEncoding) {
+                        socket.write("0\r\n");
+                        socket.write("\r\n");
+                    }
+                    socket.flush(finish);
+                },
+                sendFile: function (path, offset, length) {
+                    var stat = fileStat(path);
+                    if (!stat) {
+                        return false;
+                    }
+                    var size = stat.size;
+                    if (!responseHeaders.has("content-length")) {
+                        var available = size - (offset || 0);
+                        responseHeaders.set("content-length", String(typeof length === "number" && length < available
+                            ? length
+                            : available));
+                    }
+                    res.write();
+                    var sent = socket.sendFile(path, function (error) {
+                        if (error) {
+                            console.error(error.message);
+                            closeConnection = true;
                         }
-                        return close;
-                    };
-                    var chunked_1 = function () {
-                        var chunked = true;
-                        if (chunked && headers && headers.get("connection") === "close") {
-                            chunked = false;
+                        finish();
+                    }, offset, length);
+                    if (!sent) {
+                        // the head promised a body which cannot be sent anymore
+                        closeConnection = true;
+                        socket.flush(finish);
+                    }
+                    return true;
+                },
+                compress: function () {
+                    compressRequested = true;
+                },
+                upgrade: function (status) {
+                    if (!upgradeRequest && receiving) {
+                        // the data received after the request was parsed as http
+                        throw new Error("Cannot upgrade, data was received after the request");
+                    }
+                    closeRequested = !keepAlive;
+                    res.setStatus(status || 101);
+                    res.write();
+                    socket.flush();
+                    socket.onData = null;
+                    socket.onClose = null;
+                    socket.setReadTimeout(0);
+                    socket.isUpgraded = true;
+                    upgraded = true;
+                    if (!parsing) {
+                        el_freeHttpParser(parser);
+                    }
+                    if (pending !== null) {
+                        // e.g. a first websocket frame sent along with the handshake,
+                        // passed on once the caller has set onData
+                        var rest_1 = pending;
+                        var restLength_1 = pendingLength;
+                        pending = null;
+                        queueMicrotask(function () {
+                            if (socket.onData) {
+                                socket.onData(rest_1, socket.sockfd, restLength_1);
+                            }
+                        });
+                    }
+                    res.isEnded = true;
+                    eventEmitter.emit("end");
+                    return socket;
+                },
+                abort: function () {
+                    closeSocket(socket);
+                    res.isEnded = true;
+                    eventEmitter.emit("end");
+                },
+            };
+            var writeBody = function (data) {
+                if (typeof data !== "undefined" && data.length > 0) {
+                    if (chunkedEncoding) {
+                        var encoded = typeof data === "string" ? textEncoder.encode(data) : data;
+                        socket.write(encoded.length.toString(16) + "\r\n");
+                    }
+                    socket.write(data);
+                    if (chunkedEncoding) {
+                        socket.write("\r\n");
+                    }
+                }
+            };
+            var finish = function () {
+                if (closeConnection) {
+                    console.debug("Socket " + socket.sockfd + " closed.");
+                    closeSocket(socket.sockfd);
+                }
+                else if (!receiving && active.length === 1) {
+                    // waiting for the next request, may be closed to admit new connections
+                    socket.isIdle = true;
+                }
+                res.isEnded = true;
+                eventEmitter.emit("end");
+            };
+            // decides framing and connection handling in a single pass over the
+            // response headers and serializes the whole head into one buffer
+            var buildHead = function () {
+                var connection = null;
+                var transferEncoding = null;
+                var contentLength = false;
+                var contentEncoding = false;
+                var vary = false;
+                var headerList = [];
+                responseHeaders.forEach(function (value, key) {
+                    if (key === "connection") {
+                        connection = value;
+                    }
+                    else if (key === "transfer-encoding") {
+                        transferEncoding = value;
+                    }
+                    else {
+                        if (key === "content-length") {
+                            contentLength = true;
                         }
-                        if (chunked &&
-                            responseHeaders_1 &&
-                            ((responseHeaders_1.has("transfer-encoding") &&
-                                responseHeaders_1.get("transfer-encoding") !== "chunked") ||
-                                responseHeaders_1.has("content-length"))) {
-                            chunked = false;
+                        else if (key === "content-encoding") {
+                            contentEncoding = true;
                         }
-                        if (chunked &&
-                            responseHeaders_1 &&
-                            responseHeaders_1.get("connection") === "close") {
-                            chunked = false;
+                        else if (key === "vary") {
+                            vary = true;
                         }
-                        return chunked;
-                    };
-                    // initialize response
-                    var res_1 = {
-                        headers: responseHeaders_1,
-                        isEnded: false,
-                        statusWritten: false,
-                        headersWritten: false,
-                        status: { status: 200, statusText: "OK" },
-                        on: function (event, cb) {
-                            eventEmitter_1.on(event, cb);
-                        },
-                        flush: function () {
-                            socket.flush();
-                        },
-                        setStatus: function (status, statusText) {
-                            res_1.status.status = status;
-                            if (statusText) {
-                                res_1.status.statusText = statusText;
-                            }
-                        },
-                        write: function (data) {
-                            if (res_1.isEnded) {
-                                throw Error("request has already ended");
-                            }
-                            if (!res_1.statusWritten) {
-                                res_1.statusWritten = true;
-                                socket.write("HTTP/1.1 " + res_1.status.status + " " + res_1.status.statusText + "\r\n");
-                            }
-                            if (!res_1.headersWritten) {
-                                if (chunked_1()) {
-                                    responseHeaders_1.set("transfer-encoding", "chunked");
-                                    chunkedEncoding_1 = true;
-                                }
-                                if (isConnectionClose_1()) {
-                                    responseHeaders_1.set("connection", "close");
-                                }
-                                if (!responseHeaders_1.has("connection")) {
-                                    responseHeaders_1.set("connection", "keep-alive");
-                                    socket.setReadTimeout(20000);
-                                }
-                                var contentType = responseHeaders_1.get("content-type");
-                                if (typeof contentType !== "string") {
-                                    responseHeaders_1.set("content-type", "text/plain; charset=utf-8");
-                                }
-                                else if (contentType.indexOf("charset") < 0) {
-                                    responseHeaders_1.set("content-type", contentType + "; charset=utf-8");
-                                }
-                                res_1.headersWritten = true;
-                                responseHeaders_1.forEach(function (value, key) {
-                                    socket.write(key + ": " + value + "\r\n");
-                                });
-                                socket.write("\r\n");
-                            }
-                            if (typeof data !== "undefined" && data.length > 0) {
-                                if (chunkedEncoding_1) {
-                                    var encoded = typeof data === "string"
-                                        ? textEncoder.encode(data)
-                                        : data;
-                                    socket.write(encoded.length.toString(16) + "\r\n");
-                                }
-                                if (data) {
-                                    socket.write(data);
-                                }
-                                if (chunkedEncoding_1) {
-                                    socket.write("\r\n");
-                                    //socket.flush();
-                                }
-                            }
-                        },
-                        end: function (data) {
-                            res_1.write(data);
-                            if (chunkedEncoding_1) {
-                                socket.write("0\r\n");
-                                socket.write("\r\n");
-                            }
-                            socket.flush(function () {
-                                if (isConnectionClose_1()) {
-                                    console.debug("Socket " + socket.sockfd + " closed.");
-                                    closeSocket(socket.sockfd);
-                                }
-                                res_1.isEnded = true;
-                                eventEmitter_1.emit("end");
-                            });
-                        },
-                    };
-                    // reset state for keep alive connections getting more requests
-                    // on the same socket
-                    complete = complete.substring(endOfHeaders + 4 + contentLength);
-                    gotten = gotten - endOfHeaders - 4 - contentLength;
-                    contentLength = 0;
-                    headers = undefined;
-                    statusLine = undefined;
-                    console.debug("gotten: " + gotten);
-                    console.debug("complete.length: " + complete.length);
-                    var item_1 = { req: req_1, res: res_1 };
-                    var num = active.push(item_1);
-                    console.debug("Currently active requests: " + num);
-                    res_1.on("end", function () {
-                        console.debug("splicing req/res form active list");
-                        active.splice(active.indexOf(item_1), 1);
-                    });
-                    var previous = num - 2;
-                    if (previous < 0 || active[previous].res.isEnded) {
-                        // active request/response is empty, perform immediately
-                        console.debug("// active request/response is empty or entries are ended, perform immediately");
-                        setTimeout(function () {
-                            console.debug("perform immediate");
-                            cb(req_1, res_1);
-                        }, 0);
+                        headerList.push(key, value);
+                    }
+                });
+                // these responses never have a body
+                var status = res.status.status;
+                var bodyless = status < 200 || status === 204 || status === 304;
+                if (compressRequested && !bodyless) {
+                    var acceptEncoding = headers.get("accept-encoding");
+                    var gzip = acceptsEncoding(acceptEncoding, "gzip");
+                    if (!contentLength &&
+                        !contentEncoding &&
+                        transferEncoding === null &&
+                        req.method !== "HEAD" &&
+                        (gzip || acceptsEncoding(acceptEncoding, "deflate"))) {
+                        deflateStream = el_createDeflateStream(gzip);
+                        headerList.push("content-encoding", gzip ? "gzip" : "deflate");
+                    }
+                    if (!vary) {
+                        headerList.push("vary", "accept-encoding");
+                    }
+                }
+                chunkedEncoding =
+                    !bodyless &&
+                        !closeRequested &&
+                        connection !== "close" &&
+                        !contentLength &&
+                        (transferEncoding === null || transferEncoding === "chunked");
+                closeConnection =
+                    closeRequested ||
+                        connection === "close" ||
+                        (!chunkedEncoding &&
+                            !bodyless &&
+                            transferEncoding !== "chunked" &&
+                            !contentLength);
+                var flags = chunkedEncoding ? responseHeadChunked : 0;
+                if (transferEncoding !== null && !chunkedEncoding) {
+                    headerList.push("transfer-encoding", transferEncoding);
+                }
+                if (closeConnection) {
+                    flags |= responseHeadConnectionClose;
+                }
+                else if (connection === null) {
+                    flags |= responseHeadKeepAlive;
+                    socket.setReadTimeout(20000);
+                }
+                else {
+                    headerList.push("connection", connection);
+                }
+                return el_buildResponseHead(res.status.status, res.status.statusText, headerList, flags);
+            };
+            var item = { req: req, res: res };
+            var num = active.push(item);
+            console.debug("Currently active requests: " + num);
+            res.on("end", function () {
+                console.debug("splicing req/res form active list");
+                active.splice(active.indexOf(item), 1);
+            });
+            var previous = num - 2;
+            if (previous < 0 || active[previous].res.isEnded) {
+                // active request/response is empty, perform immediately
+                console.debug("// active request/response is empty or entries are ended, perform immediately");
+                setTimeout(function () {
+                    console.debug("perform immediate");
+                    cb(req, res);
+                }, 0);
+            }
+            else {
+                // queue request/response callback after previous request/response
+                console.debug("// queue request/response callback after previous request/response");
+                active[previous].res.on("end", function () {
+                    console.debug("end of previous req/res: triggering new req/res callback");
+                    cb(req, res);
+                });
+            }
+        };
+        var parserHandler = {
+            onHead: function (method, path, headerList, contentLength, chunked, keepAlive) {
+                if (closed) {
+                    return;
+                }
+                var headers = headers_1.Esp32JsHeaders.fromList(headerList);
+                requestCounter++;
+                console.debug("Request on socket " + socket.sockfd + ": " + method + " " + path + ", requestCounter:" + requestCounter);
+                received = { method: method, path: path, body: null, headers: headers };
+                receivedKeepAlive = keepAlive;
+                receivedUpgrade =
+                    headers.get("upgrade") !== null &&
+                        /(^|[ ,])upgrade($|[ ,])/i.test(headers.get("connection") || "");
+                bodyParts = null;
+                bodyOptions = null;
+                if (contentLength > 0 || chunked) {
+                    var options = onRequestBody ? onRequestBody(received) : null;
+                    if (options) {
+                        el_setHttpParserBody(parser, true, typeof options.maxSize === "number" ? options.maxSize : -1, options.file);
+                        bodyOptions = options;
                     }
                     else {
-                        // queue request/response callback after previous request/response
-                        console.debug("// queue request/response callback after previous request/response");
-                        active[previous].res.on("end", function () {
-                            console.debug("end of previous req/res: triggering new req/res callback");
-                            cb(req_1, res_1);
-                        });
+                        bodyParts = [];
                     }
-                    if (gotten > 0 && socket.onData) {
-                        socket.onData("", _, 0);
+                }
+            },
+            onBody: function (data) {
+                if (closed) {
+                    return;
+                }
+                if (bodyOptions) {
+                    if (bodyOptions.onData &&
+                        bodyOptions.onData(data, resume) === false) {
+                        socket.readPaused = true;
                     }
                 }
+                else {
+                    bodyParts.push(data);
+                }
+            },
+            onComplete: function () {
+                if (closed) {
+                    return;
+                }
+                var req = received;
+                if (bodyParts) {
+                    req.body = bodyParts.join("");
+                }
+                received = null;
+                bodyParts = null;
+                endBody(true);
+                handleRequest(req, receivedKeepAlive, receivedUpgrade);
+                return receivedUpgrade;
+            },
+            onDetached: function (data, length) {
+                pending = pending === null ? data : pending + data;
+                pendingLength += length;
+            },
+        };
+        socket.onData = function (data) {
+            var state = 0;
+            parsing = true;
+            try {
+                state = el_executeHttpParser(parser, data, parserHandler);
+            }
+            catch (error) {
+                // the request was left half parsed, e.g. by a throwing onData
+                console.error("Receiving request on socket " + socket.sockfd + " failed: " + error);
+                state = -500;
+            }
+            finally {
+                parsing = false;
+            }
+            if (closed || upgraded) {
+                el_freeHttpParser(parser);
+                return;
+            }
+            if (pendingLength > maxPendingUpgradeData) {
+                console.debug("Too much data before upgrading socket " + socket.sockfd);
+                closeSocket(socket);
+                return;
+            }
+            receiving = state > 0;
+            if (state < 0) {
+                var status = -state;
+                console.debug("Malformed request on socket " + socket.sockfd + ": " + status);
+                socket.onData = null;
+                endBody(false);
+                writeEmptyResponse(socket, status);
+            }
+        };
+        socket.onClose = function () {
+            closed = true;
+            endBody(false);
+            if (!parsing) {
+                el_freeHttpParser(parser);
+            }
+            if (deflateStream) {
+                el_freeDeflateStream(deflateStream);
             }
         };
         socket.onError = function (sockfd) {
@@ -264,7 +474,13 @@ function httpServer(port, isSSL, cb) {
         console.error("ON ERROR: Socket " + sockfd);
     }, function () {
         console.info("SOCKET WAS CLOSED!");
-    }, isSSL);
+    }, isSSL, {
+        acceptBudget: exports.httpServerLimits.acceptBudget,
+        maxConnections: exports.httpServerLimits.maxConnections,
+        onReject: function (socket) {
+            writeEmptyResponse(socket, 503);
+        },
+    });
 }
 exports.httpServer = httpServer;
 function decodeQueryParam(value) {
@@ -284,82 +500,326 @@ function parseQueryStr(query) {
     return parsed;
 }
 exports.parseQueryStr = parseQueryStr;
-function httpClient(ssl, host, port, path, method, requestHeaders, body, successCB, errorCB, finishCB) {
-    var complete = new stringbuffer_1.StringBuffer();
-    var completeLength = 0;
-    var chunked = false;
-    var headerRead = false;
-    var headerEnd = -1;
-    var contentLength = -1;
-    requestHeaders = requestHeaders || "";
-    if (!errorCB) {
-        errorCB = print;
+/**
+ * Settings of the keep-alive connection pool used by {@link httpClient}.
+ * Connections are pooled per origin (protocol, host and port).
+ */
+exports.httpClientPool = {
+    /** Reuse connections for subsequent requests to the same origin. */
+    keepAlive: true,
+    /** Maximum number of simultaneously open sockets per origin. */
+    maxSocketsPerHost: 2,
+    /** Idle connections are closed after this number of milliseconds. */
+    idleTimeout: 15000,
+};
+var httpClientOrigins = {};
+var textDecoder = new TextDecoder();
+var textEncoder = new TextEncoder();
+// requests which may be sent again if a reused connection was closed by the server
+var idempotentMethods = ["GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE"];
+function createResponse() {
+    return {
+        received: 0,
+        status: 0,
+        statusText: "",
+        headerList: [],
+        bodyParts: [],
+        bodyLength: 0,
+        untilClose: false,
+        keepAlive: false,
+    };
+}
+function writeRequest(connection) {
+    var request = connection.request;
+    var socket = connection.socket;
+    var head = request.method + " " + request.path + " HTTP/1.1\r\nHost: " + request.host + "\r\n" + (exports.httpClientPool.keepAlive ? "" : "Connection: close\r\n");
+    var body = request.body;
+    if (body && !(body instanceof Uint8Array)) {
+        // content-length counts bytes, not characters
+        var bodyStr = body.toString();
+        body = bodyStr ? textEncoder.encode(bodyStr) : null;
     }
-    sockConnect(ssl, host, port, function (socket) {
-        var bodyStr = body ? body.toString() : null;
-        var requestLines = method + " " + path + " HTTP/1.1\r\nHost: " + host + "\r\n" + (bodyStr ? "Content-length: " + bodyStr.length + "\r\n" : "") + requestHeaders + "\r\n" + (bodyStr ? bodyStr + "\r\n" : "");
-        socket.write(requestLines);
-        socket.flush();
-    }, function (data, sockfd, length) {
-        complete.append(data);
-        completeLength = completeLength + length;
-        if (!headerRead && (headerEnd = complete.indexOf("\r\n\r\n")) >= 0) {
-            headerRead = true;
-            chunked =
-                complete.toLowerCase().indexOf("transfer-encoding: chunked") >= 0;
-            var clIndex = complete.toLowerCase().indexOf("content-length: ");
-            if (clIndex >= 0) {
-                var endOfContentLength = complete.indexOf("\r\n", clIndex);
-                contentLength = parseInt(complete.substring(clIndex + 15, endOfContentLength).toString());
-            }
-            headerEnd += 4;
+    if (body instanceof Uint8Array) {
+        socket.write(head + "Content-length: " + body.length + "\r\n" + request.requestHeaders + "\r\n");
+        if (body.length > 0) {
+            // queued behind the head without copying it
+            socket.writeShared(body);
         }
-        if (chunked) {
-            if (complete.substring(complete.length - 5).toString() == "0\r\n\r\n") {
-                closeSocket(sockfd);
-            }
+        else {
+            socket.flush();
         }
-        if (contentLength >= 0) {
-            if (completeLength - headerEnd == contentLength) {
-                closeSocket(sockfd);
-            }
+        return;
+    }
+    socket.write("" + head + request.requestHeaders + "\r\n");
+    socket.flush();
+}
+function deliverResponse(request, response) {
+    if (response.status === 0) {
+        request.errorCB("Could not load " + (request.ssl ? "https" : "http") + "://" + request.host + ":" + request.port + request.path);
+        return;
+    }
+    // copy the received parts into the final body once
+    var body = new Uint8Array(response.bodyLength);
+    var offset = 0;
+    response.bodyParts.forEach(function (part) {
+        body.set(part, offset);
+        offset += part.length;
+    });
+    response.bodyParts = [];
+    if (request.responseCB) {
+        request.responseCB({
+            status: response.status,
+            statusText: response.statusText,
+            headerList: response.headerList,
+            body: body,
+        });
+    }
+    else if (request.successCB) {
+        var content = textDecoder.decode(body);
+        //free body for GC
+        body = null;
+        var head = "HTTP/1.1 " + response.status + " " + response.statusText + "\r\n";
+        for (var i = 0; i < response.headerList.length; i += 2) {
+            head += response.headerList[i] + ": " + response.headerList[i + 1] + "\r\n";
         }
-    }, function () {
-        if (errorCB) {
-            errorCB("Could not load " + (ssl ? "https" : "http") + "://" + host + ":" + port + path);
+        request.successCB(content, head);
+    }
+    if (request.finishCB) {
+        request.finishCB();
+    }
+}
+function removeConnection(connection) {
+    var origin = connection.origin;
+    var idx = origin.connections.indexOf(connection);
+    if (idx >= 0) {
+        origin.connections.splice(idx, 1);
+    }
+    if (origin.connections.length === 0 && origin.queue.length === 0) {
+        delete httpClientOrigins[origin.key];
+    }
+}
+/**
+ * Detaches the current request from the connection. If nothing was
+ * received on a reused connection, the server has probably closed it
+ * while it was idle, so an idempotent request is queued again once.
+ */
+function detachRequest(connection) {
+    var request = connection.request;
+    var response = connection.response;
+    connection.request = null;
+    connection.response = null;
+    if (request &&
+        response &&
+        connection.reused &&
+        !request.retried &&
+        response.received === 0 &&
+        idempotentMethods.indexOf(request.method.toUpperCase()) >= 0) {
+        request.retried = true;
+        connection.origin.queue.unshift(request);
+        return null;
+    }
+    return request && response ? { request: request, response: response } : null;
+}
+function dispatchRequests(origin) {
+    while (origin.queue.length > 0) {
+        var idle = origin.connections.filter(function (c) { return c.connected && c.request === null; })[0];
+        if (idle) {
+            idle.request = origin.queue.shift();
+            idle.response = createResponse();
+            idle.reused = true;
+            idle.socket.setReadTimeout(-1);
+            writeRequest(idle);
         }
-    }, function () {
-        var startFrom = headerEnd;
-        var content = null;
-        if (chunked) {
-            content = new stringbuffer_1.StringBuffer();
-            var chunkLength = void 0;
-            do {
-                var chunkLengthEnd = complete.indexOf("\r\n", startFrom);
-                var lengthStr = complete
-                    .substring(startFrom, chunkLengthEnd)
-                    .toString();
-                chunkLength = parseInt(lengthStr, 16);
-                var chunkEnd = chunkLengthEnd + chunkLength + 2;
-                content.append(complete.substring(chunkLengthEnd + 2, chunkEnd));
-                startFrom = chunkEnd + 2;
-            } while (chunkLength > 0);
+        else if (origin.connections.length < exports.httpClientPool.maxSocketsPerHost) {
+            openConnection(origin, origin.queue.shift());
         }
         else {
-            content = complete.substring(startFrom);
+            // wait until a connection is released
+            break;
         }
-        var headers = complete.substring(0, headerEnd);
-        if (successCB) {
-            successCB(content.toString(), headers.toString());
-        }
-        //free complete for GC
-        content = null;
-        if (finishCB) {
-            finishCB();
+    }
+}
+function finishResponse(connection) {
+    var request = connection.request;
+    var response = connection.response;
+    var socket = connection.socket;
+    connection.request = null;
+    connection.response = null;
+    if (exports.httpClientPool.keepAlive && response.keepAlive) {
+        // park the connection, the read timeout closes it if it stays idle
+        socket.setReadTimeout(exports.httpClientPool.idleTimeout);
+        dispatchRequests(connection.origin);
+    }
+    else {
+        closeSocket(socket);
+    }
+    deliverResponse(request, response);
+}
+function releaseParser(connection) {
+    // the parser must not be freed while it calls back into the client
+    if (connection.parser >= 0 && !connection.parsing) {
+        el_freeHttpParser(connection.parser);
+        connection.parser = -1;
+    }
+}
+function failResponse(connection) {
+    var pending = detachRequest(connection);
+    removeConnection(connection);
+    closeSocket(connection.socket);
+    if (pending) {
+        pending.request.errorCB("Could not load " + (pending.request.ssl ? "https" : "http") + "://" + pending.request.host + ":" + pending.request.port + pending.request.path);
+    }
+    dispatchRequests(connection.origin);
+}
+function createParserHandler(connection) {
+    return {
+        onHead: function (status, statusText, headerList, contentLength, chunked, keepAlive) {
+            var request = connection.request;
+            var response = connection.response;
+            response.status = status;
+            response.statusText = statusText;
+            response.headerList = headerList;
+            response.untilClose = contentLength < 0 && !chunked;
+            response.keepAlive = keepAlive;
+            // responses to HEAD requests have no body
+            return request.method === "HEAD";
+        },
+        onBody: function (chunk) {
+            var request = connection.request;
+            if (request.chunkCB) {
+                request.chunkCB(chunk);
+            }
+            else {
+                var response = connection.response;
+                response.bodyParts.push(chunk);
+                response.bodyLength += chunk.length;
+            }
+        },
+        onComplete: function () {
+            finishResponse(connection);
+        },
+    };
+}
+function onResponseData(connection, handler, data, length) {
+    var request = connection.request;
+    var response = connection.response;
+    if (!request || !response || connection.parser < 0) {
+        console.debug("Ignoring data on idle http client connection.");
+        return;
+    }
+    response.received += length;
+    var state = 0;
+    connection.parsing = true;
+    try {
+        state = el_executeHttpParser(connection.parser, data, handler);
+    }
+    finally {
+        connection.parsing = false;
+    }
+    if (connection.closed) {
+        releaseParser(connection);
+    }
+    else if (state < 0) {
+        console.error("Malformed http response from " + connection.origin.key);
+        failResponse(connection);
+    }
+}
+function openConnection(origin, request) {
+    var connection = {
+        origin: origin,
+        socket: null,
+        request: request,
+        response: createResponse(),
+        connected: false,
+        reused: false,
+        parser: el_createHttpParser(true),
+        parsing: false,
+        closed: false,
+    };
+    var handler = createParserHandler(connection);
+    origin.connections.push(connection);
+    connection.socket = sockConnect(request.ssl, request.host, request.port, function () {
+        connection.connected = true;
+        writeRequest(connection);
+    }, function (data, _, length) {
+        onResponseData(connection, handler, data, length);
+    }, function () {
+        failResponse(connection);
+    }, function () {
+        connection.closed = true;
+        releaseParser(connection);
+        var pending = detachRequest(connection);
+        removeConnection(connection);
+        if (pending) {
+            if (pending.response.untilClose) {
+                // responses without content-length and chunked encoding end with the connection
+                deliverResponse(pending.request, pending.response);
+            }
+            else {
+                pending.request.errorCB("Connection closed before the response from " + (pending.request.ssl ? "https" : "http") + "://" + pending.request.host + ":" + pending.request.port + pending.request.path + " was complete");
+            }
         }
+        dispatchRequests(origin);
+    });
+}
+/**
+ * Sends a http request. Connections are kept alive and reused according to
+ * {@link httpClientPool}. The response is parsed incrementally as it arrives.
+ *
+ * @param chunkCB If set, it gets called with each received part of the
+ * response body, which is then not buffered and successCB gets an empty
+ * content. Useful for processing or saving large bodies.
+ */
+function httpClient(ssl, host, port, path, method, requestHeaders, body, successCB, errorCB, finishCB, chunkCB) {
+    queueRequest({
+        ssl: ssl,
+        host: host,
+        port: port,
+        path: path,
+        method: method,
+        requestHeaders: requestHeaders || "",
+        body: body,
+        successCB: successCB,
+        errorCB: errorCB || print,
+        finishCB: finishCB,
+        chunkCB: chunkCB,
+        retried: false,
     });
 }
 exports.httpClient = httpClient;
+/**
+ * Sends a http request like {@link httpClient}, but passes the status, the
+ * header list and the body bytes as received to responseCB, nothing is
+ * converted to strings. The body is sent without copying it, so it must not
+ * be modified afterwards.
+ *
+ * @param requestHeaders Header lines, each terminated by \r\n.
+ */
+function httpRequest(ssl, host, port, path, method, requestHeaders, body, responseCB, errorCB) {
+    queueRequest({
+        ssl: ssl,
+        host: host,
+        port: port,
+        path: path,
+        method: method,
+        requestHeaders: requestHeaders,
+        body: body,
+        responseCB: responseCB,
+        errorCB: errorCB,
+        retried: false,
+    });
+}
+exports.httpRequest = httpRequest;
+function queueRequest(request) {
+    var key = (request.ssl ? "https" : "http") + "://" + request.host + ":" + request.port;
+    var origin = (httpClientOrigins[key] = httpClientOrigins[key] || {
+        key: key,
+        connections: [],
+        queue: [],
+    });
+    origin.queue.push(request);
+    dispatchRequests(origin);
+}
 var XMLHttpRequest = /** @class */ (function () {
     function XMLHttpRequest() {
         this.method = "GET";
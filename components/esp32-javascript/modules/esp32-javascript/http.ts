@@ -1,19 +1,74 @@
 import socketEvents = require("socket-events");
 import { StringBuffer } from "./stringbuffer";
+import { Esp32JsHeaders } from "./headers";
+import { Esp32JsMultipartForm } from "./multipart";
 
 export interface Esp32JsRequest {
   path: string;
   headers: Headers;
   method: string;
   body: string | null;
+  /** The parsed body of multipart/form-data requests, see receiveMultipart. */
+  form?: Esp32JsMultipartForm;
+}
+
+/**
+ * Decides how a request body is received instead of being collected
+ * in req.body, see {@link httpServer}.
+ */
+export interface Esp32JsRequestBodyOptions {
+  /**
+   * Gets called with each received part of the body. Return false to
+   * stop reading from the connection until resume is called.
+   */
+  onData?: (chunk: Uint8Array, resume: () => void) => boolean | void;
+  /** Writes the body natively to this file in /data instead of calling onData. */
+  file?: string;
+  /** Maximum body size in bytes, larger bodies are answered with 413. */
+  maxSize?: number;
+  /**
+   * Gets called after the last part of the body before the request
+   * callback, or with complete false if the request fails or the
+   * connection closes before the body was received.
+   */
+  onEnd?: (complete: boolean) => void;
 }
 
 export interface Esp32JsResponse {
   on: (event: "end", cb: () => void) => void;
-  flush: () => void;
+  /** Sends the written data, cb gets called when it was sent completely. */
+  flush: (cb?: () => void) => void;
   setStatus: (status: number, statusText?: string) => void;
   write: (data?: string | Uint8Array) => void;
   end: (data?: string) => void;
+  /**
+   * Ends the response with the content of a file in /modules or /data. The
+   * file is streamed natively and content-length is set if missing.
+   * Returns false if the file does not exist, nothing is written then.
+   */
+  sendFile: (path: string, offset?: number, length?: number) => boolean;
+  /**
+   * Compresses the body with gzip or deflate if the request accepts it.
+   * Has to be called before the first write, responses with content-length
+   * are not compressed. Each write is flushed as a whole, so few larger
+   * writes compress better than many small ones.
+   */
+  compress: () => void;
+  /**
+   * Sends the head with status 101 (or the given status) and hands the
+   * connection over to the caller, e.g. for websockets or event streams.
+   * The http server stops reading from the returned socket and the response
+   * is ended. For requests with an upgrade header, data received after the
+   * request is passed to the onData the caller sets on the socket, other
+   * requests cannot be upgraded once more data was received.
+   */
+  upgrade: (status?: number) => socketEvents.Esp32JsSocket;
+  /**
+   * Closes the connection without ending the response, so the client can
+   * tell that the body is incomplete, e.g. if producing it failed after
+   * parts of it were sent.
+   */
+  abort: () => void;
   status: { status: number; statusText: string };
   isEnded: boolean;
   statusWritten: boolean;
@@ -21,28 +76,56 @@ export interface Esp32JsResponse {
   headers: Headers;
 }
 
+// data a client may send after an upgrade request before it is upgraded
+const maxPendingUpgradeData = 16 * 1024;
+
 const sockListen = socketEvents.sockListen;
 const sockConnect = socketEvents.sockConnect;
 const closeSocket = socketEvents.closeSocket;
 
-function parseHeaders(complete: StringBuffer, endOfHeaders: number) {
-  const headersRaw = complete.substring(0, endOfHeaders).toString();
-  const headerTokens = headersRaw.split("\r\n");
-  const statusLine = headerTokens.shift();
-  const headers: Headers = new Headers();
-  headerTokens.forEach(function (headerLine) {
-    const delim = headerLine.indexOf(":");
-    if (delim >= 0) {
-      headers.append(
-        headerLine.substring(0, delim).trim(),
-        headerLine.substring(delim + 1).trim()
-      );
-    }
+// flags of el_buildResponseHead selecting pre-encoded header lines
+const responseHeadConnectionClose = 1;
+const responseHeadKeepAlive = 2;
+const responseHeadChunked = 4;
+
+// answers without reading the request and ends the connection. Closing it
+// with unread data would reset it and the client may lose the response, so
+// only the sending side is shut down and the rest of the request is
+// discarded until the client closes the connection or stops sending.
+function writeEmptyResponse(
+  socket: socketEvents.Esp32JsSocket,
+  status: number
+): void {
+  socket.onData = null;
+  socket.write(
+    el_buildResponseHead(
+      status,
+      "",
+      ["content-length", "0"],
+      responseHeadConnectionClose
+    )
+  );
+  socket.flush(function () {
+    socketEvents.shutdownSocket(socket);
   });
-  return {
-    statusLine,
-    headers,
-  };
+  socket.setReadTimeout(2000);
+}
+
+/**
+ * Checks if a content coding is listed in an Accept-Encoding header
+ * without being excluded by q=0.
+ */
+export function acceptsEncoding(
+  acceptEncoding: string | null,
+  coding: string
+): boolean {
+  return (
+    acceptEncoding !== null &&
+    new RegExp("(^|[ ,])" + coding + "($|[ ,;])", "i").test(acceptEncoding) &&
+    !new RegExp("(^|[ ,])" + coding + " *; *q=0(\\.0*)?($|[ ,])", "i").test(
+      acceptEncoding
+    )
+  );
 }
 
 class EventEmitter {
@@ -60,282 +143,483 @@ class EventEmitter {
   }
 }
 
+/**
+ * Connection limits of {@link httpServer}. Connections exceeding
+ * maxConnections get a 503 response unless an idle keep-alive connection
+ * can be closed instead, on SSL servers they are closed without response.
+ * Upgraded connections, i.e. websockets and event streams, are not counted.
+ */
+export const httpServerLimits = {
+  /** Maximum number of simultaneously open connections per server, 0 means unlimited. */
+  maxConnections: 6,
+  /** Maximum number of connections accepted per event loop turn. */
+  acceptBudget: 4,
+};
+
+/**
+ * Starts a http server. The callback is called with each completely
+ * received request.
+ *
+ * @param onRequestBody Optionally called with requests which have a body
+ * as soon as their headers were received. It can return options to stream
+ * the body or to write it to a file. req.body is null for such requests.
+ */
 export function httpServer(
   port: string | number,
   isSSL: boolean,
-  cb: (req: Esp32JsRequest, res: Esp32JsResponse) => void
+  cb: (req: Esp32JsRequest, res: Esp32JsResponse) => void,
+  onRequestBody?: (req: Esp32JsRequest) => Esp32JsRequestBodyOptions | void
 ): void {
   const textEncoder = new TextEncoder();
-  const textDecoder = new TextDecoder();
   sockListen(
     port,
     function (socket) {
       let requestCounter = 0;
-      let complete: StringBuffer | null = null;
-      let contentLength = 0;
-      let headers: Headers | undefined;
-      let statusLine: string | undefined;
-      let gotten = 0;
+      const parser = el_createHttpParser();
+      // if a request is partially received
+      let receiving = false;
+      let received: Esp32JsRequest | null = null;
+      // as decided by the parser from the connection header and the version
+      let receivedKeepAlive = true;
+      let bodyParts: string[] | null = null;
+      let bodyOptions: Esp32JsRequestBodyOptions | null = null;
+      // the parser calls its handlers synchronously, a handler which closes
+      // the socket must not free the parser while it is still running
+      let parsing = false;
+      let closed = false;
+      // the parser stops after a request with an upgrade header, data
+      // received after it is kept for the new owner of the connection
+      let receivedUpgrade = false;
+      let pending: string | null = null;
+      let pendingLength = 0;
+      let upgraded = false;
+      const resume = function () {
+        socket.readPaused = false;
+      };
+      const endBody = function (complete: boolean) {
+        const options = bodyOptions;
+        bodyOptions = null;
+        if (options && options.onEnd) {
+          options.onEnd(complete);
+        }
+      };
       const active: { req: Esp32JsRequest; res: Esp32JsResponse }[] = [];
+      // compressor of the response being written, responses of a connection
+      // are written one after another
+      let deflateStream = 0;
 
-      socket.onData = function (data: string, _: number, length: number) {
-        complete = complete ? complete.append(data) : new StringBuffer(data);
-        gotten += length;
-
-        const endOfHeaders = complete.indexOf("\r\n\r\n");
-        if (gotten >= 4 && endOfHeaders >= 0) {
-          if (!headers) {
-            const parsed = parseHeaders(complete, endOfHeaders);
-            statusLine = parsed.statusLine;
-            headers = parsed.headers;
-            requestCounter++;
-            console.debug(
-              `Request on socket ${socket.sockfd}: ${statusLine}, requestCounter:${requestCounter}`
-            );
-          }
-
-          let postedData = null;
-
-          const contentLengthHeader = headers.get("content-length");
-          if (typeof contentLengthHeader === "string") {
-            contentLength = parseInt(contentLengthHeader);
-          }
+      const handleRequest = function (
+        req: Esp32JsRequest,
+        keepAlive: boolean,
+        upgradeRequest: boolean
+      ) {
+        const headers = req.headers;
+        const eventEmitter = new EventEmitter();
+        const responseHeaders = new Esp32JsHeaders();
+        let chunkedEncoding = false;
+        let compressRequested = false;
 
-          if (contentLength > 0) {
-            console.debug("A request body is expected.");
+        // the client asked to close the connection after this response, with
+        // connection: close or as HTTP/1.0 client without keep-alive. After an
+        // upgrade request no further requests are read, so the connection is
+        // closed unless it gets upgraded.
+        let closeRequested = !keepAlive || upgradeRequest;
+        let closeConnection = false;
 
-            if (gotten >= endOfHeaders + 4 + contentLength) {
-              const potentialRequestBody = textEncoder.encode(
-                complete.substring(endOfHeaders + 4).toString()
+        // initialize response
+        const res: Esp32JsResponse = {
+          headers: responseHeaders,
+          isEnded: false,
+          statusWritten: false,
+          headersWritten: false,
+          status: { status: 200, statusText: "OK" },
+          on: function (event, cb) {
+            eventEmitter.on(event, cb);
+          },
+          flush: function (cb) {
+            socket.flush(cb);
+          },
+          setStatus: function (status, statusText) {
+            res.status.status = status;
+            res.status.statusText = statusText || "";
+          },
+          write: function (data) {
+            if (res.isEnded) {
+              throw Error("request has already ended");
+            }
+            if (!res.headersWritten) {
+              res.statusWritten = true;
+              res.headersWritten = true;
+              socket.write(buildHead());
+            }
+            if (
+              deflateStream &&
+              typeof data !== "undefined" &&
+              data.length > 0
+            ) {
+              data = el_writeDeflateStream(deflateStream, data, false);
+            }
+            writeBody(data);
+          },
+          end: function (data) {
+            if (!res.headersWritten) {
+              res.write();
+            }
+            if (deflateStream) {
+              // the last part of the body also ends the compressed stream
+              const last = el_writeDeflateStream(deflateStream, data, true);
+              el_freeDeflateStream(deflateStream);
+              deflateStream = 0;
+              res.write(last);
+            } else {
+              res.write(data);
+            }
+            if (chunkedEncoding) {
+              socket.write(`0\r\n`);
+              socket.write(`\r\n`);
+            }
+            socket.flush(finish);
+          },
+          sendFile: function (path, offset, length) {
+            const stat = fileStat(path);
+            if (!stat) {
+              return false;
+            }
+            const size = stat.size;
+            if (!responseHeaders.has("content-length")) {
+              const available = size - (offset || 0);
+              responseHeaders.set(
+                "content-length",
+                String(
+                  typeof length === "number" && length < available
+                    ? length
+                    : available
+                )
               );
-              postedData = textDecoder.decode(
-                potentialRequestBody.subarray(0, contentLength)
+            }
+            res.write();
+            const sent = socket.sendFile(
+              path,
+              function (error) {
+                if (error) {
+                  console.error(error.message);
+                  closeConnection = true;
+                }
+                finish();
+              },
+              offset,
+              length
+            );
+            if (!sent) {
+              // the head promised a body which cannot be sent anymore
+              closeConnection = true;
+              socket.flush(finish);
+            }
+            return true;
+          },
+          compress: function () {
+            compressRequested = true;
+          },
+          upgrade: function (status) {
+            if (!upgradeRequest && receiving) {
+              // the data received after the request was parsed as http
+              throw new Error(
+                "Cannot upgrade, data was received after the request"
               );
-              console.debug("Request body is complete:");
-              console.debug(postedData);
-            } else {
-              //wait for more data to come (body of  a POST request)
-              console.debug("Waiting for more data to come:");
-              console.debug(contentLength);
-              console.debug(complete.length);
-              console.debug(gotten);
-              console.debug(endOfHeaders);
-              return;
+            }
+            closeRequested = !keepAlive;
+            res.setStatus(status || 101);
+            res.write();
+            socket.flush();
+            socket.onData = null;
+            socket.onClose = null;
+            socket.setReadTimeout(0);
+            socket.isUpgraded = true;
+            upgraded = true;
+            if (!parsing) {
+              el_freeHttpParser(parser);
+            }
+            if (pending !== null) {
+              // e.g. a first websocket frame sent along with the handshake,
+              // passed on once the caller has set onData
+              const rest = pending;
+              const restLength = pendingLength;
+              pending = null;
+              queueMicrotask(() => {
+                if (socket.onData) {
+                  socket.onData(rest, socket.sockfd, restLength);
+                }
+              });
+            }
+            res.isEnded = true;
+            eventEmitter.emit("end");
+            return socket;
+          },
+          abort: function () {
+            closeSocket(socket);
+            res.isEnded = true;
+            eventEmitter.emit("end");
+          },
+        };
+
+        const writeBody = function (data?: string | Uint8Array) {
+          if (typeof data !== "undefined" && data.length > 0) {
+            if (chunkedEncoding) {
+              const encoded =
+                typeof data === "string" ? textEncoder.encode(data) : data;
+              socket.write(`${encoded.length.toString(16)}\r\n`);
+            }
+            socket.write(data);
+            if (chunkedEncoding) {
+              socket.write(`\r\n`);
             }
           }
+        };
 
-          if (statusLine) {
-            const startOfPath = statusLine.indexOf(" ");
-            const path = statusLine.substring(
-              startOfPath + 1,
-              statusLine.indexOf(" ", startOfPath + 1)
-            );
-            const method = complete.substring(0, startOfPath).toString();
-
-            const req: Esp32JsRequest = {
-              method: method,
-              path: path,
-              body: postedData,
-              headers,
-            };
-
-            const eventEmitter = new EventEmitter();
-            const responseHeaders = new Headers();
-            let chunkedEncoding = false;
-
-            const isConnectionClose = function () {
-              let close = false;
-              if (!close && headers && headers.get("connection") === "close") {
-                close = true;
-              }
+        const finish = function () {
+          if (closeConnection) {
+            console.debug(`Socket ${socket.sockfd} closed.`);
+            closeSocket(socket.sockfd);
+          } else if (!receiving && active.length === 1) {
+            // waiting for the next request, may be closed to admit new connections
+            socket.isIdle = true;
+          }
+          res.isEnded = true;
+          eventEmitter.emit("end");
+        };
 
-              if (
-                !close &&
-                responseHeaders &&
-                responseHeaders.get("transfer-encoding") !== "chunked" &&
-                !responseHeaders.has("content-length")
-              ) {
-                close = true;
+        // decides framing and connection handling in a single pass over the
+        // response headers and serializes the whole head into one buffer
+        const buildHead = function () {
+          let connection = null as string | null;
+          let transferEncoding = null as string | null;
+          let contentLength = false;
+          let contentEncoding = false;
+          let vary = false;
+          const headerList: string[] = [];
+          responseHeaders.forEach((value, key) => {
+            if (key === "connection") {
+              connection = value;
+            } else if (key === "transfer-encoding") {
+              transferEncoding = value;
+            } else {
+              if (key === "content-length") {
+                contentLength = true;
+              } else if (key === "content-encoding") {
+                contentEncoding = true;
+              } else if (key === "vary") {
+                vary = true;
               }
+              headerList.push(key, value);
+            }
+          });
 
-              if (
-                !close &&
-                responseHeaders &&
-                responseHeaders.get("connection") === "close"
-              ) {
-                close = true;
-              }
+          // these responses never have a body
+          const status = res.status.status;
+          const bodyless = status < 200 || status === 204 || status === 304;
 
-              return close;
-            };
+          if (compressRequested && !bodyless) {
+            const acceptEncoding = headers.get("accept-encoding");
+            const gzip = acceptsEncoding(acceptEncoding, "gzip");
+            if (
+              !contentLength &&
+              !contentEncoding &&
+              transferEncoding === null &&
+              req.method !== "HEAD" &&
+              (gzip || acceptsEncoding(acceptEncoding, "deflate"))
+            ) {
+              deflateStream = el_createDeflateStream(gzip);
+              headerList.push("content-encoding", gzip ? "gzip" : "deflate");
+            }
+            if (!vary) {
+              headerList.push("vary", "accept-encoding");
+            }
+          }
 
-            const chunked = function () {
-              let chunked = true;
-              if (chunked && headers && headers.get("connection") === "close") {
-                chunked = false;
-              }
+          chunkedEncoding =
+            !bodyless &&
+            !closeRequested &&
+            connection !== "close" &&
+            !contentLength &&
+            (transferEncoding === null || transferEncoding === "chunked");
+          closeConnection =
+            closeRequested ||
+            connection === "close" ||
+            (!chunkedEncoding &&
+              !bodyless &&
+              transferEncoding !== "chunked" &&
+              !contentLength);
 
-              if (
-                chunked &&
-                responseHeaders &&
-                ((responseHeaders.has("transfer-encoding") &&
-                  responseHeaders.get("transfer-encoding") !== "chunked") ||
-                  responseHeaders.has("content-length"))
-              ) {
-                chunked = false;
-              }
+          let flags = chunkedEncoding ? responseHeadChunked : 0;
+          if (transferEncoding !== null && !chunkedEncoding) {
+            headerList.push("transfer-encoding", transferEncoding);
+          }
+          if (closeConnection) {
+            flags |= responseHeadConnectionClose;
+          } else if (connection === null) {
+            flags |= responseHeadKeepAlive;
+            socket.setReadTimeout(20000);
+          } else {
+            headerList.push("connection", connection);
+          }
+          return el_buildResponseHead(
+            res.status.status,
+            res.status.statusText,
+            headerList,
+            flags
+          );
+        };
 
-              if (
-                chunked &&
-                responseHeaders &&
-                responseHeaders.get("connection") === "close"
-              ) {
-                chunked = false;
-              }
+        const item = { req, res };
+        const num = active.push(item);
+        console.debug(`Currently active requests: ${num}`);
+        res.on("end", () => {
+          console.debug("splicing req/res form active list");
+          active.splice(active.indexOf(item), 1);
+        });
 
-              return chunked;
-            };
-
-            // initialize response
-            const res: Esp32JsResponse = {
-              headers: responseHeaders,
-              isEnded: false,
-              statusWritten: false,
-              headersWritten: false,
-              status: { status: 200, statusText: "OK" },
-              on: function (event, cb) {
-                eventEmitter.on(event, cb);
-              },
-              flush: function () {
-                socket.flush();
-              },
-              setStatus: function (status, statusText) {
-                res.status.status = status;
-                if (statusText) {
-                  res.status.statusText = statusText;
-                }
-              },
-              write: function (data) {
-                if (res.isEnded) {
-                  throw Error("request has already ended");
-                }
-                if (!res.statusWritten) {
-                  res.statusWritten = true;
-                  socket.write(
-                    `HTTP/1.1 ${res.status.status} ${res.status.statusText}\r\n`
-                  );
-                }
-                if (!res.headersWritten) {
-                  if (chunked()) {
-                    responseHeaders.set("transfer-encoding", "chunked");
-                    chunkedEncoding = true;
-                  }
-                  if (isConnectionClose()) {
-                    responseHeaders.set("connection", "close");
-                  }
-                  if (!responseHeaders.has("connection")) {
-                    responseHeaders.set("connection", "keep-alive");
-                    socket.setReadTimeout(20000);
-                  }
-                  const contentType = responseHeaders.get("content-type");
-                  if (typeof contentType !== "string") {
-                    responseHeaders.set(
-                      "content-type",
-                      "text/plain; charset=utf-8"
-                    );
-                  } else if (contentType.indexOf("charset") < 0) {
-                    responseHeaders.set(
-                      "content-type",
-                      `${contentType}; charset=utf-8`
-                    );
-                  }
-
-                  res.headersWritten = true;
-                  responseHeaders.forEach((value, key) => {
-                    socket.write(`${key}: ${value}\r\n`);
-                  });
-                  socket.write(`\r\n`);
-                }
-                if (typeof data !== "undefined" && data.length > 0) {
-                  if (chunkedEncoding) {
-                    const encoded =
-                      typeof data === "string"
-                        ? textEncoder.encode(data)
-                        : data;
-                    socket.write(`${encoded.length.toString(16)}\r\n`);
-                  }
-                  if (data) {
-                    socket.write(data);
-                  }
-                  if (chunkedEncoding) {
-                    socket.write(`\r\n`);
-                    //socket.flush();
-                  }
-                }
-              },
-              end: function (data) {
-                res.write(data);
-                if (chunkedEncoding) {
-                  socket.write(`0\r\n`);
-                  socket.write(`\r\n`);
-                }
-                socket.flush(function () {
-                  if (isConnectionClose()) {
-                    console.debug(`Socket ${socket.sockfd} closed.`);
-                    closeSocket(socket.sockfd);
-                  }
-                  res.isEnded = true;
-                  eventEmitter.emit("end");
-                });
-              },
-            };
-
-            // reset state for keep alive connections getting more requests
-            // on the same socket
-            complete = complete.substring(endOfHeaders + 4 + contentLength);
-            gotten = gotten - endOfHeaders - 4 - contentLength;
-            contentLength = 0;
-            headers = undefined;
-            statusLine = undefined;
-
-            console.debug(`gotten: ${gotten}`);
-            console.debug(`complete.length: ${complete.length}`);
-
-            const item = { req, res };
-            const num = active.push(item);
-            console.debug(`Currently active requests: ${num}`);
-            res.on("end", () => {
-              console.debug("splicing req/res form active list");
-              active.splice(active.indexOf(item), 1);
-            });
-
-            const previous = num - 2;
-            if (previous < 0 || active[previous].res.isEnded) {
-              // active request/response is empty, perform immediately
-              console.debug(
-                "// active request/response is empty or entries are ended, perform immediately"
+        const previous = num - 2;
+        if (previous < 0 || active[previous].res.isEnded) {
+          // active request/response is empty, perform immediately
+          console.debug(
+            "// active request/response is empty or entries are ended, perform immediately"
+          );
+          setTimeout(() => {
+            console.debug("perform immediate");
+            cb(req, res);
+          }, 0);
+        } else {
+          // queue request/response callback after previous request/response
+          console.debug(
+            "// queue request/response callback after previous request/response"
+          );
+          active[previous].res.on("end", () => {
+            console.debug(
+              "end of previous req/res: triggering new req/res callback"
+            );
+            cb(req, res);
+          });
+        }
+      };
+
+      const parserHandler = {
+        onHead: function (
+          method: string,
+          path: string,
+          headerList: string[],
+          contentLength: number,
+          chunked: boolean,
+          keepAlive: boolean
+        ) {
+          if (closed) {
+            return;
+          }
+          const headers = Esp32JsHeaders.fromList(headerList);
+          requestCounter++;
+          console.debug(
+            `Request on socket ${socket.sockfd}: ${method} ${path}, requestCounter:${requestCounter}`
+          );
+          received = { method, path, body: null, headers };
+          receivedKeepAlive = keepAlive;
+          receivedUpgrade =
+            headers.get("upgrade") !== null &&
+            /(^|[ ,])upgrade($|[ ,])/i.test(headers.get("connection") || "");
+          bodyParts = null;
+          bodyOptions = null;
+          if (contentLength > 0 || chunked) {
+            const options = onRequestBody ? onRequestBody(received) : null;
+            if (options) {
+              el_setHttpParserBody(
+                parser,
+                true,
+                typeof options.maxSize === "number" ? options.maxSize : -1,
+                options.file
               );
-              setTimeout(() => {
-                console.debug("perform immediate");
-                cb(req, res);
-              }, 0);
+              bodyOptions = options;
             } else {
-              // queue request/response callback after previous request/response
-              console.debug(
-                "// queue request/response callback after previous request/response"
-              );
-              active[previous].res.on("end", () => {
-                console.debug(
-                  "end of previous req/res: triggering new req/res callback"
-                );
-                cb(req, res);
-              });
+              bodyParts = [];
             }
-
-            if (gotten > 0 && socket.onData) {
-              socket.onData("", _, 0);
+          }
+        },
+        onBody: function (data: string | Uint8Array) {
+          if (closed) {
+            return;
+          }
+          if (bodyOptions) {
+            if (
+              bodyOptions.onData &&
+              bodyOptions.onData(data as Uint8Array, resume) === false
+            ) {
+              socket.readPaused = true;
             }
+          } else {
+            (bodyParts as string[]).push(data as string);
+          }
+        },
+        onComplete: function () {
+          if (closed) {
+            return;
+          }
+          const req = received as Esp32JsRequest;
+          if (bodyParts) {
+            req.body = bodyParts.join("");
           }
+          received = null;
+          bodyParts = null;
+          endBody(true);
+          handleRequest(req, receivedKeepAlive, receivedUpgrade);
+          return receivedUpgrade;
+        },
+        onDetached: function (data: string, length: number) {
+          pending = pending === null ? data : pending + data;
+          pendingLength += length;
+        },
+      };
+
+      socket.onData = function (data: string) {
+        let state = 0;
+        parsing = true;
+        try {
+          state = el_executeHttpParser(parser, data, parserHandler);
+        } catch (error) {
+          // the request was left half parsed, e.g. by a throwing onData
+          console.error(
+            `Receiving request on socket ${socket.sockfd} failed: ${error}`
+          );
+          state = -500;
+        } finally {
+          parsing = false;
+        }
+        if (closed || upgraded) {
+          el_freeHttpParser(parser);
+          return;
+        }
+        if (pendingLength > maxPendingUpgradeData) {
+          console.debug(
+            `Too much data before upgrading socket ${socket.sockfd}`
+          );
+          closeSocket(socket);
+          return;
+        }
+        receiving = state > 0;
+        if (state < 0) {
+          const status = -state;
+          console.debug(
+            `Malformed request on socket ${socket.sockfd}: ${status}`
+          );
+          socket.onData = null;
+          endBody(false);
+          writeEmptyResponse(socket, status);
+        }
+      };
+      socket.onClose = function () {
+        closed = true;
+        endBody(false);
+        if (!parsing) {
+          el_freeHttpParser(parser);
+        }
+        if (deflateStream) {
+          el_freeDeflateStream(deflateStream);
         }
       };
       socket.onError = function (sockfd) {
@@ -348,7 +632,14 @@ export function httpServer(
     function () {
       console.info("SOCKET WAS CLOSED!");
     },
-    isSSL
+    isSSL,
+    {
+      acceptBudget: httpServerLimits.acceptBudget,
+      maxConnections: httpServerLimits.maxConnections,
+      onReject: function (socket) {
+        writeEmptyResponse(socket, 503);
+      },
+    }
   );
 }
 
@@ -369,6 +660,395 @@ export function parseQueryStr(query: string | null): { [key: string]: string } {
   return parsed;
 }
 
+/**
+ * Settings of the keep-alive connection pool used by {@link httpClient}.
+ * Connections are pooled per origin (protocol, host and port).
+ */
+export const httpClientPool = {
+  /** Reuse connections for subsequent requests to the same origin. */
+  keepAlive: true,
+  /** Maximum number of simultaneously open sockets per origin. */
+  maxSocketsPerHost: 2,
+  /** Idle connections are closed after this number of milliseconds. */
+  idleTimeout: 15000,
+};
+
+interface HttpClientRequest {
+  ssl: boolean;
+  host: string;
+  port: string;
+  path: string;
+  method: string;
+  requestHeaders: string;
+  body?: { toString: () => string } | Uint8Array | null;
+  successCB?: (content: string, headers: string) => void;
+  responseCB?: (response: Esp32JsHttpClientResponse) => void;
+  errorCB: (message: string) => void;
+  finishCB?: () => void;
+  chunkCB?: (chunk: Uint8Array) => void;
+  retried: boolean;
+}
+
+export interface Esp32JsHttpClientResponse {
+  status: number;
+  statusText: string;
+  /** Lower case header names and their values in turn, as received. */
+  headerList: string[];
+  body: Uint8Array;
+}
+
+interface HttpClientResponse {
+  /** Number of bytes received on the connection for this response. */
+  received: number;
+  /** The status is 0 until the head was received. */
+  status: number;
+  statusText: string;
+  headerList: string[];
+  bodyParts: Uint8Array[];
+  bodyLength: number;
+  /** The body has neither content-length nor chunked encoding and ends with the connection. */
+  untilClose: boolean;
+  keepAlive: boolean;
+}
+
+interface HttpClientConnection {
+  origin: HttpClientOrigin;
+  socket: socketEvents.Esp32JsSocket | null;
+  request: HttpClientRequest | null;
+  response: HttpClientResponse | null;
+  connected: boolean;
+  reused: boolean;
+  parser: number;
+  parsing: boolean;
+  closed: boolean;
+}
+
+interface HttpClientOrigin {
+  key: string;
+  connections: HttpClientConnection[];
+  queue: HttpClientRequest[];
+}
+
+const httpClientOrigins: { [key: string]: HttpClientOrigin } = {};
+
+const textDecoder = new TextDecoder();
+const textEncoder = new TextEncoder();
+
+// requests which may be sent again if a reused connection was closed by the server
+const idempotentMethods = ["GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE"];
+
+function createResponse(): HttpClientResponse {
+  return {
+    received: 0,
+    status: 0,
+    statusText: "",
+    headerList: [],
+    bodyParts: [],
+    bodyLength: 0,
+    untilClose: false,
+    keepAlive: false,
+  };
+}
+
+function writeRequest(connection: HttpClientConnection) {
+  const request = connection.request as HttpClientRequest;
+  const socket = connection.socket as socketEvents.Esp32JsSocket;
+  const head = `${request.method} ${request.path} HTTP/1.1\r\nHost: ${
+    request.host
+  }\r\n${httpClientPool.keepAlive ? "" : "Connection: close\r\n"}`;
+  let body = request.body;
+  if (body && !(body instanceof Uint8Array)) {
+    // content-length counts bytes, not characters
+    const bodyStr = body.toString();
+    body = bodyStr ? textEncoder.encode(bodyStr) : null;
+  }
+
+  if (body instanceof Uint8Array) {
+    socket.write(
+      `${head}Content-length: ${body.length}\r\n${request.requestHeaders}\r\n`
+    );
+    if (body.length > 0) {
+      // queued behind the head without copying it
+      socket.writeShared(body);
+    } else {
+      socket.flush();
+    }
+    return;
+  }
+
+  socket.write(`${head}${request.requestHeaders}\r\n`);
+  socket.flush();
+}
+
+function deliverResponse(
+  request: HttpClientRequest,
+  response: HttpClientResponse
+) {
+  if (response.status === 0) {
+    request.errorCB(
+      `Could not load ${request.ssl ? "https" : "http"}://${request.host}:${
+        request.port
+      }${request.path}`
+    );
+    return;
+  }
+
+  // copy the received parts into the final body once
+  let body: Uint8Array | null = new Uint8Array(response.bodyLength);
+  let offset = 0;
+  response.bodyParts.forEach((part) => {
+    (body as Uint8Array).set(part, offset);
+    offset += part.length;
+  });
+  response.bodyParts = [];
+
+  if (request.responseCB) {
+    request.responseCB({
+      status: response.status,
+      statusText: response.statusText,
+      headerList: response.headerList,
+      body,
+    });
+  } else if (request.successCB) {
+    const content = textDecoder.decode(body);
+    //free body for GC
+    body = null;
+    let head = `HTTP/1.1 ${response.status} ${response.statusText}\r\n`;
+    for (let i = 0; i < response.headerList.length; i += 2) {
+      head += `${response.headerList[i]}: ${response.headerList[i + 1]}\r\n`;
+    }
+    request.successCB(content, head);
+  }
+  if (request.finishCB) {
+    request.finishCB();
+  }
+}
+
+function removeConnection(connection: HttpClientConnection) {
+  const origin = connection.origin;
+  const idx = origin.connections.indexOf(connection);
+  if (idx >= 0) {
+    origin.connections.splice(idx, 1);
+  }
+  if (origin.connections.length === 0 && origin.queue.length === 0) {
+    delete httpClientOrigins[origin.key];
+  }
+}
+
+/**
+ * Detaches the current request from the connection. If nothing was
+ * received on a reused connection, the server has probably closed it
+ * while it was idle, so an idempotent request is queued again once.
+ */
+function detachRequest(connection: HttpClientConnection) {
+  const request = connection.request;
+  const response = connection.response;
+  connection.request = null;
+  connection.response = null;
+
+  if (
+    request &&
+    response &&
+    connection.reused &&
+    !request.retried &&
+    response.received === 0 &&
+    idempotentMethods.indexOf(request.method.toUpperCase()) >= 0
+  ) {
+    request.retried = true;
+    connection.origin.queue.unshift(request);
+    return null;
+  }
+  return request && response ? { request, response } : null;
+}
+
+function dispatchRequests(origin: HttpClientOrigin) {
+  while (origin.queue.length > 0) {
+    const idle = origin.connections.filter(
+      (c) => c.connected && c.request === null
+    )[0];
+    if (idle) {
+      idle.request = origin.queue.shift() as HttpClientRequest;
+      idle.response = createResponse();
+      idle.reused = true;
+      (idle.socket as socketEvents.Esp32JsSocket).setReadTimeout(-1);
+      writeRequest(idle);
+    } else if (origin.connections.length < httpClientPool.maxSocketsPerHost) {
+      openConnection(origin, origin.queue.shift() as HttpClientRequest);
+    } else {
+      // wait until a connection is released
+      break;
+    }
+  }
+}
+
+function finishResponse(connection: HttpClientConnection) {
+  const request = connection.request as HttpClientRequest;
+  const response = connection.response as HttpClientResponse;
+  const socket = connection.socket as socketEvents.Esp32JsSocket;
+  connection.request = null;
+  connection.response = null;
+
+  if (httpClientPool.keepAlive && response.keepAlive) {
+    // park the connection, the read timeout closes it if it stays idle
+    socket.setReadTimeout(httpClientPool.idleTimeout);
+    dispatchRequests(connection.origin);
+  } else {
+    closeSocket(socket);
+  }
+
+  deliverResponse(request, response);
+}
+
+function releaseParser(connection: HttpClientConnection) {
+  // the parser must not be freed while it calls back into the client
+  if (connection.parser >= 0 && !connection.parsing) {
+    el_freeHttpParser(connection.parser);
+    connection.parser = -1;
+  }
+}
+
+function failResponse(connection: HttpClientConnection) {
+  const pending = detachRequest(connection);
+  removeConnection(connection);
+  closeSocket(connection.socket as socketEvents.Esp32JsSocket);
+  if (pending) {
+    pending.request.errorCB(
+      `Could not load ${pending.request.ssl ? "https" : "http"}://${
+        pending.request.host
+      }:${pending.request.port}${pending.request.path}`
+    );
+  }
+  dispatchRequests(connection.origin);
+}
+
+function createParserHandler(
+  connection: HttpClientConnection
+): Esp32JsHttpResponseHandler {
+  return {
+    onHead: function (
+      status,
+      statusText,
+      headerList,
+      contentLength,
+      chunked,
+      keepAlive
+    ) {
+      const request = connection.request as HttpClientRequest;
+      const response = connection.response as HttpClientResponse;
+      response.status = status;
+      response.statusText = statusText;
+      response.headerList = headerList;
+      response.untilClose = contentLength < 0 && !chunked;
+      response.keepAlive = keepAlive;
+      // responses to HEAD requests have no body
+      return request.method === "HEAD";
+    },
+    onBody: function (chunk) {
+      const request = connection.request as HttpClientRequest;
+      if (request.chunkCB) {
+        request.chunkCB(chunk);
+      } else {
+        const response = connection.response as HttpClientResponse;
+        response.bodyParts.push(chunk);
+        response.bodyLength += chunk.length;
+      }
+    },
+    onComplete: function () {
+      finishResponse(connection);
+    },
+  };
+}
+
+function onResponseData(
+  connection: HttpClientConnection,
+  handler: Esp32JsHttpResponseHandler,
+  data: string,
+  length: number
+) {
+  const request = connection.request;
+  const response = connection.response;
+  if (!request || !response || connection.parser < 0) {
+    console.debug("Ignoring data on idle http client connection.");
+    return;
+  }
+  response.received += length;
+
+  let state = 0;
+  connection.parsing = true;
+  try {
+    state = el_executeHttpParser(connection.parser, data, handler);
+  } finally {
+    connection.parsing = false;
+  }
+  if (connection.closed) {
+    releaseParser(connection);
+  } else if (state < 0) {
+    console.error(`Malformed http response from ${connection.origin.key}`);
+    failResponse(connection);
+  }
+}
+
+function openConnection(origin: HttpClientOrigin, request: HttpClientRequest) {
+  const connection: HttpClientConnection = {
+    origin,
+    socket: null,
+    request,
+    response: createResponse(),
+    connected: false,
+    reused: false,
+    parser: el_createHttpParser(true),
+    parsing: false,
+    closed: false,
+  };
+  const handler = createParserHandler(connection);
+  origin.connections.push(connection);
+
+  connection.socket = sockConnect(
+    request.ssl,
+    request.host,
+    request.port,
+    function () {
+      connection.connected = true;
+      writeRequest(connection);
+    },
+    function (data, _, length) {
+      onResponseData(connection, handler, data, length);
+    },
+    function () {
+      failResponse(connection);
+    },
+    function () {
+      connection.closed = true;
+      releaseParser(connection);
+      const pending = detachRequest(connection);
+      removeConnection(connection);
+      if (pending) {
+        if (pending.response.untilClose) {
+          // responses without content-length and chunked encoding end with the connection
+          deliverResponse(pending.request, pending.response);
+        } else {
+          pending.request.errorCB(
+            `Connection closed before the response from ${
+              pending.request.ssl ? "https" : "http"
+            }://${pending.request.host}:${pending.request.port}${
+              pending.request.path
+            } was complete`
+          );
+        }
+      }
+      dispatchRequests(origin);
+    }
+  );
+}
+
+/**
+ * Sends a http request. Connections are kept alive and reused according to
+ * {@link httpClientPool}. The response is parsed incrementally as it arrives.
+ *
+ * @param chunkCB If set, it gets called with each received part of the
+ * response body, which is then not buffered and successCB gets an empty
+ * content. Useful for processing or saving large bodies.
+ */
 export function httpClient(
   ssl: boolean,
   host: string,
@@ -379,104 +1059,69 @@ export function httpClient(
   body?: { toString: () => string },
   successCB?: (content: string, headers: string) => void,
   errorCB?: (message: string) => void,
-  finishCB?: () => void
+  finishCB?: () => void,
+  chunkCB?: (chunk: Uint8Array) => void
 ): void {
-  const complete: StringBuffer = new StringBuffer();
-  let completeLength = 0;
-  let chunked = false;
-  let headerRead = false;
-  let headerEnd = -1;
-  let contentLength = -1;
-  requestHeaders = requestHeaders || "";
-  if (!errorCB) {
-    errorCB = print;
-  }
-
-  sockConnect(
+  queueRequest({
     ssl,
     host,
     port,
-    function (socket) {
-      const bodyStr = body ? body.toString() : null;
-
-      const requestLines = `${method} ${path} HTTP/1.1\r\nHost: ${host}\r\n${
-        bodyStr ? `Content-length: ${bodyStr.length}\r\n` : ""
-      }${requestHeaders}\r\n${bodyStr ? bodyStr + "\r\n" : ""}`;
-
-      socket.write(requestLines);
-      socket.flush();
-    },
-    function (data, sockfd, length) {
-      complete.append(data);
-      completeLength = completeLength + length;
-
-      if (!headerRead && (headerEnd = complete.indexOf("\r\n\r\n")) >= 0) {
-        headerRead = true;
-        chunked =
-          complete.toLowerCase().indexOf("transfer-encoding: chunked") >= 0;
-        const clIndex = complete.toLowerCase().indexOf("content-length: ");
-        if (clIndex >= 0) {
-          const endOfContentLength = complete.indexOf("\r\n", clIndex);
-          contentLength = parseInt(
-            complete.substring(clIndex + 15, endOfContentLength).toString()
-          );
-        }
-        headerEnd += 4;
-      }
-
-      if (chunked) {
-        if (complete.substring(complete.length - 5).toString() == "0\r\n\r\n") {
-          closeSocket(sockfd);
-        }
-      }
-      if (contentLength >= 0) {
-        if (completeLength - headerEnd == contentLength) {
-          closeSocket(sockfd);
-        }
-      }
-    },
-    function () {
-      if (errorCB) {
-        errorCB(
-          `Could not load ${ssl ? "https" : "http"}://${host}:${port}${path}`
-        );
-      }
-    },
-    function () {
-      let startFrom = headerEnd;
-      let content = null;
-
-      if (chunked) {
-        content = new StringBuffer();
-
-        let chunkLength;
-        do {
-          const chunkLengthEnd = complete.indexOf("\r\n", startFrom);
-          const lengthStr = complete
-            .substring(startFrom, chunkLengthEnd)
-            .toString();
-          chunkLength = parseInt(lengthStr, 16);
-          const chunkEnd = chunkLengthEnd + chunkLength + 2;
-
-          content.append(complete.substring(chunkLengthEnd + 2, chunkEnd));
-          startFrom = chunkEnd + 2;
-        } while (chunkLength > 0);
-      } else {
-        content = complete.substring(startFrom);
-      }
+    path,
+    method,
+    requestHeaders: requestHeaders || "",
+    body,
+    successCB,
+    errorCB: errorCB || print,
+    finishCB,
+    chunkCB,
+    retried: false,
+  });
+}
 
-      const headers = complete.substring(0, headerEnd);
+/**
+ * Sends a http request like {@link httpClient}, but passes the status, the
+ * header list and the body bytes as received to responseCB, nothing is
+ * converted to strings. The body is sent without copying it, so it must not
+ * be modified afterwards.
+ *
+ * @param requestHeaders Header lines, each terminated by \r\n.
+ */
+export function httpRequest(
+  ssl: boolean,
+  host: string,
+  port: string,
+  path: string,
+  method: string,
+  requestHeaders: string,
+  body: Uint8Array | null,
+  responseCB: (response: Esp32JsHttpClientResponse) => void,
+  errorCB: (message: string) => void
+): void {
+  queueRequest({
+    ssl,
+    host,
+    port,
+    path,
+    method,
+    requestHeaders,
+    body,
+    responseCB,
+    errorCB,
+    retried: false,
+  });
+}
 
-      if (successCB) {
-        successCB(content.toString(), headers.toString());
-      }
-      //free complete for GC
-      content = null;
-      if (finishCB) {
-        finishCB();
-      }
-    }
-  );
+function queueRequest(request: HttpClientRequest) {
+  const key = `${request.ssl ? "https" : "http"}://${request.host}:${
+    request.port
+  }`;
+  const origin = (httpClientOrigins[key] = httpClientOrigins[key] || {
+    key,
+    connections: [],
+    queue: [],
+  });
+  origin.queue.push(request);
+  dispatchRequests(origin);
 }
 
 export class XMLHttpRequest {
@@ -2,6 +2,7 @@ Object.defineProperty(exports, "__esModule", { value: true });
 console.info("Load global.js (NEW)...");
 require("./global.js");
 var http = require("./http");
+var fetchApi = require("./fetch");
 var boot = require("./boot");
 var eventloop = require("esp32-js-eventloop");
 var configManager = require("./config");
@@ -13,7 +14,10 @@ configManager.reloadConfig();
 console.info("Loading http.js and exposing globals (NEW)...");
 global.XMLHttpRequest = http.XMLHttpRequest;
 console.info("Loading fetch.js and exposing globals (NEW)...");
-require("./fetch.js");
+global.fetch = fetchApi.fetch;
+global.Headers = fetchApi.Esp32JsHeaders;
+global.Request = fetchApi.Esp32JsFetchRequest;
+global.Response = fetchApi.Esp32JsFetchResponse;
 console.info("Loading boot.js and exposing main (NEW)...");
 global.main = boot.main;
 console.info("Loading socket-events (NEW)...");
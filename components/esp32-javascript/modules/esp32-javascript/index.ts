@@ -2,6 +2,7 @@ console.info("Load global.js (NEW)...");
 require("./global.js");
 
 import http = require("./http");
+import fetchApi = require("./fetch");
 import boot = require("./boot");
 import eventloop = require("esp32-js-eventloop");
 import configManager = require("./config");
@@ -17,7 +18,10 @@ console.info("Loading http.js and exposing globals (NEW)...");
 global.XMLHttpRequest = http.XMLHttpRequest;
 
 console.info("Loading fetch.js and exposing globals (NEW)...");
-require("./fetch.js");
+global.fetch = fetchApi.fetch;
+global.Headers = fetchApi.Esp32JsHeaders;
+global.Request = fetchApi.Esp32JsFetchRequest;
+global.Response = fetchApi.Esp32JsFetchResponse;
 
 console.info("Loading boot.js and exposing main (NEW)...");
 global.main = boot.main;
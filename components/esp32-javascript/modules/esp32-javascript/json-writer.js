@@ -0,0 +1,86 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.writeJsonFile = exports.sendJson = exports.Esp32JsJsonWriter = void 0;
+/**
+ * Serializes a value to JSON in chunks instead of building the whole JSON
+ * text as one string. The text is the one of JSON.stringify without
+ * indentation, encoded as UTF-8. The value must not be changed before the
+ * last chunk was returned.
+ */
+var Esp32JsJsonWriter = /** @class */ (function () {
+    function Esp32JsJsonWriter(value) {
+        this.state = el_createJsonWriter(value);
+    }
+    /**
+     * Returns the next chunk of about chunkSize bytes, longer strings are
+     * never split. Returns null after the last chunk.
+     */
+    Esp32JsJsonWriter.prototype.next = function (chunkSize) {
+        return el_writeJson(this.state, chunkSize);
+    };
+    return Esp32JsJsonWriter;
+}());
+exports.Esp32JsJsonWriter = Esp32JsJsonWriter;
+/**
+ * Ends the response with the JSON of value. Each chunk is serialized after
+ * the previous one was sent, so only one chunk of the text is in memory at
+ * once. Content-type is set to application/json if missing.
+ * Errors of the serialization, like cyclic values, are thrown if they
+ * occur in the first chunk. Later ones abort the connection, so the client
+ * does not take the truncated JSON for a complete response.
+ */
+function sendJson(res, value, chunkSize) {
+    var writer = new Esp32JsJsonWriter(value);
+    var chunk = writer.next(chunkSize);
+    var failed = false;
+    if (!res.headers.has("content-type")) {
+        res.headers.set("content-type", "application/json");
+    }
+    var pump = function () {
+        var synchronous = true;
+        var sent = true;
+        // continues in the loop as long as the socket takes the chunks at once
+        while (sent) {
+            if (chunk === null) {
+                if (failed) {
+                    res.abort();
+                }
+                else {
+                    res.end();
+                }
+                return;
+            }
+            res.write(chunk);
+            sent = false;
+            synchronous = true;
+            res.flush(function () {
+                if (synchronous) {
+                    sent = true;
+                }
+                else {
+                    pump();
+                }
+            });
+            synchronous = false;
+            try {
+                chunk = writer.next(chunkSize);
+            }
+            catch (error) {
+                console.error("Could not serialize JSON: " + error);
+                chunk = null;
+                failed = true;
+            }
+        }
+    };
+    pump();
+}
+exports.sendJson = sendJson;
+/**
+ * Writes the JSON of value to a file chunk by chunk. The file is replaced
+ * only after the JSON was written completely. Returns the number of bytes
+ * written or -1 if the file could not be written. Errors of the
+ * serialization are thrown like by JSON.stringify.
+ */
+function writeJsonFile(path, value) {
+    return el_writeJsonFile(path, value);
+}
+exports.writeJsonFile = writeJsonFile;
@@ -0,0 +1,89 @@
+import { Esp32JsResponse } from "./http";
+
+/**
+ * Serializes a value to JSON in chunks instead of building the whole JSON
+ * text as one string. The text is the one of JSON.stringify without
+ * indentation, encoded as UTF-8. The value must not be changed before the
+ * last chunk was returned.
+ */
+export class Esp32JsJsonWriter {
+  private state: unknown[];
+
+  constructor(value: unknown) {
+    this.state = el_createJsonWriter(value);
+  }
+
+  /**
+   * Returns the next chunk of about chunkSize bytes, longer strings are
+   * never split. Returns null after the last chunk.
+   */
+  public next(chunkSize?: number): Uint8Array | null {
+    return el_writeJson(this.state, chunkSize);
+  }
+}
+
+/**
+ * Ends the response with the JSON of value. Each chunk is serialized after
+ * the previous one was sent, so only one chunk of the text is in memory at
+ * once. Content-type is set to application/json if missing.
+ * Errors of the serialization, like cyclic values, are thrown if they
+ * occur in the first chunk. Later ones abort the connection, so the client
+ * does not take the truncated JSON for a complete response.
+ */
+export function sendJson(
+  res: Esp32JsResponse,
+  value: unknown,
+  chunkSize?: number
+): void {
+  const writer = new Esp32JsJsonWriter(value);
+  let chunk = writer.next(chunkSize);
+  let failed = false;
+  if (!res.headers.has("content-type")) {
+    res.headers.set("content-type", "application/json");
+  }
+
+  const pump = function () {
+    let synchronous = true;
+    let sent = true;
+    // continues in the loop as long as the socket takes the chunks at once
+    while (sent) {
+      if (chunk === null) {
+        if (failed) {
+          res.abort();
+        } else {
+          res.end();
+        }
+        return;
+      }
+      res.write(chunk);
+      sent = false;
+      synchronous = true;
+      res.flush(function () {
+        if (synchronous) {
+          sent = true;
+        } else {
+          pump();
+        }
+      });
+      synchronous = false;
+      try {
+        chunk = writer.next(chunkSize);
+      } catch (error) {
+        console.error(`Could not serialize JSON: ${error}`);
+        chunk = null;
+        failed = true;
+      }
+    }
+  };
+  pump();
+}
+
+/**
+ * Writes the JSON of value to a file chunk by chunk. The file is replaced
+ * only after the JSON was written completely. Returns the number of bytes
+ * written or -1 if the file could not be written. Errors of the
+ * serialization are thrown like by JSON.stringify.
+ */
+export function writeJsonFile(path: string, value: unknown): number {
+  return el_writeJsonFile(path, value);
+}
@@ -0,0 +1,365 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.connectMqtt = exports.Esp32JsMqttClient = void 0;
+var socketEvents = require("socket-events");
+var mqttPuback = 4;
+var mqttPingreq = 12;
+var mqttDisconnect = 14;
+var textEncoder = new TextEncoder();
+// reasons of a refused connection by CONNACK return code
+var connackErrors = {
+    1: "unacceptable protocol version",
+    2: "identifier rejected",
+    3: "server unavailable",
+    4: "bad user name or password",
+    5: "not authorized",
+};
+/**
+ * MQTT 3.1.1 client created by {@link connectMqtt}. Packets are encoded and
+ * parsed natively. Publishes are queued and all publishes until the
+ * current callback returns are written to the socket at once. QoS 1
+ * publishes wait for their PUBACK within a window of maxInflight messages
+ * and are sent again after a reconnect. Lost connections are reconnected
+ * with exponential backoff.
+ */
+var Esp32JsMqttClient = /** @class */ (function () {
+    function Esp32JsMqttClient(options) {
+        var _this = this;
+        this.options = options;
+        this.connected = false;
+        this.onconnect = null;
+        this.onmessage = null;
+        this.onclose = null;
+        this.onerror = null;
+        this.socket = null;
+        this.parser = 0;
+        this.ended = false;
+        this.queue = [];
+        this.inflight = {};
+        this.inflightCount = 0;
+        this.acks = {};
+        this.subscriptions = {};
+        this.pendingSubscribes = [];
+        this.lastPacketId = 0;
+        this.flushScheduled = false;
+        this.pingTimer = -1;
+        this.reconnectTimer = -1;
+        this.handler = {
+            onConnack: function (sessionPresent, returnCode) {
+                if (returnCode !== 0) {
+                    var message = connackErrors[returnCode] || "return code " + returnCode;
+                    _this.error("MQTT connection refused: " + message);
+                    // only an unavailable server may accept a later attempt
+                    _this.ended = _this.ended || returnCode !== 3;
+                    _this.destroy();
+                    return;
+                }
+                _this.connected = true;
+                _this.reconnectDelay = _this.options.reconnectMin || 1000;
+                _this.resume(sessionPresent);
+                if (_this.onconnect) {
+                    _this.onconnect(sessionPresent);
+                }
+            },
+            onPublish: function (topic, payload, qos, retain, dup, packetId) {
+                if (qos > 0) {
+                    _this.send(el_encodeMqttPacket(mqttPuback, packetId));
+                }
+                if (_this.onmessage) {
+                    _this.onmessage(topic, payload, qos, retain);
+                }
+            },
+            onPuback: function (packetId) {
+                var publish = _this.inflight[packetId];
+                if (publish) {
+                    delete _this.inflight[packetId];
+                    _this.inflightCount--;
+                    _this.scheduleFlush();
+                    if (publish.cb) {
+                        publish.cb();
+                    }
+                }
+            },
+            onSuback: function (packetId, returnCodes) {
+                _this.acknowledge(packetId, returnCodes);
+            },
+            onUnsuback: function (packetId) {
+                _this.acknowledge(packetId, []);
+            },
+        };
+        this.reconnectDelay = options.reconnectMin || 1000;
+    }
+    /** Opens the connection, called by {@link connectMqtt}. */
+    Esp32JsMqttClient.prototype.connect = function () {
+        var _this = this;
+        var options = this.options;
+        var ssl = !!options.ssl;
+        var port = options.port || (ssl ? 8883 : 1883);
+        var keepAlive = typeof options.keepAlive === "number" ? options.keepAlive : 60;
+        this.ended = false;
+        this.parser = el_createMqttParser(options.maxPacketSize || 16 * 1024);
+        var clientId = options.clientId ||
+            (options.clientId = "esp32js-" + Math.random().toString(36).substr(2));
+        var will = options.will;
+        var socket = (this.socket = socketEvents.sockConnect(ssl, options.host, String(port), function () {
+            socket.write(el_encodeMqttConnect(clientId, keepAlive, options.cleanSession !== false, options.username, options.password, will ? will.topic : undefined, will ? encode(will.payload) : undefined, will ? will.qos : 0, will ? will.retain : false));
+            socket.flush();
+            if (keepAlive > 0) {
+                // the pings keep data flowing, so a silent broker is gone
+                socket.setReadTimeout(keepAlive * 1500);
+                _this.pingTimer = setInterval(function () {
+                    _this.send(el_encodeMqttPacket(mqttPingreq));
+                }, keepAlive * 1000);
+            }
+        }, function (data) {
+            var ret = el_executeMqttParser(_this.parser, data, _this.handler);
+            if (ret < 0) {
+                _this.error(ret === -2 ? "MQTT packet too large" : "Malformed MQTT packet");
+                _this.destroy();
+            }
+        }, function () {
+            _this.error("MQTT connection to " + options.host + ":" + port + " failed");
+            _this.destroy();
+        }, function () { return _this.closed(); }));
+    };
+    /**
+     * Queues a message. Returns false if the queue is full. The callback gets
+     * called when a QoS 0 message was written or a QoS 1 message was
+     * acknowledged, or with an error if the client was ended before.
+     */
+    Esp32JsMqttClient.prototype.publish = function (topic, payload, options, cb) {
+        var qos = (options && options.qos) || 0;
+        var retain = !!(options && options.retain);
+        if (qos > 1) {
+            throw Error("MQTT QoS 2 is not supported");
+        }
+        if (this.ended) {
+            return false;
+        }
+        if (qos === 0 && options && options.coalesce) {
+            for (var i = 0; i < this.queue.length; i++) {
+                var queued = this.queue[i];
+                if (queued.qos === 0 && queued.topic === topic) {
+                    queued.payload = encode(payload);
+                    queued.retain = retain;
+                    return true;
+                }
+            }
+        }
+        if (this.queue.length >= (this.options.maxQueued || 100)) {
+            return false;
+        }
+        this.queue.push({ topic: topic, payload: encode(payload), qos: qos, retain: retain, cb: cb });
+        this.scheduleFlush();
+        return true;
+    };
+    /**
+     * Subscribes to topic filters, the subscriptions are renewed after
+     * reconnects without session. The callback gets the granted QoS per
+     * filter (128 for a failure) or an error.
+     */
+    Esp32JsMqttClient.prototype.subscribe = function (topics, qos, cb) {
+        var _this = this;
+        var filters = typeof topics === "string" ? [topics] : topics;
+        filters.forEach(function (filter) {
+            _this.subscriptions[filter] = qos || 0;
+        });
+        if (this.connected) {
+            this.sendSubscribe(filters, qos || 0, cb);
+        }
+        else {
+            this.pendingSubscribes.push({ filters: filters, qos: qos || 0, cb: cb });
+        }
+    };
+    Esp32JsMqttClient.prototype.unsubscribe = function (topics, cb) {
+        var _this = this;
+        var filters = typeof topics === "string" ? [topics] : topics;
+        filters.forEach(function (filter) {
+            delete _this.subscriptions[filter];
+        });
+        if (this.connected) {
+            var packetId = this.nextPacketId();
+            this.acks[packetId] = cb || noop;
+            this.send(el_encodeMqttSubscribe(packetId, filters));
+        }
+        else if (cb) {
+            cb([]);
+        }
+    };
+    /** Disconnects without reconnecting, queued messages are discarded. */
+    Esp32JsMqttClient.prototype.end = function () {
+        this.ended = true;
+        clearTimeout(this.reconnectTimer);
+        if (this.connected && this.socket) {
+            var socket_1 = this.socket;
+            socket_1.write(el_encodeMqttPacket(mqttDisconnect));
+            socket_1.flush(function () { return socketEvents.closeSocket(socket_1); });
+        }
+        else if (this.socket) {
+            this.destroy();
+        }
+        else {
+            // waiting for a reconnect
+            this.closed();
+        }
+    };
+    Esp32JsMqttClient.prototype.destroy = function () {
+        if (this.socket) {
+            socketEvents.closeSocket(this.socket);
+        }
+    };
+    Esp32JsMqttClient.prototype.error = function (message) {
+        console.error(message);
+        if (this.onerror) {
+            this.onerror(message);
+        }
+    };
+    Esp32JsMqttClient.prototype.send = function (packet) {
+        if (this.socket && this.connected) {
+            this.socket.write(packet);
+            this.scheduleFlush();
+        }
+    };
+    Esp32JsMqttClient.prototype.scheduleFlush = function () {
+        var _this = this;
+        if (!this.flushScheduled && this.connected) {
+            this.flushScheduled = true;
+            // a microtask still batches the publishes of the current callback
+            // without waiting for another event loop turn
+            queueMicrotask(function () {
+                _this.flushScheduled = false;
+                _this.flush();
+            });
+        }
+    };
+    // writes all publishes the in-flight window admits with a single flush
+    Esp32JsMqttClient.prototype.flush = function () {
+        var socket = this.socket;
+        if (!socket || !this.connected) {
+            return;
+        }
+        var written = [];
+        var maxInflight = this.options.maxInflight || 10;
+        while (this.queue.length > 0) {
+            var publish = this.queue[0];
+            var packetId = 0;
+            if (publish.qos > 0) {
+                if (this.inflightCount >= maxInflight) {
+                    break;
+                }
+                packetId = this.nextPacketId();
+                this.inflight[packetId] = publish;
+                this.inflightCount++;
+            }
+            else if (publish.cb) {
+                written.push(publish.cb);
+            }
+            this.queue.shift();
+            socket.write(el_encodeMqttPublish(publish.topic, publish.payload, publish.qos, publish.retain, false, packetId));
+        }
+        socket.flush(function () {
+            written.forEach(function (cb) { return cb(); });
+        });
+    };
+    // continues after CONNACK with the state of the previous connection
+    Esp32JsMqttClient.prototype.resume = function (sessionPresent) {
+        var _this = this;
+        var socket = this.socket;
+        Object.keys(this.inflight).forEach(function (key) {
+            var packetId = Number(key);
+            var publish = _this.inflight[packetId];
+            socket.write(el_encodeMqttPublish(publish.topic, publish.payload, publish.qos, publish.retain, true, packetId));
+        });
+        var pending = this.pendingSubscribes.splice(0);
+        if (!sessionPresent) {
+            // renew the previous subscriptions, one SUBSCRIBE per QoS
+            var topics_1 = Object.keys(this.subscriptions).filter(function (topic) {
+                return pending.every(function (subscribe) { return subscribe.filters.indexOf(topic) < 0; });
+            });
+            [0, 1].forEach(function (qos) {
+                var filters = topics_1.filter(function (topic) { return _this.subscriptions[topic] === qos; });
+                if (filters.length > 0) {
+                    _this.sendSubscribe(filters, qos);
+                }
+            });
+        }
+        pending.forEach(function (subscribe) {
+            _this.sendSubscribe(subscribe.filters, subscribe.qos, subscribe.cb);
+        });
+        this.scheduleFlush();
+    };
+    Esp32JsMqttClient.prototype.sendSubscribe = function (filters, qos, cb) {
+        var packetId = this.nextPacketId();
+        this.acks[packetId] = cb || noop;
+        this.send(el_encodeMqttSubscribe(packetId, filters, qos));
+    };
+    Esp32JsMqttClient.prototype.acknowledge = function (packetId, result) {
+        var cb = this.acks[packetId];
+        if (cb) {
+            delete this.acks[packetId];
+            cb(result);
+        }
+    };
+    Esp32JsMqttClient.prototype.nextPacketId = function () {
+        do {
+            this.lastPacketId = (this.lastPacketId % 0xffff) + 1;
+        } while (this.inflight[this.lastPacketId] || this.acks[this.lastPacketId]);
+        return this.lastPacketId;
+    };
+    Esp32JsMqttClient.prototype.closed = function () {
+        var _this = this;
+        var wasConnected = this.connected;
+        this.connected = false;
+        this.socket = null;
+        clearInterval(this.pingTimer);
+        // stops the parser if it is executing, e.g. end() was called by onmessage
+        el_freeMqttParser(this.parser);
+        this.parser = 0;
+        Object.keys(this.acks).forEach(function (key) {
+            var cb = _this.acks[Number(key)];
+            delete _this.acks[Number(key)];
+            cb(Error("MQTT connection closed"));
+        });
+        if (this.ended) {
+            var error_1 = Error("MQTT client ended");
+            var discarded_1 = this.queue.splice(0);
+            Object.keys(this.inflight).forEach(function (key) {
+                discarded_1.push(_this.inflight[Number(key)]);
+            });
+            this.inflight = {};
+            this.inflightCount = 0;
+            discarded_1.forEach(function (publish) {
+                if (publish.cb) {
+                    publish.cb(error_1);
+                }
+            });
+            this.pendingSubscribes.splice(0).forEach(function (subscribe) {
+                if (subscribe.cb) {
+                    subscribe.cb(error_1);
+                }
+            });
+        }
+        else {
+            console.debug("MQTT reconnect in " + this.reconnectDelay + " ms");
+            this.reconnectTimer = setTimeout(function () { return _this.connect(); }, this.reconnectDelay);
+            this.reconnectDelay = Math.min(this.reconnectDelay * 2, this.options.reconnectMax || 60000);
+        }
+        if (wasConnected && this.onclose) {
+            this.onclose();
+        }
+    };
+    return Esp32JsMqttClient;
+}());
+exports.Esp32JsMqttClient = Esp32JsMqttClient;
+function noop() {
+    // no callback given
+}
+function encode(payload) {
+    return typeof payload === "string" ? textEncoder.encode(payload) : payload;
+}
+/** Creates a MQTT client and connects it to the broker. */
+function connectMqtt(options) {
+    var client = new Esp32JsMqttClient(options);
+    client.connect();
+    return client;
+}
+exports.connectMqtt = connectMqtt;
@@ -0,0 +1,508 @@
+import socketEvents = require("socket-events");
+
+const mqttPuback = 4;
+const mqttPingreq = 12;
+const mqttDisconnect = 14;
+
+export interface Esp32JsMqttOptions {
+  host: string;
+  /** Defaults to 1883, or 8883 with ssl. */
+  port?: number;
+  ssl?: boolean;
+  /** Defaults to a random id. */
+  clientId?: string;
+  username?: string;
+  password?: string;
+  /** Keepalive interval in seconds, defaults to 60. */
+  keepAlive?: number;
+  /** Defaults to true. */
+  cleanSession?: boolean;
+  will?: {
+    topic: string;
+    payload: string | Uint8Array;
+    qos?: number;
+    retain?: boolean;
+  };
+  /** Maximum number of unacknowledged QoS 1 publishes, defaults to 10. */
+  maxInflight?: number;
+  /** Maximum number of queued publishes, defaults to 100. */
+  maxQueued?: number;
+  /** Delay of the first reconnect in milliseconds, doubled after each failed attempt up to reconnectMax. */
+  reconnectMin?: number;
+  reconnectMax?: number;
+  /** Maximum size of a received packet in bytes, defaults to 16 KB. */
+  maxPacketSize?: number;
+}
+
+export interface Esp32JsMqttPublishOptions {
+  /** 0 (default) or 1, QoS 2 is not supported. */
+  qos?: number;
+  retain?: boolean;
+  /**
+   * Replaces the payload of a queued QoS 0 publish of the same topic which
+   * was not sent yet, e.g. for readings where only the latest value matters.
+   */
+  coalesce?: boolean;
+}
+
+interface Subscribe {
+  filters: string[];
+  qos: number;
+  cb?: (result: number[] | Error) => void;
+}
+
+interface QueuedPublish {
+  topic: string;
+  payload: Uint8Array;
+  qos: number;
+  retain: boolean;
+  cb?: (error?: Error) => void;
+}
+
+const textEncoder = new TextEncoder();
+
+// reasons of a refused connection by CONNACK return code
+const connackErrors: { [code: number]: string } = {
+  1: "unacceptable protocol version",
+  2: "identifier rejected",
+  3: "server unavailable",
+  4: "bad user name or password",
+  5: "not authorized",
+};
+
+/**
+ * MQTT 3.1.1 client created by {@link connectMqtt}. Packets are encoded and
+ * parsed natively. Publishes are queued and all publishes until the
+ * current callback returns are written to the socket at once. QoS 1
+ * publishes wait for their PUBACK within a window of maxInflight messages
+ * and are sent again after a reconnect. Lost connections are reconnected
+ * with exponential backoff.
+ */
+export class Esp32JsMqttClient {
+  public connected = false;
+  public onconnect: ((sessionPresent: boolean) => void) | null = null;
+  public onmessage:
+    | ((
+        topic: string,
+        payload: Uint8Array,
+        qos: number,
+        retain: boolean
+      ) => void)
+    | null = null;
+  public onclose: (() => void) | null = null;
+  public onerror: ((message: string) => void) | null = null;
+
+  private socket: socketEvents.Esp32JsSocket | null = null;
+  private parser = 0;
+  private ended = false;
+  private queue: QueuedPublish[] = [];
+  private inflight: { [packetId: number]: QueuedPublish } = {};
+  private inflightCount = 0;
+  private acks: { [packetId: number]: (result: number[] | Error) => void } = {};
+  private subscriptions: { [topic: string]: number } = {};
+  private pendingSubscribes: Subscribe[] = [];
+  private lastPacketId = 0;
+  private flushScheduled = false;
+  private pingTimer = -1;
+  private reconnectTimer = -1;
+  private reconnectDelay: number;
+  private handler = {
+    onConnack: (sessionPresent: boolean, returnCode: number) => {
+      if (returnCode !== 0) {
+        const message =
+          connackErrors[returnCode] || "return code " + returnCode;
+        this.error("MQTT connection refused: " + message);
+        // only an unavailable server may accept a later attempt
+        this.ended = this.ended || returnCode !== 3;
+        this.destroy();
+        return;
+      }
+      this.connected = true;
+      this.reconnectDelay = this.options.reconnectMin || 1000;
+      this.resume(sessionPresent);
+      if (this.onconnect) {
+        this.onconnect(sessionPresent);
+      }
+    },
+    onPublish: (
+      topic: string,
+      payload: Uint8Array,
+      qos: number,
+      retain: boolean,
+      dup: boolean,
+      packetId: number
+    ) => {
+      if (qos > 0) {
+        this.send(el_encodeMqttPacket(mqttPuback, packetId));
+      }
+      if (this.onmessage) {
+        this.onmessage(topic, payload, qos, retain);
+      }
+    },
+    onPuback: (packetId: number) => {
+      const publish = this.inflight[packetId];
+      if (publish) {
+        delete this.inflight[packetId];
+        this.inflightCount--;
+        this.scheduleFlush();
+        if (publish.cb) {
+          publish.cb();
+        }
+      }
+    },
+    onSuback: (packetId: number, returnCodes: number[]) => {
+      this.acknowledge(packetId, returnCodes);
+    },
+    onUnsuback: (packetId: number) => {
+      this.acknowledge(packetId, []);
+    },
+  };
+
+  constructor(private options: Esp32JsMqttOptions) {
+    this.reconnectDelay = options.reconnectMin || 1000;
+  }
+
+  /** Opens the connection, called by {@link connectMqtt}. */
+  public connect(): void {
+    const options = this.options;
+    const ssl = !!options.ssl;
+    const port = options.port || (ssl ? 8883 : 1883);
+    const keepAlive =
+      typeof options.keepAlive === "number" ? options.keepAlive : 60;
+    this.ended = false;
+    this.parser = el_createMqttParser(options.maxPacketSize || 16 * 1024);
+    const clientId =
+      options.clientId ||
+      (options.clientId = "esp32js-" + Math.random().toString(36).substr(2));
+    const will = options.will;
+
+    const socket = (this.socket = socketEvents.sockConnect(
+      ssl,
+      options.host,
+      String(port),
+      () => {
+        socket.write(
+          el_encodeMqttConnect(
+            clientId,
+            keepAlive,
+            options.cleanSession !== false,
+            options.username,
+            options.password,
+            will ? will.topic : undefined,
+            will ? encode(will.payload) : undefined,
+            will ? will.qos : 0,
+            will ? will.retain : false
+          )
+        );
+        socket.flush();
+        if (keepAlive > 0) {
+          // the pings keep data flowing, so a silent broker is gone
+          socket.setReadTimeout(keepAlive * 1500);
+          this.pingTimer = setInterval(() => {
+            this.send(el_encodeMqttPacket(mqttPingreq));
+          }, keepAlive * 1000);
+        }
+      },
+      (data: string) => {
+        const ret = el_executeMqttParser(this.parser, data, this.handler);
+        if (ret < 0) {
+          this.error(
+            ret === -2 ? "MQTT packet too large" : "Malformed MQTT packet"
+          );
+          this.destroy();
+        }
+      },
+      () => {
+        this.error(`MQTT connection to ${options.host}:${port} failed`);
+        this.destroy();
+      },
+      () => this.closed()
+    ));
+  }
+
+  /**
+   * Queues a message. Returns false if the queue is full. The callback gets
+   * called when a QoS 0 message was written or a QoS 1 message was
+   * acknowledged, or with an error if the client was ended before.
+   */
+  public publish(
+    topic: string,
+    payload: string | Uint8Array,
+    options?: Esp32JsMqttPublishOptions,
+    cb?: (error?: Error) => void
+  ): boolean {
+    const qos = (options && options.qos) || 0;
+    const retain = !!(options && options.retain);
+    if (qos > 1) {
+      throw Error("MQTT QoS 2 is not supported");
+    }
+    if (this.ended) {
+      return false;
+    }
+    if (qos === 0 && options && options.coalesce) {
+      for (let i = 0; i < this.queue.length; i++) {
+        const queued = this.queue[i];
+        if (queued.qos === 0 && queued.topic === topic) {
+          queued.payload = encode(payload);
+          queued.retain = retain;
+          return true;
+        }
+      }
+    }
+    if (this.queue.length >= (this.options.maxQueued || 100)) {
+      return false;
+    }
+    this.queue.push({ topic, payload: encode(payload), qos, retain, cb });
+    this.scheduleFlush();
+    return true;
+  }
+
+  /**
+   * Subscribes to topic filters, the subscriptions are renewed after
+   * reconnects without session. The callback gets the granted QoS per
+   * filter (128 for a failure) or an error.
+   */
+  public subscribe(
+    topics: string | string[],
+    qos?: number,
+    cb?: (result: number[] | Error) => void
+  ): void {
+    const filters = typeof topics === "string" ? [topics] : topics;
+    filters.forEach((filter) => {
+      this.subscriptions[filter] = qos || 0;
+    });
+    if (this.connected) {
+      this.sendSubscribe(filters, qos || 0, cb);
+    } else {
+      this.pendingSubscribes.push({ filters, qos: qos || 0, cb });
+    }
+  }
+
+  public unsubscribe(
+    topics: string | string[],
+    cb?: (result: number[] | Error) => void
+  ): void {
+    const filters = typeof topics === "string" ? [topics] : topics;
+    filters.forEach((filter) => {
+      delete this.subscriptions[filter];
+    });
+    if (this.connected) {
+      const packetId = this.nextPacketId();
+      this.acks[packetId] = cb || noop;
+      this.send(el_encodeMqttSubscribe(packetId, filters));
+    } else if (cb) {
+      cb([]);
+    }
+  }
+
+  /** Disconnects without reconnecting, queued messages are discarded. */
+  public end(): void {
+    this.ended = true;
+    clearTimeout(this.reconnectTimer);
+    if (this.connected && this.socket) {
+      const socket = this.socket;
+      socket.write(el_encodeMqttPacket(mqttDisconnect));
+      socket.flush(() => socketEvents.closeSocket(socket));
+    } else if (this.socket) {
+      this.destroy();
+    } else {
+      // waiting for a reconnect
+      this.closed();
+    }
+  }
+
+  private destroy() {
+    if (this.socket) {
+      socketEvents.closeSocket(this.socket);
+    }
+  }
+
+  private error(message: string) {
+    console.error(message);
+    if (this.onerror) {
+      this.onerror(message);
+    }
+  }
+
+  private send(packet: Uint8Array) {
+    if (this.socket && this.connected) {
+      this.socket.write(packet);
+      this.scheduleFlush();
+    }
+  }
+
+  private scheduleFlush() {
+    if (!this.flushScheduled && this.connected) {
+      this.flushScheduled = true;
+      // a microtask still batches the publishes of the current callback
+      // without waiting for another event loop turn
+      queueMicrotask(() => {
+        this.flushScheduled = false;
+        this.flush();
+      });
+    }
+  }
+
+  // writes all publishes the in-flight window admits with a single flush
+  private flush() {
+    const socket = this.socket;
+    if (!socket || !this.connected) {
+      return;
+    }
+    const written: ((error?: Error) => void)[] = [];
+    const maxInflight = this.options.maxInflight || 10;
+    while (this.queue.length > 0) {
+      const publish = this.queue[0];
+      let packetId = 0;
+      if (publish.qos > 0) {
+        if (this.inflightCount >= maxInflight) {
+          break;
+        }
+        packetId = this.nextPacketId();
+        this.inflight[packetId] = publish;
+        this.inflightCount++;
+      } else if (publish.cb) {
+        written.push(publish.cb);
+      }
+      this.queue.shift();
+      socket.write(
+        el_encodeMqttPublish(
+          publish.topic,
+          publish.payload,
+          publish.qos,
+          publish.retain,
+          false,
+          packetId
+        )
+      );
+    }
+    socket.flush(() => {
+      written.forEach((cb) => cb());
+    });
+  }
+
+  // continues after CONNACK with the state of the previous connection
+  private resume(sessionPresent: boolean) {
+    const socket = this.socket as socketEvents.Esp32JsSocket;
+    Object.keys(this.inflight).forEach((key) => {
+      const packetId = Number(key);
+      const publish = this.inflight[packetId];
+      socket.write(
+        el_encodeMqttPublish(
+          publish.topic,
+          publish.payload,
+          publish.qos,
+          publish.retain,
+          true,
+          packetId
+        )
+      );
+    });
+    const pending = this.pendingSubscribes.splice(0);
+    if (!sessionPresent) {
+      // renew the previous subscriptions, one SUBSCRIBE per QoS
+      const topics = Object.keys(this.subscriptions).filter((topic) =>
+        pending.every((subscribe) => subscribe.filters.indexOf(topic) < 0)
+      );
+      [0, 1].forEach((qos) => {
+        const filters = topics.filter(
+          (topic) => this.subscriptions[topic] === qos
+        );
+        if (filters.length > 0) {
+          this.sendSubscribe(filters, qos);
+        }
+      });
+    }
+    pending.forEach((subscribe) => {
+      this.sendSubscribe(subscribe.filters, subscribe.qos, subscribe.cb);
+    });
+    this.scheduleFlush();
+  }
+
+  private sendSubscribe(
+    filters: string[],
+    qos: number,
+    cb?: (result: number[] | Error) => void
+  ) {
+    const packetId = this.nextPacketId();
+    this.acks[packetId] = cb || noop;
+    this.send(el_encodeMqttSubscribe(packetId, filters, qos));
+  }
+
+  private acknowledge(packetId: number, result: number[]) {
+    const cb = this.acks[packetId];
+    if (cb) {
+      delete this.acks[packetId];
+      cb(result);
+    }
+  }
+
+  private nextPacketId() {
+    do {
+      this.lastPacketId = (this.lastPacketId % 0xffff) + 1;
+    } while (this.inflight[this.lastPacketId] || this.acks[this.lastPacketId]);
+    return this.lastPacketId;
+  }
+
+  private closed() {
+    const wasConnected = this.connected;
+    this.connected = false;
+    this.socket = null;
+    clearInterval(this.pingTimer);
+    // stops the parser if it is executing, e.g. end() was called by onmessage
+    el_freeMqttParser(this.parser);
+    this.parser = 0;
+    Object.keys(this.acks).forEach((key) => {
+      const cb = this.acks[Number(key)];
+      delete this.acks[Number(key)];
+      cb(Error("MQTT connection closed"));
+    });
+    if (this.ended) {
+      const error = Error("MQTT client ended");
+      const discarded = this.queue.splice(0);
+      Object.keys(this.inflight).forEach((key) => {
+        discarded.push(this.inflight[Number(key)]);
+      });
+      this.inflight = {};
+      this.inflightCount = 0;
+      discarded.forEach((publish) => {
+        if (publish.cb) {
+          publish.cb(error);
+        }
+      });
+      this.pendingSubscribes.splice(0).forEach((subscribe) => {
+        if (subscribe.cb) {
+          subscribe.cb(error);
+        }
+      });
+    } else {
+      console.debug(`MQTT reconnect in ${this.reconnectDelay} ms`);
+      this.reconnectTimer = setTimeout(
+        () => this.connect(),
+        this.reconnectDelay
+      );
+      this.reconnectDelay = Math.min(
+        this.reconnectDelay * 2,
+        this.options.reconnectMax || 60000
+      );
+    }
+    if (wasConnected && this.onclose) {
+      this.onclose();
+    }
+  }
+}
+
+function noop() {
+  // no callback given
+}
+
+function encode(payload: string | Uint8Array): Uint8Array {
+  return typeof payload === "string" ? textEncoder.encode(payload) : payload;
+}
+
+/** Creates a MQTT client and connects it to the broker. */
+export function connectMqtt(options: Esp32JsMqttOptions): Esp32JsMqttClient {
+  const client = new Esp32JsMqttClient(options);
+  client.connect();
+  return client;
+}
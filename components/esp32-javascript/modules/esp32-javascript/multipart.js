@@ -0,0 +1,176 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.receiveMultipart = exports.headerParam = exports.Esp32JsMultipartForm = void 0;
+var headers_1 = require("./headers");
+var textDecoder = new TextDecoder();
+/** The result of {@link receiveMultipart}, available as req.form. */
+var Esp32JsMultipartForm = /** @class */ (function () {
+    function Esp32JsMultipartForm() {
+        /** Values of the parts which were not streamed by onPart. */
+        this.fields = {};
+        /** Paths of the parts which were written to files, by field name. */
+        this.files = {};
+        /** True if the body was received and parsed completely. */
+        this.complete = false;
+        /** The HTTP status to respond with if the body was malformed, or 0. */
+        this.error = 0;
+    }
+    return Esp32JsMultipartForm;
+}());
+exports.Esp32JsMultipartForm = Esp32JsMultipartForm;
+/** Returns a parameter of a header value like content-type, or null. */
+function headerParam(value, param) {
+    if (value) {
+        var match = new RegExp(";\\s*" + param + "\\s*=\\s*(?:\"([^\"]*)\"|([^;\\s]*))", "i").exec(value);
+        if (match) {
+            return match[1] !== undefined ? match[1] : match[2];
+        }
+    }
+    return null;
+}
+exports.headerParam = headerParam;
+function decodeChunks(chunks) {
+    if (chunks.length === 1) {
+        return textDecoder.decode(chunks[0]);
+    }
+    var length = 0;
+    chunks.forEach(function (chunk) { return (length += chunk.length); });
+    var joined = new Uint8Array(length);
+    var offset = 0;
+    chunks.forEach(function (chunk) {
+        joined.set(chunk, offset);
+        offset += chunk.length;
+    });
+    return textDecoder.decode(joined);
+}
+/**
+ * Receives a multipart/form-data request body part by part while it
+ * arrives. Call it from onRequestBody of {@link httpServer} and return its
+ * result. The boundary search and the part headers are handled natively,
+ * content is streamed to onData of the part options or written to a file
+ * without buffering the body in RAM.
+ * The form is available as req.form in the request callback, check its
+ * error before using it.
+ * Returns undefined if the request is not multipart/form-data.
+ */
+function receiveMultipart(req, options) {
+    var contentType = req.headers.get("content-type");
+    var boundary = headerParam(contentType, "boundary");
+    if (!contentType ||
+        !/^multipart\/form-data\s*(;|$)/i.test(contentType) ||
+        !boundary ||
+        boundary.length > 70) {
+        return undefined;
+    }
+    var opts = options || {};
+    var maxFieldSize = typeof opts.maxFieldSize === "number" ? opts.maxFieldSize : 4096;
+    var form = new Esp32JsMultipartForm();
+    req.form = form;
+    var parser = el_createMultipartParser(boundary);
+    var part = null;
+    var partOptions = null;
+    var fieldChunks = null;
+    // a handler may end the body while the parser runs, e.g. by closing the
+    // connection, the parser is freed after el_executeMultipartParser returns
+    var executing = false;
+    var released = false;
+    var release = function () {
+        released = true;
+        if (parser && !executing) {
+            el_freeMultipartParser(parser);
+            parser = 0;
+        }
+    };
+    var handler = {
+        onPart: function (headerList) {
+            if (released) {
+                return;
+            }
+            var headers = headers_1.Esp32JsHeaders.fromList(headerList);
+            var disposition = headers.get("content-disposition");
+            part = {
+                headers: headers,
+                name: headerParam(disposition, "name"),
+                filename: headerParam(disposition, "filename"),
+                contentType: headers.get("content-type"),
+            };
+            partOptions = (opts.onPart && opts.onPart(part)) || null;
+            if (partOptions) {
+                fieldChunks = null;
+                el_setMultipartPartBody(parser, typeof partOptions.maxSize === "number" ? partOptions.maxSize : -1, partOptions.file);
+            }
+            else {
+                fieldChunks = [];
+                el_setMultipartPartBody(parser, maxFieldSize);
+            }
+        },
+        onData: function (chunk) {
+            if (released) {
+                return;
+            }
+            if (fieldChunks) {
+                fieldChunks.push(chunk);
+            }
+            else if (partOptions && partOptions.onData) {
+                partOptions.onData(chunk);
+            }
+        },
+        onPartEnd: function () {
+            if (released) {
+                return;
+            }
+            var ended = part;
+            if (ended.name !== null) {
+                if (fieldChunks) {
+                    form.fields[ended.name] = decodeChunks(fieldChunks);
+                }
+                else if (partOptions && partOptions.file) {
+                    form.files[ended.name] = partOptions.file;
+                }
+            }
+            part = null;
+            partOptions = null;
+            fieldChunks = null;
+            if (opts.onPartEnd) {
+                opts.onPartEnd(ended);
+            }
+        },
+    };
+    return {
+        maxSize: opts.maxSize,
+        onData: function (chunk) {
+            if (!parser || released) {
+                return;
+            }
+            var state = 0;
+            executing = true;
+            try {
+                state = el_executeMultipartParser(parser, chunk, handler);
+            }
+            finally {
+                executing = false;
+                if (released) {
+                    release();
+                }
+            }
+            if (!parser) {
+                return;
+            }
+            if (state < 0) {
+                form.error = -state;
+                release();
+            }
+            else if (state > 0) {
+                form.complete = true;
+                release();
+            }
+        },
+        onEnd: function () {
+            if (!form.complete && !form.error) {
+                // the body ended before the close delimiter
+                form.error = 400;
+            }
+            release();
+        },
+    };
+}
+exports.receiveMultipart = receiveMultipart;
@@ -0,0 +1,220 @@
+import { Esp32JsRequest, Esp32JsRequestBodyOptions } from "./http";
+import { Esp32JsHeaders } from "./headers";
+
+const textDecoder = new TextDecoder();
+
+/** A part of a multipart/form-data body as passed to onPart. */
+export interface Esp32JsMultipartPart {
+  headers: Headers;
+  /** The name parameter of content-disposition, the form field name. */
+  name: string | null;
+  /** The filename parameter of content-disposition for file inputs. */
+  filename: string | null;
+  contentType: string | null;
+}
+
+export interface Esp32JsMultipartPartOptions {
+  /** Gets called with each received piece of the part content. */
+  onData?: (chunk: Uint8Array) => void;
+  /** Writes the content natively to this file in /data instead of calling onData. */
+  file?: string;
+  /** Maximum content size in bytes, larger parts fail the form with 413. */
+  maxSize?: number;
+}
+
+export interface Esp32JsMultipartOptions {
+  /**
+   * Gets called with the headers of each part. Return options to stream
+   * its content, otherwise it is collected as string in form.fields.
+   */
+  onPart?: (part: Esp32JsMultipartPart) => Esp32JsMultipartPartOptions | void;
+  /** Gets called when the content of a part was received completely. */
+  onPartEnd?: (part: Esp32JsMultipartPart) => void;
+  /** Maximum size of collected fields in bytes, defaults to 4 KB. */
+  maxFieldSize?: number;
+  /** Maximum size of the whole body in bytes, larger bodies are answered with 413. */
+  maxSize?: number;
+}
+
+/** The result of {@link receiveMultipart}, available as req.form. */
+export class Esp32JsMultipartForm {
+  /** Values of the parts which were not streamed by onPart. */
+  public fields: { [name: string]: string } = {};
+  /** Paths of the parts which were written to files, by field name. */
+  public files: { [name: string]: string } = {};
+  /** True if the body was received and parsed completely. */
+  public complete = false;
+  /** The HTTP status to respond with if the body was malformed, or 0. */
+  public error = 0;
+}
+
+/** Returns a parameter of a header value like content-type, or null. */
+export function headerParam(
+  value: string | null,
+  param: string
+): string | null {
+  if (value) {
+    const match = new RegExp(
+      `;\\s*${param}\\s*=\\s*(?:"([^"]*)"|([^;\\s]*))`,
+      "i"
+    ).exec(value);
+    if (match) {
+      return match[1] !== undefined ? match[1] : match[2];
+    }
+  }
+  return null;
+}
+
+function decodeChunks(chunks: Uint8Array[]): string {
+  if (chunks.length === 1) {
+    return textDecoder.decode(chunks[0]);
+  }
+  let length = 0;
+  chunks.forEach((chunk) => (length += chunk.length));
+  const joined = new Uint8Array(length);
+  let offset = 0;
+  chunks.forEach((chunk) => {
+    joined.set(chunk, offset);
+    offset += chunk.length;
+  });
+  return textDecoder.decode(joined);
+}
+
+/**
+ * Receives a multipart/form-data request body part by part while it
+ * arrives. Call it from onRequestBody of {@link httpServer} and return its
+ * result. The boundary search and the part headers are handled natively,
+ * content is streamed to onData of the part options or written to a file
+ * without buffering the body in RAM.
+ * The form is available as req.form in the request callback, check its
+ * error before using it.
+ * Returns undefined if the request is not multipart/form-data.
+ */
+export function receiveMultipart(
+  req: Esp32JsRequest,
+  options?: Esp32JsMultipartOptions
+): Esp32JsRequestBodyOptions | undefined {
+  const contentType = req.headers.get("content-type");
+  const boundary = headerParam(contentType, "boundary");
+  if (
+    !contentType ||
+    !/^multipart\/form-data\s*(;|$)/i.test(contentType) ||
+    !boundary ||
+    boundary.length > 70
+  ) {
+    return undefined;
+  }
+  const opts = options || {};
+  const maxFieldSize =
+    typeof opts.maxFieldSize === "number" ? opts.maxFieldSize : 4096;
+  const form = new Esp32JsMultipartForm();
+  req.form = form;
+
+  let parser = el_createMultipartParser(boundary);
+  let part: Esp32JsMultipartPart | null = null;
+  let partOptions: Esp32JsMultipartPartOptions | null = null;
+  let fieldChunks: Uint8Array[] | null = null;
+  // a handler may end the body while the parser runs, e.g. by closing the
+  // connection, the parser is freed after el_executeMultipartParser returns
+  let executing = false;
+  let released = false;
+  const release = function () {
+    released = true;
+    if (parser && !executing) {
+      el_freeMultipartParser(parser);
+      parser = 0;
+    }
+  };
+  const handler = {
+    onPart: function (headerList: string[]) {
+      if (released) {
+        return;
+      }
+      const headers = Esp32JsHeaders.fromList(headerList);
+      const disposition = headers.get("content-disposition");
+      part = {
+        headers,
+        name: headerParam(disposition, "name"),
+        filename: headerParam(disposition, "filename"),
+        contentType: headers.get("content-type"),
+      };
+      partOptions = (opts.onPart && opts.onPart(part)) || null;
+      if (partOptions) {
+        fieldChunks = null;
+        el_setMultipartPartBody(
+          parser,
+          typeof partOptions.maxSize === "number" ? partOptions.maxSize : -1,
+          partOptions.file
+        );
+      } else {
+        fieldChunks = [];
+        el_setMultipartPartBody(parser, maxFieldSize);
+      }
+    },
+    onData: function (chunk: Uint8Array) {
+      if (released) {
+        return;
+      }
+      if (fieldChunks) {
+        fieldChunks.push(chunk);
+      } else if (partOptions && partOptions.onData) {
+        partOptions.onData(chunk);
+      }
+    },
+    onPartEnd: function () {
+      if (released) {
+        return;
+      }
+      const ended = part as Esp32JsMultipartPart;
+      if (ended.name !== null) {
+        if (fieldChunks) {
+          form.fields[ended.name] = decodeChunks(fieldChunks);
+        } else if (partOptions && partOptions.file) {
+          form.files[ended.name] = partOptions.file;
+        }
+      }
+      part = null;
+      partOptions = null;
+      fieldChunks = null;
+      if (opts.onPartEnd) {
+        opts.onPartEnd(ended);
+      }
+    },
+  };
+
+  return {
+    maxSize: opts.maxSize,
+    onData: function (chunk) {
+      if (!parser || released) {
+        return;
+      }
+      let state = 0;
+      executing = true;
+      try {
+        state = el_executeMultipartParser(parser, chunk, handler);
+      } finally {
+        executing = false;
+        if (released) {
+          release();
+        }
+      }
+      if (!parser) {
+        return;
+      }
+      if (state < 0) {
+        form.error = -state;
+        release();
+      } else if (state > 0) {
+        form.complete = true;
+        release();
+      }
+    },
+    onEnd: function () {
+      if (!form.complete && !form.error) {
+        // the body ended before the close delimiter
+        form.error = 400;
+      }
+      release();
+    },
+  };
+}
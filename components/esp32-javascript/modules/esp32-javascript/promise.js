@@ -17,6 +17,16 @@ module.exports=(function() {
 	function isFulfilled(promise) { return promise.state === FULFILLED; }
 	function isRejected(promise) { return promise.state === REJECTED; }
 
+	// reactions of settled promises run as microtasks of the event loop,
+	// so a chain of thens does not take a turn of the loop for every then
+	function enqueue(reaction) {
+		if (typeof queueMicrotask === 'function') {
+			queueMicrotask(reaction);
+		} else {
+			setTimeout(reaction, 0);
+		}
+	}
+
 	// Promise Resolution Procedure [[Resolve]](promise2, x)
 	function prp(enhancedPromise, x) {
 
@@ -125,7 +135,7 @@ module.exports=(function() {
 				// context
 				(function(callback, data, nextEnhancedPromise) {
 
-					setTimeout(function() {
+					enqueue(function() {
 
 					// 2.2.1: Both `onFulfilled` and `onRejected` are optional 
 					// arguments.
@@ -182,7 +192,7 @@ module.exports=(function() {
 						enhancedState.execFn(nextEnhancedPromise)(data);
 					}
 
-					}, 0);
+					});
 
 				})(callback, data, nextEnhancedPromise)
 
@@ -296,23 +306,15 @@ module.exports=(function() {
 	}
 
 	var registry = (function() {
-		
-		var records = [];
 
+		// the enhanced promise is kept by the promise itself, a list of all
+		// promises would never release them and get slower with every promise
 		function add(promise, enhancedPromise) {
-			records.push({
-				promise: promise,
-				enhancedPromise: enhancedPromise
-			});
+			promise.enhanced = enhancedPromise;
 		}
 
 		function getEnhanced(promise) {
-			for(var i = 0; i < records.length; i++) {
-				var record = records[i];
-				if(record.promise === promise) {
-					return record.enhancedPromise;
-				}
-			}
+			return promise.enhanced;
 		}
 
 		return {
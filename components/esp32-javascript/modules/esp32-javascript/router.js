@@ -0,0 +1,178 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.Router = void 0;
+function createNode() {
+    return { children: {}, param: null, routes: null, rest: null };
+}
+function findRoute(routes, method) {
+    if (!routes) {
+        return undefined;
+    }
+    return (routes[method] ||
+        (method === "HEAD" && routes["GET"]) ||
+        routes["*"] ||
+        null);
+}
+function internalServerError(res, error) {
+    var errorMessage = "Internal server error: " + error;
+    console.error(errorMessage);
+    if (!res.isEnded) {
+        if (!res.headersWritten) {
+            res.setStatus(500);
+            res.headers.set("Content-type", "text/plain");
+        }
+        res.end(errorMessage);
+    }
+}
+/**
+ * Dispatches requests by method and path templates like
+ * /selftest/pins/:pin/:value. Templates are compiled into a trie of path
+ * segments, so the dispatch cost depends on the path length and not on the
+ * number of routes. Static segments take precedence over placeholders.
+ */
+var Router = /** @class */ (function () {
+    function Router() {
+        this.root = createNode();
+        this.middleware = [];
+    }
+    /**
+     * Adds middleware which runs for every request passed to
+     * {@link Router.handle}, even if no route matches.
+     */
+    Router.prototype.use = function (middleware) {
+        this.middleware.push(middleware);
+    };
+    /**
+     * Adds a route. The template consists of static segments, :name
+     * placeholders and an optional trailing * which matches the remaining
+     * path. Use "*" as method to match every method, GET routes also match
+     * HEAD requests.
+     */
+    Router.prototype.route = function (method, template, handler, middleware) {
+        var segments = template.split("/");
+        var paramNames = [];
+        var node = this.root;
+        var rest = false;
+        for (var i = 1; i < segments.length; i++) {
+            var segment = segments[i];
+            if (segment === "*" && i === segments.length - 1) {
+                paramNames.push("*");
+                rest = true;
+            }
+            else if (segment.charAt(0) === ":") {
+                paramNames.push(segment.substring(1));
+                node = node.param = node.param || createNode();
+            }
+            else {
+                node = node.children[segment] =
+                    node.children[segment] || createNode();
+            }
+        }
+        var route = { handler: handler, middleware: middleware || [], paramNames: paramNames };
+        if (rest) {
+            (node.rest = node.rest || {})[method.toUpperCase()] = route;
+        }
+        else {
+            (node.routes = node.routes || {})[method.toUpperCase()] = route;
+        }
+    };
+    Router.prototype.get = function (template, handler, middleware) {
+        this.route("GET", template, handler, middleware);
+    };
+    Router.prototype.post = function (template, handler, middleware) {
+        this.route("POST", template, handler, middleware);
+    };
+    Router.prototype.put = function (template, handler, middleware) {
+        this.route("PUT", template, handler, middleware);
+    };
+    /**
+     * Finds the route of a request. Returns undefined if no template matches
+     * the path and null if templates match, but not for this method.
+     */
+    Router.prototype.match = function (node, segments, index, method, values) {
+        var found;
+        if (index === segments.length) {
+            found = findRoute(node.routes, method);
+        }
+        else {
+            var child = node.children[segments[index]];
+            if (child) {
+                found = this.match(child, segments, index + 1, method, values);
+            }
+            if (!found && node.param && segments[index] !== "") {
+                values.push(segments[index]);
+                var paramFound = this.match(node.param, segments, index + 1, method, values);
+                if (paramFound) {
+                    return paramFound;
+                }
+                values.pop();
+                if (paramFound === null) {
+                    found = null;
+                }
+            }
+        }
+        if (!found && node.rest) {
+            var restFound = findRoute(node.rest, method);
+            if (restFound) {
+                values.push(segments.slice(index).join("/"));
+                return restFound;
+            }
+            found = null;
+        }
+        return found;
+    };
+    /**
+     * Runs the middleware and the matching route. Calls fallback if no route
+     * matches, a matching path with a different method is answered with 405.
+     * Errors of handlers are answered with 500.
+     */
+    Router.prototype.handle = function (req, res, fallback) {
+        var routeReq = req;
+        var queryIndex = req.path.indexOf("?");
+        var path = queryIndex >= 0 ? req.path.substring(0, queryIndex) : req.path;
+        var values = [];
+        var route = this.match(this.root, path.split("/"), 1, req.method.toUpperCase(), values);
+        routeReq.params = {};
+        if (route) {
+            for (var i = 0; i < values.length; i++) {
+                try {
+                    routeReq.params[route.paramNames[i]] = decodeURIComponent(values[i]);
+                }
+                catch (error) {
+                    routeReq.params[route.paramNames[i]] = values[i];
+                }
+            }
+        }
+        var chain = route
+            ? this.middleware.concat(route.middleware)
+            : this.middleware;
+        var next = function (index) {
+            if (res.isEnded) {
+                return;
+            }
+            if (index < chain.length) {
+                chain[index](routeReq, res, function () {
+                    next(index + 1);
+                });
+            }
+            else if (route) {
+                route.handler(routeReq, res);
+            }
+            else if (route === null) {
+                res.setStatus(405);
+                res.headers.set("Content-type", "text/plain");
+                res.end("Method not allowed");
+            }
+            else if (fallback) {
+                fallback();
+            }
+        };
+        try {
+            next(0);
+        }
+        catch (error) {
+            internalServerError(res, error);
+        }
+    };
+    return Router;
+}());
+exports.Router = Router;
@@ -0,0 +1,262 @@
+import { Esp32JsRequest, Esp32JsResponse } from "./http";
+
+export interface Esp32JsRouteRequest extends Esp32JsRequest {
+  /** Values of the :name placeholders and the trailing * of the route. */
+  params: { [name: string]: string };
+}
+
+export type Esp32JsRouteHandler = (
+  req: Esp32JsRouteRequest,
+  res: Esp32JsResponse
+) => void;
+
+/**
+ * Runs before the route handler. It either calls next() to continue or
+ * ends the response itself.
+ */
+export type Esp32JsMiddleware = (
+  req: Esp32JsRouteRequest,
+  res: Esp32JsResponse,
+  next: () => void
+) => void;
+
+interface Route {
+  handler: Esp32JsRouteHandler;
+  middleware: Esp32JsMiddleware[];
+  paramNames: string[];
+}
+
+interface RouteNode {
+  // static path segments
+  children: { [segment: string]: RouteNode };
+  // :name placeholder, the name is stored with the route
+  param: RouteNode | null;
+  // routes per method ("*" matches every method)
+  routes: { [method: string]: Route } | null;
+  // routes ending with * matching the remaining path
+  rest: { [method: string]: Route } | null;
+}
+
+function createNode(): RouteNode {
+  return { children: {}, param: null, routes: null, rest: null };
+}
+
+function findRoute(
+  routes: { [method: string]: Route } | null,
+  method: string
+): Route | null | undefined {
+  if (!routes) {
+    return undefined;
+  }
+  return (
+    routes[method] ||
+    (method === "HEAD" && routes["GET"]) ||
+    routes["*"] ||
+    null
+  );
+}
+
+function internalServerError(res: Esp32JsResponse, error: unknown) {
+  const errorMessage = "Internal server error: " + error;
+  console.error(errorMessage);
+  if (!res.isEnded) {
+    if (!res.headersWritten) {
+      res.setStatus(500);
+      res.headers.set("Content-type", "text/plain");
+    }
+    res.end(errorMessage);
+  }
+}
+
+/**
+ * Dispatches requests by method and path templates like
+ * /selftest/pins/:pin/:value. Templates are compiled into a trie of path
+ * segments, so the dispatch cost depends on the path length and not on the
+ * number of routes. Static segments take precedence over placeholders.
+ */
+export class Router {
+  private root = createNode();
+  private middleware: Esp32JsMiddleware[] = [];
+
+  /**
+   * Adds middleware which runs for every request passed to
+   * {@link Router.handle}, even if no route matches.
+   */
+  public use(middleware: Esp32JsMiddleware): void {
+    this.middleware.push(middleware);
+  }
+
+  /**
+   * Adds a route. The template consists of static segments, :name
+   * placeholders and an optional trailing * which matches the remaining
+   * path. Use "*" as method to match every method, GET routes also match
+   * HEAD requests.
+   */
+  public route(
+    method: string,
+    template: string,
+    handler: Esp32JsRouteHandler,
+    middleware?: Esp32JsMiddleware[]
+  ): void {
+    const segments = template.split("/");
+    const paramNames: string[] = [];
+    let node = this.root;
+    let rest = false;
+    for (let i = 1; i < segments.length; i++) {
+      const segment = segments[i];
+      if (segment === "*" && i === segments.length - 1) {
+        paramNames.push("*");
+        rest = true;
+      } else if (segment.charAt(0) === ":") {
+        paramNames.push(segment.substring(1));
+        node = node.param = node.param || createNode();
+      } else {
+        node = node.children[segment] =
+          node.children[segment] || createNode();
+      }
+    }
+
+    const route = { handler, middleware: middleware || [], paramNames };
+    if (rest) {
+      (node.rest = node.rest || {})[method.toUpperCase()] = route;
+    } else {
+      (node.routes = node.routes || {})[method.toUpperCase()] = route;
+    }
+  }
+
+  public get(
+    template: string,
+    handler: Esp32JsRouteHandler,
+    middleware?: Esp32JsMiddleware[]
+  ): void {
+    this.route("GET", template, handler, middleware);
+  }
+
+  public post(
+    template: string,
+    handler: Esp32JsRouteHandler,
+    middleware?: Esp32JsMiddleware[]
+  ): void {
+    this.route("POST", template, handler, middleware);
+  }
+
+  public put(
+    template: string,
+    handler: Esp32JsRouteHandler,
+    middleware?: Esp32JsMiddleware[]
+  ): void {
+    this.route("PUT", template, handler, middleware);
+  }
+
+  /**
+   * Finds the route of a request. Returns undefined if no template matches
+   * the path and null if templates match, but not for this method.
+   */
+  private match(
+    node: RouteNode,
+    segments: string[],
+    index: number,
+    method: string,
+    values: string[]
+  ): Route | null | undefined {
+    let found: Route | null | undefined;
+    if (index === segments.length) {
+      found = findRoute(node.routes, method);
+    } else {
+      const child = node.children[segments[index]];
+      if (child) {
+        found = this.match(child, segments, index + 1, method, values);
+      }
+      if (!found && node.param && segments[index] !== "") {
+        values.push(segments[index]);
+        const paramFound = this.match(
+          node.param,
+          segments,
+          index + 1,
+          method,
+          values
+        );
+        if (paramFound) {
+          return paramFound;
+        }
+        values.pop();
+        if (paramFound === null) {
+          found = null;
+        }
+      }
+    }
+    if (!found && node.rest) {
+      const restFound = findRoute(node.rest, method);
+      if (restFound) {
+        values.push(segments.slice(index).join("/"));
+        return restFound;
+      }
+      found = null;
+    }
+    return found;
+  }
+
+  /**
+   * Runs the middleware and the matching route. Calls fallback if no route
+   * matches, a matching path with a different method is answered with 405.
+   * Errors of handlers are answered with 500.
+   */
+  public handle(
+    req: Esp32JsRequest,
+    res: Esp32JsResponse,
+    fallback?: () => void
+  ): void {
+    const routeReq = req as Esp32JsRouteRequest;
+    const queryIndex = req.path.indexOf("?");
+    const path = queryIndex >= 0 ? req.path.substring(0, queryIndex) : req.path;
+    const values: string[] = [];
+    const route = this.match(
+      this.root,
+      path.split("/"),
+      1,
+      req.method.toUpperCase(),
+      values
+    );
+
+    routeReq.params = {};
+    if (route) {
+      for (let i = 0; i < values.length; i++) {
+        try {
+          routeReq.params[route.paramNames[i]] = decodeURIComponent(
+            values[i]
+          );
+        } catch (error) {
+          routeReq.params[route.paramNames[i]] = values[i];
+        }
+      }
+    }
+
+    const chain = route
+      ? this.middleware.concat(route.middleware)
+      : this.middleware;
+    const next = function (index: number) {
+      if (res.isEnded) {
+        return;
+      }
+      if (index < chain.length) {
+        chain[index](routeReq, res, function () {
+          next(index + 1);
+        });
+      } else if (route) {
+        route.handler(routeReq, res);
+      } else if (route === null) {
+        res.setStatus(405);
+        res.headers.set("Content-type", "text/plain");
+        res.end("Method not allowed");
+      } else if (fallback) {
+        fallback();
+      }
+    };
+
+    try {
+      next(0);
+    } catch (error) {
+      internalServerError(res, error);
+    }
+  }
+}
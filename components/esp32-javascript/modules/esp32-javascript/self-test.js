@@ -7,12 +7,10 @@ function setPinValue(pin, val) {
     console.log("Selftest: GPIO " + pin + " set to " + val);
 }
 function run() {
-    configserver_1.requestHandler.push(function (req, res) {
+    configserver_1.router.route("*", "/selftest/pins/:pin/:value", function (req, res) {
         try {
-            var match = void 0;
-            // eslint-disable-next-line no-cond-assign
-            if ((match = req.path.match(/^\/selftest\/pins\/(\d+)\/([0|1])/))) {
-                setPinValue(parseInt(match[1]), parseInt(match[2]));
+            if (/^\d+$/.test(req.params.pin) && /^[01]$/.test(req.params.value)) {
+                setPinValue(parseInt(req.params.pin), parseInt(req.params.value));
             }
             res.end();
         }
@@ -1,4 +1,4 @@
-import { requestHandler } from "./configserver";
+import { router } from "./configserver";
 
 function setPinValue(pin: number, val: number): void {
   pinMode(pin, OUTPUT);
@@ -7,12 +7,10 @@ function setPinValue(pin: number, val: number): void {
 }
 
 export function run(): void {
-  requestHandler.push((req, res) => {
+  router.route("*", "/selftest/pins/:pin/:value", function (req, res) {
     try {
-      let match;
-      // eslint-disable-next-line no-cond-assign
-      if ((match = req.path.match(/^\/selftest\/pins\/(\d+)\/([0|1])/))) {
-        setPinValue(parseInt(match[1]), parseInt(match[2]));
+      if (/^\d+$/.test(req.params.pin) && /^[01]$/.test(req.params.value)) {
+        setPinValue(parseInt(req.params.pin), parseInt(req.params.value));
       }
       res.end();
     } catch (error) {
@@ -0,0 +1,212 @@
+import { acceptsEncoding } from "./http";
+import { Esp32JsRouteHandler } from "./router";
+
+export interface Esp32JsStaticOptions {
+  /** Value of the max-age cache directive in seconds, defaults to 0. */
+  maxAge?: number;
+  /** File served for the directory itself, defaults to index.html. */
+  index?: string;
+}
+
+const contentTypes: { [extension: string]: string } = {
+  css: "text/css",
+  gif: "image/gif",
+  htm: "text/html",
+  html: "text/html",
+  ico: "image/x-icon",
+  jpeg: "image/jpeg",
+  jpg: "image/jpeg",
+  js: "application/javascript",
+  json: "application/json",
+  png: "image/png",
+  svg: "image/svg+xml",
+  txt: "text/plain",
+  woff: "font/woff",
+  woff2: "font/woff2",
+};
+
+const days = ["Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"];
+const months = [
+  "Jan",
+  "Feb",
+  "Mar",
+  "Apr",
+  "May",
+  "Jun",
+  "Jul",
+  "Aug",
+  "Sep",
+  "Oct",
+  "Nov",
+  "Dec",
+];
+
+function twoDigits(value: number) {
+  return value < 10 ? "0" + value : "" + value;
+}
+
+// formats seconds since epoch like Sun, 06 Nov 1994 08:49:37 GMT
+function httpDate(seconds: number): string {
+  const d = new Date(seconds * 1000);
+  return (
+    days[d.getUTCDay()] +
+    ", " +
+    twoDigits(d.getUTCDate()) +
+    " " +
+    months[d.getUTCMonth()] +
+    " " +
+    d.getUTCFullYear() +
+    " " +
+    twoDigits(d.getUTCHours()) +
+    ":" +
+    twoDigits(d.getUTCMinutes()) +
+    ":" +
+    twoDigits(d.getUTCSeconds()) +
+    " GMT"
+  );
+}
+
+// parses a single byte range, returns null if the range is not satisfiable
+function parseRange(
+  range: string,
+  size: number
+): { offset: number; length: number } | null | undefined {
+  const match = /^bytes=(\d*)-(\d*)$/.exec(range);
+  if (!match || (match[1] === "" && match[2] === "")) {
+    // multiple or malformed ranges are ignored
+    return undefined;
+  }
+  let first: number;
+  let last: number;
+  if (match[1] === "") {
+    // suffix range with the number of bytes at the end
+    first = Math.max(size - parseInt(match[2], 10), 0);
+    last = size - 1;
+  } else {
+    first = parseInt(match[1], 10);
+    last =
+      match[2] === ""
+        ? size - 1
+        : Math.min(parseInt(match[2], 10), size - 1);
+  }
+  if (first >= size || last < first) {
+    return null;
+  }
+  return { offset: first, length: last - first + 1 };
+}
+
+/**
+ * Serves the files of a directory in /modules or /data, to be used with a
+ * route ending with *, e.g. router.get("/static/*", serveStatic("/data/www")).
+ * A precompressed variant (file.gz) is preferred if the client accepts gzip.
+ * Responses carry ETag and Last-Modified, so revalidations get 304, and
+ * single byte ranges are supported. The files are streamed natively.
+ */
+export function serveStatic(
+  root: string,
+  options?: Esp32JsStaticOptions
+): Esp32JsRouteHandler {
+  const maxAge = (options && options.maxAge) || 0;
+  const index = (options && options.index) || "index.html";
+
+  return function (req, res) {
+    const name = req.params["*"] || index;
+    if (!/^[A-Za-z0-9._\-/]+$/.test(name) || name.indexOf("..") >= 0) {
+      res.setStatus(404, "Not found");
+      res.end("Not found");
+      return;
+    }
+
+    const path = root + "/" + name;
+    let file = path;
+    let stat = fileStat(path);
+    let gzip = false;
+    const gzipStat = fileStat(path + ".gz");
+    if (
+      gzipStat &&
+      acceptsEncoding(req.headers.get("accept-encoding"), "gzip")
+    ) {
+      file = path + ".gz";
+      stat = gzipStat;
+      gzip = true;
+    }
+    if (!stat) {
+      res.setStatus(404, "Not found");
+      res.end("Not found");
+      return;
+    }
+
+    const etag =
+      '"' +
+      stat.size.toString(16) +
+      "-" +
+      stat.mtime.toString(16) +
+      (gzip ? "-gz" : "") +
+      '"';
+    const lastModified = stat.mtime > 0 ? httpDate(stat.mtime) : null;
+    const extension = name.substring(name.lastIndexOf(".") + 1).toLowerCase();
+
+    res.headers.set("etag", etag);
+    if (lastModified) {
+      res.headers.set("last-modified", lastModified);
+    }
+    res.headers.set("cache-control", "max-age=" + maxAge);
+    if (gzipStat) {
+      res.headers.set("vary", "accept-encoding");
+    }
+
+    const ifNoneMatch = req.headers.get("if-none-match");
+    const notModified =
+      ifNoneMatch !== null
+        ? ifNoneMatch === "*" ||
+          ifNoneMatch
+            .split(",")
+            .some((tag) => tag.trim().replace(/^W\//, "") === etag)
+        : lastModified !== null &&
+          req.headers.get("if-modified-since") === lastModified;
+    if (notModified) {
+      res.setStatus(304);
+      res.end();
+      return;
+    }
+
+    res.headers.set(
+      "content-type",
+      contentTypes[extension] || "application/octet-stream"
+    );
+    if (gzip) {
+      res.headers.set("content-encoding", "gzip");
+    }
+    res.headers.set("accept-ranges", "bytes");
+
+    let offset = 0;
+    let length = stat.size;
+    const rangeHeader = req.headers.get("range");
+    const range = rangeHeader ? parseRange(rangeHeader, stat.size) : undefined;
+    if (range === null) {
+      res.setStatus(416);
+      res.headers.set("content-range", "bytes */" + stat.size);
+      res.headers.set("content-length", "0");
+      res.end();
+      return;
+    } else if (range) {
+      offset = range.offset;
+      length = range.length;
+      res.setStatus(206);
+      res.headers.set(
+        "content-range",
+        "bytes " + offset + "-" + (offset + length - 1) + "/" + stat.size
+      );
+    }
+
+    res.headers.set("content-length", "" + length);
+    if (req.method === "HEAD") {
+      res.end();
+    } else if (!res.sendFile(file, offset, length)) {
+      // removed since it was checked above
+      res.setStatus(404, "Not found");
+      res.headers.set("content-length", "0");
+      res.end();
+    }
+  };
+}
@@ -1,42 +1,153 @@
+var __extends = (this && this.__extends) || (function () {
+    var extendStatics = function (d, b) {
+        extendStatics = Object.setPrototypeOf ||
+            ({ __proto__: [] } instanceof Array && function (d, b) { d.__proto__ = b; }) ||
+            function (d, b) { for (var p in b) if (b.hasOwnProperty(p)) d[p] = b[p]; };
+        return extendStatics(d, b);
+    };
+    return function (d, b) {
+        extendStatics(d, b);
+        function __() { this.constructor = d; }
+        d.prototype = b === null ? Object.create(b) : (__.prototype = b.prototype, new __());
+    };
+})();
 Object.defineProperty(exports, "__esModule", { value: true });
-exports.StringBuffer = void 0;
-var StringBuffer = /** @class */ (function () {
-    function StringBuffer(s) {
-        this.content = [];
+exports.StringBuffer = exports.ByteBuffer = void 0;
+/**
+ * Segmented byte buffer for protocol data. Appended data is kept as a list
+ * of segments instead of being joined, the search across segment
+ * boundaries is done natively, slices share the segments and consumed
+ * bytes are dropped from the front without copying the rest.
+ * Strings are stored with their raw bytes as received by the sockets, all
+ * offsets are byte offsets.
+ */
+var ByteBuffer = /** @class */ (function () {
+    function ByteBuffer(data) {
+        this.segments = [];
+        // bytes of the first segment which were consumed already
+        this.offset = 0;
         this.length = 0;
-        if (typeof s === "string") {
-            this.append(s);
+        if (data !== undefined) {
+            this.append(data);
         }
     }
-    StringBuffer.prototype.indexOf = function (searchString, position) {
-        return this.toString().indexOf(searchString, position);
+    /**
+     * Appends data to the end. Uint8Arrays are appended without copying, so
+     * they must not be changed afterwards.
+     */
+    ByteBuffer.prototype.append = function (data) {
+        if (data instanceof ByteBuffer) {
+            this.appendSegments(data.segmentsBetween(0, data.length));
+        }
+        else {
+            this.length += el_byteBufferAppend(this.segments, data);
+        }
+        return this;
     };
-    StringBuffer.prototype.toLowerCase = function () {
-        return this.toString().toLowerCase();
+    /**
+     * Returns the offset of the first occurrence of a string, bytes or a
+     * single byte value at or after position, or -1.
+     */
+    ByteBuffer.prototype.indexOf = function (search, position) {
+        if (position === void 0) { position = 0; }
+        return el_byteBufferIndexOf(this.segments, this.offset, search, Math.max(position, 0));
     };
-    StringBuffer.prototype.toUpperCase = function () {
-        return this.toString().toUpperCase();
+    /** Returns the bytes from start to end, without copying if possible. */
+    ByteBuffer.prototype.toBytes = function (start, end) {
+        if (start === void 0) { start = 0; }
+        if (end === void 0) { end = this.length; }
+        start = this.clampOffset(start);
+        end = Math.max(this.clampOffset(end), start);
+        var first = this.segments[0];
+        if (first && this.offset + end <= first.length) {
+            return first.subarray(this.offset + start, this.offset + end);
+        }
+        return el_byteBufferRead(this.segments, this.offset, start, end, false);
+    };
+    ByteBuffer.prototype.toString = function (start, end) {
+        if (start === void 0) { start = 0; }
+        if (end === void 0) { end = this.length; }
+        start = this.clampOffset(start);
+        end = Math.max(this.clampOffset(end), start);
+        return el_byteBufferRead(this.segments, this.offset, start, end, true);
     };
-    StringBuffer.prototype.toString = function () {
-        if (this.content.length === 1) {
-            return this.content[0].toString();
+    /** Returns a buffer of the bytes from start to end sharing the segments. */
+    ByteBuffer.prototype.slice = function (start, end) {
+        if (start === void 0) { start = 0; }
+        if (end === void 0) { end = this.length; }
+        return this.sliceInto(new ByteBuffer(), start, end);
+    };
+    /** Drops count bytes from the front. */
+    ByteBuffer.prototype.consume = function (count) {
+        count = Math.min(Math.max(count, 0), this.length);
+        var offset = this.offset + count;
+        while (this.segments.length > 0 && offset >= this.segments[0].length) {
+            offset -= this.segments[0].length;
+            this.segments.shift();
+        }
+        this.offset = offset;
+        this.length -= count;
+    };
+    ByteBuffer.prototype.sliceInto = function (target, start, end) {
+        start = this.clampOffset(start);
+        end = Math.max(this.clampOffset(end), start);
+        target.appendSegments(this.segmentsBetween(start, end));
+        return target;
+    };
+    ByteBuffer.prototype.appendSegments = function (segments) {
+        for (var i = 0; i < segments.length; i++) {
+            this.length += el_byteBufferAppend(this.segments, segments[i]);
+        }
+    };
+    ByteBuffer.prototype.clampOffset = function (offset) {
+        return Math.min(Math.max(offset, 0), this.length);
+    };
+    // views of the segments between start and end
+    ByteBuffer.prototype.segmentsBetween = function (start, end) {
+        var views = [];
+        var segmentStart = -this.offset;
+        for (var i = 0; i < this.segments.length && segmentStart < end; i++) {
+            var segment = this.segments[i];
+            var segmentEnd = segmentStart + segment.length;
+            if (start < segmentEnd) {
+                var from = Math.max(start - segmentStart, 0);
+                var to = Math.min(end - segmentStart, segment.length);
+                views.push(from === 0 && to === segment.length
+                    ? segment
+                    : segment.subarray(from, to));
+            }
+            segmentStart = segmentEnd;
         }
-        var s = this.content.join("");
-        this.content = [s];
-        return s;
+        return views;
     };
+    return ByteBuffer;
+}());
+exports.ByteBuffer = ByteBuffer;
+/**
+ * String like interface of {@link ByteBuffer} which protocol code used
+ * before the native buffer. Offsets and length are in bytes.
+ */
+var StringBuffer = /** @class */ (function (_super) {
+    __extends(StringBuffer, _super);
+    function StringBuffer() {
+        return _super !== null && _super.apply(this, arguments) || this;
+    }
     StringBuffer.prototype.append = function () {
-        var _this = this;
         var s = [];
         for (var _i = 0; _i < arguments.length; _i++) {
             s[_i] = arguments[_i];
         }
-        s.forEach(function (str) {
-            _this.length += str.length;
-            _this.content.push(str);
-        });
+        for (var i = 0; i < s.length; i++) {
+            _super.prototype.append.call(this, s[i]);
+        }
         return this;
     };
+    StringBuffer.prototype.toLowerCase = function () {
+        return this.toString().toLowerCase();
+    };
+    StringBuffer.prototype.toUpperCase = function () {
+        return this.toString().toUpperCase();
+    };
     StringBuffer.prototype.substring = function (s, e) {
         if (typeof e === "undefined") {
             e = this.length;
@@ -46,52 +157,7 @@ var StringBuffer = /** @class */ (function () {
             s = e;
             e = b;
         }
-        if (s > this.length) {
-            s = this.length;
-        }
-        if (e > this.length) {
-            e = this.length;
-        }
-        if (s < 0) {
-            s = 0;
-        }
-        if (e < 0) {
-            e = 0;
-        }
-        var ns = new StringBuffer();
-        if (this.content.length > 0) {
-            var accs = 0;
-            var i = 0;
-            for (i = 0; i < this.content.length; i++) {
-                if (s <= accs + this.content[i].length) {
-                    break;
-                }
-                else {
-                    accs += this.content[i].length;
-                }
-            }
-            var acce = 0;
-            var ei = 0;
-            for (ei = 0; ei < this.content.length; ei++) {
-                if (e <= acce + this.content[ei].length) {
-                    break;
-                }
-                else {
-                    acce += this.content[ei].length;
-                }
-            }
-            if (i === ei) {
-                ns.append(this.content[i].substring(s - accs, e - acce));
-            }
-            else {
-                ns.append(this.content[i].substring(s - accs));
-                this.content.slice(i + 1, ei).forEach(function (e) {
-                    ns.append(e);
-                });
-                ns.append(this.content[ei].substring(0, e - acce));
-            }
-        }
-        return ns;
+        return this.sliceInto(new StringBuffer(), s, e);
     };
     StringBuffer.prototype.substr = function (s, l) {
         if (s < 0) {
@@ -106,5 +172,5 @@ var StringBuffer = /** @class */ (function () {
         return this.substring(s, s + l);
     };
     return StringBuffer;
-}());
+}(ByteBuffer));
 exports.StringBuffer = StringBuffer;
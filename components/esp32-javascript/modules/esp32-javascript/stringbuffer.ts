@@ -1,45 +1,146 @@
-export class StringBuffer {
-  private content: (string | StringBuffer)[];
-  public length: number;
+/**
+ * Segmented byte buffer for protocol data. Appended data is kept as a list
+ * of segments instead of being joined, the search across segment
+ * boundaries is done natively, slices share the segments and consumed
+ * bytes are dropped from the front without copying the rest.
+ * Strings are stored with their raw bytes as received by the sockets, all
+ * offsets are byte offsets.
+ */
+export class ByteBuffer {
+  private segments: Uint8Array[] = [];
+  // bytes of the first segment which were consumed already
+  private offset = 0;
+  public length = 0;
 
-  constructor(s?: string) {
-    this.content = [];
-    this.length = 0;
+  constructor(data?: string | Uint8Array) {
+    if (data !== undefined) {
+      this.append(data);
+    }
+  }
 
-    if (typeof s === "string") {
-      this.append(s);
+  /**
+   * Appends data to the end. Uint8Arrays are appended without copying, so
+   * they must not be changed afterwards.
+   */
+  public append(data: string | Uint8Array | ByteBuffer): this {
+    if (data instanceof ByteBuffer) {
+      this.appendSegments(data.segmentsBetween(0, data.length));
+    } else {
+      this.length += el_byteBufferAppend(this.segments, data);
     }
+    return this;
   }
 
-  public indexOf(searchString: string, position?: number): number {
-    return this.toString().indexOf(searchString, position);
+  /**
+   * Returns the offset of the first occurrence of a string, bytes or a
+   * single byte value at or after position, or -1.
+   */
+  public indexOf(search: string | Uint8Array | number, position = 0): number {
+    return el_byteBufferIndexOf(
+      this.segments,
+      this.offset,
+      search,
+      Math.max(position, 0)
+    );
   }
 
-  public toLowerCase(): string {
-    return this.toString().toLowerCase();
+  /** Returns the bytes from start to end, without copying if possible. */
+  public toBytes(start = 0, end = this.length): Uint8Array {
+    start = this.clampOffset(start);
+    end = Math.max(this.clampOffset(end), start);
+    const first = this.segments[0];
+    if (first && this.offset + end <= first.length) {
+      return first.subarray(this.offset + start, this.offset + end);
+    }
+    return el_byteBufferRead(this.segments, this.offset, start, end, false);
   }
 
-  public toUpperCase(): string {
-    return this.toString().toUpperCase();
+  public toString(start = 0, end = this.length): string {
+    start = this.clampOffset(start);
+    end = Math.max(this.clampOffset(end), start);
+    return el_byteBufferRead(this.segments, this.offset, start, end, true);
   }
 
-  public toString(): string {
-    if (this.content.length === 1) {
-      return this.content[0].toString();
+  /** Returns a buffer of the bytes from start to end sharing the segments. */
+  public slice(start = 0, end = this.length): ByteBuffer {
+    return this.sliceInto(new ByteBuffer(), start, end);
+  }
+
+  /** Drops count bytes from the front. */
+  public consume(count: number): void {
+    count = Math.min(Math.max(count, 0), this.length);
+    let offset = this.offset + count;
+    while (this.segments.length > 0 && offset >= this.segments[0].length) {
+      offset -= this.segments[0].length;
+      this.segments.shift();
+    }
+    this.offset = offset;
+    this.length -= count;
+  }
+
+  protected sliceInto<T extends ByteBuffer>(
+    target: T,
+    start: number,
+    end: number
+  ): T {
+    start = this.clampOffset(start);
+    end = Math.max(this.clampOffset(end), start);
+    target.appendSegments(this.segmentsBetween(start, end));
+    return target;
+  }
+
+  private appendSegments(segments: Uint8Array[]): void {
+    for (let i = 0; i < segments.length; i++) {
+      this.length += el_byteBufferAppend(this.segments, segments[i]);
+    }
+  }
+
+  private clampOffset(offset: number): number {
+    return Math.min(Math.max(offset, 0), this.length);
+  }
+
+  // views of the segments between start and end
+  private segmentsBetween(start: number, end: number): Uint8Array[] {
+    const views: Uint8Array[] = [];
+    let segmentStart = -this.offset;
+    for (let i = 0; i < this.segments.length && segmentStart < end; i++) {
+      const segment = this.segments[i];
+      const segmentEnd = segmentStart + segment.length;
+      if (start < segmentEnd) {
+        const from = Math.max(start - segmentStart, 0);
+        const to = Math.min(end - segmentStart, segment.length);
+        views.push(
+          from === 0 && to === segment.length
+            ? segment
+            : segment.subarray(from, to)
+        );
+      }
+      segmentStart = segmentEnd;
     }
-    const s = this.content.join("");
-    this.content = [s];
-    return s;
+    return views;
   }
+}
 
-  public append(...s: (StringBuffer | string)[]): StringBuffer {
-    s.forEach((str) => {
-      this.length += str.length;
-      this.content.push(str);
-    });
+/**
+ * String like interface of {@link ByteBuffer} which protocol code used
+ * before the native buffer. Offsets and length are in bytes.
+ */
+export class StringBuffer extends ByteBuffer {
+  public append(...s: (StringBuffer | string)[]): this {
+    for (let i = 0; i < s.length; i++) {
+      super.append(s[i]);
+    }
     return this;
   }
 
+  public toLowerCase(): string {
+    return this.toString().toLowerCase();
+  }
+
+  public toUpperCase(): string {
+    return this.toString().toUpperCase();
+  }
+
   public substring(s: number, e?: number): StringBuffer {
     if (typeof e === "undefined") {
       e = this.length;
@@ -49,50 +150,7 @@ export class StringBuffer {
       s = e;
       e = b;
     }
-    if (s > this.length) {
-      s = this.length;
-    }
-    if (e > this.length) {
-      e = this.length;
-    }
-    if (s < 0) {
-      s = 0;
-    }
-    if (e < 0) {
-      e = 0;
-    }
-    const ns = new StringBuffer();
-    if (this.content.length > 0) {
-      let accs = 0;
-      let i = 0;
-      for (i = 0; i < this.content.length; i++) {
-        if (s <= accs + this.content[i].length) {
-          break;
-        } else {
-          accs += this.content[i].length;
-        }
-      }
-      let acce = 0;
-      let ei = 0;
-      for (ei = 0; ei < this.content.length; ei++) {
-        if (e <= acce + this.content[ei].length) {
-          break;
-        } else {
-          acce += this.content[ei].length;
-        }
-      }
-      if (i === ei) {
-        ns.append(this.content[i].substring(s - accs, e - acce));
-      } else {
-        ns.append(this.content[i].substring(s - accs));
-        this.content.slice(i + 1, ei).forEach(function (e) {
-          ns.append(e);
-        });
-
-        ns.append(this.content[ei].substring(0, e - acce));
-      }
-    }
-    return ns;
+    return this.sliceInto(new StringBuffer(), s, e);
   }
 
   public substr(s: number, l: number): StringBuffer {
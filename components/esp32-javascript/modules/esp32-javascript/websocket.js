@@ -0,0 +1,333 @@
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.connectWebSocket = exports.acceptWebSocket = exports.Esp32JsWebSocket = void 0;
+var socketEvents = require("socket-events");
+var stringbuffer_1 = require("./stringbuffer");
+var opcodeText = 1;
+var opcodeBinary = 2;
+var opcodeClose = 8;
+var opcodePing = 9;
+var opcodePong = 10;
+// time to wait for the close frame of the peer after sending one
+var closeTimeout = 5000;
+// strings are encoded explicitly, duktape keeps surrogate pairs as CESU-8
+var textEncoder = new TextEncoder();
+/**
+ * A websocket connection (RFC 6455) created by {@link acceptWebSocket} or
+ * {@link connectWebSocket}. Frames are parsed and masked natively, text
+ * messages are received as strings and binary messages as Uint8Array.
+ */
+var Esp32JsWebSocket = /** @class */ (function () {
+    function Esp32JsWebSocket(client, options) {
+        var _this = this;
+        this.client = client;
+        /** 0 connecting, 1 open, 2 closing, 3 closed */
+        this.readyState = 0;
+        /** Bytes of sent messages which are not written to the socket yet. */
+        this.bufferedAmount = 0;
+        this.onopen = null;
+        this.onmessage = null;
+        this.onclose = null;
+        this.onerror = null;
+        /** Gets called when bufferedAmount dropped below highWaterMark after send() returned false. */
+        this.ondrain = null;
+        this.socket = null;
+        this.parser = 0;
+        this.parsing = false;
+        this.drainPending = false;
+        this.closeCode = 1006;
+        this.closeReason = "";
+        this.pingTimer = -1;
+        this.closeTimer = -1;
+        this.handler = {
+            onMessage: function (data) {
+                if (_this.readyState === 1 && _this.onmessage) {
+                    _this.onmessage(data);
+                }
+            },
+            onPing: function (payload) {
+                if (_this.readyState === 1) {
+                    _this.sendFrame(opcodePong, payload);
+                }
+            },
+            onClose: function (code, reason) {
+                _this.closeCode = code;
+                _this.closeReason = reason;
+                if (_this.readyState === 1) {
+                    // echo the close frame before closing the connection
+                    _this.readyState = 2;
+                    _this.sendFrame(opcodeClose, closePayload(code === 1005 ? 1000 : code), function () { return _this.destroy(); });
+                }
+                else {
+                    _this.destroy();
+                }
+            },
+        };
+        this.maxMessageSize = (options && options.maxMessageSize) || 16 * 1024;
+        this.pingInterval =
+            options && typeof options.pingInterval === "number"
+                ? options.pingInterval
+                : 30000;
+        this.highWaterMark = (options && options.highWaterMark) || 4 * 1024;
+        this.maxBufferedAmount =
+            (options && options.maxBufferedAmount) || 32 * 1024;
+    }
+    /**
+     * Starts exchanging frames on a connection after the handshake.
+     *
+     * @param data Data received after the handshake.
+     */
+    Esp32JsWebSocket.prototype.attach = function (socket, data) {
+        var _this = this;
+        this.socket = socket;
+        this.parser = el_createWebSocketParser(this.client, this.maxMessageSize);
+        this.readyState = 1;
+        socket.onData = function (data) { return _this.receive(data); };
+        socket.onClose = function () { return _this.closed(); };
+        if (this.pingInterval > 0) {
+            // any received data resets the read timeout, so a peer which does not
+            // answer two pings in a row is considered gone
+            socket.setReadTimeout(this.pingInterval * 2);
+            this.pingTimer = setInterval(function () { return _this.ping(); }, this.pingInterval);
+        }
+        if (this.onopen) {
+            this.onopen();
+        }
+        if (data) {
+            this.receive(data);
+        }
+    };
+    /**
+     * Sends a text (string) or binary (Uint8Array) message. Returns false if
+     * the message was not sent because the connection is not open, or if more
+     * than highWaterMark bytes wait to be written. Stop sending then until
+     * ondrain gets called, a connection exceeding maxBufferedAmount is dropped.
+     */
+    Esp32JsWebSocket.prototype.send = function (data) {
+        if (this.readyState !== 1) {
+            return false;
+        }
+        this.sendFrame(typeof data === "string" ? opcodeText : opcodeBinary, data);
+        if (this.bufferedAmount > this.maxBufferedAmount) {
+            console.error("Websocket dropped, " + this.bufferedAmount + " bytes were not written");
+            this.closeCode = 1008;
+            this.closeReason = "Send buffer full";
+            this.destroy();
+            return false;
+        }
+        if (this.bufferedAmount > this.highWaterMark) {
+            this.drainPending = true;
+            return false;
+        }
+        return true;
+    };
+    Esp32JsWebSocket.prototype.ping = function (data) {
+        if (this.readyState === 1) {
+            this.sendFrame(opcodePing, data);
+        }
+    };
+    /**
+     * Sends a close frame and closes the connection when the peer answered
+     * it or after a timeout.
+     */
+    Esp32JsWebSocket.prototype.close = function (code, reason) {
+        var _this = this;
+        if (this.readyState === 0) {
+            this.destroy();
+        }
+        else if (this.readyState === 1) {
+            this.readyState = 2;
+            this.closeCode = code || 1000;
+            this.closeReason = reason || "";
+            this.sendFrame(opcodeClose, closePayload(this.closeCode, reason));
+            this.closeTimer = setTimeout(function () { return _this.destroy(); }, closeTimeout);
+        }
+    };
+    /** Stops reading from the connection until resume is called. */
+    Esp32JsWebSocket.prototype.pause = function () {
+        if (this.socket) {
+            this.socket.readPaused = true;
+        }
+    };
+    Esp32JsWebSocket.prototype.resume = function () {
+        if (this.socket) {
+            this.socket.readPaused = false;
+        }
+    };
+    /** Closes the connection without a close handshake. */
+    Esp32JsWebSocket.prototype.destroy = function () {
+        if (this.socket) {
+            socketEvents.closeSocket(this.socket);
+        }
+        else {
+            this.closed();
+        }
+    };
+    Esp32JsWebSocket.prototype.receive = function (data) {
+        var _this = this;
+        this.parsing = true;
+        var code = el_executeWebSocketParser(this.parser, data, this.handler);
+        this.parsing = false;
+        if (this.readyState === 3) {
+            // closed by a handler while parsing
+            this.freeParser();
+        }
+        else if (code > 0) {
+            console.error("Websocket protocol error " + code);
+            this.readyState = 2;
+            this.closeCode = code;
+            this.sendFrame(opcodeClose, closePayload(code), function () { return _this.destroy(); });
+        }
+    };
+    Esp32JsWebSocket.prototype.sendFrame = function (opcode, data, written) {
+        var _this = this;
+        var socket = this.socket;
+        var frame = el_encodeWebSocketFrame(opcode, typeof data === "string" ? textEncoder.encode(data) : data, this.client);
+        this.bufferedAmount += frame.length;
+        socket.write(frame);
+        socket.flush(function () {
+            _this.bufferedAmount -= frame.length;
+            if (written) {
+                written();
+            }
+            if (_this.drainPending && _this.bufferedAmount <= _this.highWaterMark) {
+                _this.drainPending = false;
+                if (_this.ondrain && _this.readyState === 1) {
+                    _this.ondrain();
+                }
+            }
+        });
+    };
+    Esp32JsWebSocket.prototype.freeParser = function () {
+        if (this.parser) {
+            el_freeWebSocketParser(this.parser);
+            this.parser = 0;
+        }
+    };
+    Esp32JsWebSocket.prototype.closed = function () {
+        if (this.readyState === 3) {
+            return;
+        }
+        this.readyState = 3;
+        clearInterval(this.pingTimer);
+        clearTimeout(this.closeTimer);
+        if (!this.parsing) {
+            this.freeParser();
+        }
+        if (this.onclose) {
+            this.onclose(this.closeCode, this.closeReason);
+        }
+    };
+    return Esp32JsWebSocket;
+}());
+exports.Esp32JsWebSocket = Esp32JsWebSocket;
+function closePayload(code, reason) {
+    var encoded = textEncoder.encode(reason || "");
+    var payload = new Uint8Array(2 + Math.min(encoded.length, 123));
+    payload[0] = code >> 8;
+    payload[1] = code & 0xff;
+    payload.set(encoded.subarray(0, payload.length - 2), 2);
+    return payload;
+}
+/**
+ * Completes the handshake of a websocket upgrade request received by
+ * httpServer. Requests which are no valid upgrade requests are answered
+ * with 400 and null is returned.
+ */
+function acceptWebSocket(req, res, options) {
+    var key = req.headers.get("sec-websocket-key");
+    if (req.method !== "GET" ||
+        !/(^|[ ,])websocket($|[ ,])/i.test(req.headers.get("upgrade") || "") ||
+        !/(^|[ ,])upgrade($|[ ,])/i.test(req.headers.get("connection") || "") ||
+        !key) {
+        res.setStatus(400);
+        res.end("Websocket upgrade expected");
+        return null;
+    }
+    if (req.headers.get("sec-websocket-version") !== "13") {
+        res.setStatus(426);
+        res.headers.set("sec-websocket-version", "13");
+        res.end();
+        return null;
+    }
+    res.headers.set("upgrade", "websocket");
+    res.headers.set("connection", "Upgrade");
+    res.headers.set("sec-websocket-accept", el_webSocketAccept(key));
+    var ws = new Esp32JsWebSocket(false, options);
+    ws.attach(res.upgrade());
+    return ws;
+}
+exports.acceptWebSocket = acceptWebSocket;
+/**
+ * Opens a websocket connection to a ws:// or wss:// url. onopen gets
+ * called after the handshake, onerror if it failed.
+ */
+function connectWebSocket(url, options) {
+    var match = /^(wss?):\/\/([^/:?#]+)(?::(\d+))?([^#]*)$/.exec(url);
+    if (!match) {
+        throw Error("Invalid websocket url " + url);
+    }
+    var ssl = match[1] === "wss";
+    var host = match[2];
+    var port = match[3] || (ssl ? "443" : "80");
+    var path = match[4] || "/";
+    var ws = new Esp32JsWebSocket(true, options);
+    var key = el_createWebSocketKey();
+    var head = new stringbuffer_1.ByteBuffer();
+    var connectFailed = function (message) {
+        if (ws.readyState === 0) {
+            ws.readyState = 3;
+            if (ws.onerror) {
+                ws.onerror(message);
+            }
+            if (ws.onclose) {
+                ws.onclose(1006, "");
+            }
+        }
+    };
+    var fail = function (message) {
+        connectFailed(message);
+        socketEvents.closeSocket(socket);
+    };
+    var socket = socketEvents.sockConnect(ssl, host, port, function () {
+        if (ws.readyState !== 0) {
+            // closed while connecting
+            socketEvents.closeSocket(socket);
+            return;
+        }
+        socket.write("GET " + path + " HTTP/1.1\r\nhost: " + host + ":" + port + "\r\nupgrade: websocket\r\nconnection: Upgrade\r\nsec-websocket-key: " + key + "\r\nsec-websocket-version: 13\r\n\r\n");
+        socket.flush();
+    }, function (data) {
+        if (ws.readyState !== 0) {
+            socketEvents.closeSocket(socket);
+            return;
+        }
+        // only the new data and the possible start of the delimiter before it
+        var scanFrom = Math.max(head.length - 3, 0);
+        head.append(data);
+        var end = head.indexOf("\r\n\r\n", scanFrom);
+        if (end < 0) {
+            if (head.length > 4096) {
+                fail("Websocket handshake response too large");
+            }
+            return;
+        }
+        var lines = head.toString(0, end).split("\r\n");
+        var accept = el_webSocketAccept(key);
+        var accepted = lines.some(function (line) {
+            var colon = line.indexOf(":");
+            return (line.substring(0, colon).trim().toLowerCase() ===
+                "sec-websocket-accept" && line.substring(colon + 1).trim() === accept);
+        });
+        if (!/^HTTP\/1\.1 101/.test(lines[0]) || !accepted) {
+            fail("Websocket handshake failed: " + lines[0]);
+            return;
+        }
+        ws.attach(socket, head.toString(end + 4));
+    }, function () {
+        fail("Websocket connection to " + url + " failed");
+    }, function () {
+        connectFailed("Websocket connection to " + url + " closed");
+    });
+    return ws;
+}
+exports.connectWebSocket = connectWebSocket;
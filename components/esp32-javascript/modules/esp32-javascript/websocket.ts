@@ -0,0 +1,390 @@
+import socketEvents = require("socket-events");
+import { Esp32JsRequest, Esp32JsResponse } from "./http";
+import { ByteBuffer } from "./stringbuffer";
+
+const opcodeText = 1;
+const opcodeBinary = 2;
+const opcodeClose = 8;
+const opcodePing = 9;
+const opcodePong = 10;
+
+// time to wait for the close frame of the peer after sending one
+const closeTimeout = 5000;
+// strings are encoded explicitly, duktape keeps surrogate pairs as CESU-8
+const textEncoder = new TextEncoder();
+
+export interface Esp32JsWebSocketOptions {
+  /** Maximum size of a received message in bytes, defaults to 16 KB. */
+  maxMessageSize?: number;
+  /** Interval of keepalive pings in milliseconds, 0 disables them. */
+  pingInterval?: number;
+  /** send() returns false while more bytes wait to be written, defaults to 4 KB. */
+  highWaterMark?: number;
+  /** The connection is dropped if more bytes wait to be written, defaults to 32 KB. */
+  maxBufferedAmount?: number;
+}
+
+/**
+ * A websocket connection (RFC 6455) created by {@link acceptWebSocket} or
+ * {@link connectWebSocket}. Frames are parsed and masked natively, text
+ * messages are received as strings and binary messages as Uint8Array.
+ */
+export class Esp32JsWebSocket {
+  /** 0 connecting, 1 open, 2 closing, 3 closed */
+  public readyState = 0;
+  /** Bytes of sent messages which are not written to the socket yet. */
+  public bufferedAmount = 0;
+  public onopen: (() => void) | null = null;
+  public onmessage: ((data: string | Uint8Array) => void) | null = null;
+  public onclose: ((code: number, reason: string) => void) | null = null;
+  public onerror: ((message: string) => void) | null = null;
+  /** Gets called when bufferedAmount dropped below highWaterMark after send() returned false. */
+  public ondrain: (() => void) | null = null;
+
+  private socket: socketEvents.Esp32JsSocket | null = null;
+  private parser = 0;
+  private parsing = false;
+  private drainPending = false;
+  private closeCode = 1006;
+  private closeReason = "";
+  private pingTimer = -1;
+  private closeTimer = -1;
+  private maxMessageSize: number;
+  private pingInterval: number;
+  private highWaterMark: number;
+  private maxBufferedAmount: number;
+  private handler = {
+    onMessage: (data: string | Uint8Array) => {
+      if (this.readyState === 1 && this.onmessage) {
+        this.onmessage(data);
+      }
+    },
+    onPing: (payload: Uint8Array) => {
+      if (this.readyState === 1) {
+        this.sendFrame(opcodePong, payload);
+      }
+    },
+    onClose: (code: number, reason: string) => {
+      this.closeCode = code;
+      this.closeReason = reason;
+      if (this.readyState === 1) {
+        // echo the close frame before closing the connection
+        this.readyState = 2;
+        this.sendFrame(
+          opcodeClose,
+          closePayload(code === 1005 ? 1000 : code),
+          () => this.destroy()
+        );
+      } else {
+        this.destroy();
+      }
+    },
+  };
+
+  constructor(private client: boolean, options?: Esp32JsWebSocketOptions) {
+    this.maxMessageSize = (options && options.maxMessageSize) || 16 * 1024;
+    this.pingInterval =
+      options && typeof options.pingInterval === "number"
+        ? options.pingInterval
+        : 30000;
+    this.highWaterMark = (options && options.highWaterMark) || 4 * 1024;
+    this.maxBufferedAmount =
+      (options && options.maxBufferedAmount) || 32 * 1024;
+  }
+
+  /**
+   * Starts exchanging frames on a connection after the handshake.
+   *
+   * @param data Data received after the handshake.
+   */
+  public attach(socket: socketEvents.Esp32JsSocket, data?: string): void {
+    this.socket = socket;
+    this.parser = el_createWebSocketParser(this.client, this.maxMessageSize);
+    this.readyState = 1;
+    socket.onData = (data: string) => this.receive(data);
+    socket.onClose = () => this.closed();
+    if (this.pingInterval > 0) {
+      // any received data resets the read timeout, so a peer which does not
+      // answer two pings in a row is considered gone
+      socket.setReadTimeout(this.pingInterval * 2);
+      this.pingTimer = setInterval(() => this.ping(), this.pingInterval);
+    }
+    if (this.onopen) {
+      this.onopen();
+    }
+    if (data) {
+      this.receive(data);
+    }
+  }
+
+  /**
+   * Sends a text (string) or binary (Uint8Array) message. Returns false if
+   * the message was not sent because the connection is not open, or if more
+   * than highWaterMark bytes wait to be written. Stop sending then until
+   * ondrain gets called, a connection exceeding maxBufferedAmount is dropped.
+   */
+  public send(data: string | Uint8Array): boolean {
+    if (this.readyState !== 1) {
+      return false;
+    }
+    this.sendFrame(typeof data === "string" ? opcodeText : opcodeBinary, data);
+    if (this.bufferedAmount > this.maxBufferedAmount) {
+      console.error(
+        `Websocket dropped, ${this.bufferedAmount} bytes were not written`
+      );
+      this.closeCode = 1008;
+      this.closeReason = "Send buffer full";
+      this.destroy();
+      return false;
+    }
+    if (this.bufferedAmount > this.highWaterMark) {
+      this.drainPending = true;
+      return false;
+    }
+    return true;
+  }
+
+  public ping(data?: string | Uint8Array): void {
+    if (this.readyState === 1) {
+      this.sendFrame(opcodePing, data);
+    }
+  }
+
+  /**
+   * Sends a close frame and closes the connection when the peer answered
+   * it or after a timeout.
+   */
+  public close(code?: number, reason?: string): void {
+    if (this.readyState === 0) {
+      this.destroy();
+    } else if (this.readyState === 1) {
+      this.readyState = 2;
+      this.closeCode = code || 1000;
+      this.closeReason = reason || "";
+      this.sendFrame(opcodeClose, closePayload(this.closeCode, reason));
+      this.closeTimer = setTimeout(() => this.destroy(), closeTimeout);
+    }
+  }
+
+  /** Stops reading from the connection until resume is called. */
+  public pause(): void {
+    if (this.socket) {
+      this.socket.readPaused = true;
+    }
+  }
+
+  public resume(): void {
+    if (this.socket) {
+      this.socket.readPaused = false;
+    }
+  }
+
+  /** Closes the connection without a close handshake. */
+  public destroy(): void {
+    if (this.socket) {
+      socketEvents.closeSocket(this.socket);
+    } else {
+      this.closed();
+    }
+  }
+
+  private receive(data: string) {
+    this.parsing = true;
+    const code = el_executeWebSocketParser(this.parser, data, this.handler);
+    this.parsing = false;
+    if (this.readyState === 3) {
+      // closed by a handler while parsing
+      this.freeParser();
+    } else if (code > 0) {
+      console.error(`Websocket protocol error ${code}`);
+      this.readyState = 2;
+      this.closeCode = code;
+      this.sendFrame(opcodeClose, closePayload(code), () => this.destroy());
+    }
+  }
+
+  private sendFrame(
+    opcode: number,
+    data?: string | Uint8Array,
+    written?: () => void
+  ) {
+    const socket = this.socket as socketEvents.Esp32JsSocket;
+    const frame = el_encodeWebSocketFrame(
+      opcode,
+      typeof data === "string" ? textEncoder.encode(data) : data,
+      this.client
+    );
+    this.bufferedAmount += frame.length;
+    socket.write(frame);
+    socket.flush(() => {
+      this.bufferedAmount -= frame.length;
+      if (written) {
+        written();
+      }
+      if (this.drainPending && this.bufferedAmount <= this.highWaterMark) {
+        this.drainPending = false;
+        if (this.ondrain && this.readyState === 1) {
+          this.ondrain();
+        }
+      }
+    });
+  }
+
+  private freeParser() {
+    if (this.parser) {
+      el_freeWebSocketParser(this.parser);
+      this.parser = 0;
+    }
+  }
+
+  private closed() {
+    if (this.readyState === 3) {
+      return;
+    }
+    this.readyState = 3;
+    clearInterval(this.pingTimer);
+    clearTimeout(this.closeTimer);
+    if (!this.parsing) {
+      this.freeParser();
+    }
+    if (this.onclose) {
+      this.onclose(this.closeCode, this.closeReason);
+    }
+  }
+}
+
+function closePayload(code: number, reason?: string): Uint8Array {
+  const encoded = textEncoder.encode(reason || "");
+  const payload = new Uint8Array(2 + Math.min(encoded.length, 123));
+  payload[0] = code >> 8;
+  payload[1] = code & 0xff;
+  payload.set(encoded.subarray(0, payload.length - 2), 2);
+  return payload;
+}
+
+/**
+ * Completes the handshake of a websocket upgrade request received by
+ * httpServer. Requests which are no valid upgrade requests are answered
+ * with 400 and null is returned.
+ */
+export function acceptWebSocket(
+  req: Esp32JsRequest,
+  res: Esp32JsResponse,
+  options?: Esp32JsWebSocketOptions
+): Esp32JsWebSocket | null {
+  const key = req.headers.get("sec-websocket-key");
+  if (
+    req.method !== "GET" ||
+    !/(^|[ ,])websocket($|[ ,])/i.test(req.headers.get("upgrade") || "") ||
+    !/(^|[ ,])upgrade($|[ ,])/i.test(req.headers.get("connection") || "") ||
+    !key
+  ) {
+    res.setStatus(400);
+    res.end("Websocket upgrade expected");
+    return null;
+  }
+  if (req.headers.get("sec-websocket-version") !== "13") {
+    res.setStatus(426);
+    res.headers.set("sec-websocket-version", "13");
+    res.end();
+    return null;
+  }
+
+  res.headers.set("upgrade", "websocket");
+  res.headers.set("connection", "Upgrade");
+  res.headers.set("sec-websocket-accept", el_webSocketAccept(key));
+  const ws = new Esp32JsWebSocket(false, options);
+  ws.attach(res.upgrade());
+  return ws;
+}
+
+/**
+ * Opens a websocket connection to a ws:// or wss:// url. onopen gets
+ * called after the handshake, onerror if it failed.
+ */
+export function connectWebSocket(
+  url: string,
+  options?: Esp32JsWebSocketOptions
+): Esp32JsWebSocket {
+  const match = /^(wss?):\/\/([^/:?#]+)(?::(\d+))?([^#]*)$/.exec(url);
+  if (!match) {
+    throw Error("Invalid websocket url " + url);
+  }
+  const ssl = match[1] === "wss";
+  const host = match[2];
+  const port = match[3] || (ssl ? "443" : "80");
+  const path = match[4] || "/";
+
+  const ws = new Esp32JsWebSocket(true, options);
+  const key = el_createWebSocketKey();
+  const head = new ByteBuffer();
+  const connectFailed = function (message: string) {
+    if (ws.readyState === 0) {
+      ws.readyState = 3;
+      if (ws.onerror) {
+        ws.onerror(message);
+      }
+      if (ws.onclose) {
+        ws.onclose(1006, "");
+      }
+    }
+  };
+  const fail = function (message: string) {
+    connectFailed(message);
+    socketEvents.closeSocket(socket);
+  };
+
+  const socket = socketEvents.sockConnect(
+    ssl,
+    host,
+    port,
+    function () {
+      if (ws.readyState !== 0) {
+        // closed while connecting
+        socketEvents.closeSocket(socket);
+        return;
+      }
+      socket.write(
+        `GET ${path} HTTP/1.1\r\nhost: ${host}:${port}\r\nupgrade: websocket\r\nconnection: Upgrade\r\nsec-websocket-key: ${key}\r\nsec-websocket-version: 13\r\n\r\n`
+      );
+      socket.flush();
+    },
+    function (data) {
+      if (ws.readyState !== 0) {
+        socketEvents.closeSocket(socket);
+        return;
+      }
+      // only the new data and the possible start of the delimiter before it
+      const scanFrom = Math.max(head.length - 3, 0);
+      head.append(data);
+      const end = head.indexOf("\r\n\r\n", scanFrom);
+      if (end < 0) {
+        if (head.length > 4096) {
+          fail("Websocket handshake response too large");
+        }
+        return;
+      }
+      const lines = head.toString(0, end).split("\r\n");
+      const accept = el_webSocketAccept(key);
+      const accepted = lines.some(function (line) {
+        const colon = line.indexOf(":");
+        return (
+          line.substring(0, colon).trim().toLowerCase() ===
+            "sec-websocket-accept" && line.substring(colon + 1).trim() === accept
+        );
+      });
+      if (!/^HTTP\/1\.1 101/.test(lines[0]) || !accepted) {
+        fail("Websocket handshake failed: " + lines[0]);
+        return;
+      }
+      ws.attach(socket, head.toString(end + 4));
+    },
+    function () {
+      fail("Websocket connection to " + url + " failed");
+    },
+    function () {
+      connectFailed("Websocket connection to " + url + " closed");
+    }
+  );
+  return ws;
+}
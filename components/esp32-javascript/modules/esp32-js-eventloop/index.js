@@ -9,6 +9,8 @@ errorhandler =
         : errorhandler;
 var timers = [];
 var intervals = [];
+// eslint-disable-next-line @typescript-eslint/ban-types
+var microtasks = [];
 var handles = 0;
 exports.beforeSuspendHandlers = [];
 exports.afterSuspendHandlers = [];
@@ -48,6 +50,27 @@ function installIntervalTimeout(handle, fn, timeout) {
         }
     }, timeout);
 }
+/**
+ * Queues fn to run after the current callback, before the loop waits for
+ * the next events. Unlike setTimeout(fn, 0) it needs neither a timer nor
+ * another turn of the loop, which is what promise reactions are run with.
+ */
+// eslint-disable-next-line @typescript-eslint/ban-types
+function queueMicrotask(fn) {
+    microtasks.push(fn);
+}
+function runMicrotasks() {
+    while (microtasks.length > 0) {
+        // eslint-disable-next-line @typescript-eslint/ban-types
+        var fn = microtasks.shift();
+        try {
+            fn();
+        }
+        catch (error) {
+            errorhandler(error);
+        }
+    }
+}
 // eslint-disable-next-line @typescript-eslint/ban-types
 function setInterval(fn, timeout) {
     var handle = handles++;
@@ -61,6 +84,10 @@ function el_select_next() {
             h();
         });
     }
+    if (microtasks.length > 0) {
+        // queued by the handlers above, run them before waiting for events
+        return [];
+    }
     var events = el_suspend();
     // eslint-disable-next-line @typescript-eslint/ban-types
     var collected = [];
@@ -116,9 +143,11 @@ function start() {
                     catch (error) {
                         errorhandler(error);
                     }
+                    runMicrotasks();
                 }
             });
         }
+        runMicrotasks();
         nextfuncs = el_select_next();
     }
 }
@@ -127,3 +156,4 @@ global.setTimeout = setTimeout;
 global.clearTimeout = clearTimeout;
 global.setInterval = setInterval;
 global.clearInterval = clearInterval;
+global.queueMicrotask = queueMicrotask;
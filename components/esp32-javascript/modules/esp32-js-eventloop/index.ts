@@ -22,6 +22,8 @@ errorhandler =
 
 const timers: Esp32JsTimer[] = [];
 const intervals: number[] = [];
+// eslint-disable-next-line @typescript-eslint/ban-types
+const microtasks: Function[] = [];
 let handles = 0;
 export const beforeSuspendHandlers: (() => void)[] = [];
 export const afterSuspendHandlers: Esp32JsEventHandler[] = [];
@@ -66,6 +68,28 @@ function installIntervalTimeout(handle: number, fn: Function, timeout: number) {
   }, timeout);
 }
 
+/**
+ * Queues fn to run after the current callback, before the loop waits for
+ * the next events. Unlike setTimeout(fn, 0) it needs neither a timer nor
+ * another turn of the loop, which is what promise reactions are run with.
+ */
+// eslint-disable-next-line @typescript-eslint/ban-types
+function queueMicrotask(fn: Function) {
+  microtasks.push(fn);
+}
+
+function runMicrotasks() {
+  while (microtasks.length > 0) {
+    // eslint-disable-next-line @typescript-eslint/ban-types
+    const fn = microtasks.shift() as Function;
+    try {
+      fn();
+    } catch (error) {
+      errorhandler(error);
+    }
+  }
+}
+
 // eslint-disable-next-line @typescript-eslint/ban-types
 function setInterval(fn: Function, timeout: number) {
   const handle = handles++;
@@ -80,6 +104,10 @@ function el_select_next() {
       h();
     });
   }
+  if (microtasks.length > 0) {
+    // queued by the handlers above, run them before waiting for events
+    return [];
+  }
 
   const events = el_suspend();
 
@@ -138,9 +166,11 @@ export function start(): void {
           } catch (error) {
             errorhandler(error);
           }
+          runMicrotasks();
         }
       });
     }
+    runMicrotasks();
     nextfuncs = el_select_next();
   }
 }
@@ -149,3 +179,4 @@ global.setTimeout = setTimeout;
 global.clearTimeout = clearTimeout;
 global.setInterval = setInterval;
 global.clearInterval = clearInterval;
+global.queueMicrotask = queueMicrotask;
@@ -0,0 +1,266 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "byte-buffer.h"
+
+/*
+ * Byte buffers keep their content as a JS array of Uint8Array segments, the
+ * first of which may be consumed up to a byte offset. Received data is
+ * appended as a segment and slices are views of the segments, so neither
+ * copies the content. The functions here search and read across segment
+ * boundaries without joining the segments first.
+ */
+
+// returns the data of segment i of the array at segments, NULL if invalid
+static const uint8_t *getSegment(duk_context *ctx, duk_idx_t segments, duk_uarridx_t i, duk_size_t *size)
+{
+    const uint8_t *data = NULL;
+    *size = 0;
+    if (duk_get_prop_index(ctx, segments, i))
+    {
+        data = duk_get_buffer_data(ctx, -1, size);
+    }
+    duk_pop(ctx);
+    return data;
+}
+
+// true if the needle occurs at position at of data, continuing in the following segments
+static bool matchesAt(duk_context *ctx, duk_idx_t segments, duk_uarridx_t i, duk_uarridx_t count,
+                      const uint8_t *data, duk_size_t size, duk_size_t at,
+                      const uint8_t *needle, duk_size_t needleLen)
+{
+    duk_size_t matched = 0;
+    while (true)
+    {
+        duk_size_t n = size - at;
+        if (n > needleLen - matched)
+        {
+            n = needleLen - matched;
+        }
+        if (memcmp(data + at, needle + matched, n) != 0)
+        {
+            return false;
+        }
+        matched += n;
+        if (matched == needleLen)
+        {
+            return true;
+        }
+        if (++i >= count || (data = getSegment(ctx, segments, i, &size)) == NULL)
+        {
+            return false;
+        }
+        at = 0;
+    }
+}
+
+static duk_ret_t el_byteBufferAppend(duk_context *ctx)
+{
+    duk_size_t size;
+    const void *data;
+    bool isString = duk_is_string(ctx, 1);
+    if (isString)
+    {
+        data = duk_get_lstring(ctx, 1, &size);
+    }
+    else
+    {
+        data = duk_require_buffer_data(ctx, 1, &size);
+    }
+
+    if (size > 0)
+    {
+        duk_uarridx_t count = duk_get_length(ctx, 0);
+        duk_size_t lastSize = 0;
+        const uint8_t *last = count > 0 ? getSegment(ctx, 0, count - 1, &lastSize) : NULL;
+
+        if (last != NULL && lastSize + size <= BYTE_BUFFER_COALESCE_SIZE)
+        {
+            // replaces small segments by one to keep searches and reads short
+            uint8_t *joined = duk_push_fixed_buffer(ctx, lastSize + size);
+            memcpy(joined, last, lastSize);
+            memcpy(joined + lastSize, data, size);
+            duk_push_buffer_object(ctx, -1, 0, lastSize + size, DUK_BUFOBJ_UINT8ARRAY);
+            duk_put_prop_index(ctx, 0, count - 1);
+            duk_pop(ctx);
+        }
+        else if (isString)
+        {
+            void *copy = duk_push_fixed_buffer(ctx, size);
+            memcpy(copy, data, size);
+            duk_push_buffer_object(ctx, -1, 0, size, DUK_BUFOBJ_UINT8ARRAY);
+            duk_put_prop_index(ctx, 0, count);
+            duk_pop(ctx);
+        }
+        else
+        {
+            duk_dup(ctx, 1);
+            duk_put_prop_index(ctx, 0, count);
+        }
+    }
+
+    duk_push_uint(ctx, size);
+    return 1;
+}
+
+static duk_ret_t el_byteBufferIndexOf(duk_context *ctx)
+{
+    duk_uarridx_t count = duk_get_length(ctx, 0);
+    duk_size_t offset = duk_to_uint(ctx, 1);
+    uint8_t byte;
+    const uint8_t *needle;
+    duk_size_t needleLen;
+    if (duk_is_number(ctx, 2))
+    {
+        byte = (uint8_t)duk_get_uint(ctx, 2);
+        needle = &byte;
+        needleLen = 1;
+    }
+    else if (duk_is_string(ctx, 2))
+    {
+        needle = (const uint8_t *)duk_get_lstring(ctx, 2, &needleLen);
+    }
+    else
+    {
+        needle = duk_require_buffer_data(ctx, 2, &needleLen);
+    }
+    duk_size_t from = offset + duk_to_uint(ctx, 3);
+
+    duk_size_t segmentStart = 0;
+    for (duk_uarridx_t i = 0; i < count; i++)
+    {
+        duk_size_t size;
+        const uint8_t *data = getSegment(ctx, 0, i, &size);
+        if (data == NULL)
+        {
+            return duk_error(ctx, DUK_ERR_TYPE_ERROR, "Invalid byte buffer segment");
+        }
+        if (from < segmentStart + size)
+        {
+            if (needleLen == 0)
+            {
+                duk_push_number(ctx, from - offset);
+                return 1;
+            }
+            duk_size_t at = from > segmentStart ? from - segmentStart : 0;
+            const uint8_t *hit;
+            while (at < size && (hit = memchr(data + at, needle[0], size - at)) != NULL)
+            {
+                at = hit - data;
+                if (matchesAt(ctx, 0, i, count, data, size, at, needle, needleLen))
+                {
+                    duk_push_number(ctx, segmentStart + at - offset);
+                    return 1;
+                }
+                at++;
+            }
+        }
+        segmentStart += size;
+    }
+
+    if (needleLen == 0)
+    {
+        // like String.prototype.indexOf for positions past the end
+        duk_push_number(ctx, segmentStart - offset);
+    }
+    else
+    {
+        duk_push_int(ctx, -1);
+    }
+    return 1;
+}
+
+static duk_ret_t el_byteBufferRead(duk_context *ctx)
+{
+    duk_uarridx_t count = duk_get_length(ctx, 0);
+    duk_size_t offset = duk_to_uint(ctx, 1);
+    duk_size_t start = offset + duk_to_uint(ctx, 2);
+    duk_size_t end = offset + duk_to_uint(ctx, 3);
+    bool asString = duk_to_boolean(ctx, 4);
+    if (end < start)
+    {
+        end = start;
+    }
+
+    uint8_t *target = NULL;
+    duk_size_t copied = 0;
+    duk_size_t segmentStart = 0;
+    for (duk_uarridx_t i = 0; i < count && segmentStart < end; i++)
+    {
+        duk_size_t size;
+        const uint8_t *data = getSegment(ctx, 0, i, &size);
+        if (data == NULL)
+        {
+            return duk_error(ctx, DUK_ERR_TYPE_ERROR, "Invalid byte buffer segment");
+        }
+        if (start < segmentStart + size)
+        {
+            duk_size_t from = start > segmentStart ? start - segmentStart : 0;
+            duk_size_t to = end < segmentStart + size ? end - segmentStart : size;
+            if (target == NULL && asString && from + end - start == to)
+            {
+                // within one segment, no need for a temporary buffer
+                duk_push_lstring(ctx, (const char *)data + from, to - from);
+                return 1;
+            }
+            if (target == NULL)
+            {
+                target = duk_push_fixed_buffer(ctx, end - start);
+            }
+            memcpy(target + copied, data + from, to - from);
+            copied += to - from;
+        }
+        segmentStart += size;
+    }
+
+    if (target == NULL)
+    {
+        target = duk_push_fixed_buffer(ctx, 0);
+    }
+    if (asString)
+    {
+        duk_push_lstring(ctx, (const char *)target, copied);
+    }
+    else
+    {
+        duk_push_buffer_object(ctx, -1, 0, copied, DUK_BUFOBJ_UINT8ARRAY);
+    }
+    return 1;
+}
+
+void registerByteBufferBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_byteBufferAppend, 2);
+    duk_put_global_string(ctx, "el_byteBufferAppend");
+
+    duk_push_c_function(ctx, el_byteBufferIndexOf, 4);
+    duk_put_global_string(ctx, "el_byteBufferIndexOf");
+
+    duk_push_c_function(ctx, el_byteBufferRead, 5);
+    duk_put_global_string(ctx, "el_byteBufferRead");
+}
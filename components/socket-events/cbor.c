@@ -0,0 +1,723 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "cbor.h"
+
+/*
+ * CBOR (RFC 8949) encoding and decoding of JS values. Numbers use the
+ * shortest of integer, half, single and double precision which keeps the
+ * value, strings are converted between the CESU-8 of duktape and UTF-8,
+ * buffers and typed arrays are byte strings and dates are epoch based
+ * date/time values (tag 1). Both directions recurse on the C stack up to
+ * CBOR_MAX_DEPTH.
+ */
+
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK 0xFF
+#define CBOR_TAG_EPOCH 1
+
+typedef struct
+{
+    duk_context *ctx;
+    // value stack index of the buffer holding data
+    duk_idx_t buffer;
+    uint8_t *data;
+    duk_size_t length;
+    duk_size_t size;
+    // Date.prototype, dates are recognized by their prototype
+    void *datePrototype;
+    // containers being encoded, to detect cycles
+    void *parents[CBOR_MAX_DEPTH];
+} cbor_output_t;
+
+typedef struct
+{
+    const uint8_t *data;
+    duk_size_t length;
+    duk_size_t pos;
+} cbor_input_t;
+
+static uint8_t *reserve(cbor_output_t *out, duk_size_t len)
+{
+    if (out->length + len > out->size)
+    {
+        duk_size_t size = out->size * 2;
+        if (size < out->length + len)
+        {
+            size = out->length + len;
+        }
+        out->data = duk_resize_buffer(out->ctx, out->buffer, size);
+        out->size = size;
+    }
+    uint8_t *p = out->data + out->length;
+    out->length += len;
+    return p;
+}
+
+static void emit(cbor_output_t *out, const void *data, duk_size_t len)
+{
+    memcpy(reserve(out, len), data, len);
+}
+
+// writes the initial byte followed by len bytes of value in network byte order
+static void emitBits(cbor_output_t *out, uint8_t initial, uint64_t value, int len)
+{
+    uint8_t *p = reserve(out, len + 1);
+    p[0] = initial;
+    for (int i = len; i > 0; i--)
+    {
+        p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static void emitHead(cbor_output_t *out, int major, uint64_t value)
+{
+    if (value < 24)
+    {
+        emitBits(out, (major << 5) | (uint8_t)value, 0, 0);
+    }
+    else if (value <= 0xFF)
+    {
+        emitBits(out, (major << 5) | 24, value, 1);
+    }
+    else if (value <= 0xFFFF)
+    {
+        emitBits(out, (major << 5) | 25, value, 2);
+    }
+    else if (value <= 0xFFFFFFFF)
+    {
+        emitBits(out, (major << 5) | 26, value, 4);
+    }
+    else
+    {
+        emitBits(out, (major << 5) | 27, value, 8);
+    }
+}
+
+// stores d as half precision float if this keeps the value
+static bool toHalf(double d, uint16_t *half)
+{
+    float f = (float)d;
+    if ((double)f != d)
+    {
+        return false;
+    }
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent == 128)
+    {
+        *half = sign | 0x7C00;
+        return mantissa == 0;
+    }
+    if (exponent == -127)
+    {
+        *half = sign;
+        return mantissa == 0;
+    }
+    if (exponent > 15 || exponent < -24)
+    {
+        return false;
+    }
+    if (exponent >= -14)
+    {
+        *half = sign | ((exponent + 15) << 10) | (mantissa >> 13);
+        return (mantissa & 0x1FFF) == 0;
+    }
+    // subnormal half precision
+    int shift = -1 - exponent;
+    mantissa |= 0x800000;
+    *half = sign | (mantissa >> shift);
+    return (mantissa & ((1u << shift) - 1)) == 0;
+}
+
+static void emitNumber(cbor_output_t *out, double d)
+{
+    uint16_t half;
+    float f = (float)d;
+    if (isnan(d))
+    {
+        emitBits(out, 0xF9, 0x7E00, 2);
+    }
+    else if (fabs(d) <= 9007199254740991.0 && d == (double)(int64_t)d && !(d == 0 && signbit(d)))
+    {
+        if (d >= 0)
+        {
+            emitHead(out, CBOR_UNSIGNED, (uint64_t)d);
+        }
+        else
+        {
+            emitHead(out, CBOR_NEGATIVE, (uint64_t)(-1 - (int64_t)d));
+        }
+    }
+    else if (toHalf(d, &half))
+    {
+        emitBits(out, 0xF9, half, 2);
+    }
+    else if ((double)f == d)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        emitBits(out, 0xFA, bits, 4);
+    }
+    else
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        emitBits(out, 0xFB, bits, 8);
+    }
+}
+
+// duktape keeps surrogate pairs as CESU-8, CBOR text is UTF-8
+static duk_size_t convertText(const uint8_t *s, duk_size_t len, uint8_t *utf8)
+{
+    duk_size_t n = 0;
+    for (duk_size_t i = 0; i < len; i++)
+    {
+        const uint8_t *u = s + i;
+        if (u[0] == 0xED && i + 2 < len && u[1] >= 0xA0)
+        {
+            if (i + 5 < len && u[1] < 0xB0 && u[3] == 0xED && u[4] >= 0xB0)
+            {
+                uint32_t cp = 0x10000 + ((((u[1] & 0x0F) << 6) | (u[2] & 0x3F)) << 10) +
+                              (((u[4] & 0x0F) << 6) | (u[5] & 0x3F));
+                if (utf8 != NULL)
+                {
+                    utf8[n] = 0xF0 | (cp >> 18);
+                    utf8[n + 1] = 0x80 | ((cp >> 12) & 0x3F);
+                    utf8[n + 2] = 0x80 | ((cp >> 6) & 0x3F);
+                    utf8[n + 3] = 0x80 | (cp & 0x3F);
+                }
+                n += 4;
+                i += 5;
+            }
+            else
+            {
+                // lone surrogates are no valid UTF-8, they become U+FFFD
+                if (utf8 != NULL)
+                {
+                    utf8[n] = 0xEF;
+                    utf8[n + 1] = 0xBF;
+                    utf8[n + 2] = 0xBD;
+                }
+                n += 3;
+                i += 2;
+            }
+            continue;
+        }
+        if (utf8 != NULL)
+        {
+            utf8[n] = u[0];
+        }
+        n++;
+    }
+    return n;
+}
+
+static void emitText(cbor_output_t *out, const char *s, duk_size_t len)
+{
+    if (memchr(s, 0xED, len) == NULL)
+    {
+        emitHead(out, CBOR_TEXT, len);
+        emit(out, s, len);
+        return;
+    }
+    duk_size_t utf8Len = convertText((const uint8_t *)s, len, NULL);
+    emitHead(out, CBOR_TEXT, utf8Len);
+    convertText((const uint8_t *)s, len, reserve(out, utf8Len));
+}
+
+// functions, symbols and pointers have no CBOR representation, like in JSON
+static bool isEncodable(duk_context *ctx, duk_idx_t idx)
+{
+    return !duk_is_function(ctx, idx) && !duk_is_symbol(ctx, idx) &&
+           !duk_check_type(ctx, idx, DUK_TYPE_POINTER);
+}
+
+static duk_ret_t encodeValue(duk_context *ctx, cbor_output_t *out, duk_idx_t idx, int depth)
+{
+    switch (duk_get_type(ctx, idx))
+    {
+    case DUK_TYPE_UNDEFINED:
+        emitHead(out, CBOR_SIMPLE, 23);
+        return 0;
+    case DUK_TYPE_NULL:
+        emitHead(out, CBOR_SIMPLE, 22);
+        return 0;
+    case DUK_TYPE_BOOLEAN:
+        emitHead(out, CBOR_SIMPLE, duk_get_boolean(ctx, idx) ? 21 : 20);
+        return 0;
+    case DUK_TYPE_NUMBER:
+        emitNumber(out, duk_get_number(ctx, idx));
+        return 0;
+    case DUK_TYPE_STRING:
+    {
+        duk_size_t len;
+        const char *s = duk_get_lstring(ctx, idx, &len);
+        if (duk_is_symbol(ctx, idx))
+        {
+            emitHead(out, CBOR_SIMPLE, 22);
+        }
+        else
+        {
+            emitText(out, s, len);
+        }
+        return 0;
+    }
+    case DUK_TYPE_OBJECT:
+    case DUK_TYPE_BUFFER:
+        break;
+    default:
+        emitHead(out, CBOR_SIMPLE, 22);
+        return 0;
+    }
+
+    if (duk_is_buffer_data(ctx, idx))
+    {
+        // typed arrays, ArrayBuffers and DataViews are encoded with their bytes
+        duk_size_t len;
+        void *data = duk_get_buffer_data(ctx, idx, &len);
+        emitHead(out, CBOR_BYTES, len);
+        emit(out, data, len);
+        return 0;
+    }
+    if (!isEncodable(ctx, idx))
+    {
+        emitHead(out, CBOR_SIMPLE, 22);
+        return 0;
+    }
+    duk_get_prototype(ctx, idx);
+    bool isDate = duk_get_heapptr(ctx, -1) == out->datePrototype;
+    duk_pop(ctx);
+    if (isDate)
+    {
+        duk_get_prop_string(ctx, idx, "getTime");
+        duk_dup(ctx, idx);
+        duk_call_method(ctx, 0);
+        emitHead(out, CBOR_TAG, CBOR_TAG_EPOCH);
+        emitNumber(out, duk_get_number(ctx, -1) / 1000);
+        duk_pop(ctx);
+        return 0;
+    }
+
+    if (depth >= CBOR_MAX_DEPTH)
+    {
+        return duk_error(ctx, DUK_ERR_RANGE_ERROR, "cbor nesting too deep");
+    }
+    void *heapptr = duk_get_heapptr(ctx, idx);
+    for (int i = 0; i < depth; i++)
+    {
+        if (out->parents[i] == heapptr)
+        {
+            return duk_error(ctx, DUK_ERR_TYPE_ERROR, "cyclic input");
+        }
+    }
+    out->parents[depth] = heapptr;
+
+    duk_idx_t top = duk_get_top(ctx);
+    if (duk_is_array(ctx, idx))
+    {
+        duk_size_t length = duk_get_length(ctx, idx);
+        emitHead(out, CBOR_ARRAY, length);
+        for (duk_size_t i = 0; i < length; i++)
+        {
+            duk_get_prop_index(ctx, idx, (duk_uarridx_t)i);
+            encodeValue(ctx, out, top, depth + 1);
+            duk_pop(ctx);
+        }
+        return 0;
+    }
+
+    // own enumerable members are collected first, their count is the head
+    duk_size_t count = 0;
+    duk_enum(ctx, idx, DUK_ENUM_OWN_PROPERTIES_ONLY);
+    while (duk_next(ctx, top, 1))
+    {
+        if (isEncodable(ctx, -1))
+        {
+            duk_require_stack(ctx, 2);
+            count++;
+        }
+        else
+        {
+            duk_pop_2(ctx);
+        }
+    }
+    emitHead(out, CBOR_MAP, count);
+    for (duk_size_t i = 0; i < count; i++)
+    {
+        duk_idx_t key = top + 1 + 2 * (duk_idx_t)i;
+        duk_size_t len;
+        const char *name = duk_get_lstring(ctx, key, &len);
+        emitText(out, name, len);
+        encodeValue(ctx, out, key + 1, depth + 1);
+    }
+    duk_set_top(ctx, top);
+    return 0;
+}
+
+static duk_ret_t invalidInput(duk_context *ctx, cbor_input_t *in)
+{
+    return duk_error(ctx, DUK_ERR_TYPE_ERROR, "invalid cbor at offset %lu", (unsigned long)in->pos);
+}
+
+// reads the initial byte and argument of a data item, returns false if truncated
+static bool readHead(cbor_input_t *in, int *major, int *info, uint64_t *value)
+{
+    if (in->pos >= in->length)
+    {
+        return false;
+    }
+    uint8_t initial = in->data[in->pos++];
+    *major = initial >> 5;
+    *info = initial & 0x1F;
+    *value = *info;
+    if (*info < 24 || *info == CBOR_INDEFINITE)
+    {
+        return true;
+    }
+    int len = *info == 24 ? 1 : *info == 25 ? 2 : *info == 26 ? 4 : *info == 27 ? 8 : 0;
+    if (len == 0 || in->length - in->pos < (duk_size_t)len)
+    {
+        return false;
+    }
+    *value = 0;
+    for (int i = 0; i < len; i++)
+    {
+        *value = (*value << 8) | in->data[in->pos++];
+    }
+    return true;
+}
+
+static double halfToDouble(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double d;
+    if (exponent == 0)
+    {
+        d = ldexp(mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        d = ldexp(mantissa + 1024, exponent - 25);
+    }
+    else
+    {
+        d = mantissa == 0 ? INFINITY : NAN;
+    }
+    return (half & 0x8000) ? -d : d;
+}
+
+// pushes UTF-8 text as string, characters outside the BMP become CESU-8 surrogate pairs
+static void pushText(duk_context *ctx, const uint8_t *s, duk_size_t len)
+{
+    duk_size_t supplementary = 0;
+    for (duk_size_t i = 0; i < len; i++)
+    {
+        supplementary += s[i] >= 0xF0;
+    }
+    if (supplementary == 0)
+    {
+        duk_push_lstring(ctx, (const char *)s, len);
+        return;
+    }
+    uint8_t *cesu = duk_push_fixed_buffer(ctx, len + 2 * supplementary);
+    duk_size_t n = 0;
+    for (duk_size_t i = 0; i < len; i++)
+    {
+        if (s[i] >= 0xF0 && i + 3 < len)
+        {
+            uint32_t cp = ((s[i] & 0x07) << 18) | ((s[i + 1] & 0x3F) << 12) |
+                          ((s[i + 2] & 0x3F) << 6) | (s[i + 3] & 0x3F);
+            uint32_t high = 0xD800 + ((cp - 0x10000) >> 10);
+            uint32_t low = 0xDC00 + ((cp - 0x10000) & 0x3FF);
+            cesu[n++] = 0xED;
+            cesu[n++] = 0x80 | ((high >> 6) & 0x3F);
+            cesu[n++] = 0x80 | (high & 0x3F);
+            cesu[n++] = 0xED;
+            cesu[n++] = 0x80 | ((low >> 6) & 0x3F);
+            cesu[n++] = 0x80 | (low & 0x3F);
+            i += 3;
+        }
+        else
+        {
+            cesu[n++] = s[i];
+        }
+    }
+    duk_push_lstring(ctx, (const char *)cesu, n);
+    duk_remove(ctx, -2);
+}
+
+// pushes a byte or text string, indefinite ones are joined from their chunks
+static duk_ret_t decodeString(duk_context *ctx, cbor_input_t *in, int major, int info, uint64_t len)
+{
+    const uint8_t *data = in->data + in->pos;
+    if (info != CBOR_INDEFINITE)
+    {
+        if (len > in->length - in->pos)
+        {
+            return invalidInput(ctx, in);
+        }
+        in->pos += len;
+    }
+    else
+    {
+        // the chunks are definite strings of the same type until the break
+        duk_size_t start = in->pos;
+        duk_size_t total = 0;
+        int chunkMajor;
+        int chunkInfo;
+        uint64_t chunkLen;
+        while (in->pos < in->length && in->data[in->pos] != CBOR_BREAK)
+        {
+            if (!readHead(in, &chunkMajor, &chunkInfo, &chunkLen) || chunkMajor != major ||
+                chunkInfo == CBOR_INDEFINITE || chunkLen > in->length - in->pos)
+            {
+                return invalidInput(ctx, in);
+            }
+            in->pos += chunkLen;
+            total += chunkLen;
+        }
+        if (in->pos >= in->length)
+        {
+            return invalidInput(ctx, in);
+        }
+        in->pos++;
+
+        uint8_t *joined = duk_push_fixed_buffer(ctx, total);
+        cbor_input_t chunks = {in->data, in->pos - 1, start};
+        len = 0;
+        while (chunks.pos < chunks.length)
+        {
+            readHead(&chunks, &chunkMajor, &chunkInfo, &chunkLen);
+            memcpy(joined + len, chunks.data + chunks.pos, chunkLen);
+            chunks.pos += chunkLen;
+            len += chunkLen;
+        }
+        if (major == CBOR_TEXT)
+        {
+            pushText(ctx, joined, len);
+            duk_remove(ctx, -2);
+        }
+        else
+        {
+            duk_push_buffer_object(ctx, -1, 0, len, DUK_BUFOBJ_UINT8ARRAY);
+            duk_remove(ctx, -2);
+        }
+        return 0;
+    }
+
+    if (major == CBOR_TEXT)
+    {
+        pushText(ctx, data, len);
+    }
+    else
+    {
+        memcpy(duk_push_fixed_buffer(ctx, len), data, len);
+        duk_push_buffer_object(ctx, -1, 0, len, DUK_BUFOBJ_UINT8ARRAY);
+        duk_remove(ctx, -2);
+    }
+    return 0;
+}
+
+// returns true and skips the break if an indefinite container ends here
+static bool atBreak(cbor_input_t *in)
+{
+    if (in->pos < in->length && in->data[in->pos] == CBOR_BREAK)
+    {
+        in->pos++;
+        return true;
+    }
+    return false;
+}
+
+static duk_ret_t decodeValue(duk_context *ctx, cbor_input_t *in, int depth)
+{
+    int major;
+    int info;
+    uint64_t value;
+    if (!readHead(in, &major, &info, &value))
+    {
+        return invalidInput(ctx, in);
+    }
+    if (info == CBOR_INDEFINITE && (major < CBOR_BYTES || major == CBOR_TAG || major == CBOR_SIMPLE))
+    {
+        // a break outside of an indefinite container
+        in->pos--;
+        return invalidInput(ctx, in);
+    }
+    if (depth >= CBOR_MAX_DEPTH)
+    {
+        return duk_error(ctx, DUK_ERR_RANGE_ERROR, "cbor nesting too deep");
+    }
+    duk_require_stack(ctx, 3);
+
+    switch (major)
+    {
+    case CBOR_UNSIGNED:
+        duk_push_number(ctx, (double)value);
+        break;
+    case CBOR_NEGATIVE:
+        duk_push_number(ctx, -1.0 - (double)value);
+        break;
+    case CBOR_BYTES:
+    case CBOR_TEXT:
+        return decodeString(ctx, in, major, info, value);
+    case CBOR_ARRAY:
+    {
+        // every item takes at least one byte, this limits the length of forged input
+        if (info != CBOR_INDEFINITE && value > in->length - in->pos)
+        {
+            return invalidInput(ctx, in);
+        }
+        duk_idx_t array = duk_push_array(ctx);
+        for (duk_uarridx_t i = 0; info == CBOR_INDEFINITE ? !atBreak(in) : i < value; i++)
+        {
+            decodeValue(ctx, in, depth + 1);
+            duk_put_prop_index(ctx, array, i);
+        }
+        break;
+    }
+    case CBOR_MAP:
+    {
+        if (info != CBOR_INDEFINITE && value > (in->length - in->pos) / 2)
+        {
+            return invalidInput(ctx, in);
+        }
+        duk_idx_t object = duk_push_object(ctx);
+        for (uint64_t i = 0; info == CBOR_INDEFINITE ? !atBreak(in) : i < value; i++)
+        {
+            decodeValue(ctx, in, depth + 1);
+            duk_to_string(ctx, -1);
+            decodeValue(ctx, in, depth + 1);
+            // defined like JSON.parse does, so "__proto__" is a plain member
+            duk_def_prop(ctx, object, DUK_DEFPROP_HAVE_VALUE | DUK_DEFPROP_SET_WEC);
+        }
+        break;
+    }
+    case CBOR_TAG:
+        // only epoch dates are mapped, the content of other tags is returned as is
+        decodeValue(ctx, in, depth + 1);
+        if (value == CBOR_TAG_EPOCH && duk_is_number(ctx, -1))
+        {
+            double seconds = duk_get_number(ctx, -1);
+            duk_pop(ctx);
+            duk_get_global_string(ctx, "Date");
+            duk_push_number(ctx, seconds * 1000);
+            duk_new(ctx, 1);
+        }
+        break;
+    default:
+        if (info == 25)
+        {
+            duk_push_number(ctx, halfToDouble((uint16_t)value));
+        }
+        else if (info == 26)
+        {
+            uint32_t bits = (uint32_t)value;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            duk_push_number(ctx, f);
+        }
+        else if (info == 27)
+        {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            duk_push_number(ctx, d);
+        }
+        else if (value == 20 || value == 21)
+        {
+            duk_push_boolean(ctx, value == 21);
+        }
+        else if (value == 22)
+        {
+            duk_push_null(ctx);
+        }
+        else
+        {
+            // undefined and unassigned simple values
+            duk_push_undefined(ctx);
+        }
+    }
+    return 0;
+}
+
+static duk_ret_t el_cborEncode(duk_context *ctx)
+{
+    duk_set_top(ctx, 1);
+    cbor_output_t out;
+    out.ctx = ctx;
+    out.length = 0;
+    out.size = CBOR_BUFFER_SIZE;
+    out.data = duk_push_dynamic_buffer(ctx, out.size);
+    out.buffer = duk_get_top_index(ctx);
+    duk_get_global_string(ctx, "Date");
+    duk_get_prop_string(ctx, -1, "prototype");
+    out.datePrototype = duk_get_heapptr(ctx, -1);
+
+    encodeValue(ctx, &out, 0, 0);
+    duk_resize_buffer(ctx, out.buffer, out.length);
+    duk_push_buffer_object(ctx, out.buffer, 0, out.length, DUK_BUFOBJ_UINT8ARRAY);
+    return 1;
+}
+
+static duk_ret_t el_cborDecode(duk_context *ctx)
+{
+    cbor_input_t in = {0};
+    in.data = duk_require_buffer_data(ctx, 0, &in.length);
+    decodeValue(ctx, &in, 0);
+    if (in.pos != in.length)
+    {
+        return duk_error(ctx, DUK_ERR_TYPE_ERROR, "unexpected data after cbor value at offset %lu",
+                         (unsigned long)in.pos);
+    }
+    return 1;
+}
+
+void registerCborBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_cborEncode, 1);
+    duk_put_global_string(ctx, "el_cborEncode");
+
+    duk_push_c_function(ctx, el_cborDecode, 1);
+    duk_put_global_string(ctx, "el_cborDecode");
+}
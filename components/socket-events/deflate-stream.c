@@ -0,0 +1,512 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "deflate-stream.h"
+#include "esp32-js-log.h"
+
+/*
+ * Streaming deflate encoder (RFC 1951) for small heaps. It uses greedy LZ77
+ * matching over a small window and the fixed Huffman codes, which avoids
+ * building code trees and keeps the whole state in a single allocation.
+ * Every write ends with a sync flush, so the receiver can decompress all
+ * data written so far.
+ */
+
+#if DEFLATE_WINDOW_BITS < 9 || DEFLATE_WINDOW_BITS > 14
+#error "DEFLATE_WINDOW_BITS has to be between 9 and 14"
+#endif
+
+#define WSIZE (1 << DEFLATE_WINDOW_BITS)
+#define WMASK (WSIZE - 1)
+#define HASH_BITS (DEFLATE_WINDOW_BITS - 2)
+#define HASH_SIZE (1 << HASH_BITS)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define NIL 0xFFFF
+
+struct deflate_stream
+{
+    int format;
+    bool headerWritten;
+    uint32_t check;
+    uint32_t size;
+    // bytes up to strstart are encoded, the WSIZE bytes before are the history
+    int filled;
+    int strstart;
+    uint16_t head[HASH_SIZE];
+    uint16_t prev[WSIZE];
+    uint8_t window[2 * WSIZE];
+};
+
+typedef struct
+{
+    uint8_t *out;
+    size_t pos;
+    uint32_t bits;
+    int count;
+} bit_writer_t;
+
+static const uint16_t lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                    8193, 12289, 16385, 24577};
+static const uint8_t distExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// crc32 with a table per nibble instead of per byte to save memory
+static const uint32_t crcTable[] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+                                    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+                                    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                                    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+static uint32_t updateCrc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crcTable[crc & 15];
+        crc = (crc >> 4) ^ crcTable[crc & 15];
+    }
+    return ~crc;
+}
+
+static uint32_t updateAdler32(uint32_t adler, const uint8_t *data, size_t len)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (len > 0)
+    {
+        // largest block without overflow of b, see zlib
+        size_t n = len < 5552 ? len : 5552;
+        len -= n;
+        while (n-- > 0)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void putBits(bit_writer_t *bw, uint32_t value, int count)
+{
+    bw->bits |= value << bw->count;
+    bw->count += count;
+    while (bw->count >= 8)
+    {
+        bw->out[bw->pos++] = (uint8_t)bw->bits;
+        bw->bits >>= 8;
+        bw->count -= 8;
+    }
+}
+
+static void alignToByte(bit_writer_t *bw)
+{
+    if (bw->count > 0)
+    {
+        bw->out[bw->pos++] = (uint8_t)bw->bits;
+        bw->bits = 0;
+        bw->count = 0;
+    }
+}
+
+static void putByte(bit_writer_t *bw, uint8_t value)
+{
+    bw->out[bw->pos++] = value;
+}
+
+// huffman codes are stored most significant bit first
+static uint32_t reverseBits(uint32_t code, int count)
+{
+    uint32_t reversed = 0;
+    while (count-- > 0)
+    {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+static void putLiteralLength(bit_writer_t *bw, int symbol)
+{
+    if (symbol < 144)
+    {
+        putBits(bw, reverseBits(0x30 + symbol, 8), 8);
+    }
+    else if (symbol < 256)
+    {
+        putBits(bw, reverseBits(0x190 + symbol - 144, 9), 9);
+    }
+    else if (symbol < 280)
+    {
+        putBits(bw, reverseBits(symbol - 256, 7), 7);
+    }
+    else
+    {
+        putBits(bw, reverseBits(0xC0 + symbol - 280, 8), 8);
+    }
+}
+
+static void putMatch(bit_writer_t *bw, int length, int distance)
+{
+    int code = sizeof(lengthBase) / sizeof(lengthBase[0]) - 1;
+    while (lengthBase[code] > length)
+    {
+        code--;
+    }
+    putLiteralLength(bw, 257 + code);
+    putBits(bw, length - lengthBase[code], lengthExtra[code]);
+
+    code = sizeof(distBase) / sizeof(distBase[0]) - 1;
+    while (distBase[code] > distance)
+    {
+        code--;
+    }
+    putBits(bw, reverseBits(code, 5), 5);
+    putBits(bw, distance - distBase[code], distExtra[code]);
+}
+
+static inline uint32_t hash(const uint8_t *p)
+{
+    return ((((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static inline void insertString(deflate_stream_t *stream, int pos)
+{
+    uint32_t h = hash(stream->window + pos);
+    stream->prev[pos & WMASK] = stream->head[h];
+    stream->head[h] = (uint16_t)pos;
+}
+
+// moves the upper half of the window down to make room for new input
+static void slideWindow(deflate_stream_t *stream)
+{
+    memmove(stream->window, stream->window + WSIZE, WSIZE);
+    stream->filled -= WSIZE;
+    stream->strstart -= WSIZE;
+    for (int i = 0; i < HASH_SIZE; i++)
+    {
+        uint16_t pos = stream->head[i];
+        stream->head[i] = (pos != NIL && pos >= WSIZE) ? pos - WSIZE : NIL;
+    }
+    for (int i = 0; i < WSIZE; i++)
+    {
+        uint16_t pos = stream->prev[i];
+        stream->prev[i] = (pos != NIL && pos >= WSIZE) ? pos - WSIZE : NIL;
+    }
+}
+
+static int longestMatch(deflate_stream_t *stream, int candidate, int maxLength, int *distance)
+{
+    const uint8_t *window = stream->window;
+    const uint8_t *current = window + stream->strstart;
+    int limit = stream->strstart - WSIZE;
+    int bestLength = MIN_MATCH - 1;
+    int chain = DEFLATE_MAX_CHAIN;
+
+    while (candidate != NIL && candidate > limit && candidate < stream->strstart && chain-- > 0)
+    {
+        const uint8_t *match = window + candidate;
+        if (match[bestLength] == current[bestLength] && match[0] == current[0] && match[1] == current[1])
+        {
+            int length = 2;
+            while (length < maxLength && match[length] == current[length])
+            {
+                length++;
+            }
+            if (length > bestLength)
+            {
+                bestLength = length;
+                *distance = stream->strstart - candidate;
+                if (length == maxLength)
+                {
+                    break;
+                }
+            }
+        }
+        candidate = stream->prev[candidate & WMASK];
+    }
+    return bestLength;
+}
+
+// encodes the window from strstart up to end
+static void compressWindow(deflate_stream_t *stream, bit_writer_t *bw, int end)
+{
+    uint8_t *window = stream->window;
+    while (stream->strstart < end)
+    {
+        int length = 0;
+        int distance = 0;
+        int available = stream->filled - stream->strstart;
+        if (available >= MIN_MATCH)
+        {
+            int candidate = stream->head[hash(window + stream->strstart)];
+            insertString(stream, stream->strstart);
+            length = longestMatch(stream, candidate, available < MAX_MATCH ? available : MAX_MATCH, &distance);
+        }
+        if (length >= MIN_MATCH)
+        {
+            putMatch(bw, length, distance);
+            int matchEnd = stream->strstart + length;
+            stream->strstart++;
+            while (stream->strstart < matchEnd)
+            {
+                if (stream->filled - stream->strstart >= MIN_MATCH)
+                {
+                    insertString(stream, stream->strstart);
+                }
+                stream->strstart++;
+            }
+        }
+        else
+        {
+            putLiteralLength(bw, window[stream->strstart]);
+            stream->strstart++;
+        }
+    }
+}
+
+static void writeHeader(deflate_stream_t *stream, bit_writer_t *bw)
+{
+    if (stream->format == DEFLATE_FORMAT_GZIP)
+    {
+        // magic, deflate, no flags, no mtime, no extra flags, unknown OS
+        static const uint8_t gzipHeader[] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+        for (size_t i = 0; i < sizeof(gzipHeader); i++)
+        {
+            putByte(bw, gzipHeader[i]);
+        }
+    }
+    else
+    {
+        // deflate with the window size, the check bits make the header a multiple of 31
+        uint16_t header = (0x08 | ((DEFLATE_WINDOW_BITS - 8) << 4)) << 8;
+        header += 31 - header % 31;
+        putByte(bw, header >> 8);
+        putByte(bw, header & 0xFF);
+    }
+}
+
+static void writeTrailer(deflate_stream_t *stream, bit_writer_t *bw)
+{
+    if (stream->format == DEFLATE_FORMAT_GZIP)
+    {
+        for (int i = 0; i < 32; i += 8)
+        {
+            putByte(bw, (uint8_t)(stream->check >> i));
+        }
+        for (int i = 0; i < 32; i += 8)
+        {
+            putByte(bw, (uint8_t)(stream->size >> i));
+        }
+    }
+    else
+    {
+        for (int i = 24; i >= 0; i -= 8)
+        {
+            putByte(bw, (uint8_t)(stream->check >> i));
+        }
+    }
+}
+
+deflate_stream_t *createDeflateStream(int format)
+{
+    deflate_stream_t *stream = (deflate_stream_t *)malloc(sizeof(deflate_stream_t));
+    if (stream == NULL)
+    {
+        return NULL;
+    }
+    stream->format = format;
+    stream->headerWritten = false;
+    stream->check = format == DEFLATE_FORMAT_GZIP ? 0 : 1;
+    stream->size = 0;
+    stream->filled = 0;
+    stream->strstart = 0;
+    memset(stream->head, 0xFF, sizeof(stream->head));
+    return stream;
+}
+
+void freeDeflateStream(deflate_stream_t *stream)
+{
+    free(stream);
+}
+
+size_t deflateStreamBound(size_t len)
+{
+    // a fixed code takes at most 9 bits per input byte, plus the block headers,
+    // the sync flush and the gzip header and trailer
+    return len + len / 8 + 32;
+}
+
+size_t writeDeflateStream(deflate_stream_t *stream, const uint8_t *data, size_t len, bool final, uint8_t *out)
+{
+    bit_writer_t bw = {out, 0, 0, 0};
+    if (!stream->headerWritten)
+    {
+        writeHeader(stream, &bw);
+        stream->headerWritten = true;
+    }
+
+    bool stored = false;
+    if (len > 0)
+    {
+        const uint8_t *start = data;
+        size_t total = len;
+        size_t blockStart = bw.pos;
+        stream->check = stream->format == DEFLATE_FORMAT_GZIP ? updateCrc32(stream->check, data, len)
+                                                              : updateAdler32(stream->check, data, len);
+        stream->size += len;
+
+        // block with fixed codes
+        putBits(&bw, 2, 3);
+        while (true)
+        {
+            if (stream->filled == 2 * WSIZE)
+            {
+                slideWindow(stream);
+            }
+            size_t n = 2 * WSIZE - stream->filled;
+            if (n > len)
+            {
+                n = len;
+            }
+            memcpy(stream->window + stream->filled, data, n);
+            stream->filled += n;
+            data += n;
+            len -= n;
+            if (len == 0)
+            {
+                compressWindow(stream, &bw, stream->filled);
+                break;
+            }
+            // keep a full match as lookahead for the next input
+            compressWindow(stream, &bw, stream->filled - MAX_MATCH);
+        }
+        // end of block
+        putLiteralLength(&bw, 256);
+
+        if (bw.pos - blockStart > total + total / 65535 * 5 + 5)
+        {
+            // incompressible data is replaced by stored blocks
+            bw.pos = blockStart;
+            bw.bits = 0;
+            bw.count = 0;
+            for (size_t offset = 0; offset < total; offset += 0xFFFF)
+            {
+                uint16_t n = total - offset < 0xFFFF ? total - offset : 0xFFFF;
+                uint16_t complement = ~n;
+                putBits(&bw, 0, 3);
+                alignToByte(&bw);
+                putByte(&bw, n & 0xFF);
+                putByte(&bw, n >> 8);
+                putByte(&bw, complement & 0xFF);
+                putByte(&bw, complement >> 8);
+                memcpy(bw.out + bw.pos, start + offset, n);
+                bw.pos += n;
+            }
+            stored = true;
+        }
+    }
+
+    if (final)
+    {
+        // empty last block with fixed codes
+        putBits(&bw, 3, 3);
+        putLiteralLength(&bw, 256);
+        alignToByte(&bw);
+        writeTrailer(stream, &bw);
+    }
+    else if (!stored && (bw.pos > 0 || bw.count > 0))
+    {
+        // empty stored block to flush the output to a byte boundary
+        putBits(&bw, 0, 3);
+        alignToByte(&bw);
+        putByte(&bw, 0x00);
+        putByte(&bw, 0x00);
+        putByte(&bw, 0xFF);
+        putByte(&bw, 0xFF);
+    }
+    return bw.pos;
+}
+
+static duk_ret_t el_createDeflateStream(duk_context *ctx)
+{
+    deflate_stream_t *stream = createDeflateStream(duk_to_boolean(ctx, 0) ? DEFLATE_FORMAT_GZIP : DEFLATE_FORMAT_ZLIB);
+    if (stream == NULL)
+    {
+        jslog(ERROR, "Not enough memory for deflate stream");
+        return duk_error(ctx, DUK_ERR_ERROR, "Not enough memory for deflate stream");
+    }
+    duk_push_int(ctx, (duk_int_t)stream);
+    return 1;
+}
+
+static duk_ret_t el_freeDeflateStream(duk_context *ctx)
+{
+    freeDeflateStream((deflate_stream_t *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t el_writeDeflateStream(duk_context *ctx)
+{
+    deflate_stream_t *stream = (deflate_stream_t *)duk_to_int(ctx, 0);
+    duk_size_t len = 0;
+    const uint8_t *data = NULL;
+    if (duk_is_string(ctx, 1))
+    {
+        data = (const uint8_t *)duk_get_lstring(ctx, 1, &len);
+    }
+    else if (!duk_is_null_or_undefined(ctx, 1))
+    {
+        data = (const uint8_t *)duk_require_buffer_data(ctx, 1, &len);
+    }
+    bool final = duk_to_boolean(ctx, 2);
+
+    uint8_t *out = (uint8_t *)duk_push_dynamic_buffer(ctx, deflateStreamBound(len));
+    size_t outLen = writeDeflateStream(stream, data, len, final, out);
+    duk_resize_buffer(ctx, -1, outLen);
+    duk_push_buffer_object(ctx, -1, 0, outLen, DUK_BUFOBJ_UINT8ARRAY);
+    return 1;
+}
+
+void registerDeflateStreamBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_createDeflateStream, 1);
+    duk_put_global_string(ctx, "el_createDeflateStream");
+
+    duk_push_c_function(ctx, el_freeDeflateStream, 1);
+    duk_put_global_string(ctx, "el_freeDeflateStream");
+
+    duk_push_c_function(ctx, el_writeDeflateStream, 3);
+    duk_put_global_string(ctx, "el_writeDeflateStream");
+}
@@ -0,0 +1,290 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <netdb.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <lwip/sockets.h>
+#include "dns-cache.h"
+#include "socket-events.h"
+#include "tcp.h"
+#include "esp32-javascript.h"
+#include "esp32-js-log.h"
+
+typedef struct
+{
+    int sockfd;
+    int portno;
+    // socket event status, set when the lookup finished
+    int status;
+} dns_waiter_t;
+
+typedef struct
+{
+    char hostname[DNS_CACHE_MAX_HOSTNAME_LEN];
+    bool used;
+    bool pending;
+    bool resolved;
+    struct in_addr addr;
+    TickType_t expires;
+    TickType_t lastUsed;
+    int waiters_len;
+    dns_waiter_t *waiters;
+} dns_cache_entry_t;
+
+static dns_cache_entry_t cache[DNS_CACHE_SIZE];
+static SemaphoreHandle_t cacheMutex;
+static xQueueHandle resolveQueue;
+static TaskHandle_t dnsTask;
+
+static dns_cache_entry_t *findEntry(const char *hostname)
+{
+    for (int i = 0; i < DNS_CACHE_SIZE; i++)
+    {
+        if (cache[i].used && strcmp(cache[i].hostname, hostname) == 0)
+        {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+static dns_cache_entry_t *evictEntry()
+{
+    dns_cache_entry_t *lru = NULL;
+    for (int i = 0; i < DNS_CACHE_SIZE; i++)
+    {
+        if (!cache[i].used)
+        {
+            return &cache[i];
+        }
+        // in-flight lookups have waiters attached and must stay
+        if (!cache[i].pending && (lru == NULL || (int32_t)(cache[i].lastUsed - lru->lastUsed) < 0))
+        {
+            lru = &cache[i];
+        }
+    }
+    return lru;
+}
+
+static bool lookupHost(const char *hostname, struct in_addr *addr)
+{
+    // gethostbyname is not reentrant, so it must only be called from the dns task
+    struct hostent *server = gethostbyname(hostname);
+    if (server == NULL || server->h_length != sizeof(addr->s_addr))
+    {
+        return false;
+    }
+    memcpy(&addr->s_addr, server->h_addr, server->h_length);
+    return true;
+}
+
+static void dns_task(void *ignore)
+{
+    char hostname[DNS_CACHE_MAX_HOSTNAME_LEN];
+
+    while (true)
+    {
+        if (xQueueReceive(resolveQueue, hostname, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+
+        jslog(DEBUG, "Resolving %s ...\n", hostname);
+        struct in_addr addr;
+        bool resolved = lookupHost(hostname, &addr);
+        if (!resolved)
+        {
+            jslog(ERROR, "ERROR, no such host as %s\n", hostname);
+        }
+
+        dns_waiter_t *waiters = NULL;
+        int waiters_len = 0;
+
+        xSemaphoreTake(cacheMutex, portMAX_DELAY);
+        dns_cache_entry_t *entry = findEntry(hostname);
+        if (entry != NULL)
+        {
+            entry->pending = false;
+            entry->resolved = resolved;
+            entry->addr = addr;
+            entry->expires = xTaskGetTickCount() +
+                             pdMS_TO_TICKS(resolved ? DNS_CACHE_POSITIVE_TTL_MS : DNS_CACHE_NEGATIVE_TTL_MS);
+
+            // connect while holding the lock, so that a concurrent close cannot hand the
+            // file descriptor to a different socket in between
+            for (int i = 0; i < entry->waiters_len; i++)
+            {
+                dns_waiter_t *waiter = &entry->waiters[i];
+                waiter->status = EL_SOCKET_STATUS_ERROR;
+                if (resolved && connectAddress(waiter->sockfd, &addr, waiter->portno) == 0)
+                {
+                    waiter->status = EL_SOCKET_STATUS_RESOLVED;
+                }
+            }
+            waiters = entry->waiters;
+            waiters_len = entry->waiters_len;
+            entry->waiters = NULL;
+            entry->waiters_len = 0;
+        }
+        xSemaphoreGive(cacheMutex);
+
+        // fired without the lock, a full event queue must not block lookups of the JS task
+        js_eventlist_t events;
+        events.events_len = 0;
+        for (int i = 0; i < waiters_len; i++)
+        {
+            js_event_t event;
+            el_create_event(&event, EL_SOCKET_EVENT_TYPE, waiters[i].status, (void *)waiters[i].sockfd);
+            el_add_event(&events, &event);
+            if (events.events_len == MAX_EVENTS)
+            {
+                el_fire_events(&events);
+                events.events_len = 0;
+            }
+        }
+        free(waiters);
+        el_fire_events(&events);
+    }
+}
+
+int resolveHost(const char *hostname, int sockfd, int portno, struct in_addr *addr)
+{
+    // numeric addresses never need a lookup
+    if (inet_aton(hostname, addr))
+    {
+        return EL_DNS_RESOLVED;
+    }
+
+    if (strlen(hostname) >= DNS_CACHE_MAX_HOSTNAME_LEN)
+    {
+        jslog(ERROR, "Hostname too long: %s\n", hostname);
+        return EL_DNS_FAILED;
+    }
+
+    int ret = EL_DNS_FAILED;
+    TickType_t now = xTaskGetTickCount();
+
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    dns_cache_entry_t *entry = findEntry(hostname);
+    if (entry != NULL && !entry->pending && (int32_t)(entry->expires - now) > 0)
+    {
+        entry->lastUsed = now;
+        if (entry->resolved)
+        {
+            *addr = entry->addr;
+            ret = EL_DNS_RESOLVED;
+        }
+    }
+    else
+    {
+        if (entry == NULL)
+        {
+            entry = evictEntry();
+        }
+
+        if (entry == NULL)
+        {
+            jslog(ERROR, "Too many pending DNS lookups, cannot resolve %s\n", hostname);
+        }
+        else
+        {
+            if (!entry->pending)
+            {
+                strcpy(entry->hostname, hostname);
+                entry->used = true;
+                entry->pending = true;
+                entry->waiters_len = 0;
+                entry->waiters = NULL;
+                xQueueSend(resolveQueue, entry->hostname, portMAX_DELAY);
+            }
+
+            // coalesce all connects to the same host into one lookup
+            dns_waiter_t *waiters = (dns_waiter_t *)realloc(entry->waiters, (entry->waiters_len + 1) * sizeof(dns_waiter_t));
+            if (waiters == NULL)
+            {
+                jslog(ERROR, "Cannot allocate DNS waiter for %s\n", hostname);
+            }
+            else
+            {
+                waiters[entry->waiters_len].sockfd = sockfd;
+                waiters[entry->waiters_len].portno = portno;
+                entry->waiters = waiters;
+                entry->waiters_len++;
+                entry->lastUsed = now;
+                ret = EL_DNS_PENDING;
+            }
+        }
+    }
+    xSemaphoreGive(cacheMutex);
+
+    return ret;
+}
+
+void cancelResolve(int sockfd)
+{
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    for (int i = 0; i < DNS_CACHE_SIZE; i++)
+    {
+        dns_cache_entry_t *entry = &cache[i];
+        for (int j = 0; j < entry->waiters_len; j++)
+        {
+            if (entry->waiters[j].sockfd == sockfd)
+            {
+                entry->waiters[j] = entry->waiters[entry->waiters_len - 1];
+                entry->waiters_len--;
+                j--;
+            }
+        }
+    }
+    xSemaphoreGive(cacheMutex);
+}
+
+void clearDnsCache()
+{
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    for (int i = 0; i < DNS_CACHE_SIZE; i++)
+    {
+        if (!cache[i].pending)
+        {
+            cache[i].used = false;
+        }
+    }
+    xSemaphoreGive(cacheMutex);
+}
+
+void initDnsCache()
+{
+    memset(cache, 0, sizeof(cache));
+    cacheMutex = xSemaphoreCreateMutex();
+    // there can never be more lookups in flight than cache entries
+    resolveQueue = xQueueCreate(DNS_CACHE_SIZE, DNS_CACHE_MAX_HOSTNAME_LEN);
+
+    xTaskCreatePinnedToCore(&dns_task, "dns_task", 4 * 1024, NULL, 5, &dnsTask, 0);
+}
@@ -0,0 +1,130 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file-stream.h"
+#include "tcp.h"
+#include "idle-timeout.h"
+#include "esp32-js-log.h"
+
+static bool isStreamablePath(const char *path)
+{
+    return strncmp(path, "/modules/", 9) == 0 || strncmp(path, "/data/", 6) == 0;
+}
+
+file_stream_t *openFileStream(const char *path, long offset, long length)
+{
+    if (!isStreamablePath(path) || strstr(path, "/../") != NULL)
+    {
+        jslog(ERROR, "Streaming is only allowed from /modules and /data: %s", path);
+        return NULL;
+    }
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        jslog(ERROR, "Failed to open file %s for streaming", path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    if (offset < 0 || offset > fsize)
+    {
+        offset = fsize;
+    }
+    fseek(f, offset, SEEK_SET);
+
+    file_stream_t *stream = (file_stream_t *)malloc(sizeof(file_stream_t));
+    if (stream == NULL)
+    {
+        jslog(ERROR, "Not enough memory to stream file %s", path);
+        fclose(f);
+        return NULL;
+    }
+    stream->file = f;
+    stream->remaining = fsize - offset;
+    if (length >= 0 && length < stream->remaining)
+    {
+        stream->remaining = length;
+    }
+    stream->filled = 0;
+    stream->written = 0;
+    return stream;
+}
+
+/**
+ * Writes chunks of the file until the socket would block.
+ * Returns the number of bytes still to be sent, 0 when done and -1 on error.
+ */
+long sendFileStream(file_stream_t *stream, int sockfd, SSL *ssl)
+{
+    for (int i = 0; i < FILE_STREAM_CHUNKS_PER_CALL; i++)
+    {
+        if (stream->written == stream->filled)
+        {
+            if (stream->remaining == 0)
+            {
+                break;
+            }
+            size_t toRead = stream->remaining < FILE_STREAM_CHUNK_SIZE ? stream->remaining : FILE_STREAM_CHUNK_SIZE;
+            size_t n = fread(stream->buffer, 1, toRead, stream->file);
+            if (n == 0)
+            {
+                jslog(ERROR, "Reading file for streaming failed");
+                return -1;
+            }
+            stream->filled = n;
+            stream->written = 0;
+            stream->remaining -= n;
+        }
+
+        int ret = writeSocket(sockfd, stream->buffer + stream->written, stream->filled - stream->written, ssl);
+        if (ret < 0)
+        {
+            return -1;
+        }
+        else if (ret == 0)
+        {
+            // EAGAIN, continue on the next writable event
+            break;
+        }
+        stream->written += ret;
+        // slow receivers should not run into the read timeout
+        touchSocket(sockfd);
+    }
+    return stream->remaining + (stream->filled - stream->written);
+}
+
+void closeFileStream(file_stream_t *stream)
+{
+    if (stream != NULL)
+    {
+        fclose(stream->file);
+        free(stream);
+    }
+}
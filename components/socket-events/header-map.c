@@ -0,0 +1,341 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include "header-map.h"
+
+/*
+ * Header lists hold the entries of an Esp32JsHeaders object in one JS array,
+ * alternating the name and the value of each entry. Well-known names are
+ * stored as their index in knownHeaders, other names as lower case strings,
+ * so names are validated and lower cased once per call and compared as
+ * integers in most cases.
+ */
+
+// sorted for the binary search in findKnownHeader
+static const char *const knownHeaders[] = {
+    "accept",
+    "accept-encoding",
+    "accept-language",
+    "accept-ranges",
+    "access-control-allow-origin",
+    "age",
+    "authorization",
+    "cache-control",
+    "connection",
+    "content-disposition",
+    "content-encoding",
+    "content-length",
+    "content-range",
+    "content-type",
+    "cookie",
+    "date",
+    "etag",
+    "expires",
+    "host",
+    "if-match",
+    "if-modified-since",
+    "if-none-match",
+    "if-range",
+    "keep-alive",
+    "last-event-id",
+    "last-modified",
+    "location",
+    "origin",
+    "pragma",
+    "range",
+    "referer",
+    "sec-websocket-accept",
+    "sec-websocket-key",
+    "sec-websocket-protocol",
+    "sec-websocket-version",
+    "server",
+    "set-cookie",
+    "transfer-encoding",
+    "upgrade",
+    "user-agent",
+    "vary",
+    "www-authenticate",
+    "x-forwarded-for",
+    "x-requested-with",
+};
+
+#define KNOWN_HEADERS_COUNT (sizeof(knownHeaders) / sizeof(knownHeaders[0]))
+
+typedef struct
+{
+    // index in knownHeaders or -1
+    int id;
+    // the lower case name
+    const char *name;
+    size_t len;
+} header_key_t;
+
+// returns the id of a lower case header name or -1 if it is not well-known
+int findKnownHeader(const char *name, size_t len)
+{
+    int low = 0;
+    int high = KNOWN_HEADERS_COUNT - 1;
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        const char *known = knownHeaders[mid];
+        int cmp = strncmp(known, name, len);
+        if (cmp == 0 && known[len] != '\0')
+        {
+            // the known name is longer
+            cmp = 1;
+        }
+        if (cmp == 0)
+        {
+            return mid;
+        }
+        if (cmp < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+static bool isTokenChar(char c)
+{
+    return isalnum((unsigned char)c) || (c != '\0' && strchr("!#$%&'*+-.^_`|~", c) != NULL);
+}
+
+/**
+ * Converts the name at idx to a string, validates and lower cases it into
+ * buf or a buffer pushed to the value stack for long names.
+ * Returns false for invalid names.
+ */
+static bool toHeaderKey(duk_context *ctx, duk_idx_t idx, header_key_t *key, char *buf)
+{
+    duk_size_t len;
+    const char *name = duk_to_lstring(ctx, idx, &len);
+    char *lower = len <= HEADER_MAP_NAME_BUFFER_SIZE ? buf : (char *)duk_push_fixed_buffer(ctx, len);
+    for (duk_size_t i = 0; i < len; i++)
+    {
+        if (!isTokenChar(name[i]))
+        {
+            return false;
+        }
+        lower[i] = tolower((unsigned char)name[i]);
+    }
+    key->id = findKnownHeader(lower, len);
+    key->name = lower;
+    key->len = len;
+    return len > 0;
+}
+
+// the error of the polyfill this replaces
+#define INVALID_NAME_ERROR(ctx) duk_error(ctx, DUK_ERR_TYPE_ERROR, "Invalid character in header field name:%s", duk_get_string(ctx, 1))
+
+// returns the index of the entry with this name in the list or -1
+static int findEntry(duk_context *ctx, duk_idx_t list_idx, const header_key_t *key)
+{
+    duk_size_t len = duk_get_length(ctx, list_idx);
+    for (duk_size_t i = 0; i < len; i += 2)
+    {
+        duk_get_prop_index(ctx, list_idx, i);
+        bool match;
+        if (key->id >= 0)
+        {
+            match = duk_is_number(ctx, -1) && duk_get_int(ctx, -1) == key->id;
+        }
+        else if (duk_is_string(ctx, -1))
+        {
+            duk_size_t nameLen;
+            const char *name = duk_get_lstring(ctx, -1, &nameLen);
+            match = nameLen == key->len && memcmp(name, key->name, nameLen) == 0;
+        }
+        else
+        {
+            match = false;
+        }
+        duk_pop(ctx);
+        if (match)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Adds the value (at value_idx, a string) to the entry of the name or
+ * appends a new entry. Existing values are replaced or joined with ", ".
+ */
+static void putEntry(duk_context *ctx, duk_idx_t list_idx, const header_key_t *key, duk_idx_t value_idx, bool replace)
+{
+    value_idx = duk_normalize_index(ctx, value_idx);
+    int i = findEntry(ctx, list_idx, key);
+    if (i < 0)
+    {
+        duk_size_t len = duk_get_length(ctx, list_idx);
+        if (key->id >= 0)
+        {
+            duk_push_int(ctx, key->id);
+        }
+        else
+        {
+            duk_push_lstring(ctx, key->name, key->len);
+        }
+        duk_put_prop_index(ctx, list_idx, len);
+        duk_dup(ctx, value_idx);
+        duk_put_prop_index(ctx, list_idx, len + 1);
+        return;
+    }
+    if (!replace)
+    {
+        duk_get_prop_index(ctx, list_idx, i + 1);
+        if (duk_get_length(ctx, -1) > 0)
+        {
+            duk_push_string(ctx, ", ");
+            duk_dup(ctx, value_idx);
+            duk_concat(ctx, 3);
+            duk_put_prop_index(ctx, list_idx, i + 1);
+            return;
+        }
+        duk_pop(ctx);
+    }
+    duk_dup(ctx, value_idx);
+    duk_put_prop_index(ctx, list_idx, i + 1);
+}
+
+// el_setHeader(list, name, value, replace)
+static duk_ret_t el_setHeader(duk_context *ctx)
+{
+    char buf[HEADER_MAP_NAME_BUFFER_SIZE];
+    header_key_t key;
+    duk_require_object(ctx, 0);
+    if (!toHeaderKey(ctx, 1, &key, buf))
+    {
+        return INVALID_NAME_ERROR(ctx);
+    }
+    duk_to_string(ctx, 2);
+    putEntry(ctx, 0, &key, 2, duk_to_boolean(ctx, 3));
+    return 0;
+}
+
+// el_getHeader(list, name), returns the value or null
+static duk_ret_t el_getHeader(duk_context *ctx)
+{
+    char buf[HEADER_MAP_NAME_BUFFER_SIZE];
+    header_key_t key;
+    duk_require_object(ctx, 0);
+    if (!toHeaderKey(ctx, 1, &key, buf))
+    {
+        return INVALID_NAME_ERROR(ctx);
+    }
+    int i = findEntry(ctx, 0, &key);
+    if (i < 0)
+    {
+        duk_push_null(ctx);
+    }
+    else
+    {
+        duk_get_prop_index(ctx, 0, i + 1);
+    }
+    return 1;
+}
+
+// el_deleteHeader(list, name)
+static duk_ret_t el_deleteHeader(duk_context *ctx)
+{
+    char buf[HEADER_MAP_NAME_BUFFER_SIZE];
+    header_key_t key;
+    duk_require_object(ctx, 0);
+    if (!toHeaderKey(ctx, 1, &key, buf))
+    {
+        return INVALID_NAME_ERROR(ctx);
+    }
+    int i = findEntry(ctx, 0, &key);
+    if (i >= 0)
+    {
+        duk_size_t len = duk_get_length(ctx, 0);
+        for (duk_size_t j = i + 2; j < len; j++)
+        {
+            duk_get_prop_index(ctx, 0, j);
+            duk_put_prop_index(ctx, 0, j - 2);
+        }
+        duk_set_length(ctx, 0, len - 2);
+    }
+    return 0;
+}
+
+// el_appendHeaderList(list, headerList) appends the lower case and validated names and values of the http parser
+static duk_ret_t el_appendHeaderList(duk_context *ctx)
+{
+    duk_require_object(ctx, 0);
+    duk_require_object(ctx, 1);
+    duk_size_t len = duk_get_length(ctx, 1);
+    for (duk_size_t i = 0; i + 1 < len; i += 2)
+    {
+        header_key_t key;
+        duk_get_prop_index(ctx, 1, i);
+        key.name = duk_require_lstring(ctx, -1, &key.len);
+        key.id = findKnownHeader(key.name, key.len);
+        duk_get_prop_index(ctx, 1, i + 1);
+        putEntry(ctx, 0, &key, -1, false);
+        duk_pop_2(ctx);
+    }
+    return 0;
+}
+
+// el_headerNames() returns the well-known names by id
+static duk_ret_t el_headerNames(duk_context *ctx)
+{
+    duk_idx_t arr_idx = duk_push_array(ctx);
+    for (duk_uarridx_t i = 0; i < KNOWN_HEADERS_COUNT; i++)
+    {
+        duk_push_string(ctx, knownHeaders[i]);
+        duk_put_prop_index(ctx, arr_idx, i);
+    }
+    return 1;
+}
+
+void registerHeaderMapBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_setHeader, 4);
+    duk_put_global_string(ctx, "el_setHeader");
+
+    duk_push_c_function(ctx, el_getHeader, 2);
+    duk_put_global_string(ctx, "el_getHeader");
+
+    duk_push_c_function(ctx, el_deleteHeader, 2);
+    duk_put_global_string(ctx, "el_deleteHeader");
+
+    duk_push_c_function(ctx, el_appendHeaderList, 2);
+    duk_put_global_string(ctx, "el_appendHeaderList");
+
+    duk_push_c_function(ctx, el_headerNames, 0);
+    duk_put_global_string(ctx, "el_headerNames");
+}
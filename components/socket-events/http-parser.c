@@ -0,0 +1,709 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "http-parser.h"
+#include "esp32-js-log.h"
+
+#define HP_IDLE 0
+#define HP_HEAD 1
+#define HP_BODY 2
+#define HP_CHUNK_SIZE 3
+#define HP_CHUNK_DATA 4
+#define HP_CHUNK_DATA_END 5
+#define HP_TRAILER 6
+#define HP_ERROR 7
+// response body without length, delimited by closing the connection
+#define HP_BODY_UNTIL_CLOSE 8
+// the connection was taken over after a message, e.g. by a websocket
+#define HP_DETACHED 9
+
+http_parser_t *createHttpParser(int type)
+{
+    http_parser_t *parser = (http_parser_t *)calloc(1, sizeof(http_parser_t));
+    if (parser != NULL)
+    {
+        parser->type = type;
+        parser->state = HP_IDLE;
+        parser->maxBodySize = -1;
+    }
+    return parser;
+}
+
+// closes the file the body is written to, incomplete files are removed
+static bool closeBodyFile(http_parser_t *parser, bool remove)
+{
+    bool ok = true;
+    if (parser->bodyFile != NULL)
+    {
+        ok = fclose(parser->bodyFile) == 0;
+        parser->bodyFile = NULL;
+        if (remove || !ok)
+        {
+            unlink(parser->bodyFilePath);
+        }
+    }
+    free(parser->bodyFilePath);
+    parser->bodyFilePath = NULL;
+    return ok;
+}
+
+void freeHttpParser(http_parser_t *parser)
+{
+    if (parser != NULL)
+    {
+        closeBodyFile(parser, true);
+        free(parser->head);
+        free(parser);
+    }
+}
+
+/**
+ * Sets how the body of the current request is received. Has to be called
+ * from onHead. Binary bodies are passed to onBody as Uint8Array instead of
+ * strings. Bodies exceeding maxSize (if >= 0) fail with 413. If path is set,
+ * the body is written natively to this file in /data instead of being passed
+ * to onBody. The file is complete when onComplete is called and removed if
+ * the request fails.
+ * Returns false if the file could not be opened, the request then fails
+ * with 500.
+ */
+bool setHttpParserBody(http_parser_t *parser, bool binary, long maxSize, const char *path)
+{
+    parser->binaryBody = binary;
+    parser->maxBodySize = maxSize;
+    if (path != NULL)
+    {
+        if (strncmp(path, "/data/", 6) != 0 || strstr(path, "/../") != NULL)
+        {
+            jslog(ERROR, "Request bodies can only be written to /data: %s", path);
+            parser->bodyError = 500;
+            return false;
+        }
+        closeBodyFile(parser, true);
+        parser->bodyFile = fopen(path, "w");
+        if (parser->bodyFile == NULL)
+        {
+            jslog(ERROR, "Failed to open file %s for the request body", path);
+            parser->bodyError = 500;
+            return false;
+        }
+        parser->bodyFilePath = strdup(path);
+    }
+    return true;
+}
+
+static void releaseHead(http_parser_t *parser)
+{
+    free(parser->head);
+    parser->head = NULL;
+    parser->headLen = 0;
+    parser->headSize = 0;
+}
+
+static int fail(http_parser_t *parser, int status)
+{
+    releaseHead(parser);
+    closeBodyFile(parser, true);
+    parser->state = HP_ERROR;
+    parser->error = status;
+    return -status;
+}
+
+static bool appendHead(http_parser_t *parser, char c)
+{
+    if (parser->headLen == parser->headSize)
+    {
+        int maxSize = parser->type == HTTP_PARSER_RESPONSE ? HTTP_PARSER_MAX_RESPONSE_HEAD_SIZE : HTTP_PARSER_MAX_HEAD_SIZE;
+        if (parser->headSize >= maxSize)
+        {
+            return false;
+        }
+        int size = parser->headSize == 0 ? HTTP_PARSER_INITIAL_HEAD_SIZE : parser->headSize * 2;
+        if (size > maxSize)
+        {
+            size = maxSize;
+        }
+        char *head = (char *)realloc(parser->head, size);
+        if (head == NULL)
+        {
+            return false;
+        }
+        parser->head = head;
+        parser->headSize = size;
+    }
+    parser->head[parser->headLen++] = c;
+    return true;
+}
+
+static bool isTokenChar(char c)
+{
+    return isalnum((unsigned char)c) || strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
+// returns the length of the line starting at start without line breaks and stores the start of the next line
+static int nextLine(const char *start, const char *end, const char **next)
+{
+    const char *lf = memchr(start, '\n', end - start);
+    if (lf == NULL)
+    {
+        *next = end;
+        return end - start;
+    }
+    *next = lf + 1;
+    return (lf > start && lf[-1] == '\r') ? lf - start - 1 : lf - start;
+}
+
+// returns the truthiness of the handler function's return value
+static bool callHandler(duk_context *ctx, duk_idx_t handler_idx, const char *name, int nargs)
+{
+    // the function has to be below the arguments on the value stack
+    duk_get_prop_string(ctx, handler_idx, name);
+    duk_insert(ctx, -(nargs + 1));
+    duk_call(ctx, nargs);
+    bool ret = duk_to_boolean(ctx, -1);
+    duk_pop(ctx);
+    return ret;
+}
+
+// passes body data to onBody or writes it to the body file
+static int handleBody(duk_context *ctx, http_parser_t *parser, duk_idx_t handler_idx, const char *data, size_t len)
+{
+    parser->bodySize += len;
+    if (parser->maxBodySize >= 0 && parser->bodySize > parser->maxBodySize)
+    {
+        return fail(parser, 413);
+    }
+    if (parser->bodyFile != NULL)
+    {
+        if (fwrite(data, 1, len, parser->bodyFile) != len)
+        {
+            jslog(ERROR, "Failed to write request body to %s", parser->bodyFilePath);
+            return fail(parser, 507);
+        }
+        return 0;
+    }
+
+    // strings for requests and Uint8Array for responses and binary request bodies
+    if (parser->type == HTTP_PARSER_RESPONSE || parser->binaryBody)
+    {
+        void *buf = duk_push_fixed_buffer(ctx, len);
+        memcpy(buf, data, len);
+        duk_push_buffer_object(ctx, -1, 0, len, DUK_BUFOBJ_UINT8ARRAY);
+        duk_remove(ctx, -2);
+    }
+    else
+    {
+        duk_push_lstring(ctx, data, len);
+    }
+    callHandler(ctx, handler_idx, "onBody", 1);
+    return 0;
+}
+
+static int completeMessage(duk_context *ctx, http_parser_t *parser, duk_idx_t handler_idx)
+{
+    parser->state = HP_IDLE;
+    if (parser->bodyFile != NULL && !closeBodyFile(parser, false))
+    {
+        jslog(ERROR, "Failed to write request body file");
+        return fail(parser, 507);
+    }
+    if (callHandler(ctx, handler_idx, "onComplete", 0))
+    {
+        parser->state = HP_DETACHED;
+    }
+    return 0;
+}
+
+// returns the minor version of "HTTP/1.x" or -1
+static int parseVersion(const char *version, int len)
+{
+    if (len != 8 || strncmp(version, "HTTP/1.", 7) != 0 || !isdigit((unsigned char)version[7]))
+    {
+        return -1;
+    }
+    return version[7] - '0';
+}
+
+// if a comma separated header value contains the token, ignoring case
+static bool hasToken(const char *value, const char *valueEnd, const char *token)
+{
+    int tokenLen = strlen(token);
+    while (value < valueEnd)
+    {
+        while (value < valueEnd && (*value == ' ' || *value == '\t' || *value == ','))
+        {
+            value++;
+        }
+        const char *tokenEnd = value;
+        while (tokenEnd < valueEnd && *tokenEnd != ',' && *tokenEnd != ' ' && *tokenEnd != '\t')
+        {
+            tokenEnd++;
+        }
+        if (tokenEnd - value == tokenLen && strncasecmp(value, token, tokenLen) == 0)
+        {
+            return true;
+        }
+        value = tokenEnd;
+    }
+    return false;
+}
+
+/**
+ * Parses request or status line and headers and calls onHead(method, path,
+ * headers, contentLength, chunked, keepAlive) for requests or
+ * onHead(status, statusText, headers, contentLength, chunked, keepAlive) for
+ * responses. Headers are passed as flat array of lower case names and trimmed
+ * values. keepAlive reflects HTTP version and connection header. A response
+ * handler returns true from onHead if the response has no body, e.g. for
+ * HEAD requests. Interim 1xx responses except 101 are skipped.
+ */
+static int parseHead(duk_context *ctx, http_parser_t *parser, duk_idx_t handler_idx)
+{
+    char *head = parser->head;
+    const char *end = head + parser->headLen;
+    const char *next;
+    int len = nextLine(head, end, &next);
+    int minorVersion;
+    int status = 0;
+
+    if (parser->type == HTTP_PARSER_RESPONSE)
+    {
+        // status line: HTTP-version SP status-code SP [reason-phrase]
+        minorVersion = parseVersion(head, len < 8 ? len : 8);
+        if (minorVersion < 0 || len < 12 || head[8] != ' ' || !isdigit((unsigned char)head[9]) ||
+            !isdigit((unsigned char)head[10]) || !isdigit((unsigned char)head[11]) || (len > 12 && head[12] != ' '))
+        {
+            return fail(parser, 400);
+        }
+        status = (head[9] - '0') * 100 + (head[10] - '0') * 10 + (head[11] - '0');
+        if (status >= 100 && status < 200 && status != 101)
+        {
+            releaseHead(parser);
+            parser->state = HP_IDLE;
+            return 0;
+        }
+        duk_push_int(ctx, status);
+        duk_push_lstring(ctx, len > 13 ? head + 13 : "", len > 13 ? len - 13 : 0);
+    }
+    else
+    {
+        // request line: method SP request-target SP HTTP-version
+        const char *sp1 = memchr(head, ' ', len);
+        const char *sp2 = sp1 != NULL ? memchr(sp1 + 1, ' ', head + len - sp1 - 1) : NULL;
+        minorVersion = sp2 != NULL ? parseVersion(sp2 + 1, head + len - sp2 - 1) : -1;
+        if (sp1 == NULL || sp1 == head || sp2 == NULL || sp2 == sp1 + 1 || minorVersion < 0)
+        {
+            return fail(parser, 400);
+        }
+        for (const char *c = head; c < sp1; c++)
+        {
+            if (!isTokenChar(*c))
+            {
+                return fail(parser, 400);
+            }
+        }
+
+        duk_push_lstring(ctx, head, sp1 - head);
+        duk_push_lstring(ctx, sp1 + 1, sp2 - sp1 - 1);
+    }
+    duk_idx_t arr_idx = duk_push_array(ctx);
+    duk_uarridx_t arr_len = 0;
+
+    long contentLength = -1;
+    bool chunked = false;
+    bool keepAlive = minorVersion > 0;
+    while (next < end)
+    {
+        char *line = (char *)next;
+        len = nextLine(line, end, &next);
+        if (len == 0)
+        {
+            break;
+        }
+        char *colon = memchr(line, ':', len);
+        if (colon == NULL || colon == line)
+        {
+            duk_pop_3(ctx);
+            return fail(parser, 400);
+        }
+        for (char *c = line; c < colon; c++)
+        {
+            if (!isTokenChar(*c))
+            {
+                // also rejects obsolete line folding and whitespace before the colon
+                duk_pop_3(ctx);
+                return fail(parser, 400);
+            }
+            *c = tolower((unsigned char)*c);
+        }
+        const char *value = colon + 1;
+        const char *valueEnd = line + len;
+        while (value < valueEnd && (*value == ' ' || *value == '\t'))
+        {
+            value++;
+        }
+        while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+        {
+            valueEnd--;
+        }
+        int nameLen = colon - line;
+        int valueLen = valueEnd - value;
+
+        if (nameLen == 14 && strncmp(line, "content-length", 14) == 0)
+        {
+            long parsed = 0;
+            for (const char *c = value; c < valueEnd; c++)
+            {
+                if (!isdigit((unsigned char)*c) || parsed > 0x7FFFFFF)
+                {
+                    duk_pop_3(ctx);
+                    return fail(parser, 400);
+                }
+                parsed = parsed * 10 + (*c - '0');
+            }
+            if (valueLen == 0 || (contentLength >= 0 && contentLength != parsed))
+            {
+                duk_pop_3(ctx);
+                return fail(parser, 400);
+            }
+            contentLength = parsed;
+        }
+        else if (nameLen == 17 && strncmp(line, "transfer-encoding", 17) == 0)
+        {
+            // chunked has to be the last transfer coding, other codings are not supported
+            if (valueLen < 7 || strncasecmp(valueEnd - 7, "chunked", 7) != 0 || (valueLen > 7 && valueEnd[-8] != ' ' && valueEnd[-8] != ','))
+            {
+                duk_pop_3(ctx);
+                return fail(parser, 501);
+            }
+            chunked = true;
+        }
+        else if (nameLen == 10 && strncmp(line, "connection", 10) == 0)
+        {
+            keepAlive = minorVersion > 0 ? !hasToken(value, valueEnd, "close") : hasToken(value, valueEnd, "keep-alive");
+        }
+
+        duk_push_lstring(ctx, line, nameLen);
+        duk_put_prop_index(ctx, arr_idx, arr_len++);
+        duk_push_lstring(ctx, value, valueLen);
+        duk_put_prop_index(ctx, arr_idx, arr_len++);
+    }
+    if (chunked && contentLength >= 0 && parser->type == HTTP_PARSER_REQUEST)
+    {
+        // the body length of such a request is ambiguous, a proxy in front
+        // could have framed it differently (request smuggling)
+        duk_pop_3(ctx);
+        return fail(parser, 400);
+    }
+    releaseHead(parser);
+
+    if (chunked)
+    {
+        // transfer-encoding overrides content-length of a response
+        contentLength = -1;
+    }
+    duk_push_number(ctx, contentLength);
+    duk_push_boolean(ctx, chunked);
+    duk_push_boolean(ctx, keepAlive);
+    bool noBody = callHandler(ctx, handler_idx, "onHead", 6) && parser->type == HTTP_PARSER_RESPONSE;
+    noBody = noBody || status == 101 || status == 204 || status == 304;
+    if (parser->bodyError != 0)
+    {
+        return fail(parser, parser->bodyError);
+    }
+    if (!noBody && parser->maxBodySize >= 0 && contentLength > parser->maxBodySize)
+    {
+        return fail(parser, 413);
+    }
+
+    if (noBody)
+    {
+        parser->state = HP_IDLE;
+    }
+    else if (chunked)
+    {
+        parser->state = HP_CHUNK_SIZE;
+        parser->remaining = 0;
+        parser->chunkSizeDigits = 0;
+        parser->chunkExtension = false;
+    }
+    else if (contentLength > 0)
+    {
+        parser->state = HP_BODY;
+        parser->remaining = contentLength;
+    }
+    else if (contentLength < 0 && parser->type == HTTP_PARSER_RESPONSE)
+    {
+        parser->state = HP_BODY_UNTIL_CLOSE;
+    }
+    else
+    {
+        parser->state = HP_IDLE;
+    }
+
+    if (parser->state == HP_IDLE)
+    {
+        return completeMessage(ctx, parser, handler_idx);
+    }
+    return 0;
+}
+
+/**
+ * Feeds received bytes into the parser and calls the onHead, onBody and
+ * onComplete functions of the handler object. Bodies are passed to onBody
+ * as they arrive with the chunked framing removed, as strings for requests
+ * and as Uint8Array for responses. A response body without content-length
+ * and chunked encoding ends with the connection, so onComplete is not called
+ * for it.
+ * If onComplete returns true the connection is taken over, e.g. by an
+ * upgrade. Parsing stops then, the bytes after the message and all bytes
+ * passed later are given to onDetached with their length as a string.
+ * Returns HTTP_PARSER_IDLE if no message is partially received,
+ * HTTP_PARSER_IN_MESSAGE if it is, or the negative HTTP status to respond
+ * with on malformed messages.
+ */
+int executeHttpParser(duk_context *ctx, http_parser_t *parser, const char *data, size_t len, duk_idx_t handler_idx)
+{
+    size_t pos = 0;
+    while (pos < len && parser->state != HP_ERROR && parser->state != HP_DETACHED)
+    {
+        char c = data[pos];
+        switch (parser->state)
+        {
+        case HP_IDLE:
+            pos++;
+            // line breaks before the request line are ignored
+            if (c != '\r' && c != '\n')
+            {
+                parser->state = HP_HEAD;
+                parser->lineLen = 1;
+                parser->binaryBody = false;
+                parser->maxBodySize = -1;
+                parser->bodySize = 0;
+                parser->bodyError = 0;
+                if (!appendHead(parser, c))
+                {
+                    return fail(parser, 431);
+                }
+            }
+            break;
+        case HP_HEAD:
+            pos++;
+            if (!appendHead(parser, c))
+            {
+                return fail(parser, 431);
+            }
+            if (c == '\n')
+            {
+                if (parser->lineLen == 0)
+                {
+                    int ret = parseHead(ctx, parser, handler_idx);
+                    if (ret < 0)
+                    {
+                        return ret;
+                    }
+                }
+                parser->lineLen = 0;
+            }
+            else if (c != '\r')
+            {
+                parser->lineLen++;
+            }
+            break;
+        case HP_BODY:
+        case HP_CHUNK_DATA:
+        {
+            size_t n = len - pos < (size_t)parser->remaining ? len - pos : (size_t)parser->remaining;
+            parser->remaining -= n;
+            bool last = parser->remaining == 0;
+            if (last && parser->state == HP_CHUNK_DATA)
+            {
+                parser->state = HP_CHUNK_DATA_END;
+            }
+            int ret = handleBody(ctx, parser, handler_idx, data + pos, n);
+            pos += n;
+            if (ret == 0 && last && parser->state == HP_BODY)
+            {
+                ret = completeMessage(ctx, parser, handler_idx);
+            }
+            if (ret < 0)
+            {
+                return ret;
+            }
+            break;
+        }
+        case HP_BODY_UNTIL_CLOSE:
+        {
+            int ret = handleBody(ctx, parser, handler_idx, data + pos, len - pos);
+            pos = len;
+            if (ret < 0)
+            {
+                return ret;
+            }
+            break;
+        }
+        case HP_CHUNK_SIZE:
+            pos++;
+            if (c == '\n')
+            {
+                if (parser->chunkSizeDigits == 0)
+                {
+                    return fail(parser, 400);
+                }
+                parser->state = parser->remaining > 0 ? HP_CHUNK_DATA : HP_TRAILER;
+                parser->lineLen = 0;
+                parser->chunkSizeDigits = 0;
+                parser->chunkExtension = false;
+            }
+            else if (c == ';' || parser->chunkExtension)
+            {
+                parser->chunkExtension = true;
+            }
+            else if (isxdigit((unsigned char)c) && parser->remaining <= 0x7FFFFFF)
+            {
+                parser->remaining = parser->remaining * 16 + (isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+                parser->chunkSizeDigits++;
+            }
+            else if (c != '\r' && c != ' ' && c != '\t')
+            {
+                return fail(parser, 400);
+            }
+            break;
+        case HP_CHUNK_DATA_END:
+            pos++;
+            if (c == '\n')
+            {
+                parser->state = HP_CHUNK_SIZE;
+            }
+            else if (c != '\r')
+            {
+                return fail(parser, 400);
+            }
+            break;
+        case HP_TRAILER:
+            // trailer fields are skipped
+            pos++;
+            if (c == '\n')
+            {
+                if (parser->lineLen == 0)
+                {
+                    int ret = completeMessage(ctx, parser, handler_idx);
+                    if (ret < 0)
+                    {
+                        return ret;
+                    }
+                }
+                parser->lineLen = 0;
+            }
+            else if (c != '\r')
+            {
+                parser->lineLen++;
+            }
+            break;
+        }
+    }
+
+    if (parser->state == HP_ERROR)
+    {
+        return -parser->error;
+    }
+    if (parser->state == HP_DETACHED)
+    {
+        if (pos < len)
+        {
+            duk_push_lstring(ctx, data + pos, len - pos);
+            duk_push_int(ctx, len - pos);
+            callHandler(ctx, handler_idx, "onDetached", 2);
+        }
+        return HTTP_PARSER_IDLE;
+    }
+    return parser->state == HP_IDLE ? HTTP_PARSER_IDLE : HTTP_PARSER_IN_MESSAGE;
+}
+
+static duk_ret_t el_createHttpParser(duk_context *ctx)
+{
+    http_parser_t *parser = createHttpParser(duk_to_boolean(ctx, 0) ? HTTP_PARSER_RESPONSE : HTTP_PARSER_REQUEST);
+    if (parser == NULL)
+    {
+        jslog(ERROR, "Not enough memory for http parser");
+        return duk_error(ctx, DUK_ERR_ERROR, "Not enough memory for http parser");
+    }
+    duk_push_int(ctx, (duk_int_t)parser);
+    return 1;
+}
+
+static duk_ret_t el_freeHttpParser(duk_context *ctx)
+{
+    freeHttpParser((http_parser_t *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t el_executeHttpParser(duk_context *ctx)
+{
+    http_parser_t *parser = (http_parser_t *)duk_to_int(ctx, 0);
+    duk_size_t len;
+    const char *data;
+    if (duk_is_string(ctx, 1))
+    {
+        data = duk_get_lstring(ctx, 1, &len);
+    }
+    else
+    {
+        data = (const char *)duk_require_buffer_data(ctx, 1, &len);
+    }
+    duk_require_object(ctx, 2);
+
+    duk_push_int(ctx, executeHttpParser(ctx, parser, data, len, 2));
+    return 1;
+}
+
+static duk_ret_t el_setHttpParserBody(duk_context *ctx)
+{
+    http_parser_t *parser = (http_parser_t *)duk_to_int(ctx, 0);
+    bool binary = duk_to_boolean(ctx, 1);
+    long maxSize = duk_is_number(ctx, 2) ? (long)duk_get_number(ctx, 2) : -1;
+    const char *path = duk_is_string(ctx, 3) ? duk_get_string(ctx, 3) : NULL;
+    duk_push_boolean(ctx, setHttpParserBody(parser, binary, maxSize, path));
+    return 1;
+}
+
+void registerHttpParserBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_createHttpParser, 1);
+    duk_put_global_string(ctx, "el_createHttpParser");
+
+    duk_push_c_function(ctx, el_freeHttpParser, 1);
+    duk_put_global_string(ctx, "el_freeHttpParser");
+
+    duk_push_c_function(ctx, el_executeHttpParser, 3);
+    duk_put_global_string(ctx, "el_executeHttpParser");
+
+    duk_push_c_function(ctx, el_setHttpParserBody, 4);
+    duk_put_global_string(ctx, "el_setHttpParserBody");
+}
@@ -0,0 +1,108 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <lwip/sockets.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "idle-timeout.h"
+
+// Last activity and timeout of every lwIP socket, indexed by file descriptor.
+// Only accessed from the duktape task, so no locking is required.
+typedef struct
+{
+    TickType_t lastActivity;
+    TickType_t timeout;
+} idle_timeout_t;
+
+static idle_timeout_t timeouts[CONFIG_LWIP_MAX_SOCKETS];
+
+static idle_timeout_t *getIdleTimeout(int sockfd)
+{
+    int index = sockfd - LWIP_SOCKET_OFFSET;
+    if (index < 0 || index >= CONFIG_LWIP_MAX_SOCKETS)
+    {
+        return NULL;
+    }
+    return &timeouts[index];
+}
+
+void setIdleTimeout(int sockfd, int timeoutMs)
+{
+    idle_timeout_t *entry = getIdleTimeout(sockfd);
+    if (entry != NULL)
+    {
+        entry->lastActivity = xTaskGetTickCount();
+        // 0 means no timeout, so round up to at least one tick
+        entry->timeout = timeoutMs > 0 ? pdMS_TO_TICKS(timeoutMs) + 1 : 0;
+    }
+}
+
+void touchSocket(int sockfd)
+{
+    idle_timeout_t *entry = getIdleTimeout(sockfd);
+    if (entry != NULL)
+    {
+        entry->lastActivity = xTaskGetTickCount();
+    }
+}
+
+void clearIdleTimeout(int sockfd)
+{
+    idle_timeout_t *entry = getIdleTimeout(sockfd);
+    if (entry != NULL)
+    {
+        entry->timeout = 0;
+    }
+}
+
+/**
+ * Stores up to max sockets whose timeout expired into sockfds and disarms
+ * their timeouts. The number of timeouts which are still armed afterwards
+ * is stored into armed.
+ */
+int collectIdleSockets(int *sockfds, int max, int *armed)
+{
+    TickType_t now = xTaskGetTickCount();
+    int count = 0;
+    *armed = 0;
+    for (int i = 0; i < CONFIG_LWIP_MAX_SOCKETS; i++)
+    {
+        idle_timeout_t *entry = &timeouts[i];
+        if (entry->timeout == 0)
+        {
+            continue;
+        }
+        if (count < max && (TickType_t)(now - entry->lastActivity) >= entry->timeout)
+        {
+            entry->timeout = 0;
+            sockfds[count++] = i + LWIP_SOCKET_OFFSET;
+        }
+        else
+        {
+            (*armed)++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,67 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#if !defined(EL_DEFLATE_STREAM_H_INCLUDED)
+#define EL_DEFLATE_STREAM_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <duktape.h>
+
+// log2 of the LZ77 window, the stream state takes about 4.5 times the window size
+#ifndef DEFLATE_WINDOW_BITS
+#define DEFLATE_WINDOW_BITS 12
+#endif
+// number of hash chain entries compared per position
+#ifndef DEFLATE_MAX_CHAIN
+#define DEFLATE_MAX_CHAIN 8
+#endif
+
+#define DEFLATE_FORMAT_ZLIB 0
+#define DEFLATE_FORMAT_GZIP 1
+
+typedef struct deflate_stream deflate_stream_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    deflate_stream_t *createDeflateStream(int format);
+    void freeDeflateStream(deflate_stream_t *stream);
+    // maximum output of a single writeDeflateStream call with len input bytes
+    size_t deflateStreamBound(size_t len);
+    // compresses data and flushes it, so the output can be decompressed up to the
+    // last input byte, final writes the end of the stream; returns the output length
+    size_t writeDeflateStream(deflate_stream_t *stream, const uint8_t *data, size_t len, bool final, uint8_t *out);
+    void registerDeflateStreamBindings(duk_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
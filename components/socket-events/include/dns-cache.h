@@ -0,0 +1,64 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_DNS_CACHE_H_INCLUDED)
+#define EL_DNS_CACHE_H_INCLUDED
+
+#include <netinet/in.h>
+
+#define EL_DNS_RESOLVED 0
+#define EL_DNS_PENDING 1
+#define EL_DNS_FAILED -1
+
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE 8
+#endif
+#ifndef DNS_CACHE_MAX_HOSTNAME_LEN
+#define DNS_CACHE_MAX_HOSTNAME_LEN 128
+#endif
+// lifetime of successful lookups
+#ifndef DNS_CACHE_POSITIVE_TTL_MS
+#define DNS_CACHE_POSITIVE_TTL_MS (5 * 60 * 1000)
+#endif
+// lifetime of failed lookups
+#ifndef DNS_CACHE_NEGATIVE_TTL_MS
+#define DNS_CACHE_NEGATIVE_TTL_MS (10 * 1000)
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void initDnsCache();
+    int resolveHost(const char *hostname, int sockfd, int portno, struct in_addr *addr);
+    void cancelResolve(int sockfd);
+    void clearDnsCache();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_FILE_STREAM_H_INCLUDED)
+#define EL_FILE_STREAM_H_INCLUDED
+
+#include "openssl/ssl.h"
+
+// bytes read from the file and written to the socket at once
+#ifndef FILE_STREAM_CHUNK_SIZE
+#define FILE_STREAM_CHUNK_SIZE 1436
+#endif
+// chunks written per writable event before other events get their turn
+#ifndef FILE_STREAM_CHUNKS_PER_CALL
+#define FILE_STREAM_CHUNKS_PER_CALL 4
+#endif
+
+typedef struct
+{
+    FILE *file;
+    // bytes which have not been read from the file yet
+    long remaining;
+    int filled;
+    int written;
+    char buffer[FILE_STREAM_CHUNK_SIZE];
+} file_stream_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    file_stream_t *openFileStream(const char *path, long offset, long length);
+    long sendFileStream(file_stream_t *stream, int sockfd, SSL *ssl);
+    void closeFileStream(file_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_HEADER_MAP_H_INCLUDED)
+#define EL_HEADER_MAP_H_INCLUDED
+
+#include <stddef.h>
+#include <duktape.h>
+
+// names up to this length are lower cased on the stack
+#ifndef HEADER_MAP_NAME_BUFFER_SIZE
+#define HEADER_MAP_NAME_BUFFER_SIZE 64
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    int findKnownHeader(const char *name, size_t len);
+    void registerHeaderMapBindings(duk_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_HTTP_PARSER_H_INCLUDED)
+#define EL_HTTP_PARSER_H_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <duktape.h>
+
+// initial and maximum size of the buffer holding request line and headers
+#ifndef HTTP_PARSER_INITIAL_HEAD_SIZE
+#define HTTP_PARSER_INITIAL_HEAD_SIZE 256
+#endif
+#ifndef HTTP_PARSER_MAX_HEAD_SIZE
+#define HTTP_PARSER_MAX_HEAD_SIZE 4096
+#endif
+#ifndef HTTP_PARSER_MAX_RESPONSE_HEAD_SIZE
+#define HTTP_PARSER_MAX_RESPONSE_HEAD_SIZE 8192
+#endif
+
+#define HTTP_PARSER_REQUEST 0
+#define HTTP_PARSER_RESPONSE 1
+
+#define HTTP_PARSER_IDLE 0
+#define HTTP_PARSER_IN_MESSAGE 1
+
+typedef struct
+{
+    // HTTP_PARSER_REQUEST or HTTP_PARSER_RESPONSE
+    int type;
+    int state;
+    int error;
+    // request line and headers of the current request, only allocated while they are received
+    char *head;
+    int headLen;
+    int headSize;
+    // length of the current line without line breaks
+    int lineLen;
+    // remaining bytes of a content-length body or of the current chunk
+    long remaining;
+    int chunkSizeDigits;
+    bool chunkExtension;
+    // body handling of the current request, see setHttpParserBody
+    bool binaryBody;
+    long maxBodySize;
+    long bodySize;
+    FILE *bodyFile;
+    char *bodyFilePath;
+    int bodyError;
+} http_parser_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    http_parser_t *createHttpParser(int type);
+    void freeHttpParser(http_parser_t *parser);
+    int executeHttpParser(duk_context *ctx, http_parser_t *parser, const char *data, size_t len, duk_idx_t handler_idx);
+    bool setHttpParserBody(http_parser_t *parser, bool binary, long maxSize, const char *path);
+    void registerHttpParserBindings(duk_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
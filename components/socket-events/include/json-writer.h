@@ -0,0 +1,54 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_JSON_WRITER_H_INCLUDED)
+#define EL_JSON_WRITER_H_INCLUDED
+
+#include <duktape.h>
+
+// bytes of JSON produced per chunk and written to files at once
+#ifndef JSON_WRITER_CHUNK_SIZE
+#define JSON_WRITER_CHUNK_SIZE 1436
+#endif
+// nested arrays and objects, deeper values throw a RangeError
+#ifndef JSON_WRITER_MAX_DEPTH
+#define JSON_WRITER_MAX_DEPTH 256
+#endif
+#ifndef JSON_WRITER_PATH_SIZE
+#define JSON_WRITER_PATH_SIZE 64
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void registerJsonWriterBindings(duk_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#if !defined(EL_MQTT_H_INCLUDED)
+#define EL_MQTT_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <duktape.h>
+
+// MQTT 3.1.1 control packet types
+#define MQTT_CONNECT 1
+#define MQTT_CONNACK 2
+#define MQTT_PUBLISH 3
+#define MQTT_PUBACK 4
+#define MQTT_SUBSCRIBE 8
+#define MQTT_SUBACK 9
+#define MQTT_UNSUBSCRIBE 10
+#define MQTT_UNSUBACK 11
+#define MQTT_PINGREQ 12
+#define MQTT_PINGRESP 13
+#define MQTT_DISCONNECT 14
+
+// errors returned by the parser
+#define MQTT_ERROR_MALFORMED -1
+#define MQTT_ERROR_TOO_LARGE -2
+
+// packet buffers up to this size are kept for the next packet
+#ifndef MQTT_KEEP_BUFFER_SIZE
+#define MQTT_KEEP_BUFFER_SIZE 512
+#endif
+
+typedef struct
+{
+    int state;
+    // first byte of the fixed header with type and flags
+    uint8_t header;
+    // remaining length of the packet and the bits of it decoded so far
+    size_t remaining;
+    int lengthShift;
+    uint8_t *packet;
+    size_t packetLen;
+    size_t packetCap;
+    size_t maxPacketSize;
+    // set while el_executeMqttParser calls the handlers, which may free the parser
+    bool executing;
+} mqtt_parser_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    mqtt_parser_t *createMqttParser(size_t maxPacketSize);
+    /**
+     * Frees the parser. If it is called by a handler while the parser is
+     * executed, parsing stops and the parser is freed when it returned.
+     */
+    void freeMqttParser(mqtt_parser_t *parser);
+    /**
+     * Parses packets received by a client and calls onConnack(sessionPresent,
+     * returnCode), onPublish(topic, payload, qos, retain, dup, packetId),
+     * onPuback(packetId), onSuback(packetId, returnCodes), onUnsuback(packetId)
+     * and onPingresp() of the handler object at handler_idx. Returns 0 or one
+     * of the MQTT_ERROR codes.
+     */
+    int executeMqttParser(duk_context *ctx, mqtt_parser_t *parser, const uint8_t *data, size_t len, duk_idx_t handler_idx);
+    void registerMqttBindings(duk_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
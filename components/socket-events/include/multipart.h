@@ -0,0 +1,85 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_MULTIPART_H_INCLUDED)
+#define EL_MULTIPART_H_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <duktape.h>
+
+// initial and maximum size of the buffer holding the headers of a part
+#ifndef MULTIPART_INITIAL_HEAD_SIZE
+#define MULTIPART_INITIAL_HEAD_SIZE 128
+#endif
+#ifndef MULTIPART_MAX_HEAD_SIZE
+#define MULTIPART_MAX_HEAD_SIZE 2048
+#endif
+
+// boundaries are limited to 70 characters by RFC 2046
+#define MULTIPART_MAX_BOUNDARY_LENGTH 70
+
+#define MULTIPART_PARSER_IN_BODY 0
+#define MULTIPART_PARSER_COMPLETE 1
+
+typedef struct
+{
+    int state;
+    int error;
+    // "\r\n--" followed by the boundary
+    char delimiter[MULTIPART_MAX_BOUNDARY_LENGTH + 4];
+    int delimiterLen;
+    // delimiter bytes matched at the end of the data received so far
+    int matched;
+    // headers of the current part, only allocated while they are received
+    char *head;
+    int headLen;
+    int headSize;
+    // length of the current header line without line breaks
+    int lineLen;
+    // content handling of the current part, see setMultipartPartBody
+    long maxPartSize;
+    long partSize;
+    FILE *partFile;
+    char *partFilePath;
+    int partError;
+} multipart_parser_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    multipart_parser_t *createMultipartParser(const char *boundary);
+    void freeMultipartParser(multipart_parser_t *parser);
+    int executeMultipartParser(duk_context *ctx, multipart_parser_t *parser, const char *data, size_t len, duk_idx_t handler_idx);
+    bool setMultipartPartBody(multipart_parser_t *parser, long maxSize, const char *path);
+    void registerMultipartBindings(duk_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
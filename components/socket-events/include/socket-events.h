@@ -31,6 +31,12 @@ SOFTWARE.
 #define EL_SOCKET_STATUS_WRITE 0
 #define EL_SOCKET_STATUS_READ 1
 #define EL_SOCKET_STATUS_ERROR 2
+#define EL_SOCKET_STATUS_RESOLVED 3
+
+#define EL_SSL_HANDSHAKE_FAILED -1
+#define EL_SSL_HANDSHAKE_WANT_READ 0
+#define EL_SSL_HANDSHAKE_DONE 1
+#define EL_SSL_HANDSHAKE_WANT_WRITE 2
 
 #ifdef __cplusplus
 extern "C"
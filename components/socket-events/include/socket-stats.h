@@ -0,0 +1,79 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_SOCKET_STATS_H_INCLUDED)
+#define EL_SOCKET_STATS_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// number of simultaneously tracked sockets, further sockets only count towards the totals
+#ifndef SOCKET_STATS_SIZE
+#define SOCKET_STATS_SIZE 16
+#endif
+
+// counters of a single socket or the sum of all sockets, times are in microseconds
+typedef struct
+{
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t readEagain;
+    uint32_t writeEagain;
+    // completed TLS handshakes and their accumulated duration
+    uint32_t handshakes;
+    int64_t handshakeUs;
+    // sockets which received data and the accumulated time from open to the first byte
+    uint32_t firstBytes;
+    int64_t firstByteUs;
+    // readable events and the accumulated time until they were handled by the event loop
+    uint32_t dispatches;
+    int64_t dispatchUs;
+    int64_t dispatchMaxUs;
+} socket_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void initSocketStats();
+    void socketStatsOpen(int sockfd);
+    void socketStatsClose(int sockfd);
+    void socketStatsRead(int sockfd, int len, bool eagain);
+    void socketStatsWrite(int sockfd, int len, bool eagain);
+    void socketStatsReadable(int sockfd);
+    void socketStatsDispatch(int sockfd);
+    void socketStatsHandshakeStart(int sockfd);
+    void socketStatsHandshakeDone(int sockfd);
+    bool getSocketStats(int sockfd, socket_stats_t *stats);
+    void getTotalSocketStats(socket_stats_t *stats, int *openSockets, uint32_t *closed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
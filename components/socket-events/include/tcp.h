@@ -25,8 +25,10 @@ SOFTWARE.
 #if !defined(EL_TCP_H_INCLUDED)
 #define EL_TCP_H_INCLUDED
 
+#include <stdbool.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 #include "openssl/ssl.h"
 
 #ifdef __cplusplus
@@ -35,11 +37,13 @@ extern "C"
 #endif
 
     int createNonBlockingSocket(int domain, int type, int protocol, bool nonblocking);
+    int connectAddress(int sockfd, const struct in_addr *addr, int portno);
     int connectNonBlocking(int sockfd, const char *hostname, int portno);
     int bindAndListen(int sockfd, int portno);
     int acceptIncoming(int sockfd);
     int readSocket(int sockfd, char *msg, int len);
     int writeSocket(int sockfd, const char *msg, int len, SSL *ssl);
+    void shutdownSocket(int sockfd);
     void closeSocket(int sockfd);
 
 #ifdef __cplusplus
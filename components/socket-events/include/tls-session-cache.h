@@ -0,0 +1,56 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if !defined(EL_TLS_SESSION_CACHE_H_INCLUDED)
+#define EL_TLS_SESSION_CACHE_H_INCLUDED
+
+#include <stdbool.h>
+#include <mbedtls/ssl.h>
+
+#ifndef TLS_SESSION_CACHE_SIZE
+#define TLS_SESSION_CACHE_SIZE 4
+#endif
+#ifndef TLS_SESSION_CACHE_MAX_HOSTNAME_LEN
+#define TLS_SESSION_CACHE_MAX_HOSTNAME_LEN 128
+#endif
+// sessions older than this are not offered for resumption anymore
+#ifndef TLS_SESSION_CACHE_LIFETIME_MS
+#define TLS_SESSION_CACHE_LIFETIME_MS (30 * 60 * 1000)
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    bool loadTlsSession(mbedtls_ssl_context *ssl, const char *hostname, int port);
+    bool storeTlsSession(mbedtls_ssl_context *ssl, const char *hostname, int port);
+    void clearTlsSessionCache();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#if !defined(EL_WEBSOCKET_H_INCLUDED)
+#define EL_WEBSOCKET_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <duktape.h>
+
+#define WEBSOCKET_OPCODE_CONTINUATION 0
+#define WEBSOCKET_OPCODE_TEXT 1
+#define WEBSOCKET_OPCODE_BINARY 2
+#define WEBSOCKET_OPCODE_CLOSE 8
+#define WEBSOCKET_OPCODE_PING 9
+#define WEBSOCKET_OPCODE_PONG 10
+
+// close codes reported for invalid frames
+#define WEBSOCKET_CLOSE_PROTOCOL_ERROR 1002
+#define WEBSOCKET_CLOSE_INVALID_DATA 1007
+#define WEBSOCKET_CLOSE_TOO_BIG 1009
+
+// message buffers up to this size are kept for the next message
+#ifndef WEBSOCKET_KEEP_BUFFER_SIZE
+#define WEBSOCKET_KEEP_BUFFER_SIZE 1024
+#endif
+
+typedef struct
+{
+    // parses frames of a server, which are not masked
+    bool client;
+    int state;
+    uint8_t header[14];
+    size_t headerLen;
+    size_t headerSize;
+    bool fin;
+    int opcode;
+    bool masked;
+    uint8_t mask[4];
+    uint64_t payloadLen;
+    uint64_t payloadPos;
+    // data message assembled from its fragments
+    int messageOpcode;
+    uint8_t *message;
+    size_t messageLen;
+    size_t messageCap;
+    size_t maxMessageSize;
+    // payload of a control frame, which may be sent between fragments
+    uint8_t control[125];
+} websocket_parser_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    websocket_parser_t *createWebSocketParser(bool client, size_t maxMessageSize);
+    void freeWebSocketParser(websocket_parser_t *parser);
+    /**
+     * Parses received data and calls onMessage(data, binary), onPing(payload),
+     * onPong(payload) and onClose(code, reason) of the handler object at
+     * handler_idx. Returns 0 or the close code of a protocol violation.
+     */
+    int executeWebSocketParser(duk_context *ctx, websocket_parser_t *parser, const uint8_t *data, size_t len, duk_idx_t handler_idx);
+    void registerWebSocketBindings(duk_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,540 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp32-js-log.h"
+#include "json-writer.h"
+
+/*
+ * Serializes values like JSON.stringify without building the JSON text as
+ * one string. The traversal is kept in a JS array of frames instead of the
+ * C stack, so el_writeJson can stop after a chunk and continue where it
+ * left off. Each frame has JSON_FRAME_SLOTS entries: kind, container, the
+ * keys of objects, the next index and whether a member was written.
+ */
+
+#define JSON_FRAME_SLOTS 5
+#define JSON_FRAME_KIND 0
+#define JSON_FRAME_CONTAINER 1
+#define JSON_FRAME_KEYS 2
+#define JSON_FRAME_INDEX 3
+#define JSON_FRAME_WRITTEN 4
+
+#define JSON_KIND_ROOT 0
+#define JSON_KIND_ARRAY 1
+#define JSON_KIND_OBJECT 2
+
+typedef struct
+{
+    duk_context *ctx;
+    // value stack index of the buffer holding data
+    duk_idx_t buffer;
+    uint8_t *data;
+    duk_size_t length;
+    duk_size_t size;
+    // full buffers are written to the file, otherwise the buffer grows
+    FILE *file;
+    duk_size_t written;
+    bool failed;
+} json_output_t;
+
+static void flushOutput(json_output_t *out)
+{
+    if (out->length > 0 && !out->failed)
+    {
+        out->failed = fwrite(out->data, 1, out->length, out->file) != out->length;
+        out->written += out->length;
+    }
+    out->length = 0;
+}
+
+static void emit(json_output_t *out, const void *data, duk_size_t len)
+{
+    if (out->length + len > out->size)
+    {
+        if (out->file != NULL)
+        {
+            flushOutput(out);
+            if (len > out->size)
+            {
+                out->failed = out->failed || fwrite(data, 1, len, out->file) != len;
+                out->written += len;
+                return;
+            }
+        }
+        else
+        {
+            duk_size_t size = out->size * 2;
+            if (size < out->length + len)
+            {
+                size = out->length + len;
+            }
+            out->data = duk_resize_buffer(out->ctx, out->buffer, size);
+            out->size = size;
+        }
+    }
+    memcpy(out->data + out->length, data, len);
+    out->length += len;
+}
+
+static void emitString(json_output_t *out, const char *s, duk_size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    duk_size_t start = 0;
+    emit(out, "\"", 1);
+    for (duk_size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\' && c != 0xED)
+        {
+            continue;
+        }
+        if (c == 0xED)
+        {
+            const unsigned char *u = (const unsigned char *)s + i;
+            if (i + 2 >= len || u[1] < 0xA0)
+            {
+                // no surrogate
+                continue;
+            }
+            emit(out, s + start, i - start);
+            if (i + 5 < len && u[1] < 0xB0 && u[3] == 0xED && u[4] >= 0xB0)
+            {
+                // duktape keeps surrogate pairs as CESU-8, JSON text is UTF-8
+                uint32_t cp = 0x10000 + ((((u[1] & 0x0F) << 6) | (u[2] & 0x3F)) << 10) +
+                              (((u[4] & 0x0F) << 6) | (u[5] & 0x3F));
+                char utf8[4] = {(char)(0xF0 | (cp >> 18)), (char)(0x80 | ((cp >> 12) & 0x3F)),
+                                (char)(0x80 | ((cp >> 6) & 0x3F)), (char)(0x80 | (cp & 0x3F))};
+                emit(out, utf8, 4);
+                i += 5;
+            }
+            else
+            {
+                // lone surrogates are escaped like JSON.stringify does since ES2019
+                unsigned int unit = 0xD000 | ((u[1] & 0x3F) << 6) | (u[2] & 0x3F);
+                char escape[7];
+                snprintf(escape, sizeof(escape), "\\u%04x", unit);
+                emit(out, escape, 6);
+                i += 2;
+            }
+            start = i + 1;
+            continue;
+        }
+        emit(out, s + start, i - start);
+        start = i + 1;
+        char escape[6] = {'\\', (char)c, 0, 0, 0, 0};
+        int escapeLen = 2;
+        switch (c)
+        {
+        case '"':
+        case '\\':
+            break;
+        case '\b':
+            escape[1] = 'b';
+            break;
+        case '\f':
+            escape[1] = 'f';
+            break;
+        case '\n':
+            escape[1] = 'n';
+            break;
+        case '\r':
+            escape[1] = 'r';
+            break;
+        case '\t':
+            escape[1] = 't';
+            break;
+        default:
+            escape[1] = 'u';
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = hex[c >> 4];
+            escape[5] = hex[c & 0xf];
+            escapeLen = 6;
+        }
+        emit(out, escape, escapeLen);
+    }
+    emit(out, s + start, len - start);
+    emit(out, "\"", 1);
+}
+
+static void emitNumber(duk_context *ctx, json_output_t *out, duk_idx_t idx)
+{
+    double d = duk_get_number(ctx, idx);
+    if (!isfinite(d))
+    {
+        emit(out, "null", 4);
+    }
+    else if (fabs(d) < 9007199254740992.0 && d == (double)(int64_t)d)
+    {
+        char number[24];
+        int len = snprintf(number, sizeof(number), "%lld", (long long)d);
+        emit(out, number, len);
+    }
+    else
+    {
+        duk_size_t len;
+        duk_dup(ctx, idx);
+        const char *number = duk_to_lstring(ctx, -1, &len);
+        emit(out, number, len);
+        duk_pop(ctx);
+    }
+}
+
+static duk_int_t getSlot(duk_context *ctx, duk_idx_t state, duk_uarridx_t slot)
+{
+    duk_get_prop_index(ctx, state, slot);
+    duk_int_t value = duk_get_int(ctx, -1);
+    duk_pop(ctx);
+    return value;
+}
+
+static void setSlot(duk_context *ctx, duk_idx_t state, duk_uarridx_t slot, duk_int_t value)
+{
+    duk_push_int(ctx, value);
+    duk_put_prop_index(ctx, state, slot);
+}
+
+// pushes a frame for the container at idx, keys is DUK_INVALID_INDEX for arrays
+static void pushFrame(duk_context *ctx, duk_idx_t state, int kind, duk_idx_t idx, duk_idx_t keys)
+{
+    state = duk_normalize_index(ctx, state);
+    duk_uarridx_t frame = duk_get_length(ctx, state);
+    setSlot(ctx, state, frame + JSON_FRAME_KIND, kind);
+    duk_dup(ctx, idx);
+    duk_put_prop_index(ctx, state, frame + JSON_FRAME_CONTAINER);
+    if (keys != DUK_INVALID_INDEX)
+    {
+        duk_dup(ctx, keys);
+    }
+    else
+    {
+        duk_push_null(ctx);
+    }
+    duk_put_prop_index(ctx, state, frame + JSON_FRAME_KEYS);
+    setSlot(ctx, state, frame + JSON_FRAME_INDEX, 0);
+    setSlot(ctx, state, frame + JSON_FRAME_WRITTEN, 0);
+}
+
+// applies toJSON to the value on top and returns false if it is not serialized
+static bool prepareValue(duk_context *ctx, duk_idx_t key)
+{
+    if (duk_is_object(ctx, -1) && !duk_is_function(ctx, -1))
+    {
+        duk_get_prop_string(ctx, -1, "toJSON");
+        if (duk_is_function(ctx, -1))
+        {
+            duk_dup(ctx, -2);
+            duk_dup(ctx, key);
+            duk_call_method(ctx, 1);
+            duk_remove(ctx, -2);
+        }
+        else
+        {
+            duk_pop(ctx);
+        }
+    }
+    return !duk_is_undefined(ctx, -1) && !duk_is_function(ctx, -1) && !duk_is_symbol(ctx, -1);
+}
+
+// writes primitives, containers are opened and pushed as a new frame
+static duk_ret_t writeValue(duk_context *ctx, duk_idx_t state, json_output_t *out)
+{
+    duk_idx_t idx = duk_get_top_index(ctx);
+    switch (duk_get_type(ctx, idx))
+    {
+    case DUK_TYPE_BOOLEAN:
+        if (duk_get_boolean(ctx, idx))
+        {
+            emit(out, "true", 4);
+        }
+        else
+        {
+            emit(out, "false", 5);
+        }
+        return 0;
+    case DUK_TYPE_NUMBER:
+        emitNumber(ctx, out, idx);
+        return 0;
+    case DUK_TYPE_STRING:
+    {
+        duk_size_t len;
+        const char *s = duk_get_lstring(ctx, idx, &len);
+        emitString(out, s, len);
+        return 0;
+    }
+    case DUK_TYPE_BUFFER:
+        // plain buffers are serialized like Uint8Arrays
+        duk_to_object(ctx, idx);
+        break;
+    case DUK_TYPE_OBJECT:
+        break;
+    default:
+        emit(out, "null", 4);
+        return 0;
+    }
+
+    duk_uarridx_t length = duk_get_length(ctx, state);
+    if (length / JSON_FRAME_SLOTS > JSON_WRITER_MAX_DEPTH)
+    {
+        return duk_error(ctx, DUK_ERR_RANGE_ERROR, "json nesting too deep");
+    }
+    void *heapptr = duk_get_heapptr(ctx, idx);
+    // the root frame holds the root value before it was opened
+    for (duk_uarridx_t frame = JSON_FRAME_SLOTS; frame < length; frame += JSON_FRAME_SLOTS)
+    {
+        duk_get_prop_index(ctx, state, frame + JSON_FRAME_CONTAINER);
+        bool cyclic = duk_get_heapptr(ctx, -1) == heapptr;
+        duk_pop(ctx);
+        if (cyclic)
+        {
+            return duk_error(ctx, DUK_ERR_TYPE_ERROR, "cyclic input");
+        }
+    }
+
+    if (duk_is_array(ctx, idx))
+    {
+        emit(out, "[", 1);
+        pushFrame(ctx, state, JSON_KIND_ARRAY, idx, DUK_INVALID_INDEX);
+    }
+    else
+    {
+        duk_uarridx_t count = 0;
+        duk_idx_t keys = duk_push_array(ctx);
+        duk_enum(ctx, idx, DUK_ENUM_OWN_PROPERTIES_ONLY);
+        while (duk_next(ctx, -1, 0))
+        {
+            duk_put_prop_index(ctx, keys, count++);
+        }
+        duk_pop(ctx);
+        emit(out, "{", 1);
+        pushFrame(ctx, state, JSON_KIND_OBJECT, idx, keys);
+    }
+    return 0;
+}
+
+// writes until the output holds limit bytes, returns true if everything was written
+static bool encode(duk_context *ctx, duk_idx_t state, json_output_t *out, duk_size_t limit)
+{
+    duk_idx_t base = duk_get_top(ctx);
+    while (out->length < limit && !out->failed)
+    {
+        duk_uarridx_t length = duk_get_length(ctx, state);
+        if (length == 0)
+        {
+            return true;
+        }
+        duk_uarridx_t frame = length - JSON_FRAME_SLOTS;
+        duk_int_t kind = getSlot(ctx, state, frame + JSON_FRAME_KIND);
+        duk_int_t index = getSlot(ctx, state, frame + JSON_FRAME_INDEX);
+        duk_get_prop_index(ctx, state, frame + JSON_FRAME_CONTAINER);
+        duk_idx_t container = duk_get_top_index(ctx);
+
+        duk_uarridx_t count = 1;
+        if (kind == JSON_KIND_ARRAY)
+        {
+            count = duk_get_length(ctx, container);
+        }
+        else if (kind == JSON_KIND_OBJECT)
+        {
+            duk_get_prop_index(ctx, state, frame + JSON_FRAME_KEYS);
+            count = duk_get_length(ctx, -1);
+        }
+
+        if ((duk_uarridx_t)index >= count)
+        {
+            if (kind != JSON_KIND_ROOT)
+            {
+                emit(out, kind == JSON_KIND_ARRAY ? "]" : "}", 1);
+            }
+            duk_set_length(ctx, state, frame);
+        }
+        else
+        {
+            setSlot(ctx, state, frame + JSON_FRAME_INDEX, index + 1);
+            if (kind == JSON_KIND_ROOT)
+            {
+                duk_push_string(ctx, "");
+                duk_dup(ctx, container);
+                if (prepareValue(ctx, -2))
+                {
+                    writeValue(ctx, state, out);
+                }
+            }
+            else if (kind == JSON_KIND_ARRAY)
+            {
+                if (index > 0)
+                {
+                    emit(out, ",", 1);
+                }
+                duk_push_int(ctx, index);
+                duk_get_prop_index(ctx, container, index);
+                if (!prepareValue(ctx, -2))
+                {
+                    duk_pop(ctx);
+                    duk_push_null(ctx);
+                }
+                writeValue(ctx, state, out);
+            }
+            else
+            {
+                duk_get_prop_index(ctx, -1, index);
+                duk_idx_t key = duk_get_top_index(ctx);
+                duk_dup(ctx, key);
+                duk_get_prop(ctx, container);
+                if (prepareValue(ctx, key))
+                {
+                    if (getSlot(ctx, state, frame + JSON_FRAME_WRITTEN))
+                    {
+                        emit(out, ",", 1);
+                    }
+                    else
+                    {
+                        setSlot(ctx, state, frame + JSON_FRAME_WRITTEN, 1);
+                    }
+                    duk_size_t len;
+                    const char *name = duk_to_lstring(ctx, key, &len);
+                    emitString(out, name, len);
+                    emit(out, ":", 1);
+                    writeValue(ctx, state, out);
+                }
+            }
+        }
+        duk_set_top(ctx, base);
+    }
+    return false;
+}
+
+static duk_ret_t el_createJsonWriter(duk_context *ctx)
+{
+    duk_push_array(ctx);
+    pushFrame(ctx, -1, JSON_KIND_ROOT, 0, DUK_INVALID_INDEX);
+    return 1;
+}
+
+static duk_ret_t el_writeJson(duk_context *ctx)
+{
+    duk_size_t limit = duk_get_uint_default(ctx, 1, JSON_WRITER_CHUNK_SIZE);
+    if (limit == 0)
+    {
+        limit = JSON_WRITER_CHUNK_SIZE;
+    }
+    json_output_t out = {0};
+    out.ctx = ctx;
+    out.size = limit + 16;
+    out.data = duk_push_dynamic_buffer(ctx, out.size);
+    out.buffer = duk_get_top_index(ctx);
+
+    encode(ctx, 0, &out, limit);
+    if (out.length == 0)
+    {
+        duk_push_null(ctx);
+        return 1;
+    }
+    duk_resize_buffer(ctx, out.buffer, out.length);
+    duk_push_buffer_object(ctx, out.buffer, 0, out.length, DUK_BUFOBJ_UINT8ARRAY);
+    return 1;
+}
+
+static duk_ret_t writeJsonFileSafe(duk_context *ctx, void *udata)
+{
+    json_output_t *out = (json_output_t *)udata;
+    out->data = duk_push_fixed_buffer(ctx, out->size);
+    out->buffer = duk_get_top_index(ctx);
+    encode(ctx, 0, out, (duk_size_t)-1);
+    flushOutput(out);
+    return 0;
+}
+
+static duk_ret_t el_writeJsonFile(duk_context *ctx)
+{
+    duk_size_t pathLen;
+    const char *path = duk_require_lstring(ctx, 0, &pathLen);
+    char filePath[JSON_WRITER_PATH_SIZE];
+    char tmpPath[JSON_WRITER_PATH_SIZE + 4];
+    if (pathLen >= sizeof(filePath))
+    {
+        return duk_error(ctx, DUK_ERR_RANGE_ERROR, "path too long: %s", path);
+    }
+    strcpy(filePath, path);
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", filePath);
+
+    // encoded in a state array like the chunks, with the file as output
+    duk_push_array(ctx);
+    pushFrame(ctx, -1, JSON_KIND_ROOT, 1, DUK_INVALID_INDEX);
+    duk_replace(ctx, 0);
+    duk_set_top(ctx, 1);
+
+    json_output_t out = {0};
+    out.ctx = ctx;
+    out.size = JSON_WRITER_CHUNK_SIZE;
+    out.file = fopen(tmpPath, "w");
+    if (out.file == NULL)
+    {
+        jslog(ERROR, "Failed to open %s for writing", tmpPath);
+        duk_push_int(ctx, -1);
+        return 1;
+    }
+
+    duk_int_t rc = duk_safe_call(ctx, writeJsonFileSafe, &out, 1, 1);
+    bool failed = fclose(out.file) != 0 || out.failed || rc != DUK_EXEC_SUCCESS;
+    // the previous file stays untouched if the value could not be written
+    if (failed)
+    {
+        remove(tmpPath);
+        if (rc != DUK_EXEC_SUCCESS)
+        {
+            return duk_throw(ctx);
+        }
+        jslog(ERROR, "Failed to write %s", tmpPath);
+        duk_push_int(ctx, -1);
+        return 1;
+    }
+    remove(filePath);
+    if (rename(tmpPath, filePath) != 0)
+    {
+        jslog(ERROR, "Failed to rename %s to %s", tmpPath, filePath);
+        duk_push_int(ctx, -1);
+        return 1;
+    }
+    duk_push_number(ctx, out.written);
+    return 1;
+}
+
+void registerJsonWriterBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_createJsonWriter, 1);
+    duk_put_global_string(ctx, "el_createJsonWriter");
+
+    duk_push_c_function(ctx, el_writeJson, 2);
+    duk_put_global_string(ctx, "el_writeJson");
+
+    duk_push_c_function(ctx, el_writeJsonFile, 2);
+    duk_put_global_string(ctx, "el_writeJsonFile");
+}
@@ -1,5 +1,5 @@
 Object.defineProperty(exports, "__esModule", { value: true });
-exports.sockListen = exports.sockConnect = exports.closeSocket = exports.sockets = void 0;
+exports.getSocketStats = exports.sockListen = exports.sockConnect = exports.closeSocket = exports.sockets = void 0;
 var esp32_js_eventloop_1 = require("esp32-js-eventloop");
 var sslClientCtx;
 exports.sockets = [];
@@ -14,6 +14,60 @@ exports.sockets.find = function (predicate) {
         }
     }
 };
+// queued by flush to call its callback after the pending writes
+var noData = new Uint8Array(0);
+/**
+ * Writes the queued buffers of a socket until the socket would block. Returns
+ * true if the queue is empty, otherwise it continues when the socket is
+ * writable again.
+ */
+function writeQueued(socket) {
+    socket.onWritable = null;
+    while (socket.writebuffer.length > 0) {
+        var entry = socket.writebuffer[0];
+        var written = entry.written;
+        var data = entry.data;
+        var len = entry.len;
+        if (written < len) {
+            if (socket.sockfd === null) {
+                console.error("error writing to socket. not initialized.");
+                break;
+            }
+            else {
+                console.debug("before write to socket");
+                var ret = writeSocket(socket.sockfd, data, len - written, written, socket.ssl);
+                console.debug("after write to socket");
+                if (ret == 0) {
+                    // eagain, return immediately and wait for futher onWritable calls
+                    console.debug("eagain in onWritable, socket " + socket.sockfd);
+                    // wait for next select when socket is writable
+                    break;
+                }
+                if (ret >= 0) {
+                    written += ret;
+                    entry.written = written;
+                }
+                else {
+                    console.error("error writing to socket:" + ret);
+                    break;
+                }
+            }
+        }
+        if (written >= len) {
+            // remove entry because it has been written completely.
+            console.debug("// remove entry because it has been written completely.");
+            socket.writebuffer.shift();
+            if (entry.cb) {
+                entry.cb();
+            }
+        }
+    }
+    var bufferEmpty = socket.writebuffer.length === 0;
+    if (!bufferEmpty) {
+        socket.onWritable = writeQueued;
+    }
+    return bufferEmpty;
+}
 /**
  * @class
  */
@@ -24,8 +78,7 @@ var Socket = /** @class */ (function () {
         this.dataBufferSize = 0;
         this.textEncoder = new TextEncoder();
         this.writebuffer = [];
-        this.readTimeout = -1; // infinite
-        this.readTimeoutHandle = -1;
+        this.fileStream = -1;
         /**
          * The socket file descriptor.
          * @type {number}
@@ -42,28 +95,52 @@ var Socket = /** @class */ (function () {
         this.onClose = null;
         this.onWritable = null;
         this.isConnected = false;
+        this.isResolving = false;
         this.isError = false;
         this.isListening = false;
+        /**
+         * If the TLS server handshake of an accepted socket is still in progress.
+         */
+        this.isHandshaking = false;
+        this.onHandshake = null;
+        /**
+         * The listening socket which accepted this socket.
+         */
+        this.acceptedBy = null;
+        /**
+         * If the socket is an idle keep-alive connection which can be closed
+         * to admit new connections. Reset whenever data is received.
+         */
+        this.isIdle = false;
+        /**
+         * If the connection was taken over from its protocol, e.g. by a websocket
+         * or an event stream. Such long-lived connections are not counted towards
+         * maxConnections of the listener, so they cannot lock out other clients.
+         */
+        this.isUpgraded = false;
+        /**
+         * Stops waiting for received data while set, so the peer is slowed down
+         * by TCP flow control, e.g. until a consumer has processed the data.
+         */
+        this.readPaused = false;
         this.ssl = null;
+        /**
+         * If the TLS handshake resumed a cached session instead of performing a full handshake.
+         */
+        this.sslResumed = false;
         this.flushAlways = true;
     }
+    /**
+     * Closes the socket if no data was received for the given number of
+     * milliseconds. The last activity is tracked natively on every read, a
+     * value <= 0 disables the timeout.
+     *
+     * @param readTimeout The timeout in milliseconds.
+     */
     Socket.prototype.setReadTimeout = function (readTimeout) {
-        this.readTimeout = readTimeout;
-        this.extendReadTimeout();
-    };
-    Socket.prototype.clearReadTimeoutTimer = function () {
-        if (this.readTimeoutHandle >= 0) {
-            clearTimeout(this.readTimeoutHandle);
-        }
-    };
-    Socket.prototype.extendReadTimeout = function () {
-        var _this = this;
-        this.clearReadTimeoutTimer();
-        if (this.readTimeout > 0) {
-            this.readTimeoutHandle = setTimeout(function () {
-                console.log("Close socket because of read timeout.");
-                closeSocket(_this);
-            }, this.readTimeout);
+        el_setIdleTimeout(this.sockfd, readTimeout);
+        if (readTimeout > 0) {
+            scheduleIdleSweep();
         }
     };
     Socket.prototype.write = function (data) {
@@ -95,54 +172,91 @@ var Socket = /** @class */ (function () {
             this.dataBufferSize += data.length;
         }
     };
-    Socket.prototype.flush = function (cb) {
-        var onWritable = function (socket) {
-            socket.onWritable = null;
-            while (socket.writebuffer.length > 0) {
-                var entry = socket.writebuffer[0];
-                var written = entry.written;
-                var data = entry.data;
-                var len = entry.len;
-                if (written < len) {
-                    if (socket.sockfd === null) {
-                        console.error("error writing to socket. not initialized.");
-                        break;
-                    }
-                    else {
-                        console.debug("before write to socket");
-                        var ret = writeSocket(socket.sockfd, data, len - written, written, socket.ssl);
-                        console.debug("after write to socket");
-                        if (ret == 0) {
-                            // eagain, return immediately and wait for futher onWritable calls
-                            console.debug("eagain in onWritable, socket " + socket.sockfd);
-                            // wait for next select when socket is writable
-                            break;
-                        }
-                        if (ret >= 0) {
-                            written += ret;
-                            entry.written = written;
-                        }
-                        else {
-                            console.error("error writing to socket:" + ret);
-                            break;
-                        }
-                    }
-                }
-                if (written >= len) {
-                    // remove entry because it has been written completely.
-                    console.debug("// remove entry because it has been written completely.");
-                    socket.writebuffer.shift();
-                    if (entry.cb) {
-                        entry.cb();
-                    }
+    /**
+     * Queues data without copying it, so one encoded buffer can be sent to
+     * many sockets. Pending writes are flushed first and the data must not be
+     * modified afterwards.
+     *
+     * @param data The data.
+     * @param cb Gets called when the data was written completely.
+     */
+    Socket.prototype.writeShared = function (data, cb) {
+        this.flush();
+        this.writebuffer.push({ data: data, written: 0, len: data.length, cb: cb });
+        writeQueued(this);
+    };
+    /**
+     * Streams a file from /modules or /data to the socket. The file is sent
+     * natively in chunks whenever the socket is writable, so its content is
+     * never copied into the JS heap. Pending writes are flushed first and
+     * nothing else must be written to the socket until the callback was called.
+     *
+     * @param path The file path.
+     * @param cb Gets called when the file was sent completely or with an error.
+     * @param offset Position in the file to start from.
+     * @param length Maximum number of bytes to send.
+     * @returns If the file could be opened.
+     */
+    Socket.prototype.sendFile = function (path, cb, offset, length) {
+        var _this = this;
+        if (this.fileStream >= 0) {
+            throw Error("a file is already being sent");
+        }
+        var stream = el_openFileStream(path, offset, length);
+        if (stream < 0) {
+            return false;
+        }
+        this.fileStream = stream;
+        this.fileStreamCb = cb;
+        var start = function () {
+            _this.onWritable = function () { return _this.sendFileChunks(); };
+            _this.sendFileChunks();
+        };
+        if (this.dataBufferSize > 0) {
+            this.flush(start);
+        }
+        else if (this.writebuffer.length > 0) {
+            // start after the last queued write
+            var last = this.writebuffer[this.writebuffer.length - 1];
+            var lastCb = last.cb;
+            last.cb = function () {
+                if (lastCb) {
+                    lastCb();
                 }
+                start();
+            };
+        }
+        else {
+            start();
+        }
+        return true;
+    };
+    Socket.prototype.sendFileChunks = function () {
+        var remaining = el_sendFileStream(this.fileStream, this.sockfd, this.ssl);
+        if (remaining > 0) {
+            return false;
+        }
+        this.closeFileStream(remaining < 0 ? Error("error sending file on socket " + this.sockfd) : undefined);
+        return true;
+    };
+    /**
+     * Stops a running file transfer started by {@link sendFile} and calls its callback.
+     *
+     * @param error The error passed to the callback.
+     */
+    Socket.prototype.closeFileStream = function (error) {
+        if (this.fileStream >= 0) {
+            el_closeFileStream(this.fileStream);
+            this.fileStream = -1;
+            this.onWritable = null;
+            var cb = this.fileStreamCb;
+            this.fileStreamCb = undefined;
+            if (cb) {
+                cb(error);
             }
-            var bufferEmpty = socket.writebuffer.length === 0;
-            if (!bufferEmpty) {
-                socket.onWritable = onWritable;
-            }
-            return bufferEmpty;
-        };
+        }
+    };
+    Socket.prototype.flush = function (cb) {
         if (this.dataBufferSize > 0 && this.dataBuffer) {
             this.writebuffer.push({
                 data: this.dataBuffer,
@@ -150,7 +264,7 @@ var Socket = /** @class */ (function () {
                 len: this.dataBufferSize,
                 cb: cb,
             });
-            var writtenCompletely = onWritable(this);
+            var writtenCompletely = writeQueued(this);
             if (!writtenCompletely) {
                 // if not written completely the buffer was stored in write queue
                 // and a new buffer must be created to prevent race conditions
@@ -158,9 +272,35 @@ var Socket = /** @class */ (function () {
             }
             this.dataBufferSize = 0;
         }
+        else if (cb) {
+            this.writebuffer.push({ data: noData, written: 0, len: 0, cb: cb });
+            writeQueued(this);
+        }
     };
     return Socket;
 }());
+var idleSweepInterval = 1000;
+var idleSweepHandle = -1;
+/**
+ * Closes sockets whose read timeout expired. A single coarse timer checks
+ * all sockets as long as any read timeout is set.
+ */
+function sweepIdleSockets() {
+    idleSweepHandle = -1;
+    var result = el_sweepIdleSockets();
+    result.expired.forEach(function (sockfd) {
+        console.log("Close socket because of read timeout.");
+        closeSocket(sockfd);
+    });
+    if (result.armed > 0) {
+        scheduleIdleSweep();
+    }
+}
+function scheduleIdleSweep() {
+    if (idleSweepHandle < 0) {
+        idleSweepHandle = setTimeout(sweepIdleSockets, idleSweepInterval);
+    }
+}
 function getOrCreateNewSocket() {
     return new Socket();
 }
@@ -197,7 +337,7 @@ function closeSocket(socketOrSockfd) {
     if (socket.ssl) {
         shutdownSSL(socket.ssl);
     }
-    socket.clearReadTimeoutTimer();
+    socket.closeFileStream(Error("socket closed"));
     el_closeSocket(socket.sockfd);
     if (socket.ssl) {
         freeSSL(socket.ssl);
@@ -206,6 +346,16 @@ function closeSocket(socketOrSockfd) {
     resetSocket(socket);
 }
 exports.closeSocket = closeSocket;
+/**
+ * Stops sending on a socket, the peer reads the end of the stream after the
+ * data written so far. Data is still received until the socket is closed.
+ *
+ * @param {(module:socket-events~Socket|number)}
+ */
+function shutdownSocket(socketOrSockfd) {
+    el_shutdownSocket(typeof socketOrSockfd === "number" ? socketOrSockfd : socketOrSockfd.sockfd);
+}
+exports.shutdownSocket = shutdownSocket;
 /**
  * Connects to specified host and port.
  *
@@ -221,7 +371,8 @@ exports.closeSocket = closeSocket;
  */
 function sockConnect(ssl, host, port, onConnect, onData, onError, onClose) {
     var sockfd = el_createNonBlockingSocket();
-    el_connectNonBlocking(sockfd, host, parseInt(port, 10));
+    // returns 1 if the hostname is still being resolved by the dns task
+    var ret = el_connectNonBlocking(sockfd, host, parseInt(port, 10));
     var socket = getOrCreateNewSocket();
     socket.sockfd = sockfd;
     socket.onData = onData;
@@ -229,7 +380,8 @@ function sockConnect(ssl, host, port, onConnect, onData, onError, onClose) {
     socket.onError = onError;
     socket.onClose = onClose;
     socket.isConnected = false;
-    socket.isError = false;
+    socket.isResolving = ret > 0;
+    socket.isError = ret < 0;
     socket.isListening = false;
     socket.ssl = null;
     if (ssl) {
@@ -239,7 +391,7 @@ function sockConnect(ssl, host, port, onConnect, onData, onError, onClose) {
                 : sslClientCtx;
         socket.ssl = createSSL(sslClientCtx, host);
         socket.onConnect = function (skt) {
-            var result = connectSSL(skt.ssl, skt.sockfd);
+            var result = connectSSL(skt.ssl, skt.sockfd, host, parseInt(port, 10));
             if (result == 0) {
                 // retry
                 return true;
@@ -250,6 +402,8 @@ function sockConnect(ssl, host, port, onConnect, onData, onError, onClose) {
                 return false;
             }
             else {
+                // 2 means the cached session for host and port was resumed
+                skt.sslResumed = result === 2;
                 return onConnect(skt);
             }
         };
@@ -257,10 +411,67 @@ function sockConnect(ssl, host, port, onConnect, onData, onError, onClose) {
     if (exports.sockets.indexOf(socket) < 0) {
         exports.sockets.push(socket);
     }
+    if (socket.isError) {
+        // report unresolvable hosts asynchronously, like any other socket error
+        setTimeout(function () {
+            if (socket.onError) {
+                socket.onError(sockfd);
+            }
+        }, 0);
+    }
     return socket;
 }
 exports.sockConnect = sockConnect;
-function sockListen(port, onAccept, onError, onClose, isSSL) {
+/**
+ * Continues the TLS server handshake of an accepted socket. Depending on
+ * what the handshake waits for, it is resumed by the next readable or
+ * writable event of the socket.
+ */
+function continueHandshake(socket, onAccept) {
+    var result = acceptSSL(socket.ssl, socket.sockfd);
+    if (result === 1) {
+        socket.isHandshaking = false;
+        socket.onHandshake = null;
+        socket.onWritable = null;
+        // clear handshake deadline
+        socket.setReadTimeout(-1);
+        if (onAccept) {
+            onAccept(socket);
+        }
+    }
+    else if (result < 0) {
+        console.error("error accepting ssl: " + result);
+        closeSocket(socket);
+    }
+    else if (result === 2) {
+        // wait until the socket is writable
+        socket.onWritable = function () {
+            continueHandshake(socket, onAccept);
+            return true;
+        };
+    }
+    else {
+        // wait until the socket is readable
+        socket.onWritable = null;
+    }
+}
+/**
+ * Listens on the specified port.
+ *
+ * @param {(string|number)} port The local port.
+ * @param onAccept A callback which gets called for each accepted socket. For secure sockets it gets called after the TLS handshake has completed.
+ * @param {module:socket-events~onErrorCB} onError A callback which gets called on an error event.
+ * @param {module:socket-events~onCloseCB} onClose A callback which gets called on a close event.
+ * @param {boolean} isSSL If we want to accept connections via SSL.
+ * @param {module:socket-events~SockListenOptions} options Handshake timeout and connection limits.
+ *
+ * @returns {module:socket-events~Socket} The listening socket or null on error.
+ */
+function sockListen(port, onAccept, onError, onClose, isSSL, options) {
+    var handshakeTimeout = (options && options.handshakeTimeout) || 10000;
+    var acceptBudget = (options && options.acceptBudget) || 4;
+    var maxConnections = (options && options.maxConnections) || 0;
+    var onReject = options && options.onReject;
     var sslCtx = null;
     if (isSSL) {
         sslCtx = createSSLServerContext();
@@ -276,39 +487,77 @@ function sockListen(port, onAccept, onError, onClose, isSSL) {
     else {
         var socket = getOrCreateNewSocket();
         socket.sockfd = sockfd;
-        socket.onAccept = function () {
-            var ssl = null;
-            if (isSSL) {
-                ssl = createSSL(sslCtx);
+        // closes the oldest idle socket of this listener if the limit is reached
+        var admit = function () {
+            var accepted = exports.sockets.filter(function (s) {
+                return s.acceptedBy === socket && !s.isUpgraded;
+            });
+            if (accepted.length < maxConnections) {
+                return true;
             }
-            var newsockfd = el_acceptIncoming(sockfd);
-            if (newsockfd < 0) {
-                console.error("accept returned: " + newsockfd);
-                onError(sockfd);
+            var idle = accepted.filter(function (s) {
+                return s.isIdle;
+            })[0];
+            if (idle) {
+                console.debug("Closing idle socket " + idle.sockfd + " to admit new one");
+                closeSocket(idle);
+                return true;
             }
-            else if (typeof newsockfd !== "undefined") {
-                //EAGAIN
-                var newSocket = getOrCreateNewSocket();
-                newSocket.sockfd = newsockfd;
-                newSocket.isConnected = false;
-                newSocket.isError = false;
-                newSocket.isListening = false;
-                newSocket.ssl = ssl;
-                if (exports.sockets.indexOf(newSocket) < 0) {
-                    exports.sockets.push(newSocket);
-                }
-                if (onAccept) {
-                    onAccept(newSocket);
+            return false;
+        };
+        var acceptSocket = function (newsockfd) {
+            var newSocket = getOrCreateNewSocket();
+            newSocket.sockfd = newsockfd;
+            newSocket.isConnected = false;
+            newSocket.isError = false;
+            newSocket.isListening = false;
+            if (exports.sockets.indexOf(newSocket) < 0) {
+                exports.sockets.push(newSocket);
+            }
+            if (maxConnections > 0 && !admit()) {
+                console.warn("Connection limit of " + maxConnections + " reached on port " + port);
+                if (!isSSL && onReject) {
+                    // only a short grace period to deliver the rejection
+                    newSocket.setReadTimeout(2000);
+                    onReject(newSocket);
                 }
-                if (isSSL) {
-                    var sslConnected = acceptSSL(ssl, newsockfd);
-                    if (sslConnected <= 0) {
-                        closeSocket(newsockfd);
-                    }
+                else {
+                    closeSocket(newSocket);
                 }
+                return;
             }
-            else {
-                console.debug("EAGAIN received after accept...");
+            newSocket.acceptedBy = socket;
+            if (isSSL) {
+                newSocket.ssl = createSSL(sslCtx);
+                // the handshake needs read events right away
+                newSocket.isConnected = true;
+                newSocket.isHandshaking = true;
+                newSocket.onHandshake = function () {
+                    continueHandshake(newSocket, onAccept);
+                };
+                // abort handshakes which do not complete in time
+                newSocket.setReadTimeout(handshakeTimeout);
+                continueHandshake(newSocket, onAccept);
+            }
+            else if (onAccept) {
+                onAccept(newSocket);
+            }
+        };
+        socket.onAccept = function () {
+            // drain the backlog, but leave room for other events in this turn
+            for (var i = 0; i < acceptBudget; i++) {
+                var newsockfd = el_acceptIncoming(sockfd);
+                if (newsockfd < 0) {
+                    console.error("accept returned: " + newsockfd);
+                    onError(sockfd);
+                    return;
+                }
+                else if (typeof newsockfd === "undefined") {
+                    //EAGAIN
+                    console.debug("EAGAIN received after accept...");
+                    return;
+                }
+                acceptSocket(newsockfd);
             }
         };
         socket.onError = function (sockfd) {
@@ -327,6 +576,28 @@ function sockListen(port, onAccept, onError, onClose, isSSL) {
     }
 }
 exports.sockListen = sockListen;
+/**
+ * Returns the traffic and latency counters of a socket, which are kept
+ * natively and only converted on request. Without argument the counters
+ * of all sockets since boot are summed up and the number of open and
+ * closed sockets is added. Times are in microseconds: handshakeUs is the
+ * accumulated TLS handshake duration, firstByteUs the time from opening
+ * the socket to the first received byte and dispatchUs the time between
+ * a socket becoming readable and the event loop reading it.
+ *
+ * @param {(module:socket-events~Socket|number)} socketOrSockfd The socket or its file descriptor.
+ * @returns The counters or undefined if the socket is not tracked.
+ */
+function getSocketStats(socketOrSockfd) {
+    if (typeof socketOrSockfd === "number") {
+        return el_getSocketStats(socketOrSockfd);
+    }
+    else if (typeof socketOrSockfd === "object") {
+        return el_getSocketStats(socketOrSockfd.sockfd);
+    }
+    return el_getSocketStats();
+}
+exports.getSocketStats = getSocketStats;
 function resetSocket(socket) {
     if (socket) {
         exports.sockets.splice(exports.sockets.indexOf(socket), 1);
@@ -337,10 +608,10 @@ function resetSocket(socket) {
 function beforeSuspend() {
     //collect sockets
     function notConnectedFilter(s) {
-        return !s.isConnected && !s.isListening;
+        return !s.isConnected && !s.isListening && !s.isResolving;
     }
     function connectedFilter(s) {
-        return s.isConnected;
+        return s.isConnected && !s.readPaused;
     }
     function connectedWritableFilter(s) {
         return s.isConnected && s.onWritable;
@@ -393,6 +664,9 @@ function afterSuspend(evt, collected) {
                 if (socket_1.isListening && socket_1.onAccept) {
                     collected.push(socket_1.onAccept);
                 }
+                else if (socket_1.isHandshaking && socket_1.onHandshake) {
+                    collected.push(socket_1.onHandshake);
+                }
                 else {
                     console.debug("before eventloop read socket");
                     var result = readSocket(socket_1.sockfd, socket_1.ssl);
@@ -405,8 +679,8 @@ function afterSuspend(evt, collected) {
                         console.debug("******** EAGAIN!!");
                     }
                     else {
+                        socket_1.isIdle = false;
                         if (socket_1.onData) {
-                            socket_1.extendReadTimeout();
                             collected.push((function (data, fd, length) { return function () {
                                 socket_1.onData(data, fd, length);
                             }; })(result.data, socket_1.sockfd, result.length));
@@ -416,6 +690,7 @@ function afterSuspend(evt, collected) {
             }
             else if (evt.status === 2) {
                 //error
+                socket_1.isResolving = false;
                 socket_1.isError = true;
                 if (socket_1.onError) {
                     collected.push((function (sockfd) { return function () {
@@ -423,6 +698,10 @@ function afterSuspend(evt, collected) {
                     }; })(socket_1.sockfd));
                 }
             }
+            else if (evt.status === 3) {
+                //resolved, connect is in progress and will signal writable
+                socket_1.isResolving = false;
+            }
             else {
                 throw Error("UNKNOWN socket event status " + evt.status);
             }
@@ -19,12 +19,40 @@ export interface Esp32JsSocket {
   onWritable: OnWritableCB | null;
   flush(cb?: () => void): void;
   write(data: string | Uint8Array): void;
+  writeShared(data: Uint8Array, cb?: () => void): void;
+  sendFile(
+    path: string,
+    cb?: (error?: Error) => void,
+    offset?: number,
+    length?: number
+  ): boolean;
   onClose: OnCloseCB | null;
   setReadTimeout(readTimeout: number): void;
   ssl: any;
+  sslResumed: boolean;
+  isIdle: boolean;
+  isUpgraded: boolean;
+  readPaused: boolean;
   writebuffer: BufferEntry[];
 }
 
+export interface SockListenOptions {
+  /** Milliseconds after which an unfinished TLS handshake is aborted. */
+  handshakeTimeout?: number;
+  /** Maximum number of connections accepted per readable event of the listening socket. */
+  acceptBudget?: number;
+  /** Maximum number of concurrently open accepted sockets, 0 means unlimited. */
+  maxConnections?: number;
+  /**
+   * Gets called with sockets which exceed maxConnections, e.g. to send a
+   * short error response before closing them. Without it such sockets are
+   * closed immediately. It is not called on SSL listeners, their excess
+   * sockets are always closed right away: a response could only be sent
+   * after a TLS handshake, which costs the memory the limit protects.
+   */
+  onReject?: (socket: Esp32JsSocket) => void;
+}
+
 let sslClientCtx: any;
 
 /**
@@ -87,6 +115,70 @@ interface BufferEntry {
   len: number;
   cb?: () => void;
 }
+
+// queued by flush to call its callback after the pending writes
+const noData = new Uint8Array(0);
+
+/**
+ * Writes the queued buffers of a socket until the socket would block. Returns
+ * true if the queue is empty, otherwise it continues when the socket is
+ * writable again.
+ */
+function writeQueued(socket: Esp32JsSocket): boolean {
+  socket.onWritable = null;
+
+  while (socket.writebuffer.length > 0) {
+    const entry = socket.writebuffer[0];
+    let written = entry.written;
+    const data = entry.data;
+    const len = entry.len;
+
+    if (written < len) {
+      if (socket.sockfd === null) {
+        console.error("error writing to socket. not initialized.");
+        break;
+      } else {
+        console.debug("before write to socket");
+        const ret = writeSocket(
+          socket.sockfd,
+          data,
+          len - written,
+          written,
+          socket.ssl
+        );
+        console.debug("after write to socket");
+        if (ret == 0) {
+          // eagain, return immediately and wait for futher onWritable calls
+          console.debug("eagain in onWritable, socket " + socket.sockfd);
+          // wait for next select when socket is writable
+          break;
+        }
+        if (ret >= 0) {
+          written += ret;
+          entry.written = written;
+        } else {
+          console.error("error writing to socket:" + ret);
+          break;
+        }
+      }
+    }
+    if (written >= len) {
+      // remove entry because it has been written completely.
+      console.debug("// remove entry because it has been written completely.");
+      socket.writebuffer.shift();
+      if (entry.cb) {
+        entry.cb();
+      }
+    }
+  }
+
+  const bufferEmpty = socket.writebuffer.length === 0;
+  if (!bufferEmpty) {
+    socket.onWritable = writeQueued;
+  }
+  return bufferEmpty;
+}
+
 /**
  * @class
  */
@@ -96,27 +188,20 @@ class Socket implements Esp32JsSocket {
   private dataBufferSize = 0;
   private textEncoder = new TextEncoder();
   public writebuffer: BufferEntry[] = [];
-  private readTimeout = -1; // infinite
-  private readTimeoutHandle = -1;
+  private fileStream = -1;
+  private fileStreamCb: ((error?: Error) => void) | undefined;
 
+  /**
+   * Closes the socket if no data was received for the given number of
+   * milliseconds. The last activity is tracked natively on every read, a
+   * value <= 0 disables the timeout.
+   *
+   * @param readTimeout The timeout in milliseconds.
+   */
   public setReadTimeout(readTimeout: number) {
-    this.readTimeout = readTimeout;
-    this.extendReadTimeout();
-  }
-
-  public clearReadTimeoutTimer() {
-    if (this.readTimeoutHandle >= 0) {
-      clearTimeout(this.readTimeoutHandle);
-    }
-  }
-
-  public extendReadTimeout() {
-    this.clearReadTimeoutTimer();
-    if (this.readTimeout > 0) {
-      this.readTimeoutHandle = setTimeout(() => {
-        console.log("Close socket because of read timeout.");
-        closeSocket(this);
-      }, this.readTimeout);
+    el_setIdleTimeout(this.sockfd, readTimeout);
+    if (readTimeout > 0) {
+      scheduleIdleSweep();
     }
   }
 
@@ -137,9 +222,39 @@ class Socket implements Esp32JsSocket {
   public onClose: OnCloseCB | null = null;
   public onWritable: OnWritableCB | null = null;
   public isConnected = false;
+  public isResolving = false;
   public isError = false;
   public isListening = false;
+  /**
+   * If the TLS server handshake of an accepted socket is still in progress.
+   */
+  public isHandshaking = false;
+  public onHandshake: (() => void) | null = null;
+  /**
+   * The listening socket which accepted this socket.
+   */
+  public acceptedBy: Socket | null = null;
+  /**
+   * If the socket is an idle keep-alive connection which can be closed
+   * to admit new connections. Reset whenever data is received.
+   */
+  public isIdle = false;
+  /**
+   * If the connection was taken over from its protocol, e.g. by a websocket
+   * or an event stream. Such long-lived connections are not counted towards
+   * maxConnections of the listener, so they cannot lock out other clients.
+   */
+  public isUpgraded = false;
+  /**
+   * Stops waiting for received data while set, so the peer is slowed down
+   * by TCP flow control, e.g. until a consumer has processed the data.
+   */
+  public readPaused = false;
   public ssl: any = null;
+  /**
+   * If the TLS handshake resumed a cached session instead of performing a full handshake.
+   */
+  public sslResumed = false;
   public flushAlways = true;
 
   public write(data: string | Uint8Array) {
@@ -171,64 +286,102 @@ class Socket implements Esp32JsSocket {
     }
   }
 
-  public flush(cb?: () => void) {
-    const onWritable: OnWritableCB = function (socket: Esp32JsSocket) {
-      socket.onWritable = null;
-
-      while (socket.writebuffer.length > 0) {
-        const entry = socket.writebuffer[0];
-        let written = entry.written;
-        const data = entry.data;
-        const len = entry.len;
-
-        if (written < len) {
-          if (socket.sockfd === null) {
-            console.error("error writing to socket. not initialized.");
-            break;
-          } else {
-            console.debug("before write to socket");
-            const ret = writeSocket(
-              socket.sockfd,
-              data,
-              len - written,
-              written,
-              socket.ssl
-            );
-            console.debug("after write to socket");
-            if (ret == 0) {
-              // eagain, return immediately and wait for futher onWritable calls
-              console.debug("eagain in onWritable, socket " + socket.sockfd);
-              // wait for next select when socket is writable
-              break;
-            }
-            if (ret >= 0) {
-              written += ret;
-              entry.written = written;
-            } else {
-              console.error("error writing to socket:" + ret);
-              break;
-            }
-          }
-        }
-        if (written >= len) {
-          // remove entry because it has been written completely.
-          console.debug(
-            "// remove entry because it has been written completely."
-          );
-          socket.writebuffer.shift();
-          if (entry.cb) {
-            entry.cb();
-          }
+  /**
+   * Queues data without copying it, so one encoded buffer can be sent to
+   * many sockets. Pending writes are flushed first and the data must not be
+   * modified afterwards.
+   *
+   * @param data The data.
+   * @param cb Gets called when the data was written completely.
+   */
+  public writeShared(data: Uint8Array, cb?: () => void) {
+    this.flush();
+    this.writebuffer.push({ data, written: 0, len: data.length, cb });
+    writeQueued(this);
+  }
+
+  /**
+   * Streams a file from /modules or /data to the socket. The file is sent
+   * natively in chunks whenever the socket is writable, so its content is
+   * never copied into the JS heap. Pending writes are flushed first and
+   * nothing else must be written to the socket until the callback was called.
+   *
+   * @param path The file path.
+   * @param cb Gets called when the file was sent completely or with an error.
+   * @param offset Position in the file to start from.
+   * @param length Maximum number of bytes to send.
+   * @returns If the file could be opened.
+   */
+  public sendFile(
+    path: string,
+    cb?: (error?: Error) => void,
+    offset?: number,
+    length?: number
+  ): boolean {
+    if (this.fileStream >= 0) {
+      throw Error("a file is already being sent");
+    }
+    const stream = el_openFileStream(path, offset, length);
+    if (stream < 0) {
+      return false;
+    }
+    this.fileStream = stream;
+    this.fileStreamCb = cb;
+
+    const start = () => {
+      this.onWritable = () => this.sendFileChunks();
+      this.sendFileChunks();
+    };
+    if (this.dataBufferSize > 0) {
+      this.flush(start);
+    } else if (this.writebuffer.length > 0) {
+      // start after the last queued write
+      const last = this.writebuffer[this.writebuffer.length - 1];
+      const lastCb = last.cb;
+      last.cb = () => {
+        if (lastCb) {
+          lastCb();
         }
-      }
+        start();
+      };
+    } else {
+      start();
+    }
+    return true;
+  }
+
+  private sendFileChunks(): boolean {
+    const remaining = el_sendFileStream(this.fileStream, this.sockfd, this.ssl);
+    if (remaining > 0) {
+      return false;
+    }
+    this.closeFileStream(
+      remaining < 0
+        ? Error("error sending file on socket " + this.sockfd)
+        : undefined
+    );
+    return true;
+  }
 
-      const bufferEmpty = socket.writebuffer.length === 0;
-      if (!bufferEmpty) {
-        socket.onWritable = onWritable;
+  /**
+   * Stops a running file transfer started by {@link sendFile} and calls its callback.
+   *
+   * @param error The error passed to the callback.
+   */
+  public closeFileStream(error?: Error) {
+    if (this.fileStream >= 0) {
+      el_closeFileStream(this.fileStream);
+      this.fileStream = -1;
+      this.onWritable = null;
+      const cb = this.fileStreamCb;
+      this.fileStreamCb = undefined;
+      if (cb) {
+        cb(error);
       }
-      return bufferEmpty;
-    };
+    }
+  }
 
+  public flush(cb?: () => void) {
     if (this.dataBufferSize > 0 && this.dataBuffer) {
       this.writebuffer.push({
         data: this.dataBuffer,
@@ -236,17 +389,45 @@ class Socket implements Esp32JsSocket {
         len: this.dataBufferSize,
         cb: cb,
       });
-      const writtenCompletely = onWritable(this);
+      const writtenCompletely = writeQueued(this);
       if (!writtenCompletely) {
         // if not written completely the buffer was stored in write queue
         // and a new buffer must be created to prevent race conditions
         this.dataBuffer = new Uint8Array(this.defaultBufferSize);
       }
       this.dataBufferSize = 0;
+    } else if (cb) {
+      this.writebuffer.push({ data: noData, written: 0, len: 0, cb });
+      writeQueued(this);
     }
   }
 }
 
+const idleSweepInterval = 1000;
+let idleSweepHandle = -1;
+
+/**
+ * Closes sockets whose read timeout expired. A single coarse timer checks
+ * all sockets as long as any read timeout is set.
+ */
+function sweepIdleSockets() {
+  idleSweepHandle = -1;
+  const result = el_sweepIdleSockets();
+  result.expired.forEach(function (sockfd) {
+    console.log("Close socket because of read timeout.");
+    closeSocket(sockfd);
+  });
+  if (result.armed > 0) {
+    scheduleIdleSweep();
+  }
+}
+
+function scheduleIdleSweep() {
+  if (idleSweepHandle < 0) {
+    idleSweepHandle = setTimeout(sweepIdleSockets, idleSweepInterval);
+  }
+}
+
 function getOrCreateNewSocket() {
   return new Socket();
 }
@@ -290,7 +471,7 @@ export function closeSocket(socketOrSockfd: Esp32JsSocket | number): void {
   if (socket.ssl) {
     shutdownSSL(socket.ssl);
   }
-  socket.clearReadTimeoutTimer();
+  socket.closeFileStream(Error("socket closed"));
   el_closeSocket(socket.sockfd);
   if (socket.ssl) {
     freeSSL(socket.ssl);
@@ -299,6 +480,18 @@ export function closeSocket(socketOrSockfd: Esp32JsSocket | number): void {
   resetSocket(socket);
 }
 
+/**
+ * Stops sending on a socket, the peer reads the end of the stream after the
+ * data written so far. Data is still received until the socket is closed.
+ *
+ * @param {(module:socket-events~Socket|number)}
+ */
+export function shutdownSocket(socketOrSockfd: Esp32JsSocket | number): void {
+  el_shutdownSocket(
+    typeof socketOrSockfd === "number" ? socketOrSockfd : socketOrSockfd.sockfd
+  );
+}
+
 /**
  * Connects to specified host and port.
  *
@@ -322,7 +515,8 @@ export function sockConnect(
   onClose: () => void
 ): Esp32JsSocket {
   const sockfd = el_createNonBlockingSocket();
-  el_connectNonBlocking(sockfd, host, parseInt(port, 10));
+  // returns 1 if the hostname is still being resolved by the dns task
+  const ret = el_connectNonBlocking(sockfd, host, parseInt(port, 10));
 
   const socket = getOrCreateNewSocket();
   socket.sockfd = sockfd;
@@ -331,7 +525,8 @@ export function sockConnect(
   socket.onError = onError;
   socket.onClose = onClose;
   socket.isConnected = false;
-  socket.isError = false;
+  socket.isResolving = ret > 0;
+  socket.isError = ret < 0;
   socket.isListening = false;
   socket.ssl = null;
 
@@ -342,7 +537,7 @@ export function sockConnect(
         : sslClientCtx;
     socket.ssl = createSSL(sslClientCtx, host);
     socket.onConnect = function (skt) {
-      const result = connectSSL(skt.ssl, skt.sockfd);
+      const result = connectSSL(skt.ssl, skt.sockfd, host, parseInt(port, 10));
       if (result == 0) {
         // retry
         return true;
@@ -351,6 +546,8 @@ export function sockConnect(
         closeSocket(socket);
         return false;
       } else {
+        // 2 means the cached session for host and port was resumed
+        skt.sslResumed = result === 2;
         return onConnect(skt);
       }
     };
@@ -359,16 +556,76 @@ export function sockConnect(
   if (sockets.indexOf(socket) < 0) {
     sockets.push(socket);
   }
+
+  if (socket.isError) {
+    // report unresolvable hosts asynchronously, like any other socket error
+    setTimeout(() => {
+      if (socket.onError) {
+        socket.onError(sockfd);
+      }
+    }, 0);
+  }
   return socket;
 }
 
+/**
+ * Continues the TLS server handshake of an accepted socket. Depending on
+ * what the handshake waits for, it is resumed by the next readable or
+ * writable event of the socket.
+ */
+function continueHandshake(
+  socket: Socket,
+  onAccept: (socket: Esp32JsSocket) => void
+) {
+  const result = acceptSSL(socket.ssl, socket.sockfd);
+  if (result === 1) {
+    socket.isHandshaking = false;
+    socket.onHandshake = null;
+    socket.onWritable = null;
+    // clear handshake deadline
+    socket.setReadTimeout(-1);
+    if (onAccept) {
+      onAccept(socket);
+    }
+  } else if (result < 0) {
+    console.error("error accepting ssl: " + result);
+    closeSocket(socket);
+  } else if (result === 2) {
+    // wait until the socket is writable
+    socket.onWritable = function () {
+      continueHandshake(socket, onAccept);
+      return true;
+    };
+  } else {
+    // wait until the socket is readable
+    socket.onWritable = null;
+  }
+}
+
+/**
+ * Listens on the specified port.
+ *
+ * @param {(string|number)} port The local port.
+ * @param onAccept A callback which gets called for each accepted socket. For secure sockets it gets called after the TLS handshake has completed.
+ * @param {module:socket-events~onErrorCB} onError A callback which gets called on an error event.
+ * @param {module:socket-events~onCloseCB} onClose A callback which gets called on a close event.
+ * @param {boolean} isSSL If we want to accept connections via SSL.
+ * @param {module:socket-events~SockListenOptions} options Handshake timeout and connection limits.
+ *
+ * @returns {module:socket-events~Socket} The listening socket or null on error.
+ */
 export function sockListen(
   port: string | number,
   onAccept: (socket: Esp32JsSocket) => void,
   onError: (sockfd: number) => void,
   onClose: (sockfd: number) => void,
-  isSSL: boolean
+  isSSL: boolean,
+  options?: SockListenOptions
 ): Esp32JsSocket | null {
+  const handshakeTimeout = (options && options.handshakeTimeout) || 10000;
+  const acceptBudget = (options && options.acceptBudget) || 4;
+  const maxConnections = (options && options.maxConnections) || 0;
+  const onReject = options && options.onReject;
   let sslCtx: any = null;
   if (isSSL) {
     sslCtx = createSSLServerContext();
@@ -386,38 +643,80 @@ export function sockListen(
     const socket = getOrCreateNewSocket();
     socket.sockfd = sockfd;
 
-    socket.onAccept = function () {
-      let ssl = null;
-      if (isSSL) {
-        ssl = createSSL(sslCtx);
+    // closes the oldest idle socket of this listener if the limit is reached
+    const admit = function () {
+      const accepted = sockets.filter(function (s) {
+        return s.acceptedBy === socket && !s.isUpgraded;
+      });
+      if (accepted.length < maxConnections) {
+        return true;
       }
-      const newsockfd = el_acceptIncoming(sockfd);
-      if (newsockfd < 0) {
-        console.error("accept returned: " + newsockfd);
-        onError(sockfd);
-      } else if (typeof newsockfd !== "undefined") {
-        //EAGAIN
-        const newSocket = getOrCreateNewSocket();
-        newSocket.sockfd = newsockfd;
-        newSocket.isConnected = false;
-        newSocket.isError = false;
-        newSocket.isListening = false;
-        newSocket.ssl = ssl;
-
-        if (sockets.indexOf(newSocket) < 0) {
-          sockets.push(newSocket);
-        }
-        if (onAccept) {
-          onAccept(newSocket);
+      const idle = accepted.filter(function (s) {
+        return s.isIdle;
+      })[0];
+      if (idle) {
+        console.debug("Closing idle socket " + idle.sockfd + " to admit new one");
+        closeSocket(idle);
+        return true;
+      }
+      return false;
+    };
+
+    const acceptSocket = function (newsockfd: number) {
+      const newSocket = getOrCreateNewSocket();
+      newSocket.sockfd = newsockfd;
+      newSocket.isConnected = false;
+      newSocket.isError = false;
+      newSocket.isListening = false;
+
+      if (sockets.indexOf(newSocket) < 0) {
+        sockets.push(newSocket);
+      }
+      if (maxConnections > 0 && !admit()) {
+        console.warn(
+          "Connection limit of " + maxConnections + " reached on port " + port
+        );
+        if (!isSSL && onReject) {
+          // only a short grace period to deliver the rejection
+          newSocket.setReadTimeout(2000);
+          onReject(newSocket);
+        } else {
+          closeSocket(newSocket);
         }
-        if (isSSL) {
-          const sslConnected = acceptSSL(ssl, newsockfd);
-          if (sslConnected <= 0) {
-            closeSocket(newsockfd);
-          }
+        return;
+      }
+      newSocket.acceptedBy = socket;
+
+      if (isSSL) {
+        newSocket.ssl = createSSL(sslCtx);
+        // the handshake needs read events right away
+        newSocket.isConnected = true;
+        newSocket.isHandshaking = true;
+        newSocket.onHandshake = function () {
+          continueHandshake(newSocket, onAccept);
+        };
+        // abort handshakes which do not complete in time
+        newSocket.setReadTimeout(handshakeTimeout);
+        continueHandshake(newSocket, onAccept);
+      } else if (onAccept) {
+        onAccept(newSocket);
+      }
+    };
+
+    socket.onAccept = function () {
+      // drain the backlog, but leave room for other events in this turn
+      for (let i = 0; i < acceptBudget; i++) {
+        const newsockfd = el_acceptIncoming(sockfd);
+        if (newsockfd < 0) {
+          console.error("accept returned: " + newsockfd);
+          onError(sockfd);
+          return;
+        } else if (typeof newsockfd === "undefined") {
+          //EAGAIN
+          console.debug("EAGAIN received after accept...");
+          return;
         }
-      } else {
-        console.debug("EAGAIN received after accept...");
+        acceptSocket(newsockfd);
       }
     };
     socket.onError = function (sockfd) {
@@ -437,6 +736,29 @@ export function sockListen(
   }
 }
 
+/**
+ * Returns the traffic and latency counters of a socket, which are kept
+ * natively and only converted on request. Without argument the counters
+ * of all sockets since boot are summed up and the number of open and
+ * closed sockets is added. Times are in microseconds: handshakeUs is the
+ * accumulated TLS handshake duration, firstByteUs the time from opening
+ * the socket to the first received byte and dispatchUs the time between
+ * a socket becoming readable and the event loop reading it.
+ *
+ * @param {(module:socket-events~Socket|number)} socketOrSockfd The socket or its file descriptor.
+ * @returns The counters or undefined if the socket is not tracked.
+ */
+export function getSocketStats(
+  socketOrSockfd?: Esp32JsSocket | number
+): Esp32JsSocketStats | undefined {
+  if (typeof socketOrSockfd === "number") {
+    return el_getSocketStats(socketOrSockfd);
+  } else if (typeof socketOrSockfd === "object") {
+    return el_getSocketStats(socketOrSockfd.sockfd);
+  }
+  return el_getSocketStats();
+}
+
 function resetSocket(socket: Socket) {
   if (socket) {
     sockets.splice(sockets.indexOf(socket), 1);
@@ -448,10 +770,10 @@ function resetSocket(socket: Socket) {
 function beforeSuspend() {
   //collect sockets
   function notConnectedFilter(s: Socket) {
-    return !s.isConnected && !s.isListening;
+    return !s.isConnected && !s.isListening && !s.isResolving;
   }
   function connectedFilter(s: Socket) {
-    return s.isConnected;
+    return s.isConnected && !s.readPaused;
   }
   function connectedWritableFilter(s: Socket) {
     return s.isConnected && s.onWritable;
@@ -508,6 +830,8 @@ function afterSuspend(evt: Esp32JsEventloopEvent, collected: Function[]) {
         //readable
         if (socket.isListening && socket.onAccept) {
           collected.push(socket.onAccept);
+        } else if (socket.isHandshaking && socket.onHandshake) {
+          collected.push(socket.onHandshake);
         } else {
           console.debug("before eventloop read socket");
           const result = readSocket(socket.sockfd, socket.ssl);
@@ -520,8 +844,8 @@ function afterSuspend(evt: Esp32JsEventloopEvent, collected: Function[]) {
           } else if (!result) {
             console.debug("******** EAGAIN!!");
           } else {
+            socket.isIdle = false;
             if (socket.onData) {
-              socket.extendReadTimeout();
               collected.push(
                 ((data, fd, length) => () => {
                   (socket.onData as OnDataCB)(data, fd, length);
@@ -532,6 +856,7 @@ function afterSuspend(evt: Esp32JsEventloopEvent, collected: Function[]) {
         }
       } else if (evt.status === 2) {
         //error
+        socket.isResolving = false;
         socket.isError = true;
         if (socket.onError) {
           collected.push(
@@ -540,6 +865,9 @@ function afterSuspend(evt: Esp32JsEventloopEvent, collected: Function[]) {
             })(socket.sockfd)
           );
         }
+      } else if (evt.status === 3) {
+        //resolved, connect is in progress and will signal writable
+        socket.isResolving = false;
       } else {
         throw Error("UNKNOWN socket event status " + evt.status);
       }
@@ -0,0 +1,567 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "mqtt.h"
+#include "esp32-js-log.h"
+
+#define MQTT_FIXED_HEADER 0
+#define MQTT_LENGTH 1
+#define MQTT_BODY 2
+#define MQTT_FAILED 3
+#define MQTT_CLOSED 4
+
+mqtt_parser_t *createMqttParser(size_t maxPacketSize)
+{
+    mqtt_parser_t *parser = (mqtt_parser_t *)calloc(1, sizeof(mqtt_parser_t));
+    if (parser != NULL)
+    {
+        parser->state = MQTT_FIXED_HEADER;
+        parser->maxPacketSize = maxPacketSize;
+    }
+    return parser;
+}
+
+void freeMqttParser(mqtt_parser_t *parser)
+{
+    if (parser == NULL)
+    {
+        return;
+    }
+    if (parser->executing)
+    {
+        // freed by el_executeMqttParser when the handler returned
+        parser->state = MQTT_CLOSED;
+        return;
+    }
+    free(parser->packet);
+    free(parser);
+}
+
+static void callHandler(duk_context *ctx, duk_idx_t handler_idx, const char *name, int nargs)
+{
+    // the function has to be below the arguments on the value stack
+    duk_get_prop_string(ctx, handler_idx, name);
+    if (duk_is_function(ctx, -1))
+    {
+        duk_insert(ctx, -(nargs + 1));
+        duk_call(ctx, nargs);
+        duk_pop(ctx);
+    }
+    else
+    {
+        duk_pop_n(ctx, nargs + 1);
+    }
+}
+
+static uint16_t readUint16(const uint8_t *data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+// calls the handler function of a completely received packet
+static int dispatchPacket(duk_context *ctx, mqtt_parser_t *parser, duk_idx_t handler_idx)
+{
+    const uint8_t *packet = parser->packet;
+    size_t len = parser->packetLen;
+    int flags = parser->header & 0x0F;
+
+    switch (parser->header >> 4)
+    {
+    case MQTT_CONNACK:
+        if (len != 2)
+        {
+            return MQTT_ERROR_MALFORMED;
+        }
+        duk_push_boolean(ctx, packet[0] & 1);
+        duk_push_int(ctx, packet[1]);
+        callHandler(ctx, handler_idx, "onConnack", 2);
+        return 0;
+    case MQTT_PUBLISH:
+    {
+        int qos = (flags >> 1) & 3;
+        size_t pos = 2;
+        if (qos == 3 || len < 2)
+        {
+            return MQTT_ERROR_MALFORMED;
+        }
+        size_t topicLen = readUint16(packet);
+        pos += topicLen;
+        if (pos + (qos > 0 ? 2 : 0) > len)
+        {
+            return MQTT_ERROR_MALFORMED;
+        }
+        duk_push_lstring(ctx, (const char *)packet + 2, topicLen);
+        int packetId = 0;
+        if (qos > 0)
+        {
+            packetId = readUint16(packet + pos);
+            pos += 2;
+        }
+        void *payload = duk_push_fixed_buffer(ctx, len - pos);
+        memcpy(payload, packet + pos, len - pos);
+        duk_push_buffer_object(ctx, -1, 0, len - pos, DUK_BUFOBJ_UINT8ARRAY);
+        duk_remove(ctx, -2);
+        duk_push_int(ctx, qos);
+        duk_push_boolean(ctx, flags & 1);
+        duk_push_boolean(ctx, flags & 8);
+        duk_push_int(ctx, packetId);
+        callHandler(ctx, handler_idx, "onPublish", 6);
+        return 0;
+    }
+    case MQTT_PUBACK:
+    case MQTT_UNSUBACK:
+        if (len != 2)
+        {
+            return MQTT_ERROR_MALFORMED;
+        }
+        duk_push_int(ctx, readUint16(packet));
+        callHandler(ctx, handler_idx, (parser->header >> 4) == MQTT_PUBACK ? "onPuback" : "onUnsuback", 1);
+        return 0;
+    case MQTT_SUBACK:
+        if (len < 3)
+        {
+            return MQTT_ERROR_MALFORMED;
+        }
+        duk_push_int(ctx, readUint16(packet));
+        duk_push_array(ctx);
+        for (size_t i = 2; i < len; i++)
+        {
+            duk_push_int(ctx, packet[i]);
+            duk_put_prop_index(ctx, -2, i - 2);
+        }
+        callHandler(ctx, handler_idx, "onSuback", 2);
+        return 0;
+    case MQTT_PINGRESP:
+        if (len != 0)
+        {
+            return MQTT_ERROR_MALFORMED;
+        }
+        callHandler(ctx, handler_idx, "onPingresp", 0);
+        return 0;
+    }
+    // packets of QoS 2 flows or packets a broker must not send
+    return MQTT_ERROR_MALFORMED;
+}
+
+static int fail(mqtt_parser_t *parser, int error)
+{
+    parser->state = MQTT_FAILED;
+    return error;
+}
+
+static int completePacket(duk_context *ctx, mqtt_parser_t *parser, duk_idx_t handler_idx)
+{
+    parser->state = MQTT_FIXED_HEADER;
+    int ret = dispatchPacket(ctx, parser, handler_idx);
+    if (parser->packetCap > MQTT_KEEP_BUFFER_SIZE)
+    {
+        free(parser->packet);
+        parser->packet = NULL;
+        parser->packetCap = 0;
+    }
+    return ret != 0 ? fail(parser, ret) : 0;
+}
+
+int executeMqttParser(duk_context *ctx, mqtt_parser_t *parser, const uint8_t *data, size_t len, duk_idx_t handler_idx)
+{
+    size_t pos = 0;
+    while (pos < len)
+    {
+        switch (parser->state)
+        {
+        case MQTT_CLOSED:
+            return 0;
+        case MQTT_FAILED:
+            return MQTT_ERROR_MALFORMED;
+        case MQTT_FIXED_HEADER:
+            parser->header = data[pos++];
+            parser->remaining = 0;
+            parser->lengthShift = 0;
+            parser->packetLen = 0;
+            parser->state = MQTT_LENGTH;
+            break;
+        case MQTT_LENGTH:
+        {
+            // variable length encoding with 7 bits per byte, at most 4 bytes
+            uint8_t b = data[pos++];
+            parser->remaining |= (size_t)(b & 0x7F) << parser->lengthShift;
+            parser->lengthShift += 7;
+            if (b & 0x80)
+            {
+                if (parser->lengthShift >= 28)
+                {
+                    return fail(parser, MQTT_ERROR_MALFORMED);
+                }
+                break;
+            }
+            if (parser->remaining > parser->maxPacketSize)
+            {
+                return fail(parser, MQTT_ERROR_TOO_LARGE);
+            }
+            if (parser->remaining > parser->packetCap)
+            {
+                uint8_t *packet = (uint8_t *)realloc(parser->packet, parser->remaining);
+                if (packet == NULL)
+                {
+                    jslog(ERROR, "Not enough memory for mqtt packet of %u bytes", (unsigned int)parser->remaining);
+                    return fail(parser, MQTT_ERROR_TOO_LARGE);
+                }
+                parser->packet = packet;
+                parser->packetCap = parser->remaining;
+            }
+            if (parser->remaining == 0)
+            {
+                int ret = completePacket(ctx, parser, handler_idx);
+                if (ret != 0)
+                {
+                    return ret;
+                }
+            }
+            else
+            {
+                parser->state = MQTT_BODY;
+            }
+            break;
+        }
+        case MQTT_BODY:
+        {
+            size_t n = len - pos;
+            if (n > parser->remaining - parser->packetLen)
+            {
+                n = parser->remaining - parser->packetLen;
+            }
+            memcpy(parser->packet + parser->packetLen, data + pos, n);
+            parser->packetLen += n;
+            pos += n;
+            if (parser->packetLen == parser->remaining)
+            {
+                int ret = completePacket(ctx, parser, handler_idx);
+                if (ret != 0)
+                {
+                    return ret;
+                }
+            }
+            break;
+        }
+        }
+    }
+    return 0;
+}
+
+static duk_ret_t el_createMqttParser(duk_context *ctx)
+{
+    mqtt_parser_t *parser = createMqttParser(duk_to_uint32(ctx, 0));
+    if (parser == NULL)
+    {
+        jslog(ERROR, "Not enough memory for mqtt parser");
+        return duk_error(ctx, DUK_ERR_ERROR, "Not enough memory for mqtt parser");
+    }
+    duk_push_int(ctx, (duk_int_t)parser);
+    return 1;
+}
+
+static duk_ret_t el_freeMqttParser(duk_context *ctx)
+{
+    freeMqttParser((mqtt_parser_t *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static const uint8_t *getBytes(duk_context *ctx, duk_idx_t idx, duk_size_t *len)
+{
+    *len = 0;
+    if (duk_is_string(ctx, idx))
+    {
+        return (const uint8_t *)duk_get_lstring(ctx, idx, len);
+    }
+    if (duk_is_null_or_undefined(ctx, idx))
+    {
+        return NULL;
+    }
+    return (const uint8_t *)duk_require_buffer_data(ctx, idx, len);
+}
+
+typedef struct
+{
+    mqtt_parser_t *parser;
+    const uint8_t *data;
+    size_t len;
+    int ret;
+} mqtt_execution_t;
+
+static duk_ret_t executeMqttParserSafe(duk_context *ctx, void *udata)
+{
+    mqtt_execution_t *execution = (mqtt_execution_t *)udata;
+    execution->ret = executeMqttParser(ctx, execution->parser, execution->data, execution->len, 2);
+    return 0;
+}
+
+static duk_ret_t el_executeMqttParser(duk_context *ctx)
+{
+    mqtt_parser_t *parser = (mqtt_parser_t *)duk_to_int(ctx, 0);
+    duk_size_t len;
+    const uint8_t *data = getBytes(ctx, 1, &len);
+    duk_require_object(ctx, 2);
+    duk_set_top(ctx, 3);
+
+    // a handler may close the client and free the parser, e.g. onConnack
+    // with an error or end() called by onmessage, see freeMqttParser
+    mqtt_execution_t execution = {parser, data, len, 0};
+    parser->executing = true;
+    duk_int_t rc = duk_safe_call(ctx, executeMqttParserSafe, &execution, 3, 1);
+    parser->executing = false;
+    if (parser->state == MQTT_CLOSED)
+    {
+        freeMqttParser(parser);
+    }
+    if (rc != DUK_EXEC_SUCCESS)
+    {
+        return duk_throw(ctx);
+    }
+    duk_push_int(ctx, execution.ret);
+    return 1;
+}
+
+// pushes a packet buffer for the fixed header byte and remaining length,
+// returns the position of the variable header
+static uint8_t *pushPacket(duk_context *ctx, uint8_t header, size_t remaining, size_t *totalLen)
+{
+    if (remaining > 268435455)
+    {
+        (void)duk_range_error(ctx, "MQTT packet too large");
+    }
+    size_t lengthBytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : remaining < 2097152 ? 3 : 4;
+    *totalLen = 1 + lengthBytes + remaining;
+    uint8_t *packet = (uint8_t *)duk_push_fixed_buffer(ctx, *totalLen);
+    uint8_t *pos = packet;
+    *pos++ = header;
+    do
+    {
+        uint8_t b = remaining & 0x7F;
+        remaining >>= 7;
+        *pos++ = remaining > 0 ? b | 0x80 : b;
+    } while (remaining > 0);
+    return pos;
+}
+
+static duk_ret_t finishPacket(duk_context *ctx, size_t totalLen)
+{
+    duk_push_buffer_object(ctx, -1, 0, totalLen, DUK_BUFOBJ_UINT8ARRAY);
+    return 1;
+}
+
+static uint8_t *putUint16(uint8_t *pos, size_t value)
+{
+    *pos++ = value >> 8;
+    *pos++ = value & 0xFF;
+    return pos;
+}
+
+// length prefixed string or binary data
+static uint8_t *putField(uint8_t *pos, const uint8_t *data, size_t len)
+{
+    pos = putUint16(pos, len);
+    if (len > 0)
+    {
+        memcpy(pos, data, len);
+    }
+    return pos + len;
+}
+
+static const uint8_t *requireField(duk_context *ctx, duk_idx_t idx, duk_size_t *len)
+{
+    const uint8_t *data = getBytes(ctx, idx, len);
+    if (*len > 0xFFFF)
+    {
+        (void)duk_range_error(ctx, "MQTT field too long");
+    }
+    return data;
+}
+
+/**
+ * Arguments: clientId, keepAlive (seconds), cleanSession, username, password,
+ * willTopic, willPayload, willQos, willRetain. Missing username, password or
+ * willTopic leave them out.
+ */
+static duk_ret_t el_encodeMqttConnect(duk_context *ctx)
+{
+    duk_size_t clientIdLen, usernameLen, passwordLen, willTopicLen, willPayloadLen;
+    const uint8_t *clientId = requireField(ctx, 0, &clientIdLen);
+    int keepAlive = duk_to_int(ctx, 1);
+    bool cleanSession = duk_to_boolean(ctx, 2);
+    const uint8_t *username = requireField(ctx, 3, &usernameLen);
+    const uint8_t *password = requireField(ctx, 4, &passwordLen);
+    const uint8_t *willTopic = requireField(ctx, 5, &willTopicLen);
+    const uint8_t *willPayload = requireField(ctx, 6, &willPayloadLen);
+
+    uint8_t flags = cleanSession ? 0x02 : 0;
+    size_t remaining = 10 + 2 + clientIdLen;
+    if (willTopic != NULL)
+    {
+        flags |= 0x04 | ((duk_to_int(ctx, 7) & 3) << 3) | (duk_to_boolean(ctx, 8) ? 0x20 : 0);
+        remaining += 2 + willTopicLen + 2 + willPayloadLen;
+    }
+    if (username != NULL)
+    {
+        flags |= 0x80;
+        remaining += 2 + usernameLen;
+    }
+    if (password != NULL)
+    {
+        flags |= 0x40;
+        remaining += 2 + passwordLen;
+    }
+
+    size_t totalLen;
+    uint8_t *pos = pushPacket(ctx, MQTT_CONNECT << 4, remaining, &totalLen);
+    pos = putField(pos, (const uint8_t *)"MQTT", 4);
+    *pos++ = 4; // protocol level of 3.1.1
+    *pos++ = flags;
+    pos = putUint16(pos, keepAlive);
+    pos = putField(pos, clientId, clientIdLen);
+    if (willTopic != NULL)
+    {
+        pos = putField(pos, willTopic, willTopicLen);
+        pos = putField(pos, willPayload, willPayloadLen);
+    }
+    if (username != NULL)
+    {
+        pos = putField(pos, username, usernameLen);
+    }
+    if (password != NULL)
+    {
+        putField(pos, password, passwordLen);
+    }
+    return finishPacket(ctx, totalLen);
+}
+
+/**
+ * Arguments: topic, payload (string or Uint8Array), qos, retain, dup, packetId.
+ */
+static duk_ret_t el_encodeMqttPublish(duk_context *ctx)
+{
+    duk_size_t topicLen, payloadLen;
+    const uint8_t *topic = requireField(ctx, 0, &topicLen);
+    const uint8_t *payload = getBytes(ctx, 1, &payloadLen);
+    int qos = duk_to_int(ctx, 2) & 3;
+    uint8_t header = (MQTT_PUBLISH << 4) | (qos << 1) | (duk_to_boolean(ctx, 3) ? 1 : 0) |
+                     (duk_to_boolean(ctx, 4) ? 8 : 0);
+
+    size_t totalLen;
+    uint8_t *pos = pushPacket(ctx, header, 2 + topicLen + (qos > 0 ? 2 : 0) + payloadLen, &totalLen);
+    pos = putField(pos, topic, topicLen);
+    if (qos > 0)
+    {
+        pos = putUint16(pos, duk_to_int(ctx, 5));
+    }
+    if (payloadLen > 0)
+    {
+        memcpy(pos, payload, payloadLen);
+    }
+    return finishPacket(ctx, totalLen);
+}
+
+/**
+ * Encodes SUBSCRIBE if qos is a number, otherwise UNSUBSCRIBE.
+ * Arguments: packetId, array of topic filters, qos.
+ */
+static duk_ret_t el_encodeMqttSubscribe(duk_context *ctx)
+{
+    int packetId = duk_to_int(ctx, 0);
+    duk_require_object(ctx, 1);
+    bool subscribe = duk_is_number(ctx, 2);
+    int qos = duk_to_int(ctx, 2) & 3;
+    duk_size_t count = duk_get_length(ctx, 1);
+
+    size_t remaining = 2;
+    for (duk_size_t i = 0; i < count; i++)
+    {
+        duk_size_t len;
+        duk_get_prop_index(ctx, 1, i);
+        requireField(ctx, -1, &len);
+        remaining += 2 + len + (subscribe ? 1 : 0);
+        duk_pop(ctx);
+    }
+
+    size_t totalLen;
+    uint8_t *pos = pushPacket(ctx, ((subscribe ? MQTT_SUBSCRIBE : MQTT_UNSUBSCRIBE) << 4) | 0x02, remaining, &totalLen);
+    pos = putUint16(pos, packetId);
+    for (duk_size_t i = 0; i < count; i++)
+    {
+        duk_size_t len;
+        duk_get_prop_index(ctx, 1, i);
+        const uint8_t *filter = getBytes(ctx, -1, &len);
+        pos = putField(pos, filter, len);
+        if (subscribe)
+        {
+            *pos++ = qos;
+        }
+        duk_pop(ctx);
+    }
+    return finishPacket(ctx, totalLen);
+}
+
+/**
+ * Encodes packets without payload like PUBACK, PINGREQ and DISCONNECT.
+ * Arguments: type, packetId (omitted if undefined).
+ */
+static duk_ret_t el_encodeMqttPacket(duk_context *ctx)
+{
+    int type = duk_require_int(ctx, 0);
+    bool hasPacketId = !duk_is_undefined(ctx, 1);
+
+    size_t totalLen;
+    uint8_t *pos = pushPacket(ctx, type << 4, hasPacketId ? 2 : 0, &totalLen);
+    if (hasPacketId)
+    {
+        putUint16(pos, duk_to_int(ctx, 1));
+    }
+    return finishPacket(ctx, totalLen);
+}
+
+void registerMqttBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_createMqttParser, 1);
+    duk_put_global_string(ctx, "el_createMqttParser");
+
+    duk_push_c_function(ctx, el_freeMqttParser, 1);
+    duk_put_global_string(ctx, "el_freeMqttParser");
+
+    duk_push_c_function(ctx, el_executeMqttParser, 3);
+    duk_put_global_string(ctx, "el_executeMqttParser");
+
+    duk_push_c_function(ctx, el_encodeMqttConnect, 9);
+    duk_put_global_string(ctx, "el_encodeMqttConnect");
+
+    duk_push_c_function(ctx, el_encodeMqttPublish, 6);
+    duk_put_global_string(ctx, "el_encodeMqttPublish");
+
+    duk_push_c_function(ctx, el_encodeMqttSubscribe, 3);
+    duk_put_global_string(ctx, "el_encodeMqttSubscribe");
+
+    duk_push_c_function(ctx, el_encodeMqttPacket, 2);
+    duk_put_global_string(ctx, "el_encodeMqttPacket");
+}
@@ -0,0 +1,543 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "multipart.h"
+#include "esp32-js-log.h"
+
+#define MP_PREAMBLE 0
+// transport padding and line break after a delimiter
+#define MP_DELIMITER_END 1
+// second dash of the close delimiter
+#define MP_FINAL_DASH 2
+#define MP_HEAD 3
+#define MP_DATA 4
+#define MP_EPILOGUE 5
+#define MP_ERROR 6
+
+// if the boundary is valid and a delimiter built from it does not contain line breaks
+static bool isValidBoundary(const char *boundary)
+{
+    size_t len = strlen(boundary);
+    return len > 0 && len <= MULTIPART_MAX_BOUNDARY_LENGTH && strpbrk(boundary, "\r\n") == NULL;
+}
+
+multipart_parser_t *createMultipartParser(const char *boundary)
+{
+    if (!isValidBoundary(boundary))
+    {
+        return NULL;
+    }
+    multipart_parser_t *parser = (multipart_parser_t *)calloc(1, sizeof(multipart_parser_t));
+    if (parser != NULL)
+    {
+        int len = strlen(boundary);
+        memcpy(parser->delimiter, "\r\n--", 4);
+        memcpy(parser->delimiter + 4, boundary, len);
+        parser->delimiterLen = len + 4;
+        parser->state = MP_PREAMBLE;
+        // the first delimiter usually starts the body without a line break before it
+        parser->matched = 2;
+        parser->maxPartSize = -1;
+    }
+    return parser;
+}
+
+// closes the file the part is written to, incomplete files are removed
+static bool closePartFile(multipart_parser_t *parser, bool remove)
+{
+    bool ok = true;
+    if (parser->partFile != NULL)
+    {
+        ok = fclose(parser->partFile) == 0;
+        parser->partFile = NULL;
+        if (remove || !ok)
+        {
+            unlink(parser->partFilePath);
+        }
+    }
+    free(parser->partFilePath);
+    parser->partFilePath = NULL;
+    return ok;
+}
+
+void freeMultipartParser(multipart_parser_t *parser)
+{
+    if (parser != NULL)
+    {
+        closePartFile(parser, true);
+        free(parser->head);
+        free(parser);
+    }
+}
+
+/**
+ * Sets how the content of the current part is received. Has to be called
+ * from onPart. Parts exceeding maxSize (if >= 0) fail with 413. If path is
+ * set, the content is written natively to this file in /data instead of
+ * being passed to onData. The file is complete when onPartEnd is called and
+ * removed if the body fails or ends before.
+ * Returns false if the file could not be opened, parsing then fails with 500.
+ */
+bool setMultipartPartBody(multipart_parser_t *parser, long maxSize, const char *path)
+{
+    parser->maxPartSize = maxSize;
+    if (path != NULL)
+    {
+        if (strncmp(path, "/data/", 6) != 0 || strstr(path, "/../") != NULL)
+        {
+            jslog(ERROR, "Multipart content can only be written to /data: %s", path);
+            parser->partError = 500;
+            return false;
+        }
+        closePartFile(parser, true);
+        parser->partFile = fopen(path, "w");
+        if (parser->partFile == NULL)
+        {
+            jslog(ERROR, "Failed to open file %s for multipart content", path);
+            parser->partError = 500;
+            return false;
+        }
+        parser->partFilePath = strdup(path);
+    }
+    return true;
+}
+
+static void releaseHead(multipart_parser_t *parser)
+{
+    free(parser->head);
+    parser->head = NULL;
+    parser->headLen = 0;
+    parser->headSize = 0;
+}
+
+static int fail(multipart_parser_t *parser, int status)
+{
+    releaseHead(parser);
+    closePartFile(parser, true);
+    parser->state = MP_ERROR;
+    parser->error = status;
+    return -status;
+}
+
+static bool appendHead(multipart_parser_t *parser, char c)
+{
+    if (parser->headLen == parser->headSize)
+    {
+        if (parser->headSize >= MULTIPART_MAX_HEAD_SIZE)
+        {
+            return false;
+        }
+        int size = parser->headSize == 0 ? MULTIPART_INITIAL_HEAD_SIZE : parser->headSize * 2;
+        if (size > MULTIPART_MAX_HEAD_SIZE)
+        {
+            size = MULTIPART_MAX_HEAD_SIZE;
+        }
+        char *head = (char *)realloc(parser->head, size);
+        if (head == NULL)
+        {
+            return false;
+        }
+        parser->head = head;
+        parser->headSize = size;
+    }
+    parser->head[parser->headLen++] = c;
+    return true;
+}
+
+static bool isTokenChar(char c)
+{
+    return isalnum((unsigned char)c) || strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
+// returns the length of the line starting at start without line breaks and stores the start of the next line
+static int nextLine(const char *start, const char *end, const char **next)
+{
+    const char *lf = memchr(start, '\n', end - start);
+    if (lf == NULL)
+    {
+        *next = end;
+        return end - start;
+    }
+    *next = lf + 1;
+    return (lf > start && lf[-1] == '\r') ? lf - start - 1 : lf - start;
+}
+
+static void callHandler(duk_context *ctx, duk_idx_t handler_idx, const char *name, int nargs)
+{
+    // the function has to be below the arguments on the value stack
+    duk_get_prop_string(ctx, handler_idx, name);
+    duk_insert(ctx, -(nargs + 1));
+    duk_call(ctx, nargs);
+    duk_pop(ctx);
+}
+
+// passes part content to onData or writes it to the part file, preamble and epilogue are dropped
+static int handleContent(duk_context *ctx, multipart_parser_t *parser, duk_idx_t handler_idx, const char *data, size_t len)
+{
+    if (parser->state != MP_DATA || len == 0)
+    {
+        return 0;
+    }
+    parser->partSize += len;
+    if (parser->maxPartSize >= 0 && parser->partSize > parser->maxPartSize)
+    {
+        return fail(parser, 413);
+    }
+    if (parser->partFile != NULL)
+    {
+        if (fwrite(data, 1, len, parser->partFile) != len)
+        {
+            jslog(ERROR, "Failed to write multipart content to %s", parser->partFilePath);
+            return fail(parser, 507);
+        }
+        return 0;
+    }
+
+    void *buf = duk_push_fixed_buffer(ctx, len);
+    memcpy(buf, data, len);
+    duk_push_buffer_object(ctx, -1, 0, len, DUK_BUFOBJ_UINT8ARRAY);
+    duk_remove(ctx, -2);
+    callHandler(ctx, handler_idx, "onData", 1);
+    return 0;
+}
+
+/**
+ * Searches the next delimiter and passes the content before it on. Each byte
+ * is looked at once: a delimiter prefix at the end of the data is held back
+ * as match length and completed with the next data, so consumed data is
+ * never searched again. Sets found if a complete delimiter was consumed.
+ * Returns the number of consumed bytes or the negative status on errors.
+ */
+static long findDelimiter(duk_context *ctx, multipart_parser_t *parser, duk_idx_t handler_idx, const char *data, size_t len, bool *found)
+{
+    const char *delimiter = parser->delimiter;
+    size_t delimiterLen = parser->delimiterLen;
+    size_t pos = 0;
+    int ret;
+
+    *found = false;
+    if (parser->matched > 0)
+    {
+        size_t matched = parser->matched;
+        while (matched < delimiterLen && pos < len && data[pos] == delimiter[matched])
+        {
+            matched++;
+            pos++;
+        }
+        if (matched == delimiterLen)
+        {
+            parser->matched = 0;
+            *found = true;
+            return pos;
+        }
+        if (pos == len)
+        {
+            parser->matched = matched;
+            return pos;
+        }
+        // the held back bytes were content, no delimiter starts within them
+        // because the boundary contains no CR
+        parser->matched = 0;
+        ret = handleContent(ctx, parser, handler_idx, delimiter, matched);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+
+    size_t start = pos;
+    while (pos < len)
+    {
+        const char *cr = memchr(data + pos, '\r', len - pos);
+        if (cr == NULL)
+        {
+            break;
+        }
+        size_t at = cr - data;
+        size_t n = len - at < delimiterLen ? len - at : delimiterLen;
+        if (memcmp(cr, delimiter, n) == 0)
+        {
+            ret = handleContent(ctx, parser, handler_idx, data + start, at - start);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            if (n == delimiterLen)
+            {
+                *found = true;
+            }
+            else
+            {
+                parser->matched = n;
+            }
+            return at + n;
+        }
+        pos = at + 1;
+    }
+    ret = handleContent(ctx, parser, handler_idx, data + start, len - start);
+    return ret < 0 ? ret : (long)len;
+}
+
+/**
+ * Parses the headers of a part and calls onPart(headers) with a flat array
+ * of lower case names and trimmed values.
+ */
+static int parsePartHead(duk_context *ctx, multipart_parser_t *parser, duk_idx_t handler_idx)
+{
+    char *head = parser->head;
+    const char *end = head + parser->headLen;
+    const char *next = head;
+
+    duk_idx_t arr_idx = duk_push_array(ctx);
+    duk_uarridx_t arr_len = 0;
+    while (next < end)
+    {
+        char *line = (char *)next;
+        int len = nextLine(line, end, &next);
+        if (len == 0)
+        {
+            break;
+        }
+        char *colon = memchr(line, ':', len);
+        if (colon == NULL || colon == line)
+        {
+            duk_pop(ctx);
+            return fail(parser, 400);
+        }
+        for (char *c = line; c < colon; c++)
+        {
+            if (!isTokenChar(*c))
+            {
+                duk_pop(ctx);
+                return fail(parser, 400);
+            }
+            *c = tolower((unsigned char)*c);
+        }
+        const char *value = colon + 1;
+        const char *valueEnd = line + len;
+        while (value < valueEnd && (*value == ' ' || *value == '\t'))
+        {
+            value++;
+        }
+        while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+        {
+            valueEnd--;
+        }
+        duk_push_lstring(ctx, line, colon - line);
+        duk_put_prop_index(ctx, arr_idx, arr_len++);
+        duk_push_lstring(ctx, value, valueEnd - value);
+        duk_put_prop_index(ctx, arr_idx, arr_len++);
+    }
+    releaseHead(parser);
+
+    callHandler(ctx, handler_idx, "onPart", 1);
+    if (parser->partError != 0)
+    {
+        return fail(parser, parser->partError);
+    }
+    parser->state = MP_DATA;
+    return 0;
+}
+
+static int completePart(duk_context *ctx, multipart_parser_t *parser, duk_idx_t handler_idx)
+{
+    if (parser->partFile != NULL && !closePartFile(parser, false))
+    {
+        jslog(ERROR, "Failed to write multipart content file");
+        return fail(parser, 507);
+    }
+    callHandler(ctx, handler_idx, "onPartEnd", 0);
+    return 0;
+}
+
+/**
+ * Feeds received body bytes into the parser and calls the onPart, onData
+ * and onPartEnd functions of the handler object. Content is passed to onData
+ * as Uint8Array in the pieces it arrives in, without the delimiters.
+ * Returns MULTIPART_PARSER_IN_BODY until the close delimiter was received,
+ * MULTIPART_PARSER_COMPLETE afterwards (the epilogue is ignored), or the
+ * negative HTTP status to respond with on malformed bodies.
+ */
+int executeMultipartParser(duk_context *ctx, multipart_parser_t *parser, const char *data, size_t len, duk_idx_t handler_idx)
+{
+    size_t pos = 0;
+    while (pos < len && parser->state != MP_ERROR && parser->state != MP_EPILOGUE)
+    {
+        char c;
+        switch (parser->state)
+        {
+        case MP_PREAMBLE:
+        case MP_DATA:
+        {
+            bool found;
+            long ret = findDelimiter(ctx, parser, handler_idx, data + pos, len - pos, &found);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            pos += ret;
+            if (found)
+            {
+                if (parser->state == MP_DATA && completePart(ctx, parser, handler_idx) < 0)
+                {
+                    return -parser->error;
+                }
+                parser->state = MP_DELIMITER_END;
+                parser->lineLen = 0;
+            }
+            break;
+        }
+        case MP_DELIMITER_END:
+            c = data[pos++];
+            if (c == '-' && parser->lineLen == 0)
+            {
+                parser->state = MP_FINAL_DASH;
+            }
+            else if (c == '\n')
+            {
+                parser->state = MP_HEAD;
+                parser->lineLen = 0;
+                parser->maxPartSize = -1;
+                parser->partSize = 0;
+                parser->partError = 0;
+            }
+            else if (c == ' ' || c == '\t' || c == '\r')
+            {
+                parser->lineLen++;
+            }
+            else
+            {
+                return fail(parser, 400);
+            }
+            break;
+        case MP_FINAL_DASH:
+            if (data[pos++] != '-')
+            {
+                return fail(parser, 400);
+            }
+            parser->state = MP_EPILOGUE;
+            break;
+        case MP_HEAD:
+            c = data[pos++];
+            if (!appendHead(parser, c))
+            {
+                return fail(parser, 400);
+            }
+            if (c == '\n')
+            {
+                if (parser->lineLen == 0)
+                {
+                    int ret = parsePartHead(ctx, parser, handler_idx);
+                    if (ret < 0)
+                    {
+                        return ret;
+                    }
+                }
+                parser->lineLen = 0;
+            }
+            else if (c != '\r')
+            {
+                parser->lineLen++;
+            }
+            break;
+        }
+    }
+
+    if (parser->state == MP_ERROR)
+    {
+        return -parser->error;
+    }
+    return parser->state == MP_EPILOGUE ? MULTIPART_PARSER_COMPLETE : MULTIPART_PARSER_IN_BODY;
+}
+
+static duk_ret_t el_createMultipartParser(duk_context *ctx)
+{
+    const char *boundary = duk_require_string(ctx, 0);
+    if (!isValidBoundary(boundary))
+    {
+        return duk_error(ctx, DUK_ERR_ERROR, "Invalid multipart boundary");
+    }
+    multipart_parser_t *parser = createMultipartParser(boundary);
+    if (parser == NULL)
+    {
+        jslog(ERROR, "Not enough memory for multipart parser");
+        return duk_error(ctx, DUK_ERR_ERROR, "Not enough memory for multipart parser");
+    }
+    duk_push_int(ctx, (duk_int_t)parser);
+    return 1;
+}
+
+static duk_ret_t el_freeMultipartParser(duk_context *ctx)
+{
+    freeMultipartParser((multipart_parser_t *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t el_executeMultipartParser(duk_context *ctx)
+{
+    multipart_parser_t *parser = (multipart_parser_t *)duk_to_int(ctx, 0);
+    duk_size_t len;
+    const char *data;
+    if (duk_is_string(ctx, 1))
+    {
+        data = duk_get_lstring(ctx, 1, &len);
+    }
+    else
+    {
+        data = (const char *)duk_require_buffer_data(ctx, 1, &len);
+    }
+    duk_require_object(ctx, 2);
+
+    duk_push_int(ctx, executeMultipartParser(ctx, parser, data, len, 2));
+    return 1;
+}
+
+static duk_ret_t el_setMultipartPartBody(duk_context *ctx)
+{
+    multipart_parser_t *parser = (multipart_parser_t *)duk_to_int(ctx, 0);
+    long maxSize = duk_is_number(ctx, 1) ? (long)duk_get_number(ctx, 1) : -1;
+    const char *path = duk_is_string(ctx, 2) ? duk_get_string(ctx, 2) : NULL;
+    duk_push_boolean(ctx, setMultipartPartBody(parser, maxSize, path));
+    return 1;
+}
+
+void registerMultipartBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_createMultipartParser, 1);
+    duk_put_global_string(ctx, "el_createMultipartParser");
+
+    duk_push_c_function(ctx, el_freeMultipartParser, 1);
+    duk_put_global_string(ctx, "el_freeMultipartParser");
+
+    duk_push_c_function(ctx, el_executeMultipartParser, 3);
+    duk_put_global_string(ctx, "el_executeMultipartParser");
+
+    duk_push_c_function(ctx, el_setMultipartPartBody, 3);
+    duk_put_global_string(ctx, "el_setMultipartPartBody");
+}
@@ -0,0 +1,311 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include "response-head.h"
+
+typedef struct
+{
+    int status;
+    const char *text;
+    const char *line;
+    size_t lineLen;
+} status_line_t;
+
+#define STATUS_LINE_STR(status, text) "HTTP/1.1 " #status " " text "\r\n"
+#define STATUS_LINE(status, text)                                                            \
+    {                                                                                        \
+        status, text, STATUS_LINE_STR(status, text), sizeof(STATUS_LINE_STR(status, text)) - 1 \
+    }
+
+// pre-encoded status lines of the common status codes
+static const status_line_t statusLines[] = {
+    STATUS_LINE(100, "Continue"),
+    STATUS_LINE(101, "Switching Protocols"),
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(201, "Created"),
+    STATUS_LINE(202, "Accepted"),
+    STATUS_LINE(204, "No Content"),
+    STATUS_LINE(206, "Partial Content"),
+    STATUS_LINE(301, "Moved Permanently"),
+    STATUS_LINE(302, "Found"),
+    STATUS_LINE(303, "See Other"),
+    STATUS_LINE(304, "Not Modified"),
+    STATUS_LINE(307, "Temporary Redirect"),
+    STATUS_LINE(308, "Permanent Redirect"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(401, "Unauthorized"),
+    STATUS_LINE(403, "Forbidden"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(405, "Method Not Allowed"),
+    STATUS_LINE(408, "Request Timeout"),
+    STATUS_LINE(409, "Conflict"),
+    STATUS_LINE(411, "Length Required"),
+    STATUS_LINE(412, "Precondition Failed"),
+    STATUS_LINE(413, "Payload Too Large"),
+    STATUS_LINE(414, "URI Too Long"),
+    STATUS_LINE(415, "Unsupported Media Type"),
+    STATUS_LINE(416, "Range Not Satisfiable"),
+    STATUS_LINE(426, "Upgrade Required"),
+    STATUS_LINE(429, "Too Many Requests"),
+    STATUS_LINE(431, "Request Header Fields Too Large"),
+    STATUS_LINE(500, "Internal Server Error"),
+    STATUS_LINE(501, "Not Implemented"),
+    STATUS_LINE(502, "Bad Gateway"),
+    STATUS_LINE(503, "Service Unavailable"),
+    STATUS_LINE(504, "Gateway Timeout"),
+    STATUS_LINE(507, "Insufficient Storage"),
+};
+
+typedef struct
+{
+    const char *line;
+    size_t lineLen;
+} header_line_t;
+
+#define HEADER_LINE(line)      \
+    {                          \
+        line, sizeof(line) - 1 \
+    }
+
+static const header_line_t connectionClose = HEADER_LINE("connection: close\r\n");
+static const header_line_t connectionKeepAlive = HEADER_LINE("connection: keep-alive\r\n");
+static const header_line_t transferEncodingChunked = HEADER_LINE("transfer-encoding: chunked\r\n");
+static const header_line_t defaultContentType = HEADER_LINE("content-type: text/plain; charset=utf-8\r\n");
+
+static const char charsetSuffix[] = "; charset=utf-8";
+#define CHARSET_SUFFIX_LEN (sizeof(charsetSuffix) - 1)
+
+static const status_line_t *findStatusLine(int status)
+{
+    for (size_t i = 0; i < sizeof(statusLines) / sizeof(status_line_t); i++)
+    {
+        if (statusLines[i].status == status)
+        {
+            return &statusLines[i];
+        }
+    }
+    return NULL;
+}
+
+static bool containsLineBreak(const char *str, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (str[i] == '\r' || str[i] == '\n')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool startsWith(const char *str, size_t len, const char *prefix)
+{
+    size_t prefixLen = strlen(prefix);
+    return len >= prefixLen && strncasecmp(str, prefix, prefixLen) == 0;
+}
+
+// text/*, JSON and JavaScript without a charset parameter, binary types stay untouched
+static bool needsCharset(const char *str, size_t len)
+{
+    size_t typeLen = 0;
+    while (typeLen < len && str[typeLen] != ';' && str[typeLen] != ' ')
+    {
+        typeLen++;
+    }
+    bool textual = startsWith(str, typeLen, "text/") ||
+                   (typeLen == 16 && strncasecmp(str, "application/json", 16) == 0) ||
+                   (typeLen == 22 && strncasecmp(str, "application/javascript", 22) == 0) ||
+                   (typeLen > 5 && strncasecmp(str + typeLen - 5, "+json", 5) == 0);
+    if (!textual)
+    {
+        return false;
+    }
+    for (size_t i = typeLen; i + 7 <= len; i++)
+    {
+        if (strncasecmp(str + i, "charset", 7) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static char *append(char *pos, const char *data, size_t len)
+{
+    memcpy(pos, data, len);
+    return pos + len;
+}
+
+/**
+ * Serializes status line and headers of a response into a single Uint8Array.
+ * The status line and the framing headers selected by flags are copied from
+ * pre-encoded constants. A textual content-type (text/..., JSON, JavaScript)
+ * without charset gets "; charset=utf-8" appended, a missing content-type
+ * defaults to text/plain unless the status does not allow a body (1xx, 204,
+ * 304).
+ *
+ * Arguments: status, statusText (empty for the standard reason phrase),
+ * flat array of header names and values, flags.
+ */
+static duk_ret_t el_buildResponseHead(duk_context *ctx)
+{
+    int status = duk_require_int(ctx, 0);
+    duk_size_t statusTextLen = 0;
+    const char *statusText = duk_is_string(ctx, 1) ? duk_get_lstring(ctx, 1, &statusTextLen) : NULL;
+    duk_require_object(ctx, 2);
+    int headerCount = duk_get_length(ctx, 2) & ~1;
+    int flags = duk_get_int_default(ctx, 3, 0);
+
+    if (status < 100 || status > 999)
+    {
+        return duk_range_error(ctx, "Invalid status %d", status);
+    }
+    if (statusText != NULL && containsLineBreak(statusText, statusTextLen))
+    {
+        return duk_type_error(ctx, "Invalid status text");
+    }
+
+    const status_line_t *statusLine = findStatusLine(status);
+    if (statusLine != NULL && statusTextLen > 0 &&
+        (strlen(statusLine->text) != statusTextLen || memcmp(statusLine->text, statusText, statusTextLen) != 0))
+    {
+        // custom reason phrase
+        statusLine = NULL;
+    }
+    char statusCode[4];
+    snprintf(statusCode, sizeof(statusCode), "%d", status);
+
+    // first pass: validate headers and compute the exact size of the head
+    size_t len = statusLine != NULL ? statusLine->lineLen : (sizeof("HTTP/1.1 ") - 1) + 3 + 1 + statusTextLen + 2;
+    bool hasContentType = false;
+    for (int i = 0; i < headerCount; i += 2)
+    {
+        duk_size_t nameLen, valueLen;
+        duk_get_prop_index(ctx, 2, i);
+        const char *name = duk_to_lstring(ctx, -1, &nameLen);
+        duk_get_prop_index(ctx, 2, i + 1);
+        const char *value = duk_to_lstring(ctx, -1, &valueLen);
+        if (nameLen == 0 || containsLineBreak(name, nameLen) || memchr(name, ':', nameLen) != NULL ||
+            containsLineBreak(value, valueLen))
+        {
+            return duk_type_error(ctx, "Invalid header %s", name);
+        }
+        len += nameLen + 2 + valueLen + 2;
+        if (nameLen == 12 && strncasecmp(name, "content-type", 12) == 0)
+        {
+            hasContentType = true;
+            if (needsCharset(value, valueLen))
+            {
+                len += CHARSET_SUFFIX_LEN;
+            }
+        }
+        duk_pop_2(ctx);
+    }
+    if (flags & RESPONSE_HEAD_CONNECTION_CLOSE)
+    {
+        len += connectionClose.lineLen;
+    }
+    else if (flags & RESPONSE_HEAD_CONNECTION_KEEP_ALIVE)
+    {
+        len += connectionKeepAlive.lineLen;
+    }
+    if (flags & RESPONSE_HEAD_CHUNKED)
+    {
+        len += transferEncodingChunked.lineLen;
+    }
+    bool addContentType = !hasContentType && status >= 200 && status != 204 && status != 304;
+    if (addContentType)
+    {
+        len += defaultContentType.lineLen;
+    }
+    len += 2;
+
+    // second pass: copy everything into one buffer
+    char *head = (char *)duk_push_fixed_buffer(ctx, len);
+    char *pos = head;
+    if (statusLine != NULL)
+    {
+        pos = append(pos, statusLine->line, statusLine->lineLen);
+    }
+    else
+    {
+        pos = append(pos, "HTTP/1.1 ", sizeof("HTTP/1.1 ") - 1);
+        pos = append(pos, statusCode, 3);
+        *pos++ = ' ';
+        if (statusTextLen > 0)
+        {
+            pos = append(pos, statusText, statusTextLen);
+        }
+        pos = append(pos, "\r\n", 2);
+    }
+    for (int i = 0; i < headerCount; i += 2)
+    {
+        duk_size_t nameLen, valueLen;
+        duk_get_prop_index(ctx, 2, i);
+        const char *name = duk_to_lstring(ctx, -1, &nameLen);
+        duk_get_prop_index(ctx, 2, i + 1);
+        const char *value = duk_to_lstring(ctx, -1, &valueLen);
+        pos = append(pos, name, nameLen);
+        pos = append(pos, ": ", 2);
+        pos = append(pos, value, valueLen);
+        if (nameLen == 12 && strncasecmp(name, "content-type", 12) == 0 && needsCharset(value, valueLen))
+        {
+            pos = append(pos, charsetSuffix, CHARSET_SUFFIX_LEN);
+        }
+        pos = append(pos, "\r\n", 2);
+        duk_pop_2(ctx);
+    }
+    if (flags & RESPONSE_HEAD_CONNECTION_CLOSE)
+    {
+        pos = append(pos, connectionClose.line, connectionClose.lineLen);
+    }
+    else if (flags & RESPONSE_HEAD_CONNECTION_KEEP_ALIVE)
+    {
+        pos = append(pos, connectionKeepAlive.line, connectionKeepAlive.lineLen);
+    }
+    if (flags & RESPONSE_HEAD_CHUNKED)
+    {
+        pos = append(pos, transferEncodingChunked.line, transferEncodingChunked.lineLen);
+    }
+    if (addContentType)
+    {
+        pos = append(pos, defaultContentType.line, defaultContentType.lineLen);
+    }
+    append(pos, "\r\n", 2);
+
+    duk_push_buffer_object(ctx, -1, 0, len, DUK_BUFOBJ_UINT8ARRAY);
+    return 1;
+}
+
+void registerResponseHeadBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_buildResponseHead, 4);
+    duk_put_global_string(ctx, "el_buildResponseHead");
+}
@@ -0,0 +1,428 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <errno.h>
+#include <string.h>
+#include <openssl/ssl.h>
+#include <lwip/sockets.h>
+#include "socket-bindings.h"
+#include "socket-events.h"
+#include "tcp.h"
+#include "dns-cache.h"
+#include "socket-stats.h"
+#include "file-stream.h"
+#include "idle-timeout.h"
+#include "http-parser.h"
+#include "response-head.h"
+#include "deflate-stream.h"
+#include "websocket.h"
+#include "mqtt.h"
+#include "multipart.h"
+#include "header-map.h"
+#include "byte-buffer.h"
+#include "json-writer.h"
+#include "cbor.h"
+#include "esp32-javascript.h"
+#include "esp32-js-log.h"
+
+static duk_ret_t el_createNonBlockingSocket(duk_context *ctx)
+{
+    int sockfd = createNonBlockingSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, true);
+
+    duk_push_int(ctx, sockfd);
+    return 1;
+}
+
+static duk_ret_t el_connectNonBlocking(duk_context *ctx)
+{
+    int sockfd = duk_to_int(ctx, 0);
+    const char *hostname = duk_to_string(ctx, 1);
+    int port = duk_to_int(ctx, 2);
+
+    int ret = connectNonBlocking(sockfd, hostname, port);
+    duk_push_int(ctx, ret);
+    return 1;
+}
+
+static duk_ret_t el_clearDnsCache(duk_context *ctx)
+{
+    clearDnsCache();
+    return 0;
+}
+
+static duk_ret_t el_bindAndListen(duk_context *ctx)
+{
+    int sockfd = duk_to_int(ctx, 0);
+    int port = duk_to_int(ctx, 1);
+
+    int ret = bindAndListen(sockfd, port);
+    duk_push_int(ctx, ret);
+    return 1;
+}
+
+static duk_ret_t el_acceptIncoming(duk_context *ctx)
+{
+    int sockfd = duk_to_int(ctx, 0);
+
+    socketStatsDispatch(sockfd);
+    int ret = acceptIncoming(sockfd);
+    if (ret < 0)
+    {
+        if (errno == EAGAIN)
+        {
+            // expected once the backlog is drained
+            jslog(DEBUG, "accept returned EAGAIN\n");
+            //return undefined
+            return 0;
+        }
+        else
+        {
+            jslog(ERROR, "accept returned errno:%d on socket %d\n", errno, sockfd);
+        }
+    }
+
+    duk_push_int(ctx, ret);
+    return 1;
+}
+
+static duk_ret_t el_closeSocket(duk_context *ctx)
+{
+    int socketfd = duk_to_int(ctx, 0);
+    closeSocket(socketfd);
+    return 0;
+}
+
+static duk_ret_t el_shutdownSocket(duk_context *ctx)
+{
+    shutdownSocket(duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t writeSocket_bind(duk_context *ctx)
+{
+    int sockfd = duk_to_int(ctx, 0);
+    const char *msg = NULL;
+    int len = 0;
+    int offset = 0;
+    SSL *ssl = NULL;
+
+    if (!duk_is_undefined(ctx, 3))
+    {
+        offset = duk_to_int(ctx, 3);
+    }
+    if (!duk_is_undefined(ctx, 4))
+    {
+        ssl = (SSL *)duk_to_int(ctx, 4);
+    }
+
+    if (duk_is_string(ctx, 1))
+    {
+        msg = duk_to_string(ctx, 1);
+        if (duk_is_undefined(ctx, 2))
+        {
+            len = strlen(msg) - offset;
+        }
+        else
+        {
+            len = duk_to_int(ctx, 2);
+        }
+    }
+    else
+    {
+        duk_size_t buffer_len;
+        msg = (char *)duk_get_buffer_data(ctx, 1, &buffer_len);
+
+        if (duk_is_undefined(ctx, 2))
+        {
+            len = buffer_len - offset;
+        }
+        else
+        {
+            len = duk_to_int(ctx, 2);
+
+            if (len + offset > buffer_len)
+            {
+                return -1;
+            }
+        }
+    }
+    int ret = writeSocket(sockfd, msg + offset, len, ssl);
+
+    duk_push_int(ctx, ret);
+    return 1;
+}
+
+static duk_ret_t el_readSocket(duk_context *ctx)
+{
+    int sockfd = duk_to_int(ctx, 0);
+
+    SSL *ssl = NULL;
+    if (!duk_is_undefined(ctx, 1))
+    {
+        ssl = (SSL *)duk_to_int(ctx, 1);
+    }
+
+    socketStatsDispatch(sockfd);
+
+    int LEN = 3 * 1024;
+    char msg[LEN];
+
+    int ret = 0;
+    int error = 0;
+
+    if (ssl == NULL)
+    {
+        ret = readSocket(sockfd, msg, LEN - 1);
+        error = errno;
+    }
+    else
+    {
+        ret = SSL_read(ssl, msg, LEN - 1);
+        if (ret < 0)
+        {
+            error = SSL_get_error(ssl, ret);
+        }
+    }
+
+    if (ret >= 0)
+    {
+        socketStatsRead(sockfd, ret, false);
+        touchSocket(sockfd);
+        msg[ret] = '\0';
+        duk_idx_t obj_idx = duk_push_object(ctx);
+        duk_push_int(ctx, ret);
+        duk_put_prop_string(ctx, obj_idx, "length");
+        duk_push_lstring(ctx, msg, ret);
+        duk_put_prop_string(ctx, obj_idx, "data");
+    }
+    else if ((ssl == NULL && error == EAGAIN) || (ssl != NULL && error == SSL_ERROR_WANT_READ))
+    {
+        jslog(DEBUG, "*** EAGAIN OR SSL_ERROR_WANT_READ RETURNED!!!\n");
+        socketStatsRead(sockfd, 0, true);
+
+        //eagain
+        duk_push_undefined(ctx);
+    }
+    else
+    {
+        jslog(ERROR, "READ ERROR return value %d and error code %d\n", ret, error);
+        //error
+        duk_push_null(ctx);
+    }
+    return 1;
+}
+
+static duk_ret_t el_openFileStream(duk_context *ctx)
+{
+    const char *path = duk_to_string(ctx, 0);
+    long offset = duk_is_undefined(ctx, 1) ? 0 : duk_to_int(ctx, 1);
+    long length = duk_is_undefined(ctx, 2) ? -1 : duk_to_int(ctx, 2);
+
+    file_stream_t *stream = openFileStream(path, offset, length);
+    duk_push_int(ctx, stream != NULL ? (duk_int_t)stream : -1);
+    return 1;
+}
+
+static duk_ret_t el_sendFileStream(duk_context *ctx)
+{
+    file_stream_t *stream = (file_stream_t *)duk_to_int(ctx, 0);
+    int sockfd = duk_to_int(ctx, 1);
+    SSL *ssl = NULL;
+    if (!duk_is_undefined(ctx, 2) && !duk_is_null(ctx, 2))
+    {
+        ssl = (SSL *)duk_to_int(ctx, 2);
+    }
+
+    duk_push_number(ctx, sendFileStream(stream, sockfd, ssl));
+    return 1;
+}
+
+static duk_ret_t el_closeFileStream(duk_context *ctx)
+{
+    closeFileStream((file_stream_t *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t el_setIdleTimeout(duk_context *ctx)
+{
+    int sockfd = duk_to_int(ctx, 0);
+    int timeout = duk_to_int(ctx, 1);
+    setIdleTimeout(sockfd, timeout);
+    return 0;
+}
+
+static duk_ret_t el_sweepIdleSockets(duk_context *ctx)
+{
+    int sockfds[CONFIG_LWIP_MAX_SOCKETS];
+    int armed = 0;
+    int count = collectIdleSockets(sockfds, CONFIG_LWIP_MAX_SOCKETS, &armed);
+
+    duk_idx_t obj_idx = duk_push_object(ctx);
+    duk_idx_t arr_idx = duk_push_array(ctx);
+    for (int i = 0; i < count; i++)
+    {
+        duk_push_int(ctx, sockfds[i]);
+        duk_put_prop_index(ctx, arr_idx, i);
+    }
+    duk_put_prop_string(ctx, obj_idx, "expired");
+    duk_push_int(ctx, armed);
+    duk_put_prop_string(ctx, obj_idx, "armed");
+    return 1;
+}
+
+static duk_ret_t el_getsockopt(duk_context *ctx)
+{
+    int sockfd = duk_to_int(ctx, 0);
+    int val;
+    unsigned int len = sizeof(int);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &val, &len) < 0)
+    {
+        return -1;
+    }
+    duk_push_int(ctx, val);
+    return 1;
+}
+
+static void pushSocketStats(duk_context *ctx, duk_idx_t obj_idx, const socket_stats_t *stats)
+{
+    duk_push_number(ctx, stats->bytesIn);
+    duk_put_prop_string(ctx, obj_idx, "bytesIn");
+    duk_push_number(ctx, stats->bytesOut);
+    duk_put_prop_string(ctx, obj_idx, "bytesOut");
+    duk_push_uint(ctx, stats->reads);
+    duk_put_prop_string(ctx, obj_idx, "reads");
+    duk_push_uint(ctx, stats->writes);
+    duk_put_prop_string(ctx, obj_idx, "writes");
+    duk_push_uint(ctx, stats->readEagain);
+    duk_put_prop_string(ctx, obj_idx, "readEagain");
+    duk_push_uint(ctx, stats->writeEagain);
+    duk_put_prop_string(ctx, obj_idx, "writeEagain");
+    duk_push_uint(ctx, stats->handshakes);
+    duk_put_prop_string(ctx, obj_idx, "handshakes");
+    duk_push_number(ctx, stats->handshakeUs);
+    duk_put_prop_string(ctx, obj_idx, "handshakeUs");
+    duk_push_uint(ctx, stats->firstBytes);
+    duk_put_prop_string(ctx, obj_idx, "firstBytes");
+    duk_push_number(ctx, stats->firstByteUs);
+    duk_put_prop_string(ctx, obj_idx, "firstByteUs");
+    duk_push_uint(ctx, stats->dispatches);
+    duk_put_prop_string(ctx, obj_idx, "dispatches");
+    duk_push_number(ctx, stats->dispatchUs);
+    duk_put_prop_string(ctx, obj_idx, "dispatchUs");
+    duk_push_number(ctx, stats->dispatchMaxUs);
+    duk_put_prop_string(ctx, obj_idx, "dispatchMaxUs");
+}
+
+static duk_ret_t el_getSocketStats(duk_context *ctx)
+{
+    socket_stats_t stats;
+    if (duk_is_undefined(ctx, 0) || duk_to_int(ctx, 0) < 0)
+    {
+        int openSockets;
+        uint32_t closedSockets;
+        getTotalSocketStats(&stats, &openSockets, &closedSockets);
+        duk_idx_t obj_idx = duk_push_object(ctx);
+        pushSocketStats(ctx, obj_idx, &stats);
+        duk_push_int(ctx, openSockets);
+        duk_put_prop_string(ctx, obj_idx, "openSockets");
+        duk_push_uint(ctx, closedSockets);
+        duk_put_prop_string(ctx, obj_idx, "closedSockets");
+    }
+    else if (getSocketStats(duk_to_int(ctx, 0), &stats))
+    {
+        duk_idx_t obj_idx = duk_push_object(ctx);
+        pushSocketStats(ctx, obj_idx, &stats);
+    }
+    else
+    {
+        duk_push_undefined(ctx);
+    }
+    return 1;
+}
+
+void registerSocketBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, writeSocket_bind, 5 /*nargs*/);
+    duk_put_global_string(ctx, "writeSocket");
+
+    duk_push_c_function(ctx, el_readSocket, 2 /*nargs*/);
+    duk_put_global_string(ctx, "readSocket");
+
+    duk_push_c_function(ctx, el_closeSocket, 1 /*nargs*/);
+    duk_put_global_string(ctx, "el_closeSocket");
+
+    duk_push_c_function(ctx, el_shutdownSocket, 1 /*nargs*/);
+    duk_put_global_string(ctx, "el_shutdownSocket");
+
+    duk_push_c_function(ctx, el_createNonBlockingSocket, 0 /*nargs*/);
+    duk_put_global_string(ctx, "el_createNonBlockingSocket");
+
+    duk_push_c_function(ctx, el_connectNonBlocking, 3 /*nargs*/);
+    duk_put_global_string(ctx, "el_connectNonBlocking");
+
+    duk_push_c_function(ctx, el_clearDnsCache, 0 /*nargs*/);
+    duk_put_global_string(ctx, "el_clearDnsCache");
+
+    duk_push_c_function(ctx, el_bindAndListen, 2 /*nargs*/);
+    duk_put_global_string(ctx, "el_bindAndListen");
+
+    duk_push_c_function(ctx, el_acceptIncoming, 1 /*nargs*/);
+    duk_put_global_string(ctx, "el_acceptIncoming");
+
+    duk_push_c_function(ctx, el_setIdleTimeout, 2);
+    duk_put_global_string(ctx, "el_setIdleTimeout");
+
+    duk_push_c_function(ctx, el_sweepIdleSockets, 0);
+    duk_put_global_string(ctx, "el_sweepIdleSockets");
+
+    duk_push_c_function(ctx, el_openFileStream, 3);
+    duk_put_global_string(ctx, "el_openFileStream");
+
+    duk_push_c_function(ctx, el_sendFileStream, 3);
+    duk_put_global_string(ctx, "el_sendFileStream");
+
+    duk_push_c_function(ctx, el_closeFileStream, 1);
+    duk_put_global_string(ctx, "el_closeFileStream");
+
+    duk_push_c_function(ctx, el_getSocketStats, 1);
+    duk_put_global_string(ctx, "el_getSocketStats");
+
+    duk_push_c_function(ctx, el_getsockopt, 1);
+    duk_put_global_string(ctx, "el_getsockopt");
+
+    duk_push_int(ctx, EL_SOCKET_EVENT_TYPE);
+    duk_put_global_string(ctx, "EL_SOCKET_EVENT_TYPE");
+
+    registerHttpParserBindings(ctx);
+    registerResponseHeadBindings(ctx);
+    registerDeflateStreamBindings(ctx);
+    registerWebSocketBindings(ctx);
+    registerMqttBindings(ctx);
+    registerMultipartBindings(ctx);
+    registerHeaderMapBindings(ctx);
+    registerByteBufferBindings(ctx);
+    registerJsonWriterBindings(ctx);
+    registerCborBindings(ctx);
+}
@@ -32,6 +32,10 @@ SOFTWARE.
 #include "freertos/semphr.h"
 #include "esp_log.h"
 #include "tcp.h"
+#include "dns-cache.h"
+#include "tls-session-cache.h"
+#include "socket-stats.h"
+#include "socket-bindings.h"
 #include "esp32-javascript.h"
 #include "esp32-js-log.h"
 
@@ -291,6 +295,7 @@ void select_task_it()
                     }
                     else if (FD_ISSET(sockfd, &readset))
                     {
+                        socketStatsReadable(sockfd);
                         js_event_t event;
                         el_create_event(&event, EL_SOCKET_EVENT_TYPE, EL_SOCKET_STATUS_READ, (void *)sockfd);
                         el_add_event(&events, &event);
@@ -477,58 +482,6 @@ static duk_ret_t el_registerSocketEvents(duk_context *ctx)
     return 0;
 }
 
-static duk_ret_t el_createNonBlockingSocket(duk_context *ctx)
-{
-    int sockfd = createNonBlockingSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, true);
-
-    duk_push_int(ctx, sockfd);
-    return 1;
-}
-
-static duk_ret_t el_connectNonBlocking(duk_context *ctx)
-{
-    int sockfd = duk_to_int(ctx, 0);
-    const char *hostname = duk_to_string(ctx, 1);
-    int port = duk_to_int(ctx, 2);
-
-    int ret = connectNonBlocking(sockfd, hostname, port);
-    duk_push_int(ctx, ret);
-    return 1;
-}
-
-static duk_ret_t el_bindAndListen(duk_context *ctx)
-{
-    int sockfd = duk_to_int(ctx, 0);
-    int port = duk_to_int(ctx, 1);
-
-    int ret = bindAndListen(sockfd, port);
-    duk_push_int(ctx, ret);
-    return 1;
-}
-
-static duk_ret_t el_acceptIncoming(duk_context *ctx)
-{
-    int sockfd = duk_to_int(ctx, 0);
-
-    int ret = acceptIncoming(sockfd);
-    if (ret < 0)
-    {
-        if (errno == EAGAIN)
-        {
-            jslog(INFO, "accept returned EAGAIN\n");
-            //return undefined
-            return 0;
-        }
-        else
-        {
-            jslog(ERROR, "accept returned errno:%d on socket %d\n", errno, sockfd);
-        }
-    }
-
-    duk_push_int(ctx, ret);
-    return 1;
-}
-
 static duk_ret_t shutdownSSL(duk_context *ctx)
 {
     SSL *ssl = (SSL *)duk_to_int(ctx, 0);
@@ -547,20 +500,38 @@ static duk_ret_t acceptSSL(duk_context *ctx)
 {
     SSL *ssl = (SSL *)duk_to_int(ctx, 0);
     int sockfd = duk_to_int(ctx, 1);
-    jslog(INFO, "SSL server accept client ......");
-    SSL_set_fd(ssl, sockfd);
-    jslog(INFO, "SSL_accept ......");
+    if (SSL_get_fd(ssl) < 0)
+    {
+        jslog(INFO, "SSL server accept client ......");
+        SSL_set_fd(ssl, sockfd);
+        socketStatsHandshakeStart(sockfd);
+    }
     errno = 0;
     int ret = SSL_accept(ssl);
+    int result = EL_SSL_HANDSHAKE_DONE;
     if (ret <= 0)
     {
-        jslog(INFO, "SSL_accept failed; return value %d and error %d and errno %d", ret, SSL_get_error(ssl, ret), errno);
+        int err = SSL_get_error(ssl, ret);
+        if (err == SSL_ERROR_WANT_WRITE)
+        {
+            result = EL_SSL_HANDSHAKE_WANT_WRITE;
+        }
+        else if (err == SSL_ERROR_WANT_READ || (err == SSL_ERROR_SYSCALL && errno == EAGAIN))
+        {
+            result = EL_SSL_HANDSHAKE_WANT_READ;
+        }
+        else
+        {
+            jslog(INFO, "SSL_accept failed; return value %d and error %d and errno %d", ret, err, errno);
+            result = EL_SSL_HANDSHAKE_FAILED;
+        }
     }
     else
     {
         jslog(INFO, "OK");
+        socketStatsHandshakeDone(sockfd);
     }
-    duk_push_int(ctx, ret);
+    duk_push_int(ctx, result);
     return 1;
 }
 
@@ -569,12 +540,25 @@ static duk_ret_t connectSSL(duk_context *ctx)
     int before = errno;
     SSL *ssl = (SSL *)duk_to_int(ctx, 0);
     int sockfd = duk_to_int(ctx, 1);
+    const char *hostname = NULL;
+    int port = 0;
+    if (!duk_is_undefined(ctx, 2))
+    {
+        hostname = duk_to_string(ctx, 2);
+        port = duk_to_int(ctx, 3);
+    }
+    struct ssl_pm *ssl_pm = ssl->ssl_pm;
+
     jslog(INFO, "SSL server connect server ......");
     if (SSL_get_fd(ssl) < 0)
     {
         SSL_set_fd(ssl, sockfd);
+        socketStatsHandshakeStart(sockfd);
+        if (hostname != NULL && loadTlsSession(&(ssl_pm->ssl), hostname, port))
+        {
+            jslog(DEBUG, "Offering cached TLS session for %s:%d\n", hostname, port);
+        }
     }
-    struct ssl_pm *ssl_pm = ssl->ssl_pm;
     esp_crt_bundle_attach(&(ssl_pm->conf));
 
     int ret = SSL_connect(ssl);
@@ -593,143 +577,29 @@ static duk_ret_t connectSSL(duk_context *ctx)
             error = -1; //means "error"
         }
     }
-
-    if (error < 0)
-    {
-        SSL_shutdown(ssl);
-    }
-
-    duk_push_int(ctx, error);
-    return 1;
-}
-
-static duk_ret_t el_closeSocket(duk_context *ctx)
-{
-    int socketfd = duk_to_int(ctx, 0);
-    closeSocket(socketfd);
-    return 0;
-}
-
-static duk_ret_t writeSocket_bind(duk_context *ctx)
-{
-    int sockfd = duk_to_int(ctx, 0);
-    const char *msg = NULL;
-    int len = 0;
-    int offset = 0;
-    SSL *ssl = NULL;
-
-    if (!duk_is_undefined(ctx, 3))
-    {
-        offset = duk_to_int(ctx, 3);
-    }
-    if (!duk_is_undefined(ctx, 4))
+    else if (hostname != NULL && storeTlsSession(&(ssl_pm->ssl), hostname, port))
     {
-        ssl = (SSL *)duk_to_int(ctx, 4);
+        jslog(DEBUG, "Resumed TLS session for %s:%d\n", hostname, port);
+        error = 2; // means "no error, session was resumed"
     }
 
-    if (duk_is_string(ctx, 1))
+    if (error < 0)
     {
-        msg = duk_to_string(ctx, 1);
-        if (duk_is_undefined(ctx, 2))
-        {
-            len = strlen(msg) - offset;
-        }
-        else
-        {
-            len = duk_to_int(ctx, 2);
-        }
+        SSL_shutdown(ssl);
     }
-    else
+    else if (error > 0)
     {
-        duk_size_t buffer_len;
-        msg = (char *)duk_get_buffer_data(ctx, 1, &buffer_len);
-
-        if (duk_is_undefined(ctx, 2))
-        {
-            len = buffer_len - offset;
-        }
-        else
-        {
-            len = duk_to_int(ctx, 2);
-
-            if (len + offset > buffer_len)
-            {
-                return -1;
-            }
-        }
+        socketStatsHandshakeDone(sockfd);
     }
-    int ret = writeSocket(sockfd, msg + offset, len, ssl);
-
-    duk_push_int(ctx, ret);
-    return 1;
-}
 
-static duk_ret_t el_getsockopt(duk_context *ctx)
-{
-    int sockfd = duk_to_int(ctx, 0);
-    int val;
-    unsigned int len = sizeof(int);
-    if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &val, &len) < 0)
-    {
-        return -1;
-    }
-    duk_push_int(ctx, val);
+    duk_push_int(ctx, error);
     return 1;
 }
 
-static duk_ret_t el_readSocket(duk_context *ctx)
+static duk_ret_t el_clearTlsSessionCache(duk_context *ctx)
 {
-    int sockfd = duk_to_int(ctx, 0);
-
-    SSL *ssl = NULL;
-    if (!duk_is_undefined(ctx, 1))
-    {
-        ssl = (SSL *)duk_to_int(ctx, 1);
-    }
-
-    int LEN = 3 * 1024;
-    char msg[LEN];
-
-    int ret = 0;
-    int error = 0;
-
-    if (ssl == NULL)
-    {
-        ret = readSocket(sockfd, msg, LEN - 1);
-        error = errno;
-    }
-    else
-    {
-        ret = SSL_read(ssl, msg, LEN - 1);
-        if (ret < 0)
-        {
-            error = SSL_get_error(ssl, ret);
-        }
-    }
-
-    if (ret >= 0)
-    {
-        msg[ret] = '\0';
-        duk_idx_t obj_idx = duk_push_object(ctx);
-        duk_push_int(ctx, ret);
-        duk_put_prop_string(ctx, obj_idx, "length");
-        duk_push_string(ctx, msg);
-        duk_put_prop_string(ctx, obj_idx, "data");
-    }
-    else if ((ssl == NULL && error == EAGAIN) || (ssl != NULL && error == SSL_ERROR_WANT_READ))
-    {
-        jslog(DEBUG, "*** EAGAIN OR SSL_ERROR_WANT_READ RETURNED!!!\n");
-
-        //eagain
-        duk_push_undefined(ctx);
-    }
-    else
-    {
-        jslog(ERROR, "READ ERROR return value %d and error code %d\n", ret, error);
-        //error
-        duk_push_null(ctx);
-    }
-    return 1;
+    clearTlsSessionCache();
+    return 0;
 }
 
 void select_task(void *ignore)
@@ -837,26 +707,7 @@ static duk_ret_t el_createSSL(duk_context *ctx)
 
 void initSocketFunctions(duk_context *ctx)
 {
-    duk_push_c_function(ctx, writeSocket_bind, 5 /*nargs*/);
-    duk_put_global_string(ctx, "writeSocket");
-
-    duk_push_c_function(ctx, el_readSocket, 2 /*nargs*/);
-    duk_put_global_string(ctx, "readSocket");
-
-    duk_push_c_function(ctx, el_closeSocket, 1 /*nargs*/);
-    duk_put_global_string(ctx, "el_closeSocket");
-
-    duk_push_c_function(ctx, el_createNonBlockingSocket, 0 /*nargs*/);
-    duk_put_global_string(ctx, "el_createNonBlockingSocket");
-
-    duk_push_c_function(ctx, el_connectNonBlocking, 3 /*nargs*/);
-    duk_put_global_string(ctx, "el_connectNonBlocking");
-
-    duk_push_c_function(ctx, el_bindAndListen, 2 /*nargs*/);
-    duk_put_global_string(ctx, "el_bindAndListen");
-
-    duk_push_c_function(ctx, el_acceptIncoming, 1 /*nargs*/);
-    duk_put_global_string(ctx, "el_acceptIncoming");
+    registerSocketBindings(ctx);
 
     duk_push_c_function(ctx, el_registerSocketEvents, 3 /*nargs*/);
     duk_put_global_string(ctx, "el_registerSocketEvents");
@@ -873,22 +724,22 @@ void initSocketFunctions(duk_context *ctx)
     duk_push_c_function(ctx, acceptSSL, 2);
     duk_put_global_string(ctx, "acceptSSL");
 
-    duk_push_c_function(ctx, connectSSL, 2);
+    duk_push_c_function(ctx, connectSSL, 4);
     duk_put_global_string(ctx, "connectSSL");
 
+    duk_push_c_function(ctx, el_clearTlsSessionCache, 0);
+    duk_put_global_string(ctx, "el_clearTlsSessionCache");
+
     duk_push_c_function(ctx, shutdownSSL, 1);
     duk_put_global_string(ctx, "shutdownSSL");
 
     duk_push_c_function(ctx, freeSSL, 1);
     duk_put_global_string(ctx, "freeSSL");
 
-    duk_push_c_function(ctx, el_getsockopt, 1);
-    duk_put_global_string(ctx, "el_getsockopt");
-
-    duk_push_int(ctx, EL_SOCKET_EVENT_TYPE);
-    duk_put_global_string(ctx, "EL_SOCKET_EVENT_TYPE");
-
     xSemaphore = xSemaphoreCreateBinary();
 
+    initSocketStats();
+    initDnsCache();
+
     xTaskCreatePinnedToCore(&select_task, "select_task", 12 * 1024, NULL, 5, &stask, 0);
 }
\ No newline at end of file
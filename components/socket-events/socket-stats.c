@@ -0,0 +1,257 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "socket-stats.h"
+
+// Entries are allocated and read by the duktape task only. The select task
+// stores the time a socket became readable, so looking up an entry for
+// that, allocating and releasing entries are done under entriesMutex. An
+// entry cannot be handed to another socket between lookup and write then.
+typedef struct
+{
+    int sockfd;
+    int64_t openedAt;
+    int64_t handshakeStartedAt;
+    volatile uint32_t readableAt;
+    socket_stats_t stats;
+} socket_stats_entry_t;
+
+static socket_stats_entry_t entries[SOCKET_STATS_SIZE];
+static bool initialized = false;
+static SemaphoreHandle_t entriesMutex;
+// sockets which were closed or could not be tracked
+static socket_stats_t closedStats;
+static uint32_t closedSockets = 0;
+
+static socket_stats_entry_t *findEntry(int sockfd)
+{
+    if (!initialized || sockfd < 0)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < SOCKET_STATS_SIZE; i++)
+    {
+        if (entries[i].sockfd == sockfd)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static socket_stats_t *findStats(int sockfd)
+{
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    return entry != NULL ? &entry->stats : &closedStats;
+}
+
+static void addStats(socket_stats_t *sum, const socket_stats_t *stats)
+{
+    sum->bytesIn += stats->bytesIn;
+    sum->bytesOut += stats->bytesOut;
+    sum->reads += stats->reads;
+    sum->writes += stats->writes;
+    sum->readEagain += stats->readEagain;
+    sum->writeEagain += stats->writeEagain;
+    sum->handshakes += stats->handshakes;
+    sum->handshakeUs += stats->handshakeUs;
+    sum->firstBytes += stats->firstBytes;
+    sum->firstByteUs += stats->firstByteUs;
+    sum->dispatches += stats->dispatches;
+    sum->dispatchUs += stats->dispatchUs;
+    if (stats->dispatchMaxUs > sum->dispatchMaxUs)
+    {
+        sum->dispatchMaxUs = stats->dispatchMaxUs;
+    }
+}
+
+void initSocketStats()
+{
+    for (int i = 0; i < SOCKET_STATS_SIZE; i++)
+    {
+        entries[i].sockfd = -1;
+    }
+    entriesMutex = xSemaphoreCreateMutex();
+    initialized = true;
+}
+
+void socketStatsOpen(int sockfd)
+{
+    if (!initialized)
+    {
+        return;
+    }
+    xSemaphoreTake(entriesMutex, portMAX_DELAY);
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    for (int i = 0; entry == NULL && i < SOCKET_STATS_SIZE; i++)
+    {
+        if (entries[i].sockfd < 0)
+        {
+            entry = &entries[i];
+        }
+    }
+    if (entry != NULL)
+    {
+        memset(entry, 0, sizeof(socket_stats_entry_t));
+        entry->openedAt = esp_timer_get_time();
+        entry->sockfd = sockfd;
+    }
+    xSemaphoreGive(entriesMutex);
+}
+
+void socketStatsClose(int sockfd)
+{
+    if (!initialized)
+    {
+        return;
+    }
+    xSemaphoreTake(entriesMutex, portMAX_DELAY);
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    if (entry != NULL)
+    {
+        addStats(&closedStats, &entry->stats);
+        entry->sockfd = -1;
+    }
+    closedSockets++;
+    xSemaphoreGive(entriesMutex);
+}
+
+void socketStatsRead(int sockfd, int len, bool eagain)
+{
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    socket_stats_t *stats = entry != NULL ? &entry->stats : &closedStats;
+    if (eagain)
+    {
+        stats->readEagain++;
+        return;
+    }
+    stats->reads++;
+    if (len > 0)
+    {
+        if (entry != NULL && stats->bytesIn == 0)
+        {
+            stats->firstBytes = 1;
+            stats->firstByteUs = esp_timer_get_time() - entry->openedAt;
+        }
+        stats->bytesIn += len;
+    }
+}
+
+void socketStatsWrite(int sockfd, int len, bool eagain)
+{
+    socket_stats_t *stats = findStats(sockfd);
+    if (eagain)
+    {
+        stats->writeEagain++;
+        return;
+    }
+    stats->writes++;
+    if (len > 0)
+    {
+        stats->bytesOut += len;
+    }
+}
+
+// called from the select task
+void socketStatsReadable(int sockfd)
+{
+    if (!initialized)
+    {
+        return;
+    }
+    xSemaphoreTake(entriesMutex, portMAX_DELAY);
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    if (entry != NULL && entry->readableAt == 0)
+    {
+        entry->readableAt = (uint32_t)esp_timer_get_time() | 1;
+    }
+    xSemaphoreGive(entriesMutex);
+}
+
+void socketStatsDispatch(int sockfd)
+{
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    if (entry != NULL && entry->readableAt != 0)
+    {
+        int64_t latency = (uint32_t)esp_timer_get_time() - entry->readableAt;
+        entry->readableAt = 0;
+        entry->stats.dispatches++;
+        entry->stats.dispatchUs += latency;
+        if (latency > entry->stats.dispatchMaxUs)
+        {
+            entry->stats.dispatchMaxUs = latency;
+        }
+    }
+}
+
+void socketStatsHandshakeStart(int sockfd)
+{
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    if (entry != NULL)
+    {
+        entry->handshakeStartedAt = esp_timer_get_time();
+    }
+}
+
+void socketStatsHandshakeDone(int sockfd)
+{
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    if (entry != NULL && entry->handshakeStartedAt > 0)
+    {
+        entry->stats.handshakes++;
+        entry->stats.handshakeUs += esp_timer_get_time() - entry->handshakeStartedAt;
+        entry->handshakeStartedAt = 0;
+    }
+}
+
+bool getSocketStats(int sockfd, socket_stats_t *stats)
+{
+    socket_stats_entry_t *entry = findEntry(sockfd);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    *stats = entry->stats;
+    return true;
+}
+
+void getTotalSocketStats(socket_stats_t *stats, int *openSockets, uint32_t *closed)
+{
+    *stats = closedStats;
+    *openSockets = 0;
+    for (int i = 0; initialized && i < SOCKET_STATS_SIZE; i++)
+    {
+        if (entries[i].sockfd >= 0)
+        {
+            addStats(stats, &entries[i].stats);
+            (*openSockets)++;
+        }
+    }
+    *closed = closedSockets;
+}
@@ -34,11 +34,16 @@ SOFTWARE.
 #include "lwip/api.h"
 #include <lwip/sockets.h>
 #include "tcp.h"
+#include "dns-cache.h"
+#include "socket-stats.h"
+#include "idle-timeout.h"
 #include "esp32-js-log.h"
 #include "esp32-javascript.h"
 
 #define BUFSIZE 1024
+#ifndef LISTEN_BACKLOG
 #define LISTEN_BACKLOG 50
+#endif
 
 int createNonBlockingSocket(int domain, int type, int protocol, bool nonblocking)
 {
@@ -54,6 +59,13 @@ int createNonBlockingSocket(int domain, int type, int protocol, bool nonblocking
         return -1;
     }
 
+    if (type == SOCK_STREAM)
+    {
+        // a response head and body written one after the other must not wait for the delayed ack of the peer
+        opt = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    }
+
     if (nonblocking)
     {
         opt = 1;
@@ -65,28 +77,19 @@ int createNonBlockingSocket(int domain, int type, int protocol, bool nonblocking
         }
     }
 
+    socketStatsOpen(sockfd);
     return sockfd;
 }
 
-int connectNonBlocking(int sockfd, const char *hostname, int portno)
+int connectAddress(int sockfd, const struct in_addr *addr, int portno)
 {
     int ret;
     struct sockaddr_in serveraddr;
-    struct hostent *server;
-
-    /* gethostbyname: get the server's DNS entry */
-    server = gethostbyname(hostname);
-    if (server == NULL)
-    {
-        jslog(ERROR, "ERROR, no such host as %s\n", hostname);
-        return -1;
-    }
 
     /* build the server's Internet address */
     bzero((char *)&serveraddr, sizeof(serveraddr));
     serveraddr.sin_family = AF_INET;
-    bcopy((char *)server->h_addr,
-          (char *)&serveraddr.sin_addr.s_addr, server->h_length);
+    serveraddr.sin_addr = *addr;
     serveraddr.sin_port = htons(portno);
 
     /* connect: create a connection with the server */
@@ -99,6 +102,26 @@ int connectNonBlocking(int sockfd, const char *hostname, int portno)
     return 0;
 }
 
+int connectNonBlocking(int sockfd, const char *hostname, int portno)
+{
+    struct in_addr addr;
+
+    /* resolveHost: get the server's address from the dns cache or start an asynchronous lookup */
+    int ret = resolveHost(hostname, sockfd, portno, &addr);
+    if (ret == EL_DNS_FAILED)
+    {
+        jslog(ERROR, "ERROR, no such host as %s\n", hostname);
+        return -1;
+    }
+    else if (ret == EL_DNS_PENDING)
+    {
+        // the dns task connects the socket and fires EL_SOCKET_STATUS_RESOLVED
+        return 1;
+    }
+
+    return connectAddress(sockfd, &addr, portno);
+}
+
 int acceptIncoming(int sockfd)
 {
     int cfd = lwip_accept(sockfd, NULL, NULL);
@@ -106,6 +129,7 @@ int acceptIncoming(int sockfd)
     {
         int one = 1;
         setsockopt(cfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
 
         int opt = 1;
         int ret = lwip_ioctl(cfd, FIONBIO, &opt);
@@ -114,6 +138,7 @@ int acceptIncoming(int sockfd)
             jslog(ERROR, "ERROR while accepting and setting non blocking: %d\n", errno);
             return -1;
         }
+        socketStatsOpen(cfd);
     }
     else
     {
@@ -135,7 +160,9 @@ int bindAndListen(int sockfd, int portno)
     serveraddr.sin_family = AF_INET;
     serveraddr.sin_port = htons(portno);
 
-    /* connect: create a connection with the server */
+    // the port can be bound again right after a restart
+    int one = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
 
     ret = bind(sockfd, (struct sockaddr *)&serveraddr,
                sizeof(serveraddr));
@@ -170,6 +197,7 @@ int writeSocket(int sockfd, const char *msg, int len, SSL *ssl)
         if (errno == EAGAIN)
         {
             jslog(INFO, "EAGAIN in socket: %d\n", errno);
+            socketStatsWrite(sockfd, 0, true);
             return 0;
         }
         else
@@ -178,6 +206,7 @@ int writeSocket(int sockfd, const char *msg, int len, SSL *ssl)
             return n;
         }
     }
+    socketStatsWrite(sockfd, n, false);
     return n;
 }
 
@@ -214,7 +243,16 @@ int readSocket(int sockfd, char *msg, int len)
     return result;
 }
 
+// no more data is sent, the peer reads the end of the stream after the data written so far
+void shutdownSocket(int sockfd)
+{
+    shutdown(sockfd, SHUT_WR);
+}
+
 void closeSocket(int sockfd)
 {
+    cancelResolve(sockfd);
+    socketStatsClose(sockfd);
+    clearIdleTimeout(sockfd);
     close(sockfd);
 }
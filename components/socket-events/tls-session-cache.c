@@ -0,0 +1,166 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tls-session-cache.h"
+#include "esp32-js-log.h"
+
+// only accessed from the duktape task, so no locking is required
+typedef struct
+{
+    char hostname[TLS_SESSION_CACHE_MAX_HOSTNAME_LEN];
+    int port;
+    bool used;
+    TickType_t created;
+    TickType_t lastUsed;
+    mbedtls_ssl_session session;
+} tls_session_entry_t;
+
+static tls_session_entry_t cache[TLS_SESSION_CACHE_SIZE];
+
+static tls_session_entry_t *findEntry(const char *hostname, int port)
+{
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++)
+    {
+        if (cache[i].used && cache[i].port == port && strcmp(cache[i].hostname, hostname) == 0)
+        {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void freeEntry(tls_session_entry_t *entry)
+{
+    if (entry->used)
+    {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->used = false;
+    }
+}
+
+static tls_session_entry_t *evictEntry()
+{
+    tls_session_entry_t *lru = &cache[0];
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++)
+    {
+        if (!cache[i].used)
+        {
+            return &cache[i];
+        }
+        if ((int32_t)(cache[i].lastUsed - lru->lastUsed) < 0)
+        {
+            lru = &cache[i];
+        }
+    }
+    freeEntry(lru);
+    return lru;
+}
+
+static bool isExpired(tls_session_entry_t *entry, TickType_t now)
+{
+    return (now - entry->created) >= pdMS_TO_TICKS(TLS_SESSION_CACHE_LIFETIME_MS);
+}
+
+bool loadTlsSession(mbedtls_ssl_context *ssl, const char *hostname, int port)
+{
+    TickType_t now = xTaskGetTickCount();
+    tls_session_entry_t *entry = findEntry(hostname, port);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    if (isExpired(entry, now))
+    {
+        freeEntry(entry);
+        return false;
+    }
+
+    int ret = mbedtls_ssl_set_session(ssl, &entry->session);
+    if (ret != 0)
+    {
+        jslog(WARN, "Cannot offer cached TLS session for %s:%d, error %d\n", hostname, port, ret);
+        freeEntry(entry);
+        return false;
+    }
+    entry->lastUsed = now;
+    return true;
+}
+
+bool storeTlsSession(mbedtls_ssl_context *ssl, const char *hostname, int port)
+{
+    if (ssl->session == NULL || strlen(hostname) >= TLS_SESSION_CACHE_MAX_HOSTNAME_LEN)
+    {
+        return false;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    tls_session_entry_t *entry = findEntry(hostname, port);
+
+    // a resumed session keeps the master secret of the offered one, while a
+    // full handshake derives a new one. The session id cannot be compared,
+    // mbedtls clears it when it receives a session ticket.
+    bool resumed = entry != NULL &&
+                   memcmp(entry->session.master, ssl->session->master, sizeof(entry->session.master)) == 0;
+
+    if (entry == NULL)
+    {
+        entry = evictEntry();
+    }
+    else
+    {
+        freeEntry(entry);
+    }
+
+    mbedtls_ssl_session_init(&entry->session);
+    int ret = mbedtls_ssl_get_session(ssl, &entry->session);
+    if (ret != 0)
+    {
+        jslog(WARN, "Cannot cache TLS session for %s:%d, error %d\n", hostname, port, ret);
+        mbedtls_ssl_session_free(&entry->session);
+        return resumed;
+    }
+
+    strcpy(entry->hostname, hostname);
+    entry->port = port;
+    entry->used = true;
+    entry->lastUsed = now;
+    if (!resumed)
+    {
+        // resumption does not extend the lifetime of the original session
+        entry->created = now;
+    }
+    return resumed;
+}
+
+void clearTlsSessionCache()
+{
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++)
+    {
+        freeEntry(&cache[i]);
+    }
+}
@@ -0,0 +1,518 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_system.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include "websocket.h"
+#include "esp32-js-log.h"
+
+#define WS_HEADER 0
+#define WS_PAYLOAD 1
+// a close frame was received, following data is ignored
+#define WS_CLOSED 2
+#define WS_ERROR 3
+
+static const char acceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+websocket_parser_t *createWebSocketParser(bool client, size_t maxMessageSize)
+{
+    websocket_parser_t *parser = (websocket_parser_t *)calloc(1, sizeof(websocket_parser_t));
+    if (parser != NULL)
+    {
+        parser->client = client;
+        parser->state = WS_HEADER;
+        parser->headerSize = 2;
+        parser->maxMessageSize = maxMessageSize;
+    }
+    return parser;
+}
+
+void freeWebSocketParser(websocket_parser_t *parser)
+{
+    if (parser != NULL)
+    {
+        free(parser->message);
+        free(parser);
+    }
+}
+
+static bool isValidUtf8(const uint8_t *str, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        uint8_t c = str[i];
+        int following;
+        uint32_t min;
+        uint32_t codepoint;
+        if (c < 0x80)
+        {
+            i++;
+            continue;
+        }
+        else if ((c & 0xE0) == 0xC0)
+        {
+            following = 1;
+            min = 0x80;
+            codepoint = c & 0x1F;
+        }
+        else if ((c & 0xF0) == 0xE0)
+        {
+            following = 2;
+            min = 0x800;
+            codepoint = c & 0x0F;
+        }
+        else if ((c & 0xF8) == 0xF0)
+        {
+            following = 3;
+            min = 0x10000;
+            codepoint = c & 0x07;
+        }
+        else
+        {
+            return false;
+        }
+        if (i + following >= len)
+        {
+            return false;
+        }
+        for (int j = 1; j <= following; j++)
+        {
+            if ((str[i + j] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+            codepoint = (codepoint << 6) | (str[i + j] & 0x3F);
+        }
+        // overlong encodings, surrogates and values beyond unicode
+        if (codepoint < min || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+        {
+            return false;
+        }
+        i += following + 1;
+    }
+    return true;
+}
+
+static void callHandler(duk_context *ctx, duk_idx_t handler_idx, const char *name, int nargs)
+{
+    // the function has to be below the arguments on the value stack
+    duk_get_prop_string(ctx, handler_idx, name);
+    if (duk_is_function(ctx, -1))
+    {
+        duk_insert(ctx, -(nargs + 1));
+        duk_call(ctx, nargs);
+        duk_pop(ctx);
+    }
+    else
+    {
+        duk_pop_n(ctx, nargs + 1);
+    }
+}
+
+static void pushUint8Array(duk_context *ctx, const uint8_t *data, size_t len)
+{
+    void *buf = duk_push_fixed_buffer(ctx, len);
+    memcpy(buf, data, len);
+    duk_push_buffer_object(ctx, -1, 0, len, DUK_BUFOBJ_UINT8ARRAY);
+    duk_remove(ctx, -2);
+}
+
+static int fail(websocket_parser_t *parser, int code)
+{
+    parser->state = WS_ERROR;
+    return code;
+}
+
+// validates a complete frame header and prepares receiving its payload
+static int startPayload(websocket_parser_t *parser)
+{
+    uint8_t *header = parser->header;
+    parser->fin = (header[0] & 0x80) != 0;
+    parser->opcode = header[0] & 0x0F;
+    parser->masked = (header[1] & 0x80) != 0;
+
+    uint64_t payloadLen = header[1] & 0x7F;
+    size_t pos = 2;
+    if (payloadLen == 126)
+    {
+        payloadLen = ((uint64_t)header[2] << 8) | header[3];
+        pos = 4;
+    }
+    else if (payloadLen == 127)
+    {
+        payloadLen = 0;
+        for (int i = 2; i < 10; i++)
+        {
+            payloadLen = (payloadLen << 8) | header[i];
+        }
+        pos = 10;
+    }
+    if (parser->masked)
+    {
+        memcpy(parser->mask, header + pos, 4);
+    }
+    parser->payloadLen = payloadLen;
+    parser->payloadPos = 0;
+
+    // reserved bits are only set by negotiated extensions
+    if ((header[0] & 0x70) != 0 || parser->masked == parser->client)
+    {
+        return fail(parser, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+    }
+    if (parser->opcode >= WEBSOCKET_OPCODE_CLOSE)
+    {
+        if (parser->opcode > WEBSOCKET_OPCODE_PONG || !parser->fin || payloadLen > sizeof(parser->control))
+        {
+            return fail(parser, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+        }
+        return 0;
+    }
+    if (parser->opcode > WEBSOCKET_OPCODE_BINARY ||
+        (parser->opcode == WEBSOCKET_OPCODE_CONTINUATION) != (parser->messageOpcode != 0))
+    {
+        return fail(parser, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+    }
+    if (payloadLen > parser->maxMessageSize - parser->messageLen)
+    {
+        return fail(parser, WEBSOCKET_CLOSE_TOO_BIG);
+    }
+    if (parser->opcode != WEBSOCKET_OPCODE_CONTINUATION)
+    {
+        parser->messageOpcode = parser->opcode;
+    }
+    size_t size = parser->messageLen + payloadLen;
+    if (size > parser->messageCap)
+    {
+        uint8_t *message = (uint8_t *)realloc(parser->message, size);
+        if (message == NULL)
+        {
+            jslog(ERROR, "Not enough memory for websocket message of %u bytes", (unsigned int)size);
+            return fail(parser, WEBSOCKET_CLOSE_TOO_BIG);
+        }
+        parser->message = message;
+        parser->messageCap = size;
+    }
+    return 0;
+}
+
+static int completeFrame(duk_context *ctx, websocket_parser_t *parser, duk_idx_t handler_idx)
+{
+    size_t len = parser->payloadLen;
+    switch (parser->opcode)
+    {
+    case WEBSOCKET_OPCODE_CLOSE:
+    {
+        int code = 1005;
+        if (len == 1)
+        {
+            return fail(parser, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+        }
+        if (len >= 2)
+        {
+            code = (parser->control[0] << 8) | parser->control[1];
+            if (!isValidUtf8(parser->control + 2, len - 2))
+            {
+                return fail(parser, WEBSOCKET_CLOSE_INVALID_DATA);
+            }
+        }
+        parser->state = WS_CLOSED;
+        duk_push_int(ctx, code);
+        duk_push_lstring(ctx, len > 2 ? (const char *)parser->control + 2 : "", len > 2 ? len - 2 : 0);
+        callHandler(ctx, handler_idx, "onClose", 2);
+        return 0;
+    }
+    case WEBSOCKET_OPCODE_PING:
+        pushUint8Array(ctx, parser->control, len);
+        callHandler(ctx, handler_idx, "onPing", 1);
+        return 0;
+    case WEBSOCKET_OPCODE_PONG:
+        pushUint8Array(ctx, parser->control, len);
+        callHandler(ctx, handler_idx, "onPong", 1);
+        return 0;
+    }
+
+    parser->messageLen += len;
+    if (!parser->fin)
+    {
+        return 0;
+    }
+    bool binary = parser->messageOpcode == WEBSOCKET_OPCODE_BINARY;
+    if (binary)
+    {
+        pushUint8Array(ctx, parser->message, parser->messageLen);
+    }
+    else if (isValidUtf8(parser->message, parser->messageLen))
+    {
+        duk_push_lstring(ctx, (const char *)parser->message, parser->messageLen);
+    }
+    else
+    {
+        return fail(parser, WEBSOCKET_CLOSE_INVALID_DATA);
+    }
+    parser->messageOpcode = 0;
+    parser->messageLen = 0;
+    if (parser->messageCap > WEBSOCKET_KEEP_BUFFER_SIZE)
+    {
+        free(parser->message);
+        parser->message = NULL;
+        parser->messageCap = 0;
+    }
+    duk_push_boolean(ctx, binary);
+    callHandler(ctx, handler_idx, "onMessage", 2);
+    return 0;
+}
+
+int executeWebSocketParser(duk_context *ctx, websocket_parser_t *parser, const uint8_t *data, size_t len, duk_idx_t handler_idx)
+{
+    size_t pos = 0;
+    while (pos < len)
+    {
+        if (parser->state == WS_CLOSED)
+        {
+            return 0;
+        }
+        if (parser->state == WS_ERROR)
+        {
+            return WEBSOCKET_CLOSE_PROTOCOL_ERROR;
+        }
+
+        if (parser->state == WS_HEADER)
+        {
+            while (pos < len && parser->headerLen < parser->headerSize)
+            {
+                parser->header[parser->headerLen++] = data[pos++];
+                if (parser->headerLen == 2)
+                {
+                    // the size of the header is known with its second byte
+                    uint8_t lengthField = parser->header[1] & 0x7F;
+                    parser->headerSize = 2 + (lengthField == 126 ? 2 : lengthField == 127 ? 8 : 0) +
+                                         ((parser->header[1] & 0x80) ? 4 : 0);
+                }
+            }
+            if (parser->headerLen < parser->headerSize)
+            {
+                return 0;
+            }
+            parser->headerLen = 0;
+            parser->headerSize = 2;
+            int ret = startPayload(parser);
+            if (ret != 0)
+            {
+                return ret;
+            }
+            parser->state = WS_PAYLOAD;
+        }
+
+        uint8_t *dest = parser->opcode >= WEBSOCKET_OPCODE_CLOSE ? parser->control : parser->message + parser->messageLen;
+        size_t n = len - pos;
+        if (n > parser->payloadLen - parser->payloadPos)
+        {
+            n = parser->payloadLen - parser->payloadPos;
+        }
+        if (parser->masked)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                dest[parser->payloadPos + i] = data[pos + i] ^ parser->mask[(parser->payloadPos + i) & 3];
+            }
+        }
+        else
+        {
+            memcpy(dest + parser->payloadPos, data + pos, n);
+        }
+        pos += n;
+        parser->payloadPos += n;
+
+        if (parser->payloadPos == parser->payloadLen)
+        {
+            parser->state = WS_HEADER;
+            int ret = completeFrame(ctx, parser, handler_idx);
+            if (ret != 0)
+            {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+static duk_ret_t el_createWebSocketParser(duk_context *ctx)
+{
+    websocket_parser_t *parser = createWebSocketParser(duk_to_boolean(ctx, 0), duk_to_uint32(ctx, 1));
+    if (parser == NULL)
+    {
+        jslog(ERROR, "Not enough memory for websocket parser");
+        return duk_error(ctx, DUK_ERR_ERROR, "Not enough memory for websocket parser");
+    }
+    duk_push_int(ctx, (duk_int_t)parser);
+    return 1;
+}
+
+static duk_ret_t el_freeWebSocketParser(duk_context *ctx)
+{
+    freeWebSocketParser((websocket_parser_t *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t el_executeWebSocketParser(duk_context *ctx)
+{
+    websocket_parser_t *parser = (websocket_parser_t *)duk_to_int(ctx, 0);
+    duk_size_t len;
+    const uint8_t *data;
+    if (duk_is_string(ctx, 1))
+    {
+        data = (const uint8_t *)duk_get_lstring(ctx, 1, &len);
+    }
+    else
+    {
+        data = (const uint8_t *)duk_require_buffer_data(ctx, 1, &len);
+    }
+    duk_require_object(ctx, 2);
+
+    duk_push_int(ctx, executeWebSocketParser(ctx, parser, data, len, 2));
+    return 1;
+}
+
+/**
+ * Encodes a single frame with fin set.
+ * Arguments: opcode, payload (string or Uint8Array), mask (clients have to mask their frames).
+ */
+static duk_ret_t el_encodeWebSocketFrame(duk_context *ctx)
+{
+    int opcode = duk_require_int(ctx, 0);
+    duk_size_t len = 0;
+    const uint8_t *data = NULL;
+    if (duk_is_string(ctx, 1))
+    {
+        data = (const uint8_t *)duk_get_lstring(ctx, 1, &len);
+    }
+    else if (!duk_is_null_or_undefined(ctx, 1))
+    {
+        data = (const uint8_t *)duk_require_buffer_data(ctx, 1, &len);
+    }
+    bool mask = duk_to_boolean(ctx, 2);
+
+    size_t headerLen = 2 + (len > 0xFFFF ? 8 : len > 125 ? 2 : 0) + (mask ? 4 : 0);
+    uint8_t *frame = (uint8_t *)duk_push_fixed_buffer(ctx, headerLen + len);
+    frame[0] = 0x80 | (opcode & 0x0F);
+    size_t pos = 2;
+    if (len > 0xFFFF)
+    {
+        frame[1] = 127;
+        for (int i = 0; i < 8; i++)
+        {
+            frame[pos++] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        }
+    }
+    else if (len > 125)
+    {
+        frame[1] = 126;
+        frame[pos++] = len >> 8;
+        frame[pos++] = len & 0xFF;
+    }
+    else
+    {
+        frame[1] = len;
+    }
+    if (mask)
+    {
+        frame[1] |= 0x80;
+        uint32_t key = esp_random();
+        memcpy(frame + pos, &key, 4);
+        for (size_t i = 0; i < len; i++)
+        {
+            frame[pos + 4 + i] = data[i] ^ frame[pos + (i & 3)];
+        }
+    }
+    else if (len > 0)
+    {
+        memcpy(frame + pos, data, len);
+    }
+    duk_push_buffer_object(ctx, -1, 0, headerLen + len, DUK_BUFOBJ_UINT8ARRAY);
+    return 1;
+}
+
+static void pushBase64(duk_context *ctx, const uint8_t *data, size_t len)
+{
+    unsigned char encoded[32];
+    size_t encodedLen = 0;
+    mbedtls_base64_encode(encoded, sizeof(encoded), &encodedLen, data, len);
+    duk_push_lstring(ctx, (const char *)encoded, encodedLen);
+}
+
+// computes Sec-WebSocket-Accept for a Sec-WebSocket-Key
+static duk_ret_t el_webSocketAccept(duk_context *ctx)
+{
+    duk_size_t keyLen;
+    const char *key = duk_require_lstring(ctx, 0, &keyLen);
+    if (keyLen > 64)
+    {
+        return duk_range_error(ctx, "Invalid websocket key");
+    }
+    unsigned char input[64 + sizeof(acceptGuid)];
+    memcpy(input, key, keyLen);
+    memcpy(input + keyLen, acceptGuid, sizeof(acceptGuid) - 1);
+    unsigned char hash[20];
+    mbedtls_sha1_ret(input, keyLen + sizeof(acceptGuid) - 1, hash);
+    pushBase64(ctx, hash, sizeof(hash));
+    return 1;
+}
+
+// creates a random Sec-WebSocket-Key for the handshake of a client
+static duk_ret_t el_createWebSocketKey(duk_context *ctx)
+{
+    uint32_t nonce[4];
+    for (int i = 0; i < 4; i++)
+    {
+        nonce[i] = esp_random();
+    }
+    pushBase64(ctx, (const uint8_t *)nonce, sizeof(nonce));
+    return 1;
+}
+
+void registerWebSocketBindings(duk_context *ctx)
+{
+    duk_push_c_function(ctx, el_createWebSocketParser, 2);
+    duk_put_global_string(ctx, "el_createWebSocketParser");
+
+    duk_push_c_function(ctx, el_freeWebSocketParser, 1);
+    duk_put_global_string(ctx, "el_freeWebSocketParser");
+
+    duk_push_c_function(ctx, el_executeWebSocketParser, 3);
+    duk_put_global_string(ctx, "el_executeWebSocketParser");
+
+    duk_push_c_function(ctx, el_encodeWebSocketFrame, 3);
+    duk_put_global_string(ctx, "el_encodeWebSocketFrame");
+
+    duk_push_c_function(ctx, el_webSocketAccept, 1);
+    duk_put_global_string(ctx, "el_webSocketAccept");
+
+    duk_push_c_function(ctx, el_createWebSocketKey, 0);
+    duk_put_global_string(ctx, "el_createWebSocketKey");
+}
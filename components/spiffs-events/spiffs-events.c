@@ -150,12 +150,31 @@ duk_ret_t el_fileExists(duk_context *ctx)
 	return 1;
 }
 
+// size and modification time (seconds since epoch) with a single stat call
+duk_ret_t el_fileStat(duk_context *ctx)
+{
+	const char *path = duk_to_string(ctx, 0);
+	struct stat buffer;
+	if (stat(path, &buffer) != 0)
+	{
+		return 0; // undefined
+	}
+	duk_push_object(ctx);
+	duk_push_number(ctx, buffer.st_size);
+	duk_put_prop_string(ctx, -2, "size");
+	duk_push_number(ctx, buffer.st_mtime);
+	duk_put_prop_string(ctx, -2, "mtime");
+	return 1;
+}
+
 void registerBindings(duk_context *ctx)
 {
 	duk_push_c_function(ctx, el_readFile, 1);
 	duk_put_global_string(ctx, "readFile");
 	duk_push_c_function(ctx, el_fileExists, 1);
 	duk_put_global_string(ctx, "fileExists");
+	duk_push_c_function(ctx, el_fileStat, 1);
+	duk_put_global_string(ctx, "fileStat");
 	duk_push_c_function(ctx, el_writeFile, 2);
 	duk_put_global_string(ctx, "writeFile");
 }
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Builds the host runtime and the load generator into ./build
+
+set -e
+
+cd "$(dirname "$0")"
+ROOT=$(cd ../.. && pwd)
+OUT=build
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:--O2 -g}
+
+mkdir -p $OUT
+
+INCLUDES="-Iport \
+  -I$ROOT/components/duktape/include \
+  -I$ROOT/components/duk-module-node/include \
+  -I$ROOT/components/esp32-javascript/include \
+  -I$ROOT/components/esp32-js-log/include \
+  -I$ROOT/components/socket-events/include \
+  -I$ROOT/main/include"
+
+# native handles are passed to JS as 32 bit ints, see host.c
+HOST_CFLAGS="$CFLAGS -D_GNU_SOURCE -fno-pie -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast"
+
+SOURCES="host.c \
+  $ROOT/components/duk-module-node/duk_module_node.c \
+  $ROOT/components/socket-events/socket-bindings.c \
+  $ROOT/components/socket-events/tcp.c \
+  $ROOT/components/socket-events/dns-cache.c \
+  $ROOT/components/socket-events/socket-stats.c \
+  $ROOT/components/socket-events/idle-timeout.c \
+  $ROOT/components/socket-events/file-stream.c \
+  $ROOT/components/socket-events/http-parser.c \
+  $ROOT/components/socket-events/response-head.c \
+  $ROOT/components/socket-events/deflate-stream.c \
+  $ROOT/components/socket-events/websocket.c \
+  $ROOT/components/socket-events/mqtt.c \
+  $ROOT/components/socket-events/multipart.c \
+  $ROOT/components/socket-events/header-map.c \
+  $ROOT/components/socket-events/byte-buffer.c \
+  $ROOT/components/socket-events/json-writer.c \
+  $ROOT/components/socket-events/cbor.c"
+
+# duktape takes a while, so it is only compiled once
+if [ ! -f $OUT/duktape.o ]; then
+  $CC $CFLAGS -fno-pie -I$ROOT/components/duktape/include -c -o $OUT/duktape.o $ROOT/components/duktape/duktape.c
+fi
+
+$CC $HOST_CFLAGS $INCLUDES -DHOST_BENCH_ROOT="\"$ROOT\"" -no-pie -o $OUT/host-bench $SOURCES $OUT/duktape.o -lm -lpthread -lssl -lcrypto
+$CC $CFLAGS -D_GNU_SOURCE -o $OUT/loadgen loadgen.c -lm
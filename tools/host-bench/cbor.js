@@ -0,0 +1,104 @@
+/*
+ * CBOR benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench cbor.js cbor|json|stream [readings] [iterations]
+ *
+ * Encodes and decodes a telemetry payload of readings like a device sends
+ * them. "cbor" uses encodeCbor and decodeCbor, "json" JSON.stringify and
+ * JSON.parse with the UTF-8 encoding socket.write does, "stream" pushes
+ * the readings one by one to an Esp32JsCborArrayEncoder.
+ */
+require("esp32-javascript/global.js");
+var cbor = require("esp32-javascript/cbor");
+
+var mode = scriptArgs[1] || "cbor";
+var readings = Number(scriptArgs[2] || 50);
+var iterations = Number(scriptArgs[3] || 500);
+
+var payload = { device: "esp32-4c11aed2", firmware: "1.4.2", readings: [] };
+for (var i = 0; i < readings; i++) {
+  payload.readings.push({
+    t: 1603180800 + i * 60,
+    sensor: i % 4,
+    temperature: 21.5 + (i % 10) * 0.25,
+    humidity: 48.3 + (i % 7) * 0.1,
+    pressure: 101325 - i,
+    ok: i % 13 !== 0,
+  });
+}
+
+var textEncoder = new TextEncoder();
+var textDecoder = new TextDecoder();
+
+var encode;
+var decode;
+if (mode === "json") {
+  encode = function () {
+    return textEncoder.encode(JSON.stringify(payload));
+  };
+  decode = function (data) {
+    return JSON.parse(textDecoder.decode(data));
+  };
+} else if (mode === "stream") {
+  encode = function () {
+    var chunks = [];
+    var length = 0;
+    var encoder = new cbor.Esp32JsCborArrayEncoder(function (chunk) {
+      chunks.push(chunk);
+      length += chunk.length;
+    });
+    for (var i = 0; i < payload.readings.length; i++) {
+      encoder.push(payload.readings[i]);
+    }
+    encoder.end();
+    var data = new Uint8Array(length);
+    for (var offset = 0, j = 0; j < chunks.length; j++) {
+      data.set(chunks[j], offset);
+      offset += chunks[j].length;
+    }
+    return data;
+  };
+  decode = cbor.decodeCbor;
+} else {
+  encode = function () {
+    return cbor.encodeCbor(payload);
+  };
+  decode = cbor.decodeCbor;
+}
+
+function measure(fn) {
+  var result;
+  el_getHeapStats(true);
+  var start = el_hrtime();
+  for (var i = 0; i < iterations; i++) {
+    result = fn();
+  }
+  var micros = el_hrtime() - start;
+  return {
+    micros: micros / iterations,
+    allocs: el_getHeapStats(false).allocs / iterations,
+    result: result,
+  };
+}
+
+var encoded = measure(encode);
+var data = encoded.result;
+var decoded = measure(function () {
+  return decode(data);
+});
+var expected =
+  mode === "stream" ? JSON.stringify(payload.readings) : JSON.stringify(payload);
+if (JSON.stringify(decoded.result) !== expected) {
+  throw Error("decoded value differs");
+}
+print(
+  JSON.stringify({
+    name: "cbor-" + mode + "-" + readings,
+    readings: readings,
+    bytes: data.length,
+    encodeMicros: Math.round(encoded.micros * 10) / 10,
+    decodeMicros: Math.round(decoded.micros * 10) / 10,
+    encodeAllocs: Math.round(encoded.allocs * 10) / 10,
+    decodeAllocs: Math.round(decoded.allocs * 10) / 10,
+  })
+);
@@ -0,0 +1,116 @@
+/*
+ * Http client benchmark for the host runtime, started by run.sh against
+ * "loadgen -S":
+ *
+ *     build/host-bench client.js port requests concurrency [close] [fetch]
+ *
+ * Keeps concurrency requests in flight through httpClient (or fetch) and
+ * prints the results as JSON in the format of loadgen.
+ */
+require("esp32-javascript/global.js");
+global.Promise = require("esp32-javascript/promise.js").Promise;
+var fetchApi = require("esp32-javascript/fetch");
+global.Headers = fetchApi.Esp32JsHeaders;
+require("socket-events");
+var eventloop = require("esp32-js-eventloop");
+var http = require("esp32-javascript/http");
+
+var port = scriptArgs[1] || "8080";
+var requests = Number(scriptArgs[2] || 10000);
+var concurrency = Number(scriptArgs[3] || 1);
+var keepAlive = scriptArgs.indexOf("close") < 0;
+var useFetch = scriptArgs.indexOf("fetch") >= 0;
+
+http.httpClientPool.keepAlive = keepAlive;
+http.httpClientPool.maxSocketsPerHost = concurrency;
+
+var issued = 0;
+var completed = 0;
+var errors = 0;
+var bytesIn = 0;
+var latencies = [];
+var start = 0;
+
+function percentile(sorted, p) {
+  return sorted.length > 0
+    ? sorted[Math.round(p * (sorted.length - 1))] / 1000
+    : 0;
+}
+
+function report() {
+  var seconds = (el_hrtime() - start) / 1e6;
+  var sorted = latencies.sort(function (a, b) {
+    return a - b;
+  });
+  var heap = el_getHeapStats(false);
+  print(
+    JSON.stringify({
+      name:
+        (useFetch ? "fetch" : "httpClient") +
+        (keepAlive ? "" : "-close") +
+        "-c" +
+        concurrency,
+      path: "/",
+      connections: concurrency,
+      pipeline: 1,
+      keepAlive: keepAlive,
+      requests: completed,
+      errors: errors,
+      seconds: seconds,
+      requestsPerSecond: Math.round((completed / seconds) * 10) / 10,
+      p50Ms: percentile(sorted, 0.5),
+      p99Ms: percentile(sorted, 0.99),
+      maxMs: percentile(sorted, 1),
+      bytesIn: bytesIn,
+      client: { heapUsed: heap.used, heapPeak: heap.peak },
+    })
+  );
+  exit(errors > 0 ? 1 : 0);
+}
+
+function done(sentAt, length) {
+  completed++;
+  bytesIn += length;
+  latencies.push(el_hrtime() - sentAt);
+  next();
+}
+
+function failed(message) {
+  errors++;
+  console.error(message);
+  next();
+}
+
+function next() {
+  if (issued < requests) {
+    issued++;
+    var sentAt = el_hrtime();
+    if (useFetch) {
+      fetchApi.fetch("http://127.0.0.1:" + port + "/")
+        .then(function (response) {
+          return response.arrayBuffer();
+        })
+        .then(function (buffer) {
+          done(sentAt, buffer.byteLength);
+        }, failed);
+    } else {
+      http.httpClient(false, "127.0.0.1", port, "/", "GET", "", undefined,
+        function (content) {
+          done(sentAt, content.length);
+        },
+        failed
+      );
+    }
+  } else if (completed + errors === requests) {
+    report();
+  }
+}
+
+global.main = function () {
+  el_getHeapStats(true);
+  start = el_hrtime();
+  for (var i = 0; i < concurrency; i++) {
+    next();
+  }
+};
+eventloop.start();
@@ -0,0 +1,132 @@
+/*
+ * Connect latency benchmark for the dns cache, started by run.sh against
+ * "loadgen -S" with the lookups going to "loadgen -D":
+ *
+ *     HOST_BENCH_DNS_PORT=dnsport build/host-bench dns.js port rounds concurrency [cached]
+ *
+ * Every round connects concurrency sockets to the same hostname at once.
+ * Without "cached" the cache is cleared before each round, so the round
+ * needs a lookup, which all its sockets share. A latency is the time from
+ * the start of the round until the socket is connected. maxLoopGapMs is
+ * the longest the event loop did not run a 1 ms timer during the rounds.
+ * Prints the results as JSON in the format of loadgen.
+ */
+require("esp32-javascript/global.js");
+var socketEvents = require("socket-events");
+var eventloop = require("esp32-js-eventloop");
+
+var port = scriptArgs[1] || "8080";
+var rounds = Number(scriptArgs[2] || 50);
+var concurrency = Number(scriptArgs[3] || 1);
+var cached = scriptArgs.indexOf("cached") >= 0;
+var host = "bench.test";
+
+var completed = 0;
+var errors = 0;
+var latencies = [];
+var start = 0;
+var lastTick = 0;
+var maxLoopGap = 0;
+var finished = false;
+
+function percentile(sorted, p) {
+  return sorted.length > 0
+    ? sorted[Math.round(p * (sorted.length - 1))] / 1000
+    : 0;
+}
+
+function report() {
+  finished = true;
+  var seconds = (el_hrtime() - start) / 1e6;
+  var sorted = latencies.sort(function (a, b) {
+    return a - b;
+  });
+  print(
+    JSON.stringify({
+      name: "dns-" + (cached ? "cached" : "uncached") + "-c" + concurrency,
+      path: host,
+      connections: concurrency,
+      requests: completed,
+      errors: errors,
+      seconds: seconds,
+      p50Ms: percentile(sorted, 0.5),
+      p99Ms: percentile(sorted, 0.99),
+      maxMs: percentile(sorted, 1),
+      maxLoopGapMs: maxLoopGap / 1000,
+    })
+  );
+  exit(errors > 0 ? 1 : 0);
+}
+
+function tick() {
+  var now = el_hrtime();
+  maxLoopGap = Math.max(maxLoopGap, now - lastTick);
+  lastTick = now;
+  if (!finished) {
+    setTimeout(tick, 1);
+  }
+}
+
+function connect(startedAt, done) {
+  var ended = false;
+  function end(ok) {
+    if (!ended) {
+      ended = true;
+      if (ok) {
+        completed++;
+        latencies.push(el_hrtime() - startedAt);
+      } else {
+        errors++;
+      }
+      done();
+    }
+  }
+  var socket = socketEvents.sockConnect(
+    false,
+    host,
+    port,
+    function () {
+      end(true);
+      socketEvents.closeSocket(socket);
+    },
+    function () {},
+    function () {
+      end(false);
+    },
+    function () {
+      end(false);
+    }
+  );
+}
+
+function round(remaining) {
+  if (remaining === 0) {
+    report();
+    return;
+  }
+  if (!cached) {
+    el_clearDnsCache();
+  }
+  var pending = concurrency;
+  var startedAt = el_hrtime();
+  for (var i = 0; i < concurrency; i++) {
+    connect(startedAt, function () {
+      if (--pending === 0) {
+        round(remaining - 1);
+      }
+    });
+  }
+}
+
+global.main = function () {
+  // the first lookup fills the cache for the cached runs
+  connect(el_hrtime(), function () {
+    completed = 0;
+    latencies = [];
+    start = el_hrtime();
+    lastTick = start;
+    tick();
+    round(rounds);
+  });
+};
+eventloop.start();
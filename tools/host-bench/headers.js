@@ -0,0 +1,125 @@
+/*
+ * Headers benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench headers.js native|polyfill request|response [iterations]
+ *
+ * Runs what httpServer and its handlers do with the headers of a typical
+ * browser request (created from the parser list, several lookups) or of a
+ * response (set by a handler, checked and serialized by buildHead).
+ * "polyfill" is the former JS implementation for comparison.
+ */
+require("esp32-javascript/global.js");
+var Esp32JsHeaders = require("esp32-javascript/headers").Esp32JsHeaders;
+
+var mode = scriptArgs[1] || "native";
+var scenario = scriptArgs[2] || "request";
+var iterations = Number(scriptArgs[3] || 20000);
+
+// the implementation in fetch.js before the native header lists
+function normalizeName(name) {
+  name = String(name);
+  if (/[^a-z0-9\-#$%&'*+.^_`|~]/i.test(name) || name === "") {
+    throw new TypeError("Invalid character in header field name:" + name);
+  }
+  return name.toLowerCase();
+}
+function PolyfillHeaders() {
+  this.map = {};
+}
+PolyfillHeaders.fromList = function (headerList) {
+  var headers = new PolyfillHeaders();
+  var map = headers.map;
+  for (var i = 0; i < headerList.length; i += 2) {
+    var oldValue = map[headerList[i]];
+    map[headerList[i]] = oldValue
+      ? oldValue + ", " + headerList[i + 1]
+      : headerList[i + 1];
+  }
+  return headers;
+};
+PolyfillHeaders.prototype.get = function (name) {
+  name = normalizeName(name);
+  return this.has(name) ? this.map[name] : null;
+};
+PolyfillHeaders.prototype.has = function (name) {
+  return this.map.hasOwnProperty(normalizeName(name));
+};
+PolyfillHeaders.prototype.set = function (name, value) {
+  this.map[normalizeName(name)] = String(value);
+};
+PolyfillHeaders.prototype.forEach = function (callback, thisArg) {
+  for (var name in this.map) {
+    if (this.map.hasOwnProperty(name)) {
+      callback.call(thisArg, this.map[name], name, this);
+    }
+  }
+};
+
+var Headers = mode === "polyfill" ? PolyfillHeaders : Esp32JsHeaders;
+
+// as received from a browser, names lower cased by the http parser
+var requestList = [
+  "host", "192.168.4.1",
+  "connection", "keep-alive",
+  "cache-control", "max-age=0",
+  "authorization", "Basic YWRtaW46YWRtaW4=",
+  "upgrade-insecure-requests", "1",
+  "user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/86.0 Safari/537.36",
+  "accept", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8",
+  "accept-encoding", "gzip, deflate",
+  "accept-language", "de-DE,de;q=0.9,en;q=0.8",
+  "if-none-match", "\"5f8e1a2b-4c1\"",
+];
+
+function request() {
+  var headers = Headers.fromList(requestList);
+  // httpServer, the config server and serveStatic
+  var found = 0;
+  found += headers.get("connection") === "close" ? 1 : 0;
+  found += headers.get("authorization") ? 1 : 0;
+  found += headers.get("accept-encoding") ? 1 : 0;
+  found += headers.get("if-none-match") ? 1 : 0;
+  found += headers.get("range") ? 1 : 0;
+  found += headers.get("content-type") ? 1 : 0;
+  return found;
+}
+
+function response() {
+  var headers = new Headers();
+  headers.set("Content-type", "text/html");
+  headers.set("etag", "\"5f8e1a2b-4c1\"");
+  headers.set("last-modified", "Tue, 20 Oct 2020 08:00:00 GMT");
+  headers.set("cache-control", "max-age=3600");
+  if (!headers.has("content-length")) {
+    headers.set("content-length", "1217");
+  }
+  var size = 0;
+  headers.forEach(function (value, key) {
+    size += key.length + value.length;
+  });
+  return size;
+}
+
+function measure(fn) {
+  var check = fn();
+  el_getHeapStats(true);
+  var start = el_hrtime();
+  for (var i = 0; i < iterations; i++) {
+    if (fn() !== check) {
+      throw Error(scenario + " returned different results");
+    }
+  }
+  var micros = el_hrtime() - start;
+  var heap = el_getHeapStats(false);
+  print(
+    JSON.stringify({
+      name: "headers-" + scenario + "-" + mode,
+      iterations: iterations,
+      seconds: micros / 1e6,
+      microsPerIteration: Math.round((micros / iterations) * 100) / 100,
+      allocsPerIteration: Math.round((heap.allocs / iterations) * 10) / 10,
+    })
+  );
+}
+
+measure(scenario === "response" ? response : request);
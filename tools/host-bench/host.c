@@ -0,0 +1,1120 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Runs the esp32-javascript modules on a Linux host, e.g. for benchmarks:
+ *
+ *     host-bench script.js [args...]
+ *
+ * The socket bindings, the dns cache and the protocol natives are the ones
+ * of socket-events on top of POSIX sockets, see socket-bindings.c. The select
+ * task of socket-events.c is replaced by a poll loop inside el_suspend, timers
+ * are kept in a list and FreeRTOS tasks are threads. TLS uses OpenSSL.
+ *
+ * Native handles are passed to JS as 32 bit ints like on the ESP32, so the
+ * binary is linked without PIE and malloc is kept from using mmap, which
+ * keeps all heap addresses in the low 2 GB.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <limits.h>
+#include <malloc.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <netdb.h>
+#include <resolv.h>
+#include "lwip/sockets.h"
+#include "openssl/ssl.h"
+#include "esp_timer.h"
+#include "duktape.h"
+#include "duk_module_node.h"
+#include "esp32-javascript.h"
+#include "esp32-js-log.h"
+#include "socket-events.h"
+#include "socket-bindings.h"
+#include "socket-stats.h"
+#include "dns-cache.h"
+
+#ifndef HOST_BENCH_ROOT
+#define HOST_BENCH_ROOT "."
+#endif
+
+// directories searched for non-relative module ids, relative to the root
+static const char *moduleDirs[] = {
+    "components/esp32-javascript/modules",
+    "components/socket-events/modules",
+    NULL};
+
+static const char *root = HOST_BENCH_ROOT;
+static log_level_t logLevel = WARN;
+
+void jslog(log_level_t level, const char *msg, ...)
+{
+    if (level < logLevel)
+    {
+        return;
+    }
+    va_list argp;
+    va_start(argp, msg);
+    vfprintf(stderr, msg, argp);
+    va_end(argp);
+}
+
+/*
+ * Duktape heap allocator which counts the allocated bytes, the high-water
+ * mark is what limits the number of connections on the device. The
+ * allocations of OpenSSL are counted the same way.
+ */
+typedef struct
+{
+    size_t size;
+    size_t padding;
+} alloc_header_t;
+
+typedef struct
+{
+    size_t used;
+    size_t peak;
+    uint32_t allocs;
+} heap_counter_t;
+
+static heap_counter_t duktapeHeap;
+static heap_counter_t tlsHeap;
+
+static void countedFree(heap_counter_t *counter, void *ptr)
+{
+    if (ptr != NULL)
+    {
+        alloc_header_t *header = (alloc_header_t *)ptr - 1;
+        counter->used -= header->size;
+        free(header);
+    }
+}
+
+static void *countedRealloc(heap_counter_t *counter, void *ptr, size_t size)
+{
+    if (ptr != NULL && size == 0)
+    {
+        countedFree(counter, ptr);
+        return NULL;
+    }
+    alloc_header_t *header = ptr != NULL ? (alloc_header_t *)ptr - 1 : NULL;
+    size_t oldSize = header != NULL ? header->size : 0;
+    header = (alloc_header_t *)realloc(header, sizeof(alloc_header_t) + size);
+    if (header == NULL)
+    {
+        return NULL;
+    }
+    header->size = size;
+    counter->used = counter->used - oldSize + size;
+    counter->allocs++;
+    if (counter->used > counter->peak)
+    {
+        counter->peak = counter->used;
+    }
+    return header + 1;
+}
+
+static void *heap_alloc(void *udata, duk_size_t size)
+{
+    return countedRealloc(&duktapeHeap, NULL, size);
+}
+
+static void heap_free(void *udata, void *ptr)
+{
+    countedFree(&duktapeHeap, ptr);
+}
+
+static void *heap_realloc(void *udata, void *ptr, duk_size_t size)
+{
+    return countedRealloc(&duktapeHeap, ptr, size);
+}
+
+static void *tls_malloc(size_t size, const char *file, int line)
+{
+    return countedRealloc(&tlsHeap, NULL, size);
+}
+
+static void *tls_realloc(void *ptr, size_t size, const char *file, int line)
+{
+    return countedRealloc(&tlsHeap, ptr, size);
+}
+
+static void tls_free(void *ptr, const char *file, int line)
+{
+    countedFree(&tlsHeap, ptr);
+}
+
+static duk_ret_t el_getHeapStats(duk_context *ctx)
+{
+    duk_gc(ctx, 0);
+    duk_idx_t obj_idx = duk_push_object(ctx);
+    duk_push_number(ctx, duktapeHeap.used);
+    duk_put_prop_string(ctx, obj_idx, "used");
+    duk_push_number(ctx, duktapeHeap.peak);
+    duk_put_prop_string(ctx, obj_idx, "peak");
+    duk_push_number(ctx, duktapeHeap.allocs);
+    duk_put_prop_string(ctx, obj_idx, "allocs");
+    duk_push_number(ctx, tlsHeap.used);
+    duk_put_prop_string(ctx, obj_idx, "tlsUsed");
+    duk_push_number(ctx, tlsHeap.peak);
+    duk_put_prop_string(ctx, obj_idx, "tlsPeak");
+    if (duk_to_boolean(ctx, 0))
+    {
+        duktapeHeap.peak = duktapeHeap.used;
+        duktapeHeap.allocs = 0;
+        tlsHeap.peak = tlsHeap.used;
+    }
+    return 1;
+}
+
+// monotonic microseconds, Date.now() is too coarse for request latencies
+static duk_ret_t el_hrtime(duk_context *ctx)
+{
+    duk_push_number(ctx, (duk_double_t)esp_timer_get_time());
+    return 1;
+}
+
+// CPU time of the JS thread in microseconds, unlike el_hrtime not affected by other processes
+static duk_ret_t el_cpuTime(duk_context *ctx)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    duk_push_number(ctx, (duk_double_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+    return 1;
+}
+
+/*
+ * Event queue. Timer and socket events are queued and handed to the event
+ * loop in lists of MAX_EVENTS, as the event queue of the device does. Events
+ * of other threads, i.e. the dns task, are posted to a second list and wake
+ * up the poll loop through a pipe.
+ */
+typedef struct
+{
+    int handle;
+    int64_t due;
+} host_timer_t;
+
+static js_event_t *pending = NULL;
+static int pendingStart = 0;
+static int pendingLen = 0;
+static int pendingCap = 0;
+
+static host_timer_t *timers = NULL;
+static int timersLen = 0;
+static int timersCap = 0;
+static int nextTimerHandle = 1;
+// timers started and stopped, i.e. the FreeRTOS timer operations on the device
+static uint32_t timersStarted = 0;
+static uint32_t timersStopped = 0;
+
+static js_event_t *posted = NULL;
+static int postedLen = 0;
+static int postedCap = 0;
+static pthread_mutex_t postedMutex = PTHREAD_MUTEX_INITIALIZER;
+static int wakeFds[2] = {-1, -1};
+
+static int *notConnectedSockets = NULL;
+static int notConnectedSockets_len = 0;
+static int *connectedSockets = NULL;
+static int connectedSockets_len = 0;
+static int *connectedWritableSockets = NULL;
+static int connectedWritableSockets_len = 0;
+
+static int64_t nowMs()
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static void queueEvent(int type, int status, int fd)
+{
+    if (pendingStart > 0 && pendingStart == pendingLen)
+    {
+        pendingStart = pendingLen = 0;
+    }
+    if (pendingLen == pendingCap)
+    {
+        pendingCap = pendingCap > 0 ? pendingCap * 2 : 64;
+        pending = (js_event_t *)realloc(pending, pendingCap * sizeof(js_event_t));
+    }
+    el_create_event(&pending[pendingLen++], type, status, (void *)(intptr_t)fd);
+}
+
+void el_create_event(js_event_t *event, int type, int status, void *fd)
+{
+    event->type = type;
+    event->status = status;
+    event->fd = fd;
+}
+
+void el_add_event(js_eventlist_t *events, js_event_t *event)
+{
+    if (events->events_len >= MAX_EVENTS)
+    {
+        jslog(ERROR, "Event queue full. Max event number: %d => aborting.\n", MAX_EVENTS);
+        abort();
+    }
+    events->events[events->events_len++] = *event;
+}
+
+// may be called from any thread
+void el_fire_events(js_eventlist_t *events)
+{
+    if (events->events_len == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&postedMutex);
+    if (postedLen + events->events_len > postedCap)
+    {
+        postedCap = postedCap > 0 ? postedCap * 2 : 16;
+        posted = (js_event_t *)realloc(posted, postedCap * sizeof(js_event_t));
+    }
+    memcpy(posted + postedLen, events->events, events->events_len * sizeof(js_event_t));
+    postedLen += events->events_len;
+    pthread_mutex_unlock(&postedMutex);
+
+    char wake = 1;
+    if (write(wakeFds[1], &wake, 1) < 0 && errno != EAGAIN)
+    {
+        jslog(ERROR, "Cannot wake up the event loop: %d\n", errno);
+    }
+}
+
+static void takePostedEvents()
+{
+    char drain[64];
+    while (read(wakeFds[0], drain, sizeof(drain)) > 0)
+    {
+    }
+    pthread_mutex_lock(&postedMutex);
+    for (int i = 0; i < postedLen; i++)
+    {
+        queueEvent(posted[i].type, posted[i].status, (int)(intptr_t)posted[i].fd);
+    }
+    postedLen = 0;
+    pthread_mutex_unlock(&postedMutex);
+}
+
+static duk_ret_t el_createTimer(duk_context *ctx)
+{
+    int delay = duk_to_int32(ctx, 0);
+    int handle = nextTimerHandle++;
+    if (delay <= 0)
+    {
+        // fire event immediately without starting the timer
+        queueEvent(EL_TIMER_EVENT_TYPE, handle, 0);
+    }
+    else
+    {
+        if (timersLen == timersCap)
+        {
+            timersCap = timersCap > 0 ? timersCap * 2 : 32;
+            timers = (host_timer_t *)realloc(timers, timersCap * sizeof(host_timer_t));
+        }
+        timers[timersLen].handle = handle;
+        timers[timersLen].due = nowMs() + delay;
+        timersLen++;
+        timersStarted++;
+    }
+    duk_push_int(ctx, handle);
+    return 1;
+}
+
+static duk_ret_t el_removeTimer(duk_context *ctx)
+{
+    int handle = duk_to_int32(ctx, 0);
+    for (int i = 0; i < timersLen; i++)
+    {
+        if (timers[i].handle == handle)
+        {
+            timers[i] = timers[--timersLen];
+            timersStopped++;
+            break;
+        }
+    }
+    return 0;
+}
+
+static duk_ret_t el_getTimerStats(duk_context *ctx)
+{
+    duk_idx_t obj_idx = duk_push_object(ctx);
+    duk_push_number(ctx, timersStarted);
+    duk_put_prop_string(ctx, obj_idx, "started");
+    duk_push_number(ctx, timersStopped);
+    duk_put_prop_string(ctx, obj_idx, "stopped");
+    duk_push_int(ctx, timersLen);
+    duk_put_prop_string(ctx, obj_idx, "running");
+    if (duk_to_boolean(ctx, 0))
+    {
+        timersStarted = 0;
+        timersStopped = 0;
+    }
+    return 1;
+}
+
+static int *copySocketList(duk_context *ctx, duk_idx_t idx, int *old, int *len)
+{
+    free(old);
+    *len = duk_get_length(ctx, idx);
+    int *sockfds = (int *)calloc(*len > 0 ? *len : 1, sizeof(int));
+    for (int i = 0; i < *len; i++)
+    {
+        duk_get_prop_index(ctx, idx, i);
+        sockfds[i] = duk_to_int(ctx, -1);
+        duk_pop(ctx);
+    }
+    return sockfds;
+}
+
+static duk_ret_t el_registerSocketEvents(duk_context *ctx)
+{
+    if (!duk_is_array(ctx, 0) || !duk_is_array(ctx, 1) || !duk_is_array(ctx, 2))
+    {
+        return duk_error(ctx, DUK_ERR_TYPE_ERROR, "Socket lists expected");
+    }
+    notConnectedSockets = copySocketList(ctx, 0, notConnectedSockets, &notConnectedSockets_len);
+    connectedSockets = copySocketList(ctx, 1, connectedSockets, &connectedSockets_len);
+    connectedWritableSockets = copySocketList(ctx, 2, connectedWritableSockets, &connectedWritableSockets_len);
+    return 0;
+}
+
+static void addPollFd(struct pollfd **fds, int *len, int *cap, int sockfd, short events)
+{
+    for (int i = 0; i < *len; i++)
+    {
+        if ((*fds)[i].fd == sockfd)
+        {
+            (*fds)[i].events |= events;
+            return;
+        }
+    }
+    if (*len == *cap)
+    {
+        *cap = *cap > 0 ? *cap * 2 : 64;
+        *fds = (struct pollfd *)realloc(*fds, *cap * sizeof(struct pollfd));
+    }
+    (*fds)[*len].fd = sockfd;
+    (*fds)[*len].events = events;
+    (*fds)[*len].revents = 0;
+    (*len)++;
+}
+
+static short findRevents(struct pollfd *fds, int len, int sockfd)
+{
+    for (int i = 0; i < len; i++)
+    {
+        if (fds[i].fd == sockfd)
+        {
+            return fds[i].revents;
+        }
+    }
+    return 0;
+}
+
+static bool isRegistered(int *sockfds, int len, int sockfd)
+{
+    for (int i = 0; i < len; i++)
+    {
+        if (sockfds[i] == sockfd)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Waits until a socket is ready or a timer is due and queues their events,
+ * using the same mapping from socket state to events as select_task_it.
+ */
+static void waitForEvents()
+{
+    static struct pollfd *fds = NULL;
+    static int fdsCap = 0;
+    int fdsLen = 0;
+
+    for (int i = 0; i < notConnectedSockets_len; i++)
+    {
+        addPollFd(&fds, &fdsLen, &fdsCap, notConnectedSockets[i], POLLOUT);
+    }
+    for (int i = 0; i < connectedSockets_len; i++)
+    {
+        addPollFd(&fds, &fdsLen, &fdsCap, connectedSockets[i], POLLIN);
+    }
+    for (int i = 0; i < connectedWritableSockets_len; i++)
+    {
+        addPollFd(&fds, &fdsLen, &fdsCap, connectedWritableSockets[i], POLLOUT);
+    }
+
+    int timeout = -1;
+    int64_t now = nowMs();
+    for (int i = 0; i < timersLen; i++)
+    {
+        int64_t wait = timers[i].due > now ? timers[i].due - now : 0;
+        if (timeout < 0 || wait < timeout)
+        {
+            timeout = (int)wait;
+        }
+    }
+    // sockets which are still being resolved are only woken up by the dns task
+    addPollFd(&fds, &fdsLen, &fdsCap, wakeFds[0], POLLIN);
+
+    int ret = poll(fds, fdsLen, timeout);
+    if (ret < 0 && errno != EINTR)
+    {
+        jslog(ERROR, "poll returns ERROR: %d\n", errno);
+    }
+    if (ret > 0)
+    {
+        if (findRevents(fds, fdsLen, wakeFds[0]) & POLLIN)
+        {
+            takePostedEvents();
+        }
+        for (int i = 0; i < notConnectedSockets_len; i++)
+        {
+            int sockfd = notConnectedSockets[i];
+            short revents = findRevents(fds, fdsLen, sockfd);
+            if (revents & POLLERR)
+            {
+                queueEvent(EL_SOCKET_EVENT_TYPE, EL_SOCKET_STATUS_ERROR, sockfd);
+            }
+            else if (revents & (POLLOUT | POLLHUP))
+            {
+                queueEvent(EL_SOCKET_EVENT_TYPE, EL_SOCKET_STATUS_WRITE, sockfd);
+            }
+        }
+        for (int i = 0; i < connectedSockets_len; i++)
+        {
+            int sockfd = connectedSockets[i];
+            short revents = findRevents(fds, fdsLen, sockfd);
+            if (revents & (POLLIN | POLLHUP))
+            {
+                socketStatsReadable(sockfd);
+                queueEvent(EL_SOCKET_EVENT_TYPE, EL_SOCKET_STATUS_READ, sockfd);
+            }
+            else if (revents & POLLERR)
+            {
+                queueEvent(EL_SOCKET_EVENT_TYPE, EL_SOCKET_STATUS_ERROR, sockfd);
+            }
+            else if ((revents & POLLOUT) && isRegistered(connectedWritableSockets, connectedWritableSockets_len, sockfd))
+            {
+                queueEvent(EL_SOCKET_EVENT_TYPE, EL_SOCKET_STATUS_WRITE, sockfd);
+            }
+        }
+    }
+
+    now = nowMs();
+    for (int i = 0; i < timersLen;)
+    {
+        if (timers[i].due <= now)
+        {
+            queueEvent(EL_TIMER_EVENT_TYPE, timers[i].handle, 0);
+            timers[i] = timers[--timersLen];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static duk_ret_t el_suspend(duk_context *ctx)
+{
+    // same as on the device, see esp32-javascript.c
+    duk_gc(ctx, 0);
+    duk_gc(ctx, 0);
+
+    while (pendingStart == pendingLen)
+    {
+        waitForEvents();
+    }
+
+    int arr_idx = duk_push_array(ctx);
+    for (int i = 0; i < MAX_EVENTS && pendingStart < pendingLen; i++)
+    {
+        js_event_t *event = &pending[pendingStart++];
+        duk_idx_t obj_idx = duk_push_object(ctx);
+
+        duk_push_int(ctx, event->type);
+        duk_put_prop_string(ctx, obj_idx, "type");
+        duk_push_int(ctx, event->status);
+        duk_put_prop_string(ctx, obj_idx, "status");
+        duk_push_int(ctx, (int)(intptr_t)event->fd);
+        duk_put_prop_string(ctx, obj_idx, "fd");
+
+        duk_put_prop_index(ctx, arr_idx, i);
+    }
+    return 1;
+}
+
+/*
+ * With HOST_BENCH_DNS_PORT set, the lookups of the dns task go to the DNS
+ * stub of "loadgen -D" on that port instead of the resolvers of the system.
+ */
+#undef gethostbyname
+struct hostent *hostGethostbyname(const char *name)
+{
+    const char *port = getenv("HOST_BENCH_DNS_PORT");
+    if (port != NULL)
+    {
+        // the resolver state is per thread, only the dns task gets here
+        res_init();
+        _res.nscount = 1;
+        _res.nsaddr_list[0].sin_family = AF_INET;
+        _res.nsaddr_list[0].sin_port = htons(atoi(port));
+        _res.nsaddr_list[0].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    return gethostbyname(name);
+}
+
+/*
+ * The SPIFFS partitions /modules and /data are directories below
+ * HOST_BENCH_FS (build/fs by default). readFile and fileStat behave like the
+ * bindings of spiffs-events.c.
+ */
+#undef fopen
+static const char *hostFilePath(const char *path, char *mapped, size_t size)
+{
+    if (strncmp(path, "/modules/", 9) == 0 || strncmp(path, "/data/", 6) == 0)
+    {
+        const char *fs = getenv("HOST_BENCH_FS");
+        snprintf(mapped, size, "%s%s", fs != NULL ? fs : "build/fs", path);
+        return mapped;
+    }
+    return path;
+}
+
+FILE *hostFopen(const char *path, const char *mode)
+{
+    char mapped[PATH_MAX];
+    return fopen(hostFilePath(path, mapped, sizeof(mapped)), mode);
+}
+
+static duk_ret_t el_readFile(duk_context *ctx)
+{
+    FILE *f = hostFopen(duk_to_string(ctx, 0), "r");
+    if (f == NULL)
+    {
+        return 0; // undefined
+    }
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *string = (char *)malloc(fsize + 1);
+    size_t read = fread(string, 1, fsize, f);
+    fclose(f);
+    string[read] = 0;
+
+    duk_push_string(ctx, string);
+    free(string);
+    return 1;
+}
+
+static duk_ret_t el_fileStat(duk_context *ctx)
+{
+    char mapped[PATH_MAX];
+    struct stat buffer;
+    if (stat(hostFilePath(duk_to_string(ctx, 0), mapped, sizeof(mapped)), &buffer) != 0)
+    {
+        return 0; // undefined
+    }
+    duk_push_object(ctx);
+    duk_push_number(ctx, buffer.st_size);
+    duk_put_prop_string(ctx, -2, "size");
+    duk_push_number(ctx, buffer.st_mtime);
+    duk_put_prop_string(ctx, -2, "mtime");
+    return 1;
+}
+
+/*
+ * TLS with OpenSSL instead of the OpenSSL API of ESP-IDF on top of mbedtls.
+ * The handshake results and the session cache follow socket-events.c and
+ * tls-session-cache.c, so the JS side takes the same paths as on the device.
+ */
+#define HOST_TLS_SESSION_CACHE_SIZE 4
+#define HOST_TLS_SESSION_CACHE_LIFETIME_MS (30 * 60 * 1000)
+
+typedef struct
+{
+    char hostname[128];
+    int port;
+    int64_t created;
+    int64_t lastUsed;
+    SSL_SESSION *session;
+} host_tls_session_t;
+
+static host_tls_session_t tlsSessions[HOST_TLS_SESSION_CACHE_SIZE];
+
+static host_tls_session_t *findTlsSession(const char *hostname, int port)
+{
+    for (int i = 0; i < HOST_TLS_SESSION_CACHE_SIZE; i++)
+    {
+        if (tlsSessions[i].session != NULL && tlsSessions[i].port == port && strcmp(tlsSessions[i].hostname, hostname) == 0)
+        {
+            return &tlsSessions[i];
+        }
+    }
+    return NULL;
+}
+
+static void freeTlsSession(host_tls_session_t *entry)
+{
+    if (entry->session != NULL)
+    {
+        SSL_SESSION_free(entry->session);
+        entry->session = NULL;
+    }
+}
+
+static duk_ret_t el_createSSLServerContext(duk_context *ctx)
+{
+    char cert[PATH_MAX];
+    char key[PATH_MAX];
+    snprintf(cert, sizeof(cert), "%s/components/socket-events/cacert.pem", root);
+    snprintf(key, sizeof(key), "%s/components/socket-events/prvtkey.pem", root);
+
+    SSL_CTX *sslCtx = SSL_CTX_new(TLS_server_method());
+    // the test certificate of socket-events is signed with MD5
+    SSL_CTX_set_security_level(sslCtx, 0);
+    if (SSL_CTX_use_certificate_file(sslCtx, cert, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_use_PrivateKey_file(sslCtx, key, SSL_FILETYPE_PEM) != 1)
+    {
+        return duk_error(ctx, DUK_ERR_ERROR, "Cannot load %s or %s", cert, key);
+    }
+    duk_push_int(ctx, (duk_int_t)sslCtx);
+    return 1;
+}
+
+static duk_ret_t el_createSSLClientContext(duk_context *ctx)
+{
+    // TLS 1.2 like the device, the expired test certificate is not verified
+    SSL_CTX *sslCtx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_security_level(sslCtx, 0);
+    SSL_CTX_set_max_proto_version(sslCtx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(sslCtx, SSL_VERIFY_NONE, NULL);
+    duk_push_int(ctx, (duk_int_t)sslCtx);
+    return 1;
+}
+
+static duk_ret_t el_createSSL(duk_context *ctx)
+{
+    SSL *ssl = SSL_new((SSL_CTX *)duk_to_int(ctx, 0));
+    if (!duk_is_undefined(ctx, 1))
+    {
+        SSL_set_tlsext_host_name(ssl, duk_to_string(ctx, 1));
+    }
+    duk_push_int(ctx, (duk_int_t)ssl);
+    return 1;
+}
+
+static int handshakeResult(SSL *ssl, int ret)
+{
+    int err = SSL_get_error(ssl, ret);
+    if (err == SSL_ERROR_WANT_WRITE)
+    {
+        return EL_SSL_HANDSHAKE_WANT_WRITE;
+    }
+    if (err == SSL_ERROR_WANT_READ)
+    {
+        return EL_SSL_HANDSHAKE_WANT_READ;
+    }
+    return EL_SSL_HANDSHAKE_FAILED;
+}
+
+static duk_ret_t el_acceptSSL(duk_context *ctx)
+{
+    SSL *ssl = (SSL *)duk_to_int(ctx, 0);
+    int sockfd = duk_to_int(ctx, 1);
+    if (SSL_get_fd(ssl) < 0)
+    {
+        SSL_set_fd(ssl, sockfd);
+        socketStatsHandshakeStart(sockfd);
+    }
+    int ret = SSL_accept(ssl);
+    int result = ret > 0 ? EL_SSL_HANDSHAKE_DONE : handshakeResult(ssl, ret);
+    if (result == EL_SSL_HANDSHAKE_DONE)
+    {
+        socketStatsHandshakeDone(sockfd);
+    }
+    duk_push_int(ctx, result);
+    return 1;
+}
+
+static duk_ret_t el_connectSSL(duk_context *ctx)
+{
+    SSL *ssl = (SSL *)duk_to_int(ctx, 0);
+    int sockfd = duk_to_int(ctx, 1);
+    const char *hostname = duk_is_undefined(ctx, 2) ? NULL : duk_to_string(ctx, 2);
+    int port = duk_to_int(ctx, 3);
+    int64_t now = nowMs();
+
+    if (SSL_get_fd(ssl) < 0)
+    {
+        SSL_set_fd(ssl, sockfd);
+        socketStatsHandshakeStart(sockfd);
+        host_tls_session_t *entry = hostname != NULL ? findTlsSession(hostname, port) : NULL;
+        if (entry != NULL && now - entry->created >= HOST_TLS_SESSION_CACHE_LIFETIME_MS)
+        {
+            freeTlsSession(entry);
+        }
+        else if (entry != NULL)
+        {
+            SSL_set_session(ssl, entry->session);
+            entry->lastUsed = now;
+        }
+    }
+
+    int ret = SSL_connect(ssl);
+    if (ret <= 0)
+    {
+        // 0 retries on the next writable event, like EAGAIN on the device
+        int result = handshakeResult(ssl, ret) == EL_SSL_HANDSHAKE_FAILED ? -1 : 0;
+        if (result < 0)
+        {
+            SSL_shutdown(ssl);
+        }
+        duk_push_int(ctx, result);
+        return 1;
+    }
+    socketStatsHandshakeDone(sockfd);
+
+    bool resumed = SSL_session_reused(ssl);
+    if (hostname != NULL && strlen(hostname) < sizeof(tlsSessions[0].hostname))
+    {
+        host_tls_session_t *entry = findTlsSession(hostname, port);
+        if (entry == NULL)
+        {
+            entry = &tlsSessions[0];
+            for (int i = 0; i < HOST_TLS_SESSION_CACHE_SIZE; i++)
+            {
+                if (tlsSessions[i].session == NULL)
+                {
+                    entry = &tlsSessions[i];
+                    break;
+                }
+                if (tlsSessions[i].lastUsed < entry->lastUsed)
+                {
+                    entry = &tlsSessions[i];
+                }
+            }
+        }
+        if (!resumed)
+        {
+            freeTlsSession(entry);
+            strcpy(entry->hostname, hostname);
+            entry->port = port;
+            entry->created = now;
+            entry->session = SSL_get1_session(ssl);
+        }
+        entry->lastUsed = now;
+    }
+    duk_push_int(ctx, resumed ? 2 : 1);
+    return 1;
+}
+
+static duk_ret_t el_shutdownSSL(duk_context *ctx)
+{
+    SSL_shutdown((SSL *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t el_freeSSL(duk_context *ctx)
+{
+    SSL_free((SSL *)duk_to_int(ctx, 0));
+    return 0;
+}
+
+static duk_ret_t el_clearTlsSessionCache(duk_context *ctx)
+{
+    for (int i = 0; i < HOST_TLS_SESSION_CACHE_SIZE; i++)
+    {
+        freeTlsSession(&tlsSessions[i]);
+    }
+    return 0;
+}
+
+/*
+ * Console, module loading and process bindings.
+ */
+static duk_ret_t console_binding(duk_context *ctx)
+{
+    log_level_t level = (log_level_t)duk_get_current_magic(ctx);
+    if (level >= logLevel)
+    {
+        fprintf(level >= WARN ? stderr : stdout, "%s\n", duk_safe_to_string(ctx, 0));
+    }
+    return 0;
+}
+
+static duk_ret_t print(duk_context *ctx)
+{
+    fprintf(stdout, "%s\n", duk_safe_to_string(ctx, 0));
+    fflush(stdout);
+    return 0;
+}
+
+static duk_ret_t el_exit(duk_context *ctx)
+{
+    fflush(stdout);
+    exit(duk_get_int_default(ctx, 0, 0));
+    return 0;
+}
+
+static bool isFile(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// tries the candidates of loader.js and pushes the resolved path
+static bool pushResolved(duk_context *ctx, const char *base)
+{
+    static const char *suffixes[] = {"/index.js", "", ".js", NULL};
+    char candidate[PATH_MAX];
+    char resolved[PATH_MAX];
+    for (int i = 0; suffixes[i] != NULL; i++)
+    {
+        snprintf(candidate, sizeof(candidate), "%s%s", base, suffixes[i]);
+        if (isFile(candidate) && realpath(candidate, resolved) != NULL)
+        {
+            duk_push_string(ctx, resolved);
+            return true;
+        }
+    }
+    return false;
+}
+
+static duk_ret_t cb_resolve_module(duk_context *ctx)
+{
+    const char *requested = duk_require_string(ctx, 0);
+    const char *parent = duk_get_string_default(ctx, 1, "");
+    char base[PATH_MAX];
+
+    if (requested[0] == '/')
+    {
+        if (pushResolved(ctx, requested))
+        {
+            return 1;
+        }
+    }
+    else if (requested[0] == '.' && parent[0] != '\0')
+    {
+        const char *slash = strrchr(parent, '/');
+        snprintf(base, sizeof(base), "%.*s/%s", (int)(slash - parent), parent, requested);
+        if (pushResolved(ctx, base))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        for (int i = 0; moduleDirs[i] != NULL; i++)
+        {
+            snprintf(base, sizeof(base), "%s/%s/%s", root, moduleDirs[i], requested);
+            if (pushResolved(ctx, base))
+            {
+                return 1;
+            }
+        }
+    }
+    return duk_error(ctx, DUK_ERR_ERROR, "Module %s not found.", requested);
+}
+
+static bool pushFile(duk_context *ctx, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buffer = (char *)duk_push_fixed_buffer(ctx, size);
+    size_t read = fread(buffer, 1, size, f);
+    fclose(f);
+    duk_buffer_to_string(ctx, -1);
+    return read == (size_t)size;
+}
+
+static duk_ret_t cb_load_module(duk_context *ctx)
+{
+    const char *path = duk_require_string(ctx, 0);
+    if (!pushFile(ctx, path))
+    {
+        return duk_error(ctx, DUK_ERR_ERROR, "Cannot read module %s.", path);
+    }
+    return 1;
+}
+
+static void registerFunction(duk_context *ctx, const char *name, duk_c_function fn, duk_idx_t nargs)
+{
+    duk_push_c_function(ctx, fn, nargs);
+    duk_put_global_string(ctx, name);
+}
+
+static void registerBindings(duk_context *ctx, int argc, char **argv)
+{
+    static const struct
+    {
+        const char *name;
+        log_level_t level;
+    } consoleLevels[] = {{"log", INFO}, {"debug", DEBUG}, {"info", INFO}, {"warn", WARN}, {"error", ERROR}, {NULL, INFO}};
+
+    duk_idx_t obj_idx = duk_push_object(ctx);
+    for (int i = 0; consoleLevels[i].name != NULL; i++)
+    {
+        duk_push_c_function(ctx, console_binding, 1);
+        duk_set_magic(ctx, -1, consoleLevels[i].level);
+        duk_put_prop_string(ctx, obj_idx, consoleLevels[i].name);
+    }
+    duk_put_global_string(ctx, "console");
+
+    registerFunction(ctx, "print", print, 1);
+    registerFunction(ctx, "exit", el_exit, 1);
+    registerFunction(ctx, "el_getHeapStats", el_getHeapStats, 1);
+    registerFunction(ctx, "el_hrtime", el_hrtime, 0);
+    registerFunction(ctx, "el_cpuTime", el_cpuTime, 0);
+    registerFunction(ctx, "el_suspend", el_suspend, 0);
+    registerFunction(ctx, "el_createTimer", el_createTimer, 1);
+    registerFunction(ctx, "el_removeTimer", el_removeTimer, 1);
+    registerFunction(ctx, "el_getTimerStats", el_getTimerStats, 1);
+    registerFunction(ctx, "readFile", el_readFile, 1);
+    registerFunction(ctx, "fileStat", el_fileStat, 1);
+
+    registerSocketBindings(ctx);
+    registerFunction(ctx, "el_registerSocketEvents", el_registerSocketEvents, 3);
+    registerFunction(ctx, "createSSLServerContext", el_createSSLServerContext, 0);
+    registerFunction(ctx, "createSSLClientContext", el_createSSLClientContext, 0);
+    registerFunction(ctx, "createSSL", el_createSSL, 2);
+    registerFunction(ctx, "acceptSSL", el_acceptSSL, 2);
+    registerFunction(ctx, "connectSSL", el_connectSSL, 4);
+    registerFunction(ctx, "shutdownSSL", el_shutdownSSL, 1);
+    registerFunction(ctx, "freeSSL", el_freeSSL, 1);
+    registerFunction(ctx, "el_clearTlsSessionCache", el_clearTlsSessionCache, 0);
+
+    duk_push_int(ctx, EL_WIFI_EVENT_TYPE);
+    duk_put_global_string(ctx, "EL_WIFI_EVENT_TYPE");
+
+    duk_idx_t arr_idx = duk_push_array(ctx);
+    for (int i = 0; i < argc; i++)
+    {
+        duk_push_string(ctx, argv[i]);
+        duk_put_prop_index(ctx, arr_idx, i);
+    }
+    duk_put_global_string(ctx, "scriptArgs");
+
+    duk_push_object(ctx);
+    duk_push_c_function(ctx, cb_resolve_module, DUK_VARARGS);
+    duk_put_prop_string(ctx, -2, "resolve");
+    duk_push_c_function(ctx, cb_load_module, DUK_VARARGS);
+    duk_put_prop_string(ctx, -2, "load");
+    duk_module_node_init(ctx);
+}
+
+static void fatal(void *udata, const char *msg)
+{
+    fprintf(stderr, "FATAL: %s\n", msg != NULL ? msg : "no message");
+    abort();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s script.js [args...]\n", argv[0]);
+        return 2;
+    }
+
+    // keep every allocation in the brk heap, see above
+    mallopt(M_MMAP_MAX, 0);
+    void *probe = malloc(1);
+    if ((uintptr_t)probe > INT_MAX)
+    {
+        fprintf(stderr, "Heap addresses do not fit into 32 bits, link with -no-pie.\n");
+        return 2;
+    }
+    free(probe);
+    CRYPTO_set_mem_functions(tls_malloc, tls_realloc, tls_free);
+
+    signal(SIGPIPE, SIG_IGN);
+    if (pipe2(wakeFds, O_NONBLOCK) != 0)
+    {
+        fprintf(stderr, "Cannot create the wake up pipe.\n");
+        return 2;
+    }
+    initSocketStats();
+    initDnsCache();
+    if (getenv("HOST_BENCH_ROOT") != NULL)
+    {
+        root = getenv("HOST_BENCH_ROOT");
+    }
+    const char *level = getenv("HOST_BENCH_LOG");
+    if (level != NULL)
+    {
+        logLevel = strcmp(level, "debug") == 0 ? DEBUG : strcmp(level, "info") == 0 ? INFO : ERROR;
+    }
+
+    duk_context *ctx = duk_create_heap(heap_alloc, heap_realloc, heap_free, NULL, fatal);
+    registerBindings(ctx, argc - 1, argv + 1);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/components/esp32-javascript/urlparse.js", root);
+    if (!pushFile(ctx, path) || duk_peval(ctx) != 0)
+    {
+        fprintf(stderr, "Cannot load %s: %s\n", path, duk_safe_to_string(ctx, -1));
+        return 1;
+    }
+    duk_pop(ctx);
+
+    if (realpath(argv[1], path) == NULL)
+    {
+        fprintf(stderr, "Cannot find %s\n", argv[1]);
+        return 1;
+    }
+    duk_get_global_string(ctx, "require");
+    duk_push_string(ctx, path);
+    if (duk_pcall(ctx, 1) != 0)
+    {
+        if (duk_is_error(ctx, -1))
+        {
+            duk_get_prop_string(ctx, -1, "stack");
+        }
+        fprintf(stderr, "%s\n", duk_safe_to_string(ctx, -1));
+        return 1;
+    }
+    return 0;
+}
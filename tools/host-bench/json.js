@@ -0,0 +1,74 @@
+/*
+ * JSON serialization benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench json.js stream|stringify|file [kilobytes]
+ *
+ * Serializes an object graph of about kilobytes KB of JSON, like a large
+ * config or a list of sensor readings. "stream" pulls the chunks of
+ * Esp32JsJsonWriter as sendJson does, "file" writes it with writeJsonFile
+ * and "stringify" is JSON.stringify encoded to UTF-8 as socket.write does.
+ */
+require("esp32-javascript/global.js");
+var jsonWriter = require("esp32-javascript/json-writer");
+
+var mode = scriptArgs[1] || "stream";
+var kilobytes = Number(scriptArgs[2] || 200);
+var path = "/tmp/host-bench-" + el_hrtime() + ".json";
+
+function reading(i) {
+  return {
+    id: i,
+    name: "sensor-" + i,
+    enabled: i % 3 !== 0,
+    location: { room: "Wohnzimmer", floor: i % 4 },
+    values: [i * 0.25, 21.5, -3, 1e-7 * i],
+    note: i % 5 === 0 ? "calibrated \"manually\"\n" : null,
+  };
+}
+
+var graph = { version: 1, readings: [] };
+var size = 0;
+for (var i = 0; size < kilobytes * 1024; i++) {
+  var r = reading(i);
+  graph.readings.push(r);
+  size += JSON.stringify(r).length + 1;
+}
+
+function stream() {
+  var writer = new jsonWriter.Esp32JsJsonWriter(graph);
+  var length = 0;
+  var chunk;
+  while ((chunk = writer.next()) !== null) {
+    length += chunk.length;
+  }
+  return length;
+}
+
+function file() {
+  return jsonWriter.writeJsonFile(path, graph);
+}
+
+function stringify() {
+  return new TextEncoder().encode(JSON.stringify(graph)).length;
+}
+
+var fn = mode === "file" ? file : mode === "stringify" ? stringify : stream;
+var expected = new TextEncoder().encode(JSON.stringify(graph)).length;
+var heapBefore = el_getHeapStats(true).used;
+var start = el_hrtime();
+var length = fn();
+var micros = el_hrtime() - start;
+var heap = el_getHeapStats(false);
+if (length !== expected) {
+  throw Error("serialized " + length + " of " + expected + " bytes");
+}
+print(
+  JSON.stringify({
+    name: "json-" + mode + "-" + kilobytes + "k",
+    bytes: length,
+    seconds: micros / 1e6,
+    megabytesPerSecond: Math.round((length / micros) * 10) / 10,
+    heapPeak: heap.peak - heapBefore,
+    allocs: heap.allocs,
+  })
+);
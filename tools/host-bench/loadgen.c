@@ -0,0 +1,994 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * HTTP load generator for the host benchmarks. It keeps a number of
+ * connections busy and prints one JSON object per run:
+ *
+ *     loadgen -p 8080 -c 50 -n 20000 -P 4 /small
+ *
+ * With -S it answers requests itself, as counterpart of the http client
+ * benchmark. With -M it is a minimal MQTT 3.1.1 broker which sends every
+ * PUBLISH back to its sender, as counterpart of the MQTT benchmark. With
+ * -D it is a DNS server on UDP which answers after a delay, as counterpart
+ * of the dns benchmark.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define READ_SIZE 16384
+#define MAX_PIPELINE 64
+
+typedef enum
+{
+    RESPONSE_HEAD,
+    RESPONSE_BODY,
+    RESPONSE_CHUNK_SIZE,
+    RESPONSE_CHUNK_DATA,
+    RESPONSE_CHUNK_END,
+    RESPONSE_TRAILER,
+    RESPONSE_UNTIL_CLOSE
+} response_state_t;
+
+typedef struct
+{
+    int fd;
+    bool connecting;
+    char *in;
+    size_t inLen;
+    size_t inCap;
+    response_state_t state;
+    long remaining;
+    bool closeAfter;
+    int status;
+    // send times of the requests in flight, oldest first
+    int64_t sent[MAX_PIPELINE];
+    int inFlight;
+    int64_t connectedAt;
+} connection_t;
+
+typedef struct
+{
+    const char *host;
+    int port;
+    int connections;
+    long requests;
+    double duration;
+    int pipeline;
+    bool keepAlive;
+    long bodySize;
+    const char *path;
+    const char *name;
+    const char *statsPath;
+} options_t;
+
+static options_t options = {"127.0.0.1", 8080, 1, 10000, 0, 1, true, 0, "/", NULL, NULL};
+
+static char *request = NULL;
+static size_t requestLen = 0;
+static int epfd;
+static long issued = 0;
+static long completed = 0;
+static long errors = 0;
+static long non2xx = 0;
+static uint64_t bytesIn = 0;
+static int64_t *latencies = NULL;
+static long latenciesLen = 0;
+static long latenciesCap = 0;
+static int64_t deadline = 0;
+
+static int64_t nowUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void fail(const char *message)
+{
+    perror(message);
+    exit(1);
+}
+
+static int connectTo(const char *host, int port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid IPv4 address %s\n", host);
+        exit(1);
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        fail("socket");
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void buildRequest()
+{
+    size_t size = 512 + strlen(options.path) + options.bodySize;
+    request = (char *)malloc(size);
+    int len = snprintf(request, size, "%s %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: loadgen\r\n%s",
+                       options.bodySize > 0 ? "POST" : "GET", options.path, options.host, options.port,
+                       options.keepAlive ? "" : "Connection: close\r\n");
+    if (options.bodySize > 0)
+    {
+        len += snprintf(request + len, size - len, "Content-Type: application/octet-stream\r\nContent-Length: %ld\r\n", options.bodySize);
+    }
+    len += snprintf(request + len, size - len, "\r\n");
+    for (long i = 0; i < options.bodySize; i++)
+    {
+        request[len++] = 'a' + i % 26;
+    }
+    requestLen = len;
+}
+
+static bool mayIssue()
+{
+    if (options.duration > 0)
+    {
+        return nowUs() < deadline;
+    }
+    return issued < options.requests;
+}
+
+static void recordLatency(int64_t us)
+{
+    if (latenciesLen == latenciesCap)
+    {
+        latenciesCap = latenciesCap > 0 ? latenciesCap * 2 : 65536;
+        latencies = (int64_t *)realloc(latencies, latenciesCap * sizeof(int64_t));
+    }
+    latencies[latenciesLen++] = us;
+}
+
+static void openConnection(connection_t *c)
+{
+    c->fd = connectTo(options.host, options.port);
+    c->connecting = true;
+    c->inLen = 0;
+    c->state = RESPONSE_HEAD;
+    c->inFlight = 0;
+    c->connectedAt = nowUs();
+    if (c->fd < 0)
+    {
+        errors++;
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+static void closeConnection(connection_t *c)
+{
+    if (c->fd >= 0)
+    {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+// writes the whole buffer, the requests are small compared to the socket buffer
+static bool writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                struct timespec wait = {0, 100000};
+                nanosleep(&wait, NULL);
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void sendRequests(connection_t *c)
+{
+    int depth = options.keepAlive ? options.pipeline : 1;
+    while (c->inFlight < depth && mayIssue())
+    {
+        // requests of a close connection are timed from the connect
+        c->sent[c->inFlight++] = options.keepAlive ? nowUs() : c->connectedAt;
+        issued++;
+        if (!writeAll(c->fd, request, requestLen))
+        {
+            errors += c->inFlight;
+            c->inFlight = 0;
+            closeConnection(c);
+            return;
+        }
+    }
+}
+
+static void responseComplete(connection_t *c)
+{
+    completed++;
+    if (c->status < 200 || c->status > 299)
+    {
+        non2xx++;
+    }
+    recordLatency(nowUs() - c->sent[0]);
+    memmove(c->sent, c->sent + 1, (c->inFlight - 1) * sizeof(int64_t));
+    c->inFlight--;
+    c->state = RESPONSE_HEAD;
+}
+
+static char *findLine(char *start, char *end)
+{
+    for (char *p = start; p + 1 < end; p++)
+    {
+        if (p[0] == '\r' && p[1] == '\n')
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// parses the status line and the header lines, each ends with \r\n before end
+static bool parseHead(connection_t *c, char *head, char *end)
+{
+    c->status = 0;
+    c->remaining = -1;
+    c->closeAfter = false;
+    bool chunked = false;
+    if (sscanf(head, "HTTP/1.%*d %d", &c->status) != 1)
+    {
+        return false;
+    }
+    char *line = findLine(head, end) + 2;
+    while (line < end)
+    {
+        char *lineEnd = findLine(line, end);
+        char lower[256];
+        size_t len = lineEnd - line < (long)sizeof(lower) - 1 ? (size_t)(lineEnd - line) : sizeof(lower) - 1;
+        for (size_t i = 0; i < len; i++)
+        {
+            lower[i] = tolower((unsigned char)line[i]);
+        }
+        lower[len] = '\0';
+        if (strncmp(lower, "content-length:", 15) == 0)
+        {
+            c->remaining = strtol(lower + 15, NULL, 10);
+        }
+        else if (strncmp(lower, "transfer-encoding:", 18) == 0)
+        {
+            chunked = strstr(lower, "chunked") != NULL;
+        }
+        else if (strncmp(lower, "connection:", 11) == 0)
+        {
+            c->closeAfter = strstr(lower, "close") != NULL;
+        }
+        line = lineEnd + 2;
+    }
+    if (chunked)
+    {
+        c->state = RESPONSE_CHUNK_SIZE;
+    }
+    else if (c->remaining >= 0)
+    {
+        c->state = RESPONSE_BODY;
+    }
+    else
+    {
+        c->state = RESPONSE_UNTIL_CLOSE;
+    }
+    return true;
+}
+
+// processes the received bytes, returns false on protocol errors
+static bool processInput(connection_t *c)
+{
+    char *p = c->in;
+    char *end = c->in + c->inLen;
+    for (;;)
+    {
+        if (c->state == RESPONSE_HEAD)
+        {
+            char *headEnd = memmem(p, end - p, "\r\n\r\n", 4);
+            if (headEnd == NULL)
+            {
+                break;
+            }
+            if (c->inFlight == 0 || !parseHead(c, p, headEnd + 2))
+            {
+                return false;
+            }
+            p = headEnd + 4;
+            if (c->state == RESPONSE_BODY && c->remaining == 0)
+            {
+                responseComplete(c);
+            }
+        }
+        else if (c->state == RESPONSE_BODY || c->state == RESPONSE_CHUNK_DATA)
+        {
+            long n = end - p < c->remaining ? end - p : c->remaining;
+            p += n;
+            c->remaining -= n;
+            if (c->remaining > 0)
+            {
+                break;
+            }
+            if (c->state == RESPONSE_BODY)
+            {
+                responseComplete(c);
+            }
+            else
+            {
+                c->state = RESPONSE_CHUNK_END;
+            }
+        }
+        else if (c->state == RESPONSE_CHUNK_SIZE || c->state == RESPONSE_CHUNK_END || c->state == RESPONSE_TRAILER)
+        {
+            char *lineEnd = findLine(p, end);
+            if (lineEnd == NULL)
+            {
+                break;
+            }
+            if (c->state == RESPONSE_CHUNK_SIZE)
+            {
+                c->remaining = strtol(p, NULL, 16);
+                c->state = c->remaining > 0 ? RESPONSE_CHUNK_DATA : RESPONSE_TRAILER;
+            }
+            else if (c->state == RESPONSE_CHUNK_END)
+            {
+                c->state = RESPONSE_CHUNK_SIZE;
+            }
+            else if (lineEnd == p)
+            {
+                responseComplete(c);
+            }
+            p = lineEnd + 2;
+        }
+        else
+        {
+            // the body ends with the connection
+            p = end;
+            break;
+        }
+    }
+    c->inLen = end - p;
+    memmove(c->in, p, c->inLen);
+    return true;
+}
+
+static void handleEvent(connection_t *c, uint32_t events)
+{
+    if (c->connecting)
+    {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+        if (error != 0 || (events & EPOLLERR))
+        {
+            errors++;
+            closeConnection(c);
+            return;
+        }
+        if (!(events & EPOLLOUT))
+        {
+            return;
+        }
+        c->connecting = false;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        sendRequests(c);
+        return;
+    }
+
+    bool closed = false;
+    for (;;)
+    {
+        if (c->inCap - c->inLen < READ_SIZE)
+        {
+            c->inCap = c->inLen + READ_SIZE * 2;
+            c->in = (char *)realloc(c->in, c->inCap);
+        }
+        ssize_t n = read(c->fd, c->in + c->inLen, READ_SIZE);
+        if (n > 0)
+        {
+            bytesIn += n;
+            c->inLen += n;
+            if (!processInput(c))
+            {
+                errors += c->inFlight;
+                c->inFlight = 0;
+                closed = true;
+                break;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN)
+        {
+            break;
+        }
+        closed = true;
+        if (c->state == RESPONSE_UNTIL_CLOSE && c->inFlight > 0)
+        {
+            responseComplete(c);
+        }
+        break;
+    }
+
+    if (!closed && c->inFlight > 0 && c->closeAfter && c->state == RESPONSE_HEAD)
+    {
+        // the server closes after this response, the rest is lost
+        closed = true;
+    }
+    if (closed || (!options.keepAlive && c->inFlight == 0) || (c->closeAfter && c->inFlight == 0))
+    {
+        errors += c->inFlight;
+        c->inFlight = 0;
+        closeConnection(c);
+        return;
+    }
+    sendRequests(c);
+}
+
+static int compareLatency(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentileMs(double p)
+{
+    if (latenciesLen == 0)
+    {
+        return 0;
+    }
+    long index = (long)(p * (latenciesLen - 1) + 0.5);
+    return latencies[index] / 1000.0;
+}
+
+/*
+ * Sends a single GET on a blocking connection and returns the body, used
+ * to read the heap statistics of the benchmarked server.
+ */
+static char *fetchBody(const char *path)
+{
+    int fd = connectTo(options.host, options.port);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    char buffer[8192];
+    int len = snprintf(buffer, sizeof(buffer), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", path, options.host);
+    if (!writeAll(fd, buffer, len))
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t total = 0;
+    ssize_t n;
+    while (total < sizeof(buffer) - 1 && (n = read(fd, buffer + total, sizeof(buffer) - 1 - total)) > 0)
+    {
+        total += n;
+    }
+    close(fd);
+    buffer[total] = '\0';
+    char *body = strstr(buffer, "\r\n\r\n");
+    return body != NULL ? strdup(body + 4) : NULL;
+}
+
+static void runLoad()
+{
+    buildRequest();
+    epfd = epoll_create1(0);
+    connection_t *conns = (connection_t *)calloc(options.connections, sizeof(connection_t));
+
+    char statsPath[1024];
+    if (options.statsPath != NULL)
+    {
+        // resets the high-water mark of the server
+        snprintf(statsPath, sizeof(statsPath), "%s?reset=1", options.statsPath);
+        free(fetchBody(statsPath));
+    }
+
+    int64_t start = nowUs();
+    deadline = start + (int64_t)(options.duration * 1000000);
+    for (int i = 0; i < options.connections; i++)
+    {
+        conns[i].fd = -1;
+        if (mayIssue())
+        {
+            openConnection(&conns[i]);
+        }
+    }
+
+    struct epoll_event events[256];
+    for (;;)
+    {
+        int open = 0;
+        for (int i = 0; i < options.connections; i++)
+        {
+            connection_t *c = &conns[i];
+            if (c->fd < 0 && mayIssue())
+            {
+                openConnection(c);
+            }
+            else if (c->fd >= 0 && !c->connecting && c->inFlight == 0 && !mayIssue())
+            {
+                closeConnection(c);
+            }
+            if (c->fd >= 0)
+            {
+                open++;
+            }
+        }
+        if (open == 0)
+        {
+            break;
+        }
+        int n = epoll_wait(epfd, events, 256, 10000);
+        if (n == 0)
+        {
+            fprintf(stderr, "No progress for 10 seconds, giving up.\n");
+            for (int i = 0; i < options.connections; i++)
+            {
+                errors += conns[i].inFlight;
+                conns[i].inFlight = 0;
+                closeConnection(&conns[i]);
+            }
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            handleEvent((connection_t *)events[i].data.ptr, events[i].events);
+        }
+    }
+    double seconds = (nowUs() - start) / 1e6;
+    for (int i = 0; i < options.connections; i++)
+    {
+        free(conns[i].in);
+    }
+    free(conns);
+
+    qsort(latencies, latenciesLen, sizeof(int64_t), compareLatency);
+    printf("{\"name\":\"%s\",\"path\":\"%s\",\"connections\":%d,\"pipeline\":%d,\"keepAlive\":%s,"
+           "\"requestBytes\":%zu,\"requests\":%ld,\"errors\":%ld,\"non2xx\":%ld,\"seconds\":%.3f,"
+           "\"requestsPerSecond\":%.1f,\"p50Ms\":%.3f,\"p99Ms\":%.3f,\"maxMs\":%.3f,\"bytesIn\":%llu",
+           options.name != NULL ? options.name : options.path, options.path, options.connections,
+           options.keepAlive ? options.pipeline : 1, options.keepAlive ? "true" : "false",
+           requestLen, completed, errors, non2xx, seconds, completed / seconds,
+           percentileMs(0.5), percentileMs(0.99), percentileMs(1.0), (unsigned long long)bytesIn);
+    if (options.statsPath != NULL)
+    {
+        char *stats = fetchBody(options.statsPath);
+        printf(",\"server\":%s", stats != NULL && stats[0] == '{' ? stats : "null");
+        free(stats);
+    }
+    printf("}\n");
+}
+
+/*
+ * Serve mode: answers every request with a fixed body, keep-alive and
+ * pipelining included.
+ */
+typedef struct
+{
+    int fd;
+    char *in;
+    size_t inLen;
+    size_t inCap;
+} server_connection_t;
+
+static char *response = NULL;
+static size_t responseLen = 0;
+
+static void buildResponse()
+{
+    long size = options.bodySize > 0 ? options.bodySize : 100;
+    response = (char *)malloc(size + 256);
+    responseLen = snprintf(response, 256, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %ld\r\n\r\n", size);
+    for (long i = 0; i < size; i++)
+    {
+        response[responseLen++] = 'a' + i % 26;
+    }
+}
+
+static bool serveInput(server_connection_t *c)
+{
+    char *p = c->in;
+    char *end = c->in + c->inLen;
+    for (;;)
+    {
+        char *headEnd = memmem(p, end - p, "\r\n\r\n", 4);
+        if (headEnd == NULL)
+        {
+            break;
+        }
+        long contentLength = 0;
+        char *cl = memmem(p, headEnd - p, "\r\nContent-Length:", 17);
+        if (cl == NULL)
+        {
+            cl = memmem(p, headEnd - p, "\r\ncontent-length:", 17);
+        }
+        if (cl != NULL)
+        {
+            contentLength = strtol(cl + 17, NULL, 10);
+        }
+        if (end - (headEnd + 4) < contentLength)
+        {
+            break;
+        }
+        p = headEnd + 4 + contentLength;
+        if (!writeAll(c->fd, response, responseLen))
+        {
+            return false;
+        }
+    }
+    c->inLen = end - p;
+    memmove(c->in, p, c->inLen);
+    return true;
+}
+
+// minimal MQTT broker: acknowledges all packets and echoes publishes to their sender
+static bool serveMqttInput(server_connection_t *c)
+{
+    uint8_t *p = (uint8_t *)c->in;
+    uint8_t *end = p + c->inLen;
+    for (;;)
+    {
+        size_t remaining = 0;
+        int lenBytes = 0;
+        bool complete = false;
+        while (p + 1 + lenBytes < end && lenBytes < 4)
+        {
+            uint8_t b = p[1 + lenBytes];
+            remaining |= (size_t)(b & 0x7f) << (7 * lenBytes);
+            lenBytes++;
+            if ((b & 0x80) == 0)
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || (size_t)(end - p) < 1 + lenBytes + remaining)
+        {
+            break;
+        }
+        uint8_t type = p[0] >> 4;
+        uint8_t *body = p + 1 + lenBytes;
+        bool ok = true;
+        if (type == 1)
+        {
+            static const uint8_t connack[] = {0x20, 2, 0, 0};
+            ok = writeAll(c->fd, (const char *)connack, sizeof(connack));
+        }
+        else if (type == 3)
+        {
+            int qos = (p[0] >> 1) & 3;
+            size_t topicLen = (body[0] << 8) | body[1];
+            if (qos > 0)
+            {
+                uint8_t *id = body + 2 + topicLen;
+                uint8_t puback[] = {0x40, 2, id[0], id[1]};
+                ok = writeAll(c->fd, (const char *)puback, sizeof(puback));
+            }
+            // the echo keeps flags, topic, packet id and payload of the publish
+            ok = ok && writeAll(c->fd, (const char *)p, 1 + lenBytes + remaining);
+        }
+        else if (type == 8 || type == 10)
+        {
+            uint8_t ack[64] = {type == 8 ? 0x90 : 0xb0, 2, body[0], body[1]};
+            size_t ackLen = 4;
+            // SUBACK grants at most QoS 1 per filter
+            for (size_t i = 2; type == 8 && i + 2 < remaining && ackLen < sizeof(ack);)
+            {
+                size_t filterLen = (body[i] << 8) | body[i + 1];
+                ack[ackLen++] = body[i + 2 + filterLen] > 1 ? 1 : body[i + 2 + filterLen];
+                i += 3 + filterLen;
+            }
+            ack[1] = ackLen - 2;
+            ok = writeAll(c->fd, (const char *)ack, ackLen);
+        }
+        else if (type == 12)
+        {
+            static const uint8_t pingresp[] = {0xd0, 0};
+            ok = writeAll(c->fd, (const char *)pingresp, sizeof(pingresp));
+        }
+        else if (type == 14)
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            return false;
+        }
+        p = body + remaining;
+    }
+    c->inLen = end - p;
+    memmove(c->in, p, c->inLen);
+    return true;
+}
+
+static void runServer(bool (*serve)(server_connection_t *c))
+{
+    buildResponse();
+    int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 512) < 0)
+    {
+        fail("listen");
+    }
+    epfd = epoll_create1(0);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+
+    struct epoll_event events[256];
+    for (;;)
+    {
+        int n = epoll_wait(epfd, events, 256, -1);
+        for (int i = 0; i < n; i++)
+        {
+            server_connection_t *c = (server_connection_t *)events[i].data.ptr;
+            if (c == NULL)
+            {
+                int fd;
+                while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+                {
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    c = (server_connection_t *)calloc(1, sizeof(server_connection_t));
+                    c->fd = fd;
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = c;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+                }
+                continue;
+            }
+            bool closed = false;
+            for (;;)
+            {
+                if (c->inCap - c->inLen < READ_SIZE)
+                {
+                    c->inCap = c->inLen + READ_SIZE * 2;
+                    c->in = (char *)realloc(c->in, c->inCap);
+                }
+                ssize_t r = read(c->fd, c->in + c->inLen, READ_SIZE);
+                if (r > 0)
+                {
+                    c->inLen += r;
+                    continue;
+                }
+                closed = !(r < 0 && errno == EAGAIN);
+                break;
+            }
+            if (closed || !serve(c))
+            {
+                close(c->fd);
+                free(c->in);
+                free(c);
+            }
+        }
+    }
+}
+
+/*
+ * Answers every A query with 127.0.0.1 and other queries without records,
+ * after delayMs like a distant resolver. Queries are answered one by one,
+ * so lookups which are not coalesced add up.
+ */
+static void runDnsServer(int delayMs)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        fail("bind");
+    }
+
+    uint8_t packet[512 + 16];
+    for (;;)
+    {
+        struct sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        ssize_t len = recvfrom(fd, packet, 512, 0, (struct sockaddr *)&from, &fromLen);
+        // header and at least the root name, type and class of one question
+        if (len < 12 + 5 || packet[5] != 1)
+        {
+            continue;
+        }
+        size_t end = 12;
+        while (end < (size_t)len && packet[end] != 0)
+        {
+            end += packet[end] + 1;
+        }
+        if (end + 5 > (size_t)len)
+        {
+            continue;
+        }
+        end += 5;
+        bool a = packet[end - 4] == 0 && packet[end - 3] == 1;
+
+        // response, recursion desired and available, one question
+        packet[2] = 0x81;
+        packet[3] = 0x80;
+        packet[7] = a ? 1 : 0;
+        memset(packet + 8, 0, 4);
+        if (a)
+        {
+            // name pointer to the question, A, IN, ttl 60, 127.0.0.1
+            static const uint8_t answer[] = {0xc0, 12, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 127, 0, 0, 1};
+            memcpy(packet + end, answer, sizeof(answer));
+            end += sizeof(answer);
+        }
+        usleep(delayMs * 1000);
+        sendto(fd, packet, end, 0, (struct sockaddr *)&from, fromLen);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [path]\n"
+            "  -h host      IPv4 address of the server (127.0.0.1)\n"
+            "  -p port      port (8080)\n"
+            "  -c n         concurrent connections (1)\n"
+            "  -n n         number of requests (10000)\n"
+            "  -d seconds   run for a duration instead of a number of requests\n"
+            "  -P n         requests pipelined per keep-alive connection (1)\n"
+            "  -k           close the connection after each request\n"
+            "  -b bytes     POST a body of this size instead of GET\n"
+            "  -N name      name of the run in the output\n"
+            "  -s path      path of the heap statistics of the server\n"
+            "  -S           serve requests with a body of -b bytes (100)\n"
+            "  -M           be an MQTT broker which echoes publishes to their sender\n"
+            "  -D ms        be a DNS server on UDP which answers after ms milliseconds\n",
+            name);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    bool serve = false;
+    bool broker = false;
+    int dnsDelayMs = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:n:d:P:kb:N:s:SMD:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+            options.host = optarg;
+            break;
+        case 'p':
+            options.port = atoi(optarg);
+            break;
+        case 'c':
+            options.connections = atoi(optarg);
+            break;
+        case 'n':
+            options.requests = atol(optarg);
+            break;
+        case 'd':
+            options.duration = atof(optarg);
+            break;
+        case 'P':
+            options.pipeline = atoi(optarg);
+            break;
+        case 'k':
+            options.keepAlive = false;
+            break;
+        case 'b':
+            options.bodySize = atol(optarg);
+            break;
+        case 'N':
+            options.name = optarg;
+            break;
+        case 's':
+            options.statsPath = optarg;
+            break;
+        case 'S':
+            serve = true;
+            break;
+        case 'M':
+            broker = true;
+            break;
+        case 'D':
+            dnsDelayMs = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind < argc)
+    {
+        options.path = argv[optind];
+    }
+    if (options.connections < 1 || options.pipeline < 1 || options.pipeline > MAX_PIPELINE)
+    {
+        usage(argv[0]);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if (dnsDelayMs >= 0)
+    {
+        runDnsServer(dnsDelayMs);
+    }
+    else if (serve || broker)
+    {
+        runServer(broker ? serveMqttInput : serveInput);
+    }
+    else
+    {
+        runLoad();
+    }
+    return errors > 0 ? 1 : 0;
+}
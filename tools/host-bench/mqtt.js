@@ -0,0 +1,154 @@
+/*
+ * MQTT client benchmark for the host runtime, started by run.sh against
+ * "loadgen -M":
+ *
+ *     build/host-bench mqtt.js port messages window [qos]
+ *     build/host-bench mqtt.js port messages window http
+ *
+ * Keeps window publishes of 64 bytes in flight, every publish is completed
+ * when the broker sent it back. With "http" the 64 bytes are instead sent
+ * as one POST per message with httpClient over window keep-alive
+ * connections to "loadgen -S -b 2", the way telemetry was sent before.
+ * bytesOut, bytesIn and writes count the payload bytes and write calls of
+ * all sockets of the run. Prints the results as JSON in the format of
+ * loadgen.
+ */
+require("esp32-javascript/global.js");
+require("socket-events");
+var eventloop = require("esp32-js-eventloop");
+var http = require("esp32-javascript/http");
+var mqtt = require("esp32-javascript/mqtt");
+
+var port = Number(scriptArgs[1] || 1883);
+var messages = Number(scriptArgs[2] || 10000);
+var windowSize = Number(scriptArgs[3] || 1);
+var useHttp = scriptArgs[4] === "http";
+var qos = useHttp ? 0 : Number(scriptArgs[4] || 0);
+
+http.httpClientPool.maxSocketsPerHost = windowSize;
+
+var payload = new Uint8Array(64);
+var issued = 0;
+var completed = 0;
+var errors = 0;
+var bytesIn = 0;
+var latencies = [];
+var sentAt = {};
+var start = 0;
+var socketsBefore;
+var client;
+var body = new Array(65).join("x");
+
+function percentile(sorted, p) {
+  return sorted.length > 0
+    ? sorted[Math.round(p * (sorted.length - 1))] / 1000
+    : 0;
+}
+
+function report() {
+  var seconds = (el_hrtime() - start) / 1e6;
+  var sorted = latencies.sort(function (a, b) {
+    return a - b;
+  });
+  var heap = el_getHeapStats(false);
+  var sockets = el_getSocketStats();
+  print(
+    JSON.stringify({
+      name: (useHttp ? "http-post" : "mqtt-qos" + qos) + "-w" + windowSize,
+      path: useHttp ? "/telemetry" : "bench/#",
+      connections: 1,
+      pipeline: windowSize,
+      keepAlive: true,
+      requests: completed,
+      errors: errors,
+      seconds: seconds,
+      requestsPerSecond: Math.round((completed / seconds) * 10) / 10,
+      p50Ms: percentile(sorted, 0.5),
+      p99Ms: percentile(sorted, 0.99),
+      maxMs: percentile(sorted, 1),
+      bytesIn: bytesIn,
+      wire: {
+        bytesOut: sockets.bytesOut - socketsBefore.bytesOut,
+        bytesIn: sockets.bytesIn - socketsBefore.bytesIn,
+        writes: sockets.writes - socketsBefore.writes,
+      },
+      client: { heapUsed: heap.used, heapPeak: heap.peak },
+    })
+  );
+  exit(errors > 0 ? 1 : 0);
+}
+
+function next() {
+  if (issued < messages) {
+    var topic = "bench/" + issued++;
+    sentAt[topic] = el_hrtime();
+    if (!client.publish(topic, payload, { qos: qos })) {
+      errors++;
+      delete sentAt[topic];
+      next();
+    }
+  } else if (completed + errors === messages) {
+    report();
+  }
+}
+
+function nextPost() {
+  if (issued < messages) {
+    issued++;
+    var postedAt = el_hrtime();
+    http.httpClient(false, "127.0.0.1", String(port), "/telemetry", "POST",
+      "Content-Type: application/json\r\n", body,
+      function (content) {
+        completed++;
+        bytesIn += content.length;
+        latencies.push(el_hrtime() - postedAt);
+        nextPost();
+      },
+      function (message) {
+        errors++;
+        console.error(message);
+        nextPost();
+      }
+    );
+  } else if (completed + errors === messages) {
+    report();
+  }
+}
+
+function begin(send) {
+  el_getHeapStats(true);
+  socketsBefore = el_getSocketStats();
+  start = el_hrtime();
+  for (var i = 0; i < windowSize; i++) {
+    send();
+  }
+}
+
+global.main = function () {
+  if (useHttp) {
+    begin(nextPost);
+    return;
+  }
+  client = mqtt.connectMqtt({
+    host: "127.0.0.1",
+    port: port,
+    keepAlive: 0,
+    maxInflight: windowSize,
+    maxQueued: windowSize,
+  });
+  client.onerror = function (message) {
+    console.error(message);
+    exit(1);
+  };
+  client.onmessage = function (topic, data) {
+    completed++;
+    bytesIn += data.length;
+    latencies.push(el_hrtime() - sentAt[topic]);
+    delete sentAt[topic];
+    next();
+  };
+  client.subscribe("bench/#", qos, function () {
+    begin(next);
+  });
+};
+eventloop.start();
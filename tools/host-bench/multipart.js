@@ -0,0 +1,135 @@
+/*
+ * Multipart parser benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench multipart.js stream|buffered [size] [chunkSize]
+ *
+ * Passes a multipart/form-data body with two fields and a file of size
+ * bytes (default 1 MB) in pieces of chunkSize bytes (default 1460, one TCP
+ * segment) to receiveMultipart, as httpServer does with a received body.
+ * "stream" parses each piece as it arrives, "buffered" keeps the pieces
+ * like req.body and parses the joined body at the end. heapPeak is the
+ * Duktape heap high-water mark above the heap used before the upload.
+ */
+require("esp32-javascript/global.js");
+global.Headers = require("esp32-javascript/fetch").Esp32JsHeaders;
+var multipart = require("esp32-javascript/multipart");
+
+var mode = scriptArgs[1] || "stream";
+var size = Number(scriptArgs[2] || 1048576);
+var chunkSize = Number(scriptArgs[3] || 1460);
+var boundary = "----esp32jsBenchBoundary7MA4YWxkTrZu0gW";
+
+function field(name, value) {
+  return (
+    "--" +
+    boundary +
+    '\r\nContent-Disposition: form-data; name="' +
+    name +
+    '"\r\n\r\n' +
+    value +
+    "\r\n"
+  );
+}
+
+function buildBody() {
+  var head =
+    field("ssid", "my-network") +
+    field("password", "secret") +
+    "--" +
+    boundary +
+    '\r\nContent-Disposition: form-data; name="file"; filename="upload.bin"' +
+    "\r\nContent-Type: application/octet-stream\r\n\r\n";
+  var tail = "\r\n--" + boundary + "--\r\n";
+  // pseudo random content with a delimiter prefix every 4 KB, which has to
+  // be passed on as content
+  var near = "\r\n--" + boundary.substring(0, 20);
+  var body = new Uint8Array(head.length + size + tail.length);
+  var seed = 1;
+  var i;
+  for (i = 0; i < head.length; i++) {
+    body[i] = head.charCodeAt(i);
+  }
+  for (i = 0; i < size; i++) {
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+    body[head.length + i] =
+      i % 4096 < near.length ? near.charCodeAt(i % 4096) : (seed >> 16) & 0xff;
+  }
+  for (i = 0; i < tail.length; i++) {
+    body[head.length + size + i] = tail.charCodeAt(i);
+  }
+  return body;
+}
+
+var body = buildBody();
+var chunks = [];
+for (var offset = 0; offset < body.length; offset += chunkSize) {
+  chunks.push(body.subarray(offset, offset + chunkSize));
+}
+
+var req = {
+  method: "POST",
+  path: "/upload",
+  body: null,
+  headers: new Headers({
+    "content-type": "multipart/form-data; boundary=" + boundary,
+  }),
+};
+var received = 0;
+var heapBefore = el_getHeapStats(true).used;
+var start = el_hrtime();
+
+var options = multipart.receiveMultipart(req, {
+  onPart: function (part) {
+    if (part.filename) {
+      return {
+        onData: function (chunk) {
+          received += chunk.length;
+        },
+      };
+    }
+  },
+});
+var resume = function () {};
+if (mode === "buffered") {
+  var parts = [];
+  chunks.forEach(function (chunk) {
+    // received pieces are separate buffers
+    parts.push(new Uint8Array(chunk));
+  });
+  var joined = new Uint8Array(body.length);
+  var position = 0;
+  parts.forEach(function (part) {
+    joined.set(part, position);
+    position += part.length;
+  });
+  parts = null;
+  options.onData(joined, resume);
+  joined = null;
+} else {
+  chunks.forEach(function (chunk) {
+    options.onData(new Uint8Array(chunk), resume);
+  });
+}
+options.onEnd(true);
+
+var seconds = (el_hrtime() - start) / 1e6;
+var heap = el_getHeapStats(false);
+var form = req.form;
+var ok =
+  form.complete &&
+  !form.error &&
+  received === size &&
+  form.fields.ssid === "my-network" &&
+  form.fields.password === "secret";
+print(
+  JSON.stringify({
+    name: "multipart-" + mode,
+    bytes: body.length,
+    chunkSize: chunkSize,
+    errors: ok ? 0 : 1,
+    seconds: seconds,
+    megabytesPerSecond: Math.round((body.length / 1048576 / seconds) * 10) / 10,
+    heapPeak: heap.peak - heapBefore,
+    heapAllocs: heap.allocs,
+  })
+);
@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2020 Marcel Kottmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// FreeRTOS tasks are pthreads on the host.
+#if !defined(HOST_FREERTOS_TASK_H_INCLUDED)
+#define HOST_FREERTOS_TASK_H_INCLUDED
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+
+typedef pthread_t *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct
+{
+    TaskFunction_t fn;
+    void *arg;
+} host_task_start_t;
+
+static void *host_task_run(void *start)
+{
+    host_task_start_t task = *(host_task_start_t *)start;
+    free(start);
+    task.fn(task.arg);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth,
+                                                 void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    host_task_start_t *start = (host_task_start_t *)malloc(sizeof(host_task_start_t));
+    pthread_t *thread = (pthread_t *)malloc(sizeof(pthread_t));
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, host_task_run, start) != 0)
+    {
+        free(start);
+        free(thread);
+        return pdFAIL;
+    }
+    pthread_detach(*thread);
+    if (handle)
+    {
+        *handle = thread;
+    }
+    return pdPASS;
+}
+
+#endif
@@ -0,0 +1,154 @@
+#!/bin/bash
+
+# Runs the http benchmarks on the host and prints the results as one JSON
+# document, e.g. to compare commits:
+#
+#   tools/host-bench/run.sh > bench-$(git rev-parse --short HEAD).json
+#
+# REQUESTS scales the number of requests per run (default 5000).
+
+set -e
+
+cd "$(dirname "$0")"
+./build.sh >&2
+
+REQUESTS=${REQUESTS:-5000}
+SERVER_PORT=${SERVER_PORT:-18080}
+CLIENT_PORT=${CLIENT_PORT:-18081}
+SERVER_PORT2=${SERVER_PORT2:-18082}
+BROKER_PORT=${BROKER_PORT:-18083}
+DNS_PORT=${DNS_PORT:-18084}
+TLS_PORT=${TLS_PORT:-18085}
+SSE_PORT=${SSE_PORT:-18086}
+TELEMETRY_PORT=${TELEMETRY_PORT:-18087}
+RESULTS=()
+
+run() {
+  local result
+  result=$("$@") || echo "run failed: $*" >&2
+  if [ -n "$result" ]; then
+    RESULTS+=("$result")
+  fi
+}
+
+# a 100 KB file for the file serving benchmarks, host-bench maps /data to build/fs/data
+mkdir -p build/fs/data
+head -c 102400 /dev/zero | tr '\0' x > build/fs/data/bench-102400.txt
+
+# server benchmarks, maxConnections is raised to allow 200 connections
+build/host-bench server.js $SERVER_PORT 0 >&2 &
+SERVER=$!
+trap 'kill $SERVER $CLIENT_SERVER $BROKER $TELEMETRY $DNS $TLS_SERVER 2>/dev/null' EXIT
+sleep 1
+
+L="build/loadgen -p $SERVER_PORT -s /_stats"
+for c in 1 10 50 200; do
+  run $L -N keepalive-c$c -c $c -n $REQUESTS /small
+done
+for c in 1 10 50; do
+  run $L -N close-c$c -k -c $c -n $REQUESTS /small
+done
+run $L -N pipeline8-c10 -c 10 -P 8 -n $REQUESTS /small
+run $L -N chunked-c10 -c 10 -n $REQUESTS /chunked
+run $L -N large64k-c10 -c 10 -n $((REQUESTS / 10)) "/large?size=65536"
+run $L -N post16k-c10 -c 10 -n $((REQUESTS / 5)) -b 16384 /echo
+for c in 1 10; do
+  run $L -N sendfile100k-c$c -c $c -n $((REQUESTS / 10)) "/file?size=102400"
+  run $L -N readfile100k-c$c -c $c -n $((REQUESTS / 10)) "/readfile?size=102400"
+done
+
+# client benchmarks against the load generator
+build/loadgen -S -p $CLIENT_PORT &
+CLIENT_SERVER=$!
+sleep 0.5
+for c in 1 8; do
+  run build/host-bench client.js $CLIENT_PORT $REQUESTS $c
+  run build/host-bench client.js $CLIENT_PORT $REQUESTS $c fetch
+done
+run build/host-bench client.js $CLIENT_PORT $REQUESTS 8 close
+
+# connects to a hostname answered by "loadgen -D" after 20 ms, with and without cached lookups
+build/loadgen -D 20 -p $DNS_PORT &
+DNS=$!
+sleep 0.5
+for c in 1 8; do
+  run env HOST_BENCH_DNS_PORT=$DNS_PORT build/host-bench dns.js $CLIENT_PORT 50 $c
+  run env HOST_BENCH_DNS_PORT=$DNS_PORT build/host-bench dns.js $CLIENT_PORT 200 $c cached
+done
+
+# full and resumed TLS handshakes against a TLS server of host-bench, full
+# handshakes also from 8 and 32 concurrent clients
+build/host-bench tls.js server $TLS_PORT >&2 &
+TLS_SERVER=$!
+sleep 0.5
+run build/host-bench tls.js client $TLS_PORT $((REQUESTS / 10)) 1
+run build/host-bench tls.js client $TLS_PORT $((REQUESTS / 10)) 1 resume
+for c in 8 32; do
+  run build/host-bench tls.js client $TLS_PORT $((REQUESTS / 10)) $c
+done
+
+# websocket echo round trips and the same polled over http, server and clients in one process
+for c in 1 8; do
+  run build/host-bench websocket.js $SERVER_PORT2 $REQUESTS $c
+  run build/host-bench websocket.js $SERVER_PORT2 $REQUESTS $c 64 poll
+  run build/host-bench websocket.js $SERVER_PORT2 $((REQUESTS / 2)) $c 64 poll-close
+done
+run build/host-bench websocket.js $SERVER_PORT2 $((REQUESTS / 5)) 8 4096
+
+# CPU per server-sent event broadcast to 1 and 16 subscribers, shared and written per client
+for m in shared write; do
+  for s in 1 16; do
+    (sleep 0.5; build/host-bench sse.js subscribe $SSE_PORT $s) &
+    run build/host-bench sse.js serve $SSE_PORT $s $((REQUESTS / 2)) $m
+    wait $!
+  done
+done
+
+# MQTT publishes echoed by "loadgen -M", with 1 and 8 messages in flight, and
+# the same messages as http POSTs to "loadgen -S"
+build/loadgen -M -p $BROKER_PORT &
+BROKER=$!
+build/loadgen -S -b 2 -p $TELEMETRY_PORT &
+TELEMETRY=$!
+sleep 0.5
+run build/host-bench mqtt.js $BROKER_PORT $REQUESTS 1
+run build/host-bench mqtt.js $BROKER_PORT $REQUESTS 8
+run build/host-bench mqtt.js $BROKER_PORT $REQUESTS 8 1
+run build/host-bench mqtt.js $TELEMETRY_PORT $REQUESTS 1 http
+run build/host-bench mqtt.js $TELEMETRY_PORT $REQUESTS 8 http
+
+# 1 MB multipart upload, parsed while it arrives and after buffering it
+run build/host-bench multipart.js stream
+run build/host-bench multipart.js buffered
+
+# header maps of a typical request and response, native and the former polyfill
+for s in request response; do
+  run build/host-bench headers.js native $s
+  run build/host-bench headers.js polyfill $s
+done
+
+# the access pattern of the former request parser, native byte buffer and the former StringBuffer
+for c in 64 536 1460; do
+  run build/host-bench stringbuffer.js native 2000 $c
+  run build/host-bench stringbuffer.js old 2000 $c
+done
+
+# 200 KB of JSON streamed in chunks, written to a file and with JSON.stringify
+for m in stream file stringify; do
+  run build/host-bench json.js $m 200
+done
+
+# telemetry payloads of 50 and 500 readings as CBOR, JSON and with the streaming CBOR array encoder
+for n in 50 500; do
+  for m in cbor json stream; do
+    run build/host-bench cbor.js $m $n
+  done
+done
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+echo "{\"commit\":\"$COMMIT\",\"date\":\"$(date -u +%Y-%m-%dT%H:%M:%SZ)\",\"requestsPerRun\":$REQUESTS,\"results\":["
+for i in "${!RESULTS[@]}"; do
+  [ $i -gt 0 ] && echo ","
+  echo -n "${RESULTS[$i]}"
+done
+echo "]}"
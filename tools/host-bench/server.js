@@ -0,0 +1,92 @@
+/*
+ * Benchmark server for the host runtime, started by run.sh:
+ *
+ *     build/host-bench server.js [port] [maxConnections]
+ *
+ * GET  /small          short body with content-length
+ * GET  /chunked        4 KB body in 8 chunked writes
+ * GET  /large?size=n   n bytes with content-length, written in 4 KB parts
+ * POST /echo           answers with the length of the received body
+ * GET  /file?size=n    /data/bench-n.txt with res.sendFile
+ * GET  /readfile?size=n the same file with readFile and res.end, the former way
+ * GET  /_stats         heap and timer statistics as JSON, ?reset=1 resets the
+ *                      peak and the counters
+ */
+require("esp32-javascript/global.js");
+global.Promise = require("esp32-javascript/promise.js").Promise;
+var fetchApi = require("esp32-javascript/fetch");
+global.Headers = fetchApi.Esp32JsHeaders;
+require("socket-events");
+var eventloop = require("esp32-js-eventloop");
+var http = require("esp32-javascript/http");
+
+var port = Number(scriptArgs[1] || 8080);
+http.httpServerLimits.maxConnections = Number(scriptArgs[2] || 0);
+
+var part = new Array(4097).join("x");
+var chunk = new Array(513).join("c");
+
+function handle(req, res) {
+  var url = urlparse("http://localhost" + req.path);
+  var path = url.pathname;
+  if (path === "/small") {
+    res.headers.set("content-type", "text/plain");
+    res.headers.set("content-length", "12");
+    res.end("hello world\n");
+  } else if (path === "/chunked") {
+    res.headers.set("content-type", "text/plain");
+    for (var i = 0; i < 8; i++) {
+      res.write(chunk);
+    }
+    res.end();
+  } else if (path === "/large") {
+    var size = Number(http.parseQueryStr(url.search.substring(1)).size || 65536);
+    res.headers.set("content-type", "application/octet-stream");
+    res.headers.set("content-length", String(size));
+    for (var written = 0; written + part.length < size; written += part.length) {
+      res.write(part);
+    }
+    res.end(part.substring(0, size - written));
+  } else if (path === "/file" || path === "/readfile") {
+    var file = "/data/bench-" + http.parseQueryStr(url.search.substring(1)).size + ".txt";
+    res.headers.set("content-type", "text/plain");
+    if (path === "/file") {
+      res.sendFile(file);
+    } else {
+      var content = readFile(file);
+      res.headers.set("content-length", String(content.length));
+      res.end(content);
+    }
+  } else if (path === "/echo") {
+    var length = String(req.body ? req.body.length : 0);
+    res.headers.set("content-type", "text/plain");
+    res.headers.set("content-length", String(length.length));
+    res.end(length);
+  } else if (path === "/_stats") {
+    var reset = http.parseQueryStr(url.search.substring(1)).reset === "1";
+    var heap = el_getHeapStats(reset);
+    var timers = el_getTimerStats(reset);
+    var sockets = el_getSocketStats();
+    var body = JSON.stringify({
+      heapUsed: heap.used,
+      heapPeak: heap.peak,
+      heapAllocs: heap.allocs,
+      openSockets: sockets.openSockets,
+      timersStarted: timers.started,
+      timersStopped: timers.stopped,
+    });
+    res.headers.set("content-type", "application/json");
+    res.headers.set("content-length", String(body.length));
+    res.end(body);
+  } else {
+    res.setStatus(404, "Not Found");
+    res.headers.set("content-length", "0");
+    res.end();
+  }
+}
+
+global.main = function () {
+  http.httpServer(port, false, handle);
+  print("listening on " + port);
+};
+eventloop.start();
@@ -0,0 +1,162 @@
+/*
+ * Server-sent events benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench sse.js serve port subscribers broadcasts shared|write
+ *     build/host-bench sse.js subscribe port subscribers
+ *
+ * The server waits for subscribers event streams and then broadcasts an
+ * 80 byte reading broadcasts times, one per event-loop turn. "shared" uses
+ * Esp32JsEventStream, which encodes an event once for all clients, "write"
+ * keeps one chunked response per client and calls res.write and res.flush
+ * for each, the way events were pushed before. A broadcast is timed in CPU
+ * time of the JS thread from the call until it returns, the writes to the
+ * sockets happen within the call. The subscribers read in a separate
+ * process until the server closes the streams. Prints the results of the
+ * server as JSON.
+ */
+require("esp32-javascript/global.js");
+global.Promise = require("esp32-javascript/promise.js").Promise;
+var fetchApi = require("esp32-javascript/fetch");
+global.Headers = fetchApi.Esp32JsHeaders;
+var socketEvents = require("socket-events");
+var eventloop = require("esp32-js-eventloop");
+var http = require("esp32-javascript/http");
+var eventStream = require("esp32-javascript/event-stream");
+
+var mode = scriptArgs[1] || "serve";
+var port = Number(scriptArgs[2] || 8080);
+var subscribers = Number(scriptArgs[3] || 1);
+var broadcasts = Number(scriptArgs[4] || 1000);
+var shared = scriptArgs[5] !== "write";
+
+http.httpServerLimits.maxConnections = 0;
+
+var stream = new eventStream.Esp32JsEventStream({
+  heartbeatInterval: 0,
+  maxBufferedAmount: 64 * 1024,
+});
+var responses = [];
+var durations = [];
+var sent = 0;
+
+function percentile(sorted, p) {
+  return sorted.length > 0
+    ? sorted[Math.round(p * (sorted.length - 1))]
+    : 0;
+}
+
+function reading(i) {
+  return JSON.stringify({
+    sensor: "greenhouse-1",
+    seq: i,
+    temperature: 21.5,
+    humidity: 48.25,
+    ts: 1700000000 + i,
+  });
+}
+
+function broadcast() {
+  var data = reading(sent);
+  var before = el_cpuTime();
+  if (shared) {
+    stream.broadcast(data);
+  } else {
+    var text = "data: " + data + "\n\n";
+    for (var i = 0; i < responses.length; i++) {
+      responses[i].write(text);
+      responses[i].flush();
+    }
+  }
+  durations.push(el_cpuTime() - before);
+  if (++sent < broadcasts) {
+    setTimeout(broadcast, 0);
+  } else {
+    report();
+  }
+}
+
+function report() {
+  var sorted = durations.slice().sort(function (a, b) {
+    return a - b;
+  });
+  var total = durations.reduce(function (sum, d) {
+    return sum + d;
+  }, 0);
+  var heap = el_getHeapStats(false);
+  print(
+    JSON.stringify({
+      name: "sse-" + (shared ? "shared" : "write") + "-s" + subscribers,
+      subscribers: subscribers,
+      broadcasts: sent,
+      eventBytes: reading(0).length,
+      usPerBroadcastMean: Math.round((total / sent) * 10) / 10,
+      usPerBroadcastP50: percentile(sorted, 0.5),
+      usPerBroadcastP99: percentile(sorted, 0.99),
+      heapPeak: heap.peak,
+    })
+  );
+  if (shared) {
+    stream.close();
+  } else {
+    responses.forEach(function (res) {
+      res.end();
+    });
+  }
+  setTimeout(function () {
+    exit(0);
+  }, 100);
+}
+
+function subscribed() {
+  var count = shared ? stream.clientCount() : responses.length;
+  if (count === subscribers) {
+    el_getHeapStats(true);
+    setTimeout(broadcast, 0);
+  }
+}
+
+function subscribe() {
+  var open = subscribers;
+  for (var i = 0; i < subscribers; i++) {
+    socketEvents.sockConnect(
+      false,
+      "127.0.0.1",
+      String(port),
+      function (socket) {
+        socket.write(
+          "GET /events HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n"
+        );
+        socket.flush();
+      },
+      function () {},
+      function () {
+        console.error("subscribing failed");
+        exit(1);
+      },
+      function () {
+        if (--open === 0) {
+          exit(0);
+        }
+      }
+    );
+  }
+}
+
+global.main = function () {
+  if (mode === "subscribe") {
+    subscribe();
+    return;
+  }
+  http.httpServer(port, false, function (req, res) {
+    if (shared) {
+      stream.accept(req, res);
+    } else {
+      res.headers.set("content-type", "text/event-stream");
+      res.headers.set("cache-control", "no-cache");
+      res.write();
+      responses.push(res);
+    }
+    subscribed();
+  });
+};
+eventloop.start();
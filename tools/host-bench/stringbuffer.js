@@ -0,0 +1,193 @@
+/*
+ * Byte buffer benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench stringbuffer.js native|old [requests] [chunkSize]
+ *
+ * Feeds pipelined POST requests in chunks of chunkSize bytes through the
+ * access pattern of the former JS request parser of httpServer: append
+ * each chunk, search the end of the head, read the head and the body and
+ * drop the request from the front. "old" is the former JS StringBuffer for
+ * comparison, "native" the ByteBuffer replacing it.
+ */
+require("esp32-javascript/global.js");
+var ByteBuffer = require("esp32-javascript/stringbuffer").ByteBuffer;
+
+var mode = scriptArgs[1] || "native";
+var requests = Number(scriptArgs[2] || 2000);
+var chunkSize = Number(scriptArgs[3] || 536);
+
+// the implementation in stringbuffer.js before the native buffer
+function OldStringBuffer(s) {
+  this.content = [];
+  this.length = 0;
+  if (typeof s === "string") {
+    this.append(s);
+  }
+}
+OldStringBuffer.prototype.indexOf = function (searchString, position) {
+  return this.toString().indexOf(searchString, position);
+};
+OldStringBuffer.prototype.toString = function () {
+  if (this.content.length === 1) {
+    return this.content[0].toString();
+  }
+  var s = this.content.join("");
+  this.content = [s];
+  return s;
+};
+OldStringBuffer.prototype.append = function () {
+  for (var i = 0; i < arguments.length; i++) {
+    this.length += arguments[i].length;
+    this.content.push(arguments[i]);
+  }
+  return this;
+};
+OldStringBuffer.prototype.substring = function (s, e) {
+  if (typeof e === "undefined") {
+    e = this.length;
+  }
+  s = Math.min(Math.max(s, 0), this.length);
+  e = Math.min(Math.max(e, 0), this.length);
+  var ns = new OldStringBuffer();
+  if (this.content.length > 0) {
+    var accs = 0;
+    var i = 0;
+    for (i = 0; i < this.content.length; i++) {
+      if (s <= accs + this.content[i].length) {
+        break;
+      } else {
+        accs += this.content[i].length;
+      }
+    }
+    var acce = 0;
+    var ei = 0;
+    for (ei = 0; ei < this.content.length; ei++) {
+      if (e <= acce + this.content[ei].length) {
+        break;
+      } else {
+        acce += this.content[ei].length;
+      }
+    }
+    if (i === ei) {
+      ns.append(this.content[i].substring(s - accs, e - acce));
+    } else {
+      ns.append(this.content[i].substring(s - accs));
+      this.content.slice(i + 1, ei).forEach(function (e) {
+        ns.append(e);
+      });
+      ns.append(this.content[ei].substring(0, e - acce));
+    }
+  }
+  return ns;
+};
+
+var body = new Array(1025).join("0123456789abcdef").substring(0, 2000);
+var request =
+  "POST /setup HTTP/1.1\r\n" +
+  "Host: 192.168.4.1\r\n" +
+  "Connection: keep-alive\r\n" +
+  "Authorization: Basic YWRtaW46YWRtaW4=\r\n" +
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/86.0 Safari/537.36\r\n" +
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n" +
+  "Accept-Encoding: gzip, deflate\r\n" +
+  "Accept-Language: de-DE,de;q=0.9,en;q=0.8\r\n" +
+  "Content-Type: application/x-www-form-urlencoded\r\n" +
+  "Content-Length: " +
+  body.length +
+  "\r\n\r\n" +
+  body;
+
+var stream = new Array(requests + 1).join(request);
+
+// calls onData with the stream in chunks like the socket would
+function receive(onData) {
+  for (var i = 0; i < stream.length; i += chunkSize) {
+    onData(stream.substring(i, i + chunkSize));
+  }
+}
+
+function contentLength(head) {
+  var match = /\r\ncontent-length:\s*(\d+)/i.exec(head);
+  return match ? parseInt(match[1], 10) : 0;
+}
+
+function parseOld() {
+  var parsed = 0;
+  var complete = null;
+  var endOfHeaders = -1;
+  var length = 0;
+  receive(function (data) {
+    complete = complete ? complete.append(data) : new OldStringBuffer(data);
+    while (true) {
+      if (endOfHeaders < 0) {
+        endOfHeaders = complete.indexOf("\r\n\r\n");
+        if (endOfHeaders < 0) {
+          return;
+        }
+        length = contentLength(complete.substring(0, endOfHeaders).toString());
+      }
+      if (complete.length < endOfHeaders + 4 + length) {
+        return;
+      }
+      var content = complete
+        .substring(endOfHeaders + 4, endOfHeaders + 4 + length)
+        .toString();
+      parsed += content.length === length ? 1 : 0;
+      complete = complete.substring(endOfHeaders + 4 + length);
+      endOfHeaders = -1;
+    }
+  });
+  return parsed;
+}
+
+function parseNative() {
+  var parsed = 0;
+  var buffer = new ByteBuffer();
+  var scanned = 0;
+  var endOfHeaders = -1;
+  var length = 0;
+  receive(function (data) {
+    buffer.append(data);
+    while (true) {
+      if (endOfHeaders < 0) {
+        endOfHeaders = buffer.indexOf("\r\n\r\n", scanned);
+        if (endOfHeaders < 0) {
+          // the delimiter may start in the last 3 bytes
+          scanned = Math.max(buffer.length - 3, 0);
+          return;
+        }
+        length = contentLength(buffer.toString(0, endOfHeaders));
+      }
+      if (buffer.length < endOfHeaders + 4 + length) {
+        return;
+      }
+      var content = buffer.toBytes(endOfHeaders + 4, endOfHeaders + 4 + length);
+      parsed += content.length === length ? 1 : 0;
+      buffer.consume(endOfHeaders + 4 + length);
+      endOfHeaders = -1;
+      scanned = 0;
+    }
+  });
+  return parsed;
+}
+
+var heapBefore = el_getHeapStats(true).used;
+var start = el_hrtime();
+var parsed = mode === "old" ? parseOld() : parseNative();
+var micros = el_hrtime() - start;
+var heap = el_getHeapStats(false);
+if (parsed !== requests) {
+  throw Error("parsed " + parsed + " of " + requests + " requests");
+}
+print(
+  JSON.stringify({
+    name: "stringbuffer-" + mode + "-" + chunkSize,
+    requests: requests,
+    chunkSize: chunkSize,
+    seconds: micros / 1e6,
+    megabytesPerSecond: Math.round((stream.length / micros) * 10) / 10,
+    microsPerRequest: Math.round((micros / requests) * 100) / 100,
+    heapPeak: heap.peak - heapBefore,
+    allocsPerRequest: Math.round((heap.allocs / requests) * 10) / 10,
+  })
+);
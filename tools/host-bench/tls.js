@@ -0,0 +1,144 @@
+/*
+ * TLS handshake benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench tls.js server port
+ *     build/host-bench tls.js client port handshakes concurrency [resume]
+ *
+ * The server accepts TLS connections with sockListen and closes them once
+ * the handshake completed. The client keeps concurrency connections in
+ * handshake with sockConnect and closes each one when it is established.
+ * Without "resume" the session cache is cleared before each connect, so
+ * every handshake is a full one. A latency is the time from sockConnect
+ * until the connection is established. A first connection before the run
+ * creates the context and the cached session. tlsBefore is the memory
+ * allocated by OpenSSL after it, tlsPeak the high-water mark during the
+ * run. Prints the results of the client as JSON in the format of loadgen.
+ */
+require("esp32-javascript/global.js");
+var socketEvents = require("socket-events");
+var eventloop = require("esp32-js-eventloop");
+
+var mode = scriptArgs[1] || "server";
+var port = scriptArgs[2] || "8443";
+var handshakes = Number(scriptArgs[3] || 1000);
+var concurrency = Number(scriptArgs[4] || 1);
+var resume = scriptArgs.indexOf("resume") >= 0;
+
+var issued = 0;
+var completed = 0;
+var resumed = 0;
+var errors = 0;
+var latencies = [];
+var start = 0;
+var tlsBefore = 0;
+
+function percentile(sorted, p) {
+  return sorted.length > 0
+    ? sorted[Math.round(p * (sorted.length - 1))] / 1000
+    : 0;
+}
+
+function report() {
+  var seconds = (el_hrtime() - start) / 1e6;
+  var sorted = latencies.sort(function (a, b) {
+    return a - b;
+  });
+  var heap = el_getHeapStats(false);
+  print(
+    JSON.stringify({
+      name: "tls-" + (resume ? "resume" : "full") + "-c" + concurrency,
+      path: "127.0.0.1:" + port,
+      connections: concurrency,
+      requests: completed,
+      errors: errors,
+      resumed: resumed,
+      seconds: seconds,
+      requestsPerSecond: Math.round((completed / seconds) * 10) / 10,
+      p50Ms: percentile(sorted, 0.5),
+      p99Ms: percentile(sorted, 0.99),
+      maxMs: percentile(sorted, 1),
+      client: { tlsBefore: tlsBefore, tlsPeak: heap.tlsPeak },
+    })
+  );
+  exit(errors > 0 ? 1 : 0);
+}
+
+function next() {
+  if (issued < handshakes) {
+    issued++;
+    connect(next);
+  } else if (completed + errors === handshakes) {
+    report();
+  }
+}
+
+function connect(done) {
+  var ended = false;
+  var sentAt = el_hrtime();
+  function end(ok) {
+    if (!ended) {
+      ended = true;
+      if (ok) {
+        completed++;
+        latencies.push(el_hrtime() - sentAt);
+      } else {
+        errors++;
+      }
+      done();
+    }
+  }
+  if (!resume) {
+    el_clearTlsSessionCache();
+  }
+  socketEvents.sockConnect(
+    true,
+    "127.0.0.1",
+    port,
+    function (socket) {
+      if (socket.sslResumed) {
+        resumed++;
+      }
+      end(true);
+      socketEvents.closeSocket(socket);
+    },
+    function () {},
+    function () {
+      end(false);
+    },
+    function () {
+      end(false);
+    }
+  );
+}
+
+global.main = function () {
+  if (mode === "server") {
+    socketEvents.sockListen(
+      port,
+      function (socket) {
+        socketEvents.closeSocket(socket);
+      },
+      function () {
+        console.error("listen failed on " + port);
+        exit(1);
+      },
+      function () {},
+      true,
+      { maxConnections: 0 }
+    );
+    print("listening on " + port);
+  } else {
+    connect(function () {
+      completed = 0;
+      errors = 0;
+      resumed = 0;
+      latencies = [];
+      tlsBefore = el_getHeapStats(true).tlsUsed;
+      start = el_hrtime();
+      for (var i = 0; i < concurrency; i++) {
+        next();
+      }
+    });
+  }
+};
+eventloop.start();
@@ -0,0 +1,163 @@
+/*
+ * Websocket benchmark for the host runtime, started by run.sh:
+ *
+ *     build/host-bench websocket.js port messages connections [size] [poll|poll-close]
+ *
+ * Starts an echo server with acceptWebSocket and opens connections clients
+ * with connectWebSocket in the same process. Every client keeps one binary
+ * message of size bytes (64) in flight, a message is completed when its
+ * echo arrived. With "poll" the clients instead poll size bytes of state
+ * from httpServer with httpClient over keep-alive connections, with
+ * "poll-close" over a new connection per poll. Server and client share the
+ * heap, so heapPeak covers both sides. Prints the results as JSON in the
+ * format of loadgen.
+ */
+require("esp32-javascript/global.js");
+global.Promise = require("esp32-javascript/promise.js").Promise;
+var fetchApi = require("esp32-javascript/fetch");
+global.Headers = fetchApi.Esp32JsHeaders;
+require("socket-events");
+var eventloop = require("esp32-js-eventloop");
+var http = require("esp32-javascript/http");
+var websocket = require("esp32-javascript/websocket");
+
+var port = Number(scriptArgs[1] || 8080);
+var messages = Number(scriptArgs[2] || 10000);
+var connections = Number(scriptArgs[3] || 1);
+var size = Number(scriptArgs[4] || 64);
+var mode = scriptArgs[5] || "websocket";
+var poll = mode !== "websocket";
+
+http.httpServerLimits.maxConnections = 0;
+http.httpClientPool.keepAlive = mode !== "poll-close";
+http.httpClientPool.maxSocketsPerHost = connections;
+
+var payload = new Uint8Array(size);
+var issued = 0;
+var completed = 0;
+var bytesIn = 0;
+var latencies = [];
+var opened = 0;
+var start = 0;
+
+function percentile(sorted, p) {
+  return sorted.length > 0
+    ? sorted[Math.round(p * (sorted.length - 1))] / 1000
+    : 0;
+}
+
+function report() {
+  var seconds = (el_hrtime() - start) / 1e6;
+  var sorted = latencies.sort(function (a, b) {
+    return a - b;
+  });
+  var heap = el_getHeapStats(false);
+  print(
+    JSON.stringify({
+      name: mode + "-c" + connections + "-" + size,
+      path: poll ? "/state" : "/ws",
+      connections: connections,
+      pipeline: 1,
+      keepAlive: mode !== "poll-close",
+      requests: completed,
+      errors: 0,
+      seconds: seconds,
+      requestsPerSecond: Math.round((completed / seconds) * 10) / 10,
+      p50Ms: percentile(sorted, 0.5),
+      p99Ms: percentile(sorted, 0.99),
+      maxMs: percentile(sorted, 1),
+      bytesIn: bytesIn,
+      heapPeak: heap.peak,
+    })
+  );
+  exit(0);
+}
+
+function next(ws) {
+  if (issued < messages) {
+    issued++;
+    ws.sentAt = el_hrtime();
+    ws.send(payload);
+  } else if (completed === messages) {
+    report();
+  }
+}
+
+function openClient() {
+  var ws = websocket.connectWebSocket("ws://127.0.0.1:" + port + "/ws", {
+    pingInterval: 0,
+  });
+  ws.onopen = function () {
+    if (++opened === connections) {
+      el_getHeapStats(true);
+      start = el_hrtime();
+      for (var i = 0; i < clients.length; i++) {
+        next(clients[i]);
+      }
+    }
+  };
+  ws.onmessage = function (data) {
+    completed++;
+    bytesIn += data.length;
+    latencies.push(el_hrtime() - ws.sentAt);
+    next(ws);
+  };
+  ws.onerror = function (message) {
+    console.error(message);
+    exit(1);
+  };
+  return ws;
+}
+
+function nextPoll() {
+  if (issued < messages) {
+    issued++;
+    var sentAt = el_hrtime();
+    http.httpClient(false, "127.0.0.1", String(port), "/state", "GET", "", undefined,
+      function (content) {
+        completed++;
+        bytesIn += content.length;
+        latencies.push(el_hrtime() - sentAt);
+        nextPoll();
+      },
+      function (message) {
+        console.error(message);
+        exit(1);
+      }
+    );
+  } else if (completed === messages) {
+    report();
+  }
+}
+
+var clients = [];
+var state = new Array(size + 1).join("s");
+
+global.main = function () {
+  http.httpServer(port, false, function (req, res) {
+    if (poll) {
+      res.headers.set("content-type", "text/plain");
+      res.headers.set("content-length", String(size));
+      res.end(state);
+      return;
+    }
+    var ws = websocket.acceptWebSocket(req, res, { pingInterval: 0 });
+    if (ws) {
+      ws.onmessage = function (data) {
+        ws.send(data);
+      };
+    }
+  });
+  if (poll) {
+    el_getHeapStats(true);
+    start = el_hrtime();
+    for (var i = 0; i < connections; i++) {
+      nextPoll();
+    }
+  } else {
+    for (var i = 0; i < connections; i++) {
+      clients.push(openClient());
+    }
+  }
+};
+eventloop.start();